@@ -0,0 +1,80 @@
+#pragma once
+
+#include "piano_roll/cc_lane.hpp"
+#include "piano_roll/note_manager.hpp"
+#include "piano_roll/types.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace piano_roll {
+
+// Kind of event produced by the offline bounce. The enumerator order is the
+// ordering used for events that share a tick: note-offs first (so a note can
+// retrigger on the same tick), then controller changes, then note-ons.
+enum class BounceEventType : std::uint8_t {
+    NoteOff = 0,
+    ControlChange = 1,
+    NoteOn = 2,
+};
+
+// A single MIDI-style event in the merged output stream. For note events
+// data1/data2 are key/velocity, for controller events cc number/value.
+struct BounceEvent {
+    Tick tick{0};
+    BounceEventType type{BounceEventType::NoteOn};
+    Channel channel{0};
+    int data1{0};
+    int data2{0};
+    std::uint32_t clip{0};  // index into the clips passed to bounce_clips
+};
+
+// One clip placed on the project timeline. The referenced containers must
+// outlive the bounce call and must not be modified while it runs.
+struct BounceClip {
+    const NoteManager* notes{nullptr};
+    const std::vector<ControlLane>* lanes{nullptr};
+    Tick tick_offset{0};     // added to every event tick
+    int key_offset{0};       // transposition; notes leaving 0-127 are dropped
+    Channel cc_channel{0};   // MIDI channel used for the clip's CC events
+};
+
+struct BounceOptions {
+    // Events are extracted and merged one window of this many ticks at a
+    // time. Per clip, the working set is the events of one window plus the
+    // pending note-offs of notes still sounding at its end; it does not
+    // grow with the total number of notes.
+    Tick window_ticks{480 * 4 * 16};
+
+    // Worker threads used for per-clip event extraction; 0 picks
+    // std::thread::hardware_concurrency(). 1 runs everything inline.
+    unsigned max_threads{0};
+};
+
+using BounceSink = std::function<void(const BounceEvent&)>;
+
+// Flatten many clips into a single stream ordered by (tick, event type,
+// clip, key/cc) and hand it to `sink` event by event. Each window takes
+// a clip's note-ons from NoteManager::for_each_in_range and its note-offs
+// from a per-clip heap of notes already started, and advances a cursor per
+// CC lane; windows are extracted in parallel across clips and combined with
+// a k-way heap merge, so the output never has to be sorted as a whole.
+//
+// CC lanes are evaluated analytically (segment_value): every breakpoint is
+// sent, plus one event inside each non-Hold segment at every tick where the
+// rounded 0-127 value changes, so shaped and linear ramps play as ramps on
+// any MIDI receiver rather than as steps.
+//
+// Returns the number of events delivered to the sink.
+std::size_t bounce_clips(const std::vector<BounceClip>& clips,
+                         const BounceSink& sink,
+                         const BounceOptions& options = {});
+
+// Convenience wrapper collecting the bounced stream into a vector.
+std::vector<BounceEvent> bounce_clips_to_vector(
+    const std::vector<BounceClip>& clips,
+    const BounceOptions& options = {});
+
+}  // namespace piano_roll
@@ -3,17 +3,92 @@
 #include "piano_roll/types.hpp"
 
 #include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <future>
+#include <iterator>
+#include <span>
 #include <vector>
 
 namespace piano_roll {
 
-// Single control point in a MIDI CC lane.
+// Shape of the segment running from a control point to the next one.
+// `tension` (in [-1, 1]) bends Exponential and Bezier segments; 0 makes
+// both of them linear.
+//   Linear      – straight line.
+//   Hold        – keeps the point's value until the next point (a step).
+//   Exponential – slow start / fast finish for positive tension, the
+//                 reverse for negative (fades, filter sweeps).
+//   Bezier      – S-shaped ease in/out for positive tension, steep start and
+//                 finish with a flat middle for negative.
+enum class CurveShape : std::uint8_t {
+    Linear = 0,
+    Hold = 1,
+    Exponential = 2,
+    Bezier = 3,
+};
+
+inline constexpr int kCurveShapeCount = 4;
+
+// Single control point in a MIDI CC lane. The shape fields describe the
+// segment from this point to the next one and are ignored on the last
+// point.
 struct ControlPoint {
     Tick tick{0};
     int value{0};  // 0-127
+    bool selected{false};
+    CurveShape shape{CurveShape::Linear};
+    float tension{0.0f};
+
+    bool operator==(const ControlPoint&) const = default;
+};
+
+// Normalized segment curve: maps u in [0, 1] to the fraction of the value
+// change reached at that point of the segment.
+double curve_shape_fraction(CurveShape shape, float tension, double u) noexcept;
+
+// Value of the segment from `from` to `to` at a (fractional) tick between
+// them, evaluated analytically from from.shape / from.tension.
+double segment_value(const ControlPoint& from,
+                     const ControlPoint& to,
+                     double tick) noexcept;
+
+// Parameters for ControlLane::simplify. Dropped points are guaranteed to lie
+// within max_value_error of the curve between the kept points around them.
+//
+// By default the reduction is linear: dropped points lie near the straight
+// segment between kept points, points closer than min_tick_spacing to the
+// previously kept point are never kept (except for value jumps at a single
+// tick and the final point; this takes precedence over the error bound),
+// and points that start or end a shaped segment are always kept.
+//
+// With fit_shapes, the input is treated as dense samples and each kept
+// segment may become Hold, Exponential or Bezier when that covers more
+// samples than a straight line would, so sampled fades and sweeps collapse
+// to a handful of shaped segments. min_tick_spacing is ignored then.
+struct SimplifyOptions {
+    double max_value_error{1.0};
+    Tick min_tick_spacing{0};
+    bool fit_shapes{false};
 };
 
-// Simple MIDI CC lane: a CC number with a list of control points.
+struct SimplifyResult {
+    std::size_t points_before{0};
+    std::size_t points_after{0};
+
+    std::size_t removed() const noexcept { return points_before - points_after; }
+};
+
+// Linear-time, error-bounded reduction of a tick-sorted point list (a
+// "swinging door" variant that keeps original points). Selection flags of
+// kept points are preserved.
+std::vector<ControlPoint> simplify_control_points(
+    const std::vector<ControlPoint>& points,
+    const SimplifyOptions& options);
+
+// Simple MIDI CC lane: a CC number with a list of control points kept sorted
+// by tick. Points carry a selection flag; batched edits operate on all
+// selected points at once and record a single snapshot-based undo step.
 class ControlLane {
 public:
     ControlLane() = default;
@@ -32,14 +107,35 @@ public:
         return points_;
     }
 
-    // Add a new point and keep the lane sorted by tick.
-    void add_point(Tick tick, int value) {
-        ControlPoint p{tick, clamp_value(value)};
-        points_.push_back(p);
-        std::sort(points_.begin(), points_.end(),
-                  [](const ControlPoint& a, const ControlPoint& b) {
-                      return a.tick < b.tick;
-                  });
+    // Add a new point and keep the lane sorted by tick. A point sharing its
+    // tick with existing points goes after them (a value jump).
+    void add_point(Tick tick,
+                   int value,
+                   CurveShape shape = CurveShape::Linear,
+                   float tension = 0.0f) {
+        ControlPoint p{tick, clamp_value(value), false, shape,
+                       clamp_tension(tension)};
+        points_.insert(
+            std::upper_bound(points_.begin(), points_.end(), tick, tick_less),
+            p);
+    }
+
+    // Add many points at once (e.g. when loading): equivalent to calling
+    // add_point for each in order, but sorts the batch once and merges it
+    // into the lane instead of shifting the lane on every insert.
+    void add_points(std::span<const ControlPoint> points) {
+        const std::size_t old_size = points_.size();
+        points_.reserve(old_size + points.size());
+        for (const ControlPoint& p : points) {
+            points_.push_back(ControlPoint{p.tick,
+                                           clamp_value(p.value),
+                                           false,
+                                           p.shape,
+                                           clamp_tension(p.tension)});
+        }
+        auto middle = points_.begin() + static_cast<std::ptrdiff_t>(old_size);
+        std::stable_sort(middle, points_.end(), tick_order);
+        std::inplace_merge(points_.begin(), middle, points_.end(), tick_order);
     }
 
     // Remove the first point whose tick is within max_delta of the given tick.
@@ -89,29 +185,434 @@ public:
         p->value = clamp_value(value);
     }
 
-    // Update tick and keep lane sorted.
-    void set_tick(int index, Tick tick) {
+    // Update tick and keep lane sorted. Only the moved point is shifted into
+    // place; returns the point's new index (or -1 for an invalid index).
+    int set_tick(int index, Tick tick) {
         ControlPoint* p = point_at_index(index);
         if (!p) {
-            return;
+            return -1;
         }
         p->tick = tick;
-        std::sort(points_.begin(), points_.end(),
-                  [](const ControlPoint& a, const ControlPoint& b) {
-                      return a.tick < b.tick;
-                  });
+        auto it = points_.begin() + index;
+        auto dest = std::upper_bound(points_.begin(), it, tick, tick_less);
+        if (dest != it) {
+            std::rotate(dest, it, it + 1);
+            return static_cast<int>(dest - points_.begin());
+        }
+        dest = std::lower_bound(it + 1, points_.end(), tick, point_less);
+        std::rotate(it, it + 1, dest);
+        return static_cast<int>(dest - points_.begin()) - 1;
+    }
+
+    // Set the shape of the segment starting at index.
+    void set_shape(int index, CurveShape shape, float tension = 0.0f) {
+        ControlPoint* p = point_at_index(index);
+        if (!p) {
+            return;
+        }
+        p->shape = shape;
+        p->tension = clamp_tension(tension);
+    }
+
+    // Set the shape of every segment starting at a selected point, as one
+    // undo step.
+    bool set_selected_shape(CurveShape shape,
+                            float tension,
+                            bool record_undo = true) {
+        if (!has_selection()) {
+            return false;
+        }
+        if (record_undo) {
+            push_undo_state();
+        }
+        for (ControlPoint& p : points_) {
+            if (p.selected) {
+                p.shape = shape;
+                p.tension = clamp_tension(tension);
+            }
+        }
+        return true;
+    }
+
+    // Analytic lane value at a (fractional) tick. Before the first point the
+    // first value holds, after the last point the last value; an empty lane
+    // evaluates to 0.
+    double value_at(double tick) const noexcept;
+
+    // Evaluate the lane at start_tick + i * step_ticks for every element of
+    // `out` (block sampling for playback). The segment is located once and
+    // then advanced incrementally, so a block costs O(log n + out.size()).
+    void sample_block(double start_tick,
+                      double step_ticks,
+                      std::span<float> out) const noexcept;
+
+    // Selection.
+    std::size_t selected_count() const noexcept {
+        return static_cast<std::size_t>(
+            std::count_if(points_.begin(), points_.end(),
+                          [](const ControlPoint& p) { return p.selected; }));
+    }
+
+    bool has_selection() const noexcept {
+        return std::any_of(points_.begin(), points_.end(),
+                           [](const ControlPoint& p) { return p.selected; });
+    }
+
+    void clear_selection() noexcept {
+        for (ControlPoint& p : points_) {
+            p.selected = false;
+        }
+    }
+
+    void select_all() noexcept {
+        for (ControlPoint& p : points_) {
+            p.selected = true;
+        }
+    }
+
+    void select_index(int index, bool add_to_selection = false) noexcept {
+        if (!add_to_selection) {
+            clear_selection();
+        }
+        if (ControlPoint* p = point_at_index(index)) {
+            p->selected = true;
+        }
+    }
+
+    // Select points with start_tick <= tick < end_tick and a value within
+    // [min_value, max_value] (rectangle selection in the lane, or a pure
+    // time-range selection with the default value bounds). Returns the
+    // number of points newly selected.
+    std::size_t select_range(Tick start_tick,
+                             Tick end_tick,
+                             int min_value = 0,
+                             int max_value = 127,
+                             bool add_to_selection = false) noexcept {
+        if (!add_to_selection) {
+            clear_selection();
+        }
+        std::size_t count = 0;
+        auto first = std::lower_bound(
+            points_.begin(), points_.end(), start_tick, point_less);
+        for (auto it = first; it != points_.end() && it->tick < end_tick;
+             ++it) {
+            if (it->value >= min_value && it->value <= max_value &&
+                !it->selected) {
+                it->selected = true;
+                ++count;
+            }
+        }
+        return count;
+    }
+
+    // Batched edits on the selected points. Each is a single linear pass.
+    //
+    // translate_selected moves all selected points by delta_tick (clamped at
+    // tick 0) and delta_value (clamped to 0-127). Moving by a constant keeps
+    // the selected points ordered among themselves, so the lane is restored
+    // with one std::merge of the selected and unselected runs instead of a
+    // re-sort.
+    bool translate_selected(Tick delta_tick,
+                            int delta_value,
+                            bool record_undo = true) {
+        if (!has_selection()) {
+            return false;
+        }
+        if (record_undo) {
+            push_undo_state();
+        }
+
+        std::vector<ControlPoint> moved;
+        std::vector<ControlPoint> kept;
+        moved.reserve(points_.size());
+        kept.reserve(points_.size());
+        for (const ControlPoint& p : points_) {
+            if (!p.selected) {
+                kept.push_back(p);
+                continue;
+            }
+            ControlPoint q = p;
+            q.tick = std::max<Tick>(0, q.tick + delta_tick);
+            q.value = clamp_value(q.value + delta_value);
+            moved.push_back(q);
+        }
+        if (delta_tick == 0) {
+            // Order is unchanged; write values back in place.
+            std::size_t m = 0;
+            for (ControlPoint& p : points_) {
+                if (p.selected) {
+                    p = moved[m++];
+                }
+            }
+            return true;
+        }
+        points_.clear();
+        std::merge(kept.begin(), kept.end(), moved.begin(), moved.end(),
+                   std::back_inserter(points_), tick_order);
+        return true;
+    }
+
+    // value' = pivot + (value - pivot) * scale + offset, clamped to 0-127.
+    // Ticks are untouched, so no reordering is needed.
+    bool scale_selected_values(double scale,
+                               int offset,
+                               int pivot = 0,
+                               bool record_undo = true) {
+        if (!has_selection()) {
+            return false;
+        }
+        if (record_undo) {
+            push_undo_state();
+        }
+        for (ControlPoint& p : points_) {
+            if (!p.selected) {
+                continue;
+            }
+            double v = static_cast<double>(pivot) +
+                       static_cast<double>(p.value - pivot) * scale +
+                       static_cast<double>(offset);
+            p.value = clamp_value(static_cast<int>(v < 0.0 ? v - 0.5
+                                                           : v + 0.5));
+        }
+        return true;
+    }
+
+    // Remove all selected points. Returns the number removed.
+    std::size_t delete_selected(bool record_undo = true) {
+        if (!has_selection()) {
+            return 0;
+        }
+        if (record_undo) {
+            push_undo_state();
+        }
+        std::size_t before = points_.size();
+        points_.erase(std::remove_if(points_.begin(), points_.end(),
+                                     [](const ControlPoint& p) {
+                                         return p.selected;
+                                     }),
+                      points_.end());
+        return before - points_.size();
+    }
+
+    // Ripple edits, matching NoteManager::ripple_insert / ripple_delete:
+    // points at or after the edit point move by the same amount in place
+    // (their order is unchanged), and the undo entry keeps only the removed
+    // points. ripple_insert returns the number of points moved;
+    // ripple_delete drops the points in [start_tick, end_tick), pulls later
+    // ones back and returns the number moved or removed.
+    std::size_t ripple_insert(Tick tick, Tick length, bool record_undo = true) {
+        tick = std::max<Tick>(tick, 0);
+        auto first =
+            std::lower_bound(points_.begin(), points_.end(), tick, point_less);
+        if (length <= 0 || first == points_.end()) {
+            return 0;
+        }
+        const auto moved = static_cast<std::size_t>(points_.end() - first);
+        ripple_points(tick, length);
+        if (record_undo) {
+            push_undo_entry(UndoEntry{{}, true, tick, length});
+        }
+        return moved;
+    }
+
+    std::size_t ripple_delete(Tick start_tick,
+                              Tick end_tick,
+                              bool record_undo = true) {
+        start_tick = std::max<Tick>(start_tick, 0);
+        auto first = std::lower_bound(
+            points_.begin(), points_.end(), start_tick, point_less);
+        if (end_tick <= start_tick || first == points_.end()) {
+            return 0;
+        }
+        const auto changed = static_cast<std::size_t>(points_.end() - first);
+        std::vector<ControlPoint> removed =
+            ripple_points(start_tick, start_tick - end_tick);
+        if (record_undo) {
+            push_undo_entry(UndoEntry{
+                std::move(removed), true, start_tick, start_tick - end_tick});
+        }
+        return changed;
+    }
+
+    // Reduce the lane's point count (see SimplifyOptions). Recorded as one
+    // undo step when anything is removed.
+    SimplifyResult simplify(const SimplifyOptions& options,
+                            bool record_undo = true) {
+        SimplifyResult result{points_.size(), points_.size()};
+        std::vector<ControlPoint> reduced =
+            simplify_control_points(points_, options);
+        if (reduced.size() == points_.size()) {
+            return result;
+        }
+        replace_points(std::move(reduced), record_undo);
+        result.points_after = points_.size();
+        return result;
+    }
+
+    // Replace all points (which must be sorted by tick) as one edit.
+    void replace_points(std::vector<ControlPoint> points,
+                        bool record_undo = true) {
+        if (record_undo) {
+            push_undo_state();
+        }
+        points_ = std::move(points);
+    }
+
+    // Undo / redo support (snapshot-based, mirroring NoteManager).
+    void set_max_undo_levels(std::size_t levels) { max_undo_levels_ = levels; }
+
+    void snapshot_for_undo() { push_undo_state(); }
+
+    bool can_undo() const noexcept { return !undo_stack_.empty(); }
+    bool can_redo() const noexcept { return !redo_stack_.empty(); }
+
+    // Undo group tags, as in NoteManager::set_undo_group.
+    void set_undo_group(std::uint64_t group) noexcept {
+        if (!undo_stack_.empty()) {
+            undo_stack_.back().group = group;
+        }
+    }
+    std::uint64_t undo_group() const noexcept {
+        return undo_stack_.empty() ? 0 : undo_stack_.back().group;
+    }
+    std::uint64_t redo_group() const noexcept {
+        return redo_stack_.empty() ? 0 : redo_stack_.back().group;
+    }
+
+    bool undo() {
+        if (undo_stack_.empty()) {
+            return false;
+        }
+        UndoEntry entry = std::move(undo_stack_.back());
+        undo_stack_.pop_back();
+        if (entry.ripple) {
+            unripple_points(entry);
+            redo_stack_.push_back(std::move(entry));
+            return true;
+        }
+        redo_stack_.push_back(UndoEntry{points_});
+        redo_stack_.back().group = entry.group;
+        points_ = std::move(entry.points);
+        return true;
+    }
+
+    bool redo() {
+        if (redo_stack_.empty()) {
+            return false;
+        }
+        UndoEntry entry = std::move(redo_stack_.back());
+        redo_stack_.pop_back();
+        if (entry.ripple) {
+            ripple_points(entry.ripple_tick, entry.ripple_delta);
+            undo_stack_.push_back(std::move(entry));
+            return true;
+        }
+        undo_stack_.push_back(UndoEntry{points_});
+        undo_stack_.back().group = entry.group;
+        points_ = std::move(entry.points);
+        return true;
     }
 
 private:
+    // A full copy of the points, or for a ripple edit (delta > 0 inserted
+    // at ripple_tick, delta < 0 deleted from it) only the removed points.
+    struct UndoEntry {
+        std::vector<ControlPoint> points;
+        bool ripple{false};
+        Tick ripple_tick{0};
+        Tick ripple_delta{0};
+        std::uint64_t group{0};
+    };
+
     int cc_number_{1};
     std::vector<ControlPoint> points_;
 
+    std::vector<UndoEntry> undo_stack_;
+    std::vector<UndoEntry> redo_stack_;
+    std::size_t max_undo_levels_{100};
+
+    void push_undo_state() { push_undo_entry(UndoEntry{points_}); }
+
+    void push_undo_entry(UndoEntry&& entry) {
+        undo_stack_.push_back(std::move(entry));
+        if (undo_stack_.size() > max_undo_levels_) {
+            undo_stack_.erase(undo_stack_.begin());
+        }
+        redo_stack_.clear();
+    }
+
+    // Shift the points at or after `tick` by delta; a negative delta first
+    // removes the points in [tick, tick - delta) and returns them.
+    std::vector<ControlPoint> ripple_points(Tick tick, Tick delta) {
+        std::vector<ControlPoint> removed;
+        auto first =
+            std::lower_bound(points_.begin(), points_.end(), tick, point_less);
+        if (delta < 0) {
+            auto last = std::lower_bound(
+                first, points_.end(), tick - delta, point_less);
+            removed.assign(first, last);
+            first = points_.erase(first, last);
+        }
+        for (auto it = first; it != points_.end(); ++it) {
+            it->tick += delta;
+        }
+        return removed;
+    }
+
+    // Revert ripple_points: shift back, then put the removed run back in
+    // the gap it left.
+    void unripple_points(const UndoEntry& entry) {
+        const Tick shifted_from =
+            entry.ripple_tick + std::max<Tick>(entry.ripple_delta, 0);
+        auto first = std::lower_bound(
+            points_.begin(), points_.end(), shifted_from, point_less);
+        for (auto it = first; it != points_.end(); ++it) {
+            it->tick -= entry.ripple_delta;
+        }
+        points_.insert(first, entry.points.begin(), entry.points.end());
+    }
+
+    static bool tick_order(const ControlPoint& a,
+                           const ControlPoint& b) noexcept {
+        return a.tick < b.tick;
+    }
+    static bool point_less(const ControlPoint& p, Tick tick) noexcept {
+        return p.tick < tick;
+    }
+    static bool tick_less(Tick tick, const ControlPoint& p) noexcept {
+        return tick < p.tick;
+    }
+
     static int clamp_value(int value) noexcept {
         if (value < 0) return 0;
         if (value > 127) return 127;
         return value;
     }
+
+    static float clamp_tension(float tension) noexcept {
+        return std::clamp(tension, -1.0f, 1.0f);
+    }
 };
 
-}  // namespace piano_roll
+// Simplifies every lane of a project on a background thread. start() copies
+// the lanes' points, so the UI keeps editing freely; apply() (called from
+// the UI thread once ready()) installs the results as one undo step per
+// lane, skipping lanes whose points changed since start().
+class LaneSimplifyJob {
+public:
+    void start(const std::vector<ControlLane>& lanes,
+               const SimplifyOptions& options);
+
+    bool running() const noexcept { return result_.valid(); }
+    bool ready() const;
 
+    // Blocks if the job has not finished yet. Returns one result per lane
+    // passed to start(); skipped lanes report no change.
+    std::vector<SimplifyResult> apply(std::vector<ControlLane>& lanes);
+
+private:
+    std::vector<std::vector<ControlPoint>> inputs_;
+    std::future<std::vector<std::vector<ControlPoint>>> result_;
+};
+
+}  // namespace piano_roll
@@ -3,9 +3,51 @@
 #include "piano_roll/cc_lane.hpp"
 #include "piano_roll/coordinate_system.hpp"
 #include "piano_roll/render_config.hpp"
+#include "piano_roll/types.hpp"
+
+#include <vector>
 
 namespace piano_roll {
 
+// Horizontal mapping shared by every CC lane drawn in one frame. The
+// visible tick window and the tick boundaries of each pixel column depend
+// only on the viewport, so they are computed once per frame and reused by
+// all stacked lanes instead of being recomputed per lane and per point.
+struct ControlLaneFrame {
+    float left{0.0f};   // screen x where the lane area starts (after keys)
+    float right{0.0f};  // screen x where the lane area ends
+
+    // Screen x of a tick is x_at_tick_zero + tick * pixels_per_tick.
+    double x_at_tick_zero{0.0};
+    double pixels_per_tick{0.0};
+
+    // Visible tick window [visible_start, visible_end).
+    Tick visible_start{0};
+    Tick visible_end{0};
+
+    // column_ticks[c] is the first tick drawn at or right of the left edge
+    // of pixel column c; the final entry closes the last column, so there
+    // are column_count() + 1 entries.
+    std::vector<Tick> column_ticks;
+
+    std::size_t column_count() const noexcept {
+        return column_ticks.empty() ? 0 : column_ticks.size() - 1;
+    }
+
+    float tick_to_x(Tick tick) const noexcept {
+        return static_cast<float>(x_at_tick_zero +
+                                  static_cast<double>(tick) * pixels_per_tick);
+    }
+};
+
+// Recompute `frame` for the current viewport. canvas_min_x/canvas_max_x are
+// the screen-space horizontal bounds of the whole piano roll (piano keys
+// included). The column buffer is reused across frames.
+void update_control_lane_frame(ControlLaneFrame& frame,
+                               const CoordinateSystem& coords,
+                               float canvas_min_x,
+                               float canvas_max_x);
+
 // Render a MIDI CC lane under the notes grid, using the rectangle of the
 // last ImGui item as the overall piano roll area. When built without
 // PIANO_ROLL_USE_IMGUI this function does nothing.
@@ -13,5 +55,17 @@ void RenderControlLane(const ControlLane& lane,
                        const CoordinateSystem& coords,
                        const PianoRollRenderConfig& config);
 
-}  // namespace piano_roll
+// Render one lane of a stack between the screen-space rows lane_top and
+// lane_bottom using a precomputed frame. Only points inside the frame's
+// tick window are visited; when a lane has more visible points than pixel
+// columns, each column is drawn as a single min/max stroke so the cost is
+// bounded by the lane width rather than the point count. `active` marks
+// the lane receiving edits.
+void RenderControlLane(const ControlLane& lane,
+                       const ControlLaneFrame& frame,
+                       float lane_top,
+                       float lane_bottom,
+                       const PianoRollRenderConfig& config,
+                       bool active = true);
 
+}  // namespace piano_roll
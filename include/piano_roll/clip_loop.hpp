@@ -0,0 +1,82 @@
+#pragma once
+
+#include "piano_roll/note_manager.hpp"
+#include "piano_roll/types.hpp"
+
+#include <algorithm>
+#include <optional>
+
+namespace piano_roll {
+
+// Looped clip content shown after the clip end, as in Bitwig: the notes in
+// [start, end) repeat `repetitions` times, each repetition offset by one
+// clip length. Repetitions are drawn as ghosts straight from the clip's
+// notes; nothing is copied into the NoteManager.
+struct ClipLoop {
+    Tick start{0};
+    Tick end{0};
+    int repetitions{0};
+
+    Tick length() const noexcept { return end - start; }
+    bool enabled() const noexcept { return repetitions > 0 && end > start; }
+
+    // Tick span occupied by repetition r (1-based): [end + (r-1)L, end + rL).
+    Tick repetition_start(int repetition) const noexcept {
+        return end + static_cast<Tick>(repetition - 1) * length();
+    }
+
+    // Repetitions overlapping ticks [from, to), as a 1-based inclusive range.
+    // Returns false when none do.
+    bool repetitions_in(Tick from,
+                        Tick to,
+                        int& first,
+                        int& last) const noexcept {
+        if (!enabled() || to <= end) {
+            return false;
+        }
+        const Tick loop_end = repetition_start(repetitions + 1);
+        from = std::max(from, end);
+        to = std::min(to, loop_end);
+        if (from >= to) {
+            return false;
+        }
+        first = static_cast<int>((from - end) / length()) + 1;
+        last = static_cast<int>((to - 1 - end) / length()) + 1;
+        return true;
+    }
+
+    // Map a tick inside a ghost repetition back to the clip. Returns the
+    // source tick and sets `repetition`, or nullopt outside the repetitions.
+    std::optional<Tick> to_source(Tick tick, int& repetition) const noexcept {
+        int first = 0;
+        int last = 0;
+        if (!repetitions_in(tick, tick + 1, first, last)) {
+            return std::nullopt;
+        }
+        repetition = first;
+        return tick - static_cast<Tick>(repetition) * length();
+    }
+};
+
+// Read-only hit test against the ghost repetitions: the clip note drawn at
+// (tick, key), or nullptr. Only the part of a note inside [start, end) is
+// repeated, so notes are matched within the clip span only. `repetition`
+// (optional) receives the 1-based repetition that was hit.
+inline const Note* ghost_note_at(const NoteManager& notes,
+                                 const ClipLoop& loop,
+                                 Tick tick,
+                                 MidiKey key,
+                                 int* repetition = nullptr) {
+    int hit_repetition = 0;
+    std::optional<Tick> source = loop.to_source(tick, hit_repetition);
+    if (!source.has_value() || *source < loop.start) {
+        return nullptr;
+    }
+    const Note* note = notes.note_at(*source, key);
+    if (note != nullptr && repetition != nullptr) {
+        *repetition = hit_repetition;
+    }
+    return note;
+}
+
+}  // namespace piano_roll
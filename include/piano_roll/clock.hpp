@@ -0,0 +1,55 @@
+#pragma once
+
+#include <chrono>
+
+namespace piano_roll {
+
+// Monotonic time source, in seconds, for timing-dependent UI behaviour
+// (scrollbar double-clicks, the piano-key flash, edge scrolling, playback
+// stepping). Components read it instead of the system clock or ImGui's
+// frame delta, so benchmark and replay harnesses can install a
+// VirtualClock and run frames faster than real time with identical
+// results. Performance HUD timings still measure real time.
+class Clock {
+public:
+    virtual ~Clock() = default;
+    virtual double now_seconds() const noexcept = 0;
+};
+
+// std::chrono::steady_clock; the default for every component.
+class SteadyClock final : public Clock {
+public:
+    double now_seconds() const noexcept override {
+        return std::chrono::duration<double>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+};
+
+// Shared SteadyClock instance used when no clock is installed.
+inline const Clock& default_clock() noexcept {
+    static const SteadyClock clock;
+    return clock;
+}
+
+// Clock that only moves when told to, e.g. by 1/60 s before each replayed
+// frame.
+class VirtualClock final : public Clock {
+public:
+    explicit VirtualClock(double start_seconds = 0.0) noexcept
+        : now_(start_seconds) {}
+
+    double now_seconds() const noexcept override { return now_; }
+
+    void set(double seconds) noexcept { now_ = seconds; }
+    void advance(double seconds) noexcept {
+        if (seconds > 0.0) {
+            now_ += seconds;
+        }
+    }
+
+private:
+    double now_;
+};
+
+}  // namespace piano_roll
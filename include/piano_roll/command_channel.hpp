@@ -0,0 +1,308 @@
+#pragma once
+
+#include "piano_roll/note_manager.hpp"
+#include "piano_roll/shared_snapshot.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <span>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace piano_roll {
+
+// Local IPC command channel: test rigs and scripts drive a NoteManager
+// from another process over a Unix-domain stream socket, without the UI.
+//
+// Clients send batches of binary commands; the server's I/O thread only
+// frames them, and the UI thread applies queued batches once per frame in
+// CommandServer::process. A batch is validated as a whole before anything
+// is applied (a malformed batch changes nothing) and its edits form one
+// undo step. Every batch gets one response carrying each command's result
+// plus how long the batch waited for a frame and how long it took to
+// apply.
+//
+// Wire format (native byte order; the socket is local only):
+//   CommandBatchHeader, then command_count x (CommandHeader + payload)
+//   CommandResponseHeader, then result_count x (CommandResultHeader +
+//   payload)
+// Note records use SharedNoteRecord from shared_snapshot.hpp.
+//
+// POSIX only; on other platforms start/connect fail with an error message.
+
+inline constexpr std::uint32_t kCommandBatchMagic = 0x43525050;     // "PPRC"
+inline constexpr std::uint32_t kCommandResponseMagic = 0x52525050;  // "PPRR"
+inline constexpr std::uint16_t kCommandProtocolVersion = 1;
+
+enum class CommandOpcode : std::uint16_t {
+    // SharedNoteRecord[] -> assigned NoteIds (std::uint64_t[], 0 = skipped).
+    // Ids in the records are ignored; kSharedSelected selects the note.
+    InsertNotes = 1,
+    // CommandNoteMove[] -> count of notes moved. Applied as one
+    // NoteManager::apply_note_edits batch; unknown ids and moves leaving
+    // the valid range are skipped.
+    MoveNotes = 2,
+    // CommandNoteFilter -> count of notes selected.
+    SelectWhere = 3,
+    // CommandRange -> SharedNoteRecord[] of the notes overlapping it.
+    QueryRange = 4,
+    // (no payload) -> SharedNoteRecord[] of every note.
+    Snapshot = 5,
+};
+
+enum class CommandStatus : std::uint16_t {
+    Ok = 0,
+    Malformed = 1,      // batch rejected, nothing applied
+    UnknownOpcode = 2,  // batch rejected, nothing applied
+};
+
+struct CommandBatchHeader {
+    std::uint32_t magic;
+    std::uint16_t version;
+    std::uint16_t command_count;
+    std::uint32_t batch_id;
+    std::uint32_t payload_size;  // bytes following this header
+};
+
+struct CommandHeader {
+    std::uint16_t opcode;
+    std::uint16_t reserved;
+    std::uint32_t size;  // payload bytes following this header
+};
+
+struct CommandResponseHeader {
+    std::uint32_t magic;
+    std::uint16_t version;
+    std::uint16_t result_count;
+    std::uint32_t batch_id;
+    std::uint16_t status;  // CommandStatus of the batch
+    std::uint16_t reserved;
+    std::uint64_t queued_ns;  // received by the I/O thread -> apply start
+    std::uint64_t apply_ns;   // apply start -> response queued
+    std::uint64_t revision;   // NoteManager::revision() after the batch
+    std::uint32_t payload_size;
+    std::uint32_t reserved2;
+};
+
+struct CommandResultHeader {
+    std::uint16_t opcode;
+    std::uint16_t status;
+    std::uint32_t count;
+    std::uint32_t size;  // payload bytes following this header
+    std::uint32_t reserved;
+};
+
+struct CommandNoteMove {
+    std::uint64_t id;
+    std::int64_t delta_tick;
+    std::int32_t delta_key;
+    std::uint32_t reserved;
+};
+
+inline constexpr std::uint8_t kCommandAnyChannel = 0xff;
+
+// Notes overlapping [start_tick, end_tick) on keys [min_key, max_key] with
+// velocity and channel in range.
+struct CommandNoteFilter {
+    std::int64_t start_tick;
+    std::int64_t end_tick;
+    std::int16_t min_key;
+    std::int16_t max_key;
+    std::uint8_t min_velocity;
+    std::uint8_t max_velocity;
+    std::uint8_t channel;  // kCommandAnyChannel for any
+    std::uint8_t add_to_selection;  // 0 replaces the selection
+};
+
+struct CommandRange {
+    std::int64_t start_tick;
+    std::int64_t end_tick;
+    std::int16_t min_key;
+    std::int16_t max_key;
+    std::uint32_t reserved;
+};
+
+static_assert(sizeof(CommandBatchHeader) == 16);
+static_assert(sizeof(CommandHeader) == 8);
+static_assert(sizeof(CommandResponseHeader) == 48);
+static_assert(sizeof(CommandResultHeader) == 16);
+static_assert(sizeof(CommandNoteMove) == 24);
+static_assert(sizeof(CommandNoteFilter) == 24);
+static_assert(sizeof(CommandRange) == 24);
+
+// Client-side builder for one batch.
+class CommandBatch {
+public:
+    void insert_notes(std::span<const Note> notes);
+    void move_notes(std::span<const CommandNoteMove> moves);
+    void select_where(const CommandNoteFilter& filter);
+    void query_range(Tick start_tick,
+                     Tick end_tick,
+                     MidiKey min_key = 0,
+                     MidiKey max_key = 127);
+    void snapshot();
+
+    // Filter matching every note, as a starting point for select_where.
+    static CommandNoteFilter match_all() noexcept;
+
+    std::size_t command_count() const noexcept { return command_count_; }
+    bool empty() const noexcept { return command_count_ == 0; }
+    void clear() noexcept;
+
+    // Header plus commands, ready to send.
+    std::vector<unsigned char> encode(std::uint32_t batch_id) const;
+
+private:
+    std::vector<unsigned char> payload_;
+    std::size_t command_count_{0};
+
+    void append(CommandOpcode opcode, const void* data, std::size_t size);
+};
+
+struct CommandResult {
+    CommandOpcode opcode{CommandOpcode::Snapshot};
+    CommandStatus status{CommandStatus::Ok};
+    std::uint32_t count{0};
+    std::vector<NoteId> ids;                // InsertNotes
+    std::vector<SharedNoteRecord> notes;    // QueryRange, Snapshot
+};
+
+struct CommandBatchResult {
+    std::uint32_t batch_id{0};
+    CommandStatus status{CommandStatus::Ok};
+    std::uint64_t queued_ns{0};
+    std::uint64_t apply_ns{0};
+    std::uint64_t revision{0};
+    std::vector<CommandResult> results;
+};
+
+struct CommandServerOptions {
+    // Batches larger than this close the connection.
+    std::size_t max_batch_bytes{64u << 20};
+    std::size_t max_clients{16};
+    // While this many batches wait for process(), the I/O thread stops
+    // reading from clients, so a fast writer backs up in its own socket
+    // buffer instead of in server memory.
+    std::size_t max_pending_batches{256};
+    // Record one NoteManager undo step per batch that changes notes.
+    bool record_undo{true};
+};
+
+// Per-batch latency and throughput counters, updated by process().
+struct CommandServerStats {
+    std::uint64_t batches{0};
+    std::uint64_t commands{0};
+    std::uint64_t rejected{0};
+    std::uint64_t notes_inserted{0};
+    std::uint64_t notes_moved{0};
+    std::uint64_t last_queued_ns{0};
+    std::uint64_t last_apply_ns{0};
+    std::uint64_t max_apply_ns{0};
+    std::uint64_t total_queued_ns{0};
+    std::uint64_t total_apply_ns{0};
+};
+
+class CommandServer {
+public:
+    explicit CommandServer(CommandServerOptions options = {});
+    ~CommandServer();
+    CommandServer(const CommandServer&) = delete;
+    CommandServer& operator=(const CommandServer&) = delete;
+
+    // Listen on the socket path (replacing a stale socket file; mode 0600)
+    // and start the I/O thread. Returns false and sets error() on failure.
+    bool start(const std::string& socket_path);
+    void stop();
+    bool running() const noexcept { return io_thread_.joinable(); }
+
+    // UI thread, once per frame: apply up to max_batches queued batches to
+    // `notes` in arrival order and queue their responses. Returns the
+    // number of batches processed.
+    std::size_t process(NoteManager& notes,
+                        std::size_t max_batches = static_cast<std::size_t>(-1));
+
+    std::size_t pending_batches() const;
+    const CommandServerStats& stats() const noexcept { return stats_; }
+    const std::string& error() const noexcept { return error_; }
+
+private:
+    struct PendingBatch {
+        std::uint64_t client{0};
+        std::uint64_t received_ns{0};
+        std::vector<unsigned char> bytes;
+    };
+
+    struct Connection {
+        int fd{-1};
+        std::vector<unsigned char> input;
+        std::vector<unsigned char> output;
+        std::size_t output_sent{0};
+    };
+
+    CommandServerOptions options_;
+    std::string path_;
+    std::string error_;
+    int listen_fd_{-1};
+    int wake_read_fd_{-1};
+    int wake_write_fd_{-1};
+    std::atomic<bool> stopping_{false};
+    std::thread io_thread_;
+
+    // Shared between the I/O thread and process().
+    mutable std::mutex mutex_;
+    std::deque<PendingBatch> pending_;
+    std::unordered_map<std::uint64_t, std::vector<unsigned char>> outgoing_;
+
+    // I/O thread only.
+    std::unordered_map<std::uint64_t, Connection> connections_;
+    std::uint64_t next_client_{1};
+
+    // UI thread only.
+    CommandServerStats stats_{};
+    std::vector<PendingBatch> work_;
+
+    void io_loop();
+    bool read_connection(std::uint64_t id, Connection& connection);
+    bool write_connection(Connection& connection);
+    void wake() noexcept;
+    std::vector<unsigned char> apply_batch(NoteManager& notes,
+                                           const PendingBatch& batch);
+};
+
+// Blocking client for tests, scripts and benchmarks.
+class CommandClient {
+public:
+    CommandClient() = default;
+    ~CommandClient();
+    CommandClient(const CommandClient&) = delete;
+    CommandClient& operator=(const CommandClient&) = delete;
+
+    bool connect(const std::string& socket_path);
+    void close();
+    bool connected() const noexcept { return fd_ >= 0; }
+
+    // Send a batch without waiting; returns its id (0 on failure). Several
+    // batches may be in flight; responses arrive in sending order.
+    std::uint32_t send(const CommandBatch& batch);
+    // Wait for the next response.
+    bool receive(CommandBatchResult& result);
+    // send() + receive().
+    bool execute(const CommandBatch& batch, CommandBatchResult& result);
+
+    const std::string& error() const noexcept { return error_; }
+
+private:
+    int fd_{-1};
+    std::uint32_t next_batch_id_{1};
+    std::string error_;
+    std::vector<unsigned char> buffer_;
+
+    bool read_exact(void* data, std::size_t size);
+};
+
+}  // namespace piano_roll
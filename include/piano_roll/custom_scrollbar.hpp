@@ -1,5 +1,6 @@
 #pragma once
 
+#include "piano_roll/clock.hpp"
 #include "piano_roll/draggable_rectangle.hpp"
 
 #include <functional>
@@ -32,6 +33,12 @@ public:
     void set_explored_area(double min_pos, double max_pos);
     void expand_explored_area(double position);
 
+    // Time source for double-click detection (nullptr restores the
+    // default steady clock). Not owned; must outlive the scrollbar.
+    void set_clock(const Clock* clock) noexcept {
+        clock_ = clock != nullptr ? clock : &default_clock();
+    }
+
     // Interaction handlers. Return true if handled.
     bool handle_mouse_move(double mouse_x, double mouse_y);
     bool handle_mouse_down(double mouse_x, double mouse_y, int button);
@@ -99,6 +106,8 @@ private:
     double explored_max_{100.0};
 
     // Double-click detection.
+    const Clock* clock_{&default_clock()};
+    bool has_last_click_{false};
     double last_click_time_{0.0};
     double double_click_threshold_{0.8};
 
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+
+namespace piano_roll {
+
+// Per-note expression dimensions used by MPE instruments.
+enum class ExpressionDimension : std::uint8_t {
+    PitchBend = 0,  // value in [-1, 1], relative to the instrument bend range
+    Pressure = 1,   // value in [0, 1] (channel pressure / aftertouch)
+    Timbre = 2,     // value in [0, 1] (CC74 "slide")
+};
+
+inline constexpr int kExpressionDimensionCount = 3;
+
+// A single breakpoint of a per-note expression curve. Ticks are relative to
+// the owning note's start, so moving a note never touches its expression.
+struct ExpressionPoint {
+    ExpressionDimension dimension{ExpressionDimension::PitchBend};
+    std::uint32_t tick_offset{0};
+    float value{0.0f};
+};
+
+// Compact reference from a Note into the NoteManager-owned expression
+// arena: `count` points starting at `offset`, sorted by (dimension,
+// tick_offset). An empty reference means the note has no expression.
+struct ExpressionRef {
+    std::uint32_t offset{0};
+    std::uint32_t count{0};
+
+    bool empty() const noexcept { return count == 0; }
+};
+
+// Neutral value of a dimension when a note has no points for it.
+inline constexpr float expression_default_value(
+    ExpressionDimension dimension) noexcept {
+    return dimension == ExpressionDimension::Timbre ? 0.5f : 0.0f;
+}
+
+}  // namespace piano_roll
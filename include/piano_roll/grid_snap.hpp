@@ -79,10 +79,23 @@ public:
     Tick snap_tick_floor(Tick tick) const;
     Tick snap_tick_ceil(Tick tick) const;
 
-    // Magnetic snap: only snap if close to a grid line (in pixels).
+    // Magnetic snap: only snap if close to a grid line (in pixels). The
+    // two-argument form uses magnetic_range_pixels(), which PointerTool's
+    // snap-to-notes shares so grid and note snapping agree.
+    static constexpr double kDefaultMagneticRangePixels = 8.0;
+    void set_magnetic_range_pixels(double pixels) noexcept {
+        magnetic_range_pixels_ = pixels;
+    }
+    double magnetic_range_pixels() const noexcept {
+        return magnetic_range_pixels_;
+    }
+    std::pair<Tick, bool> magnetic_snap(Tick tick,
+                                        double pixels_per_beat) const {
+        return magnetic_snap(tick, pixels_per_beat, magnetic_range_pixels_);
+    }
     std::pair<Tick, bool> magnetic_snap(Tick tick,
                                         double pixels_per_beat,
-                                        double magnetic_range_pixels = 8.0) const;
+                                        double magnetic_range_pixels) const;
 
     // Grid/ruler helpers for rendering.
     std::vector<GridLine> grid_lines(Tick start_tick,
@@ -102,6 +115,7 @@ private:
     int beats_per_measure_{4};
 
     SnapMode snap_mode_{SnapMode::Adaptive};
+    double magnetic_range_pixels_{kDefaultMagneticRangePixels};
     SnapDivision snap_division_;
     SnapDivision grid_division_;
 
@@ -0,0 +1,117 @@
+#pragma once
+
+#include "piano_roll/note_manager.hpp"
+#include "piano_roll/types.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace piano_roll {
+
+// Sounding weight per pitch class (0 = C), in note ticks.
+using PitchClassProfile = std::array<double, 12>;
+
+enum class ChordQuality : std::uint8_t {
+    None,
+    Major,
+    Minor,
+    Diminished,
+    Augmented,
+    Sus2,
+    Sus4,
+    Dominant7,
+    Major7,
+    Minor7,
+    HalfDiminished7,
+    Power,
+};
+
+struct Chord {
+    int root{-1};  // pitch class, -1 without a chord
+    ChordQuality quality{ChordQuality::None};
+
+    bool valid() const noexcept { return quality != ChordQuality::None; }
+    bool operator==(const Chord&) const = default;
+};
+
+// Chord symbol such as "C", "F#m7" or "Bbsus4"; empty for no chord.
+std::string chord_name(const Chord& chord);
+
+// Best matching chord template for a profile. Chord tones count for a
+// template and other pitch classes against it, and the lowest sounding
+// pitch class (bass_pitch_class, -1 if unknown) is preferred as the root.
+// At least two chord tones must sound.
+Chord label_chord(const PitchClassProfile& profile, int bass_pitch_class = -1);
+
+// Key estimate from a profile (Krumhansl-Kessler key profiles).
+struct KeyEstimate {
+    int tonic{-1};  // pitch class, -1 for an empty profile
+    bool minor{false};
+    double correlation{0.0};
+
+    // Bit i set when pitch class i is in the key's major or natural minor
+    // scale; 0 without an estimate.
+    std::uint16_t scale_mask() const noexcept;
+};
+
+KeyEstimate estimate_key(const PitchClassProfile& profile);
+
+// Per-beat analysis of one beat of the clip.
+struct BeatHarmony {
+    // Ticks of each pitch class sounding inside the beat, summed over notes.
+    std::array<std::uint32_t, 12> weights{};
+    MidiKey bass{-1};  // lowest key sounding in the beat, -1 if silent
+    Chord chord;
+};
+
+// Harmonic analysis track: a pitch-class histogram and a chord label for
+// every beat of a NoteManager's notes, for chord symbols above the ruler
+// and scale highlighting on the key strip. sync() follows
+// NoteManager::dirty_ranges_since and recomputes only the beats the logged
+// spans touch, with one range query per run of dirty beats, and relabels
+// only the beats whose histogram changed. Readers (e.g. PianoRollRenderer)
+// use the cached beats and never scan the notes.
+class HarmonyAnalysis {
+public:
+    HarmonyAnalysis() = default;
+
+    // Bring the track up to date. A different manager or beat length than
+    // the previous call causes a full rebuild.
+    void sync(const NoteManager& notes, int ticks_per_beat);
+    void rebuild(const NoteManager& notes, int ticks_per_beat);
+
+    int ticks_per_beat() const noexcept { return ticks_per_beat_; }
+
+    // Beat i covers [i * ticks_per_beat, (i + 1) * ticks_per_beat). Beats
+    // past the end of the notes are absent (treat them as silent).
+    std::span<const BeatHarmony> beats() const noexcept { return beats_; }
+    const BeatHarmony* beat_at(Tick tick) const noexcept;
+
+    // Summed histogram of the beats overlapping [start_tick, end_tick).
+    PitchClassProfile profile(Tick start_tick, Tick end_tick) const noexcept;
+
+    // Beats whose histogram changed and were relabelled by the last sync()
+    // (all of them after a rebuild).
+    std::size_t beats_updated() const noexcept { return beats_updated_; }
+
+private:
+    const NoteManager* source_{nullptr};
+    std::uint64_t revision_{0};
+    int ticks_per_beat_{0};
+    std::vector<BeatHarmony> beats_;
+    std::size_t beats_updated_{0};
+    std::vector<DirtyRange> dirty_scratch_;
+    std::vector<BeatHarmony> previous_;
+
+    // Recompute beats [first, last) from the notes and relabel them.
+    void update_beats(const NoteManager& notes,
+                      std::size_t first,
+                      std::size_t last);
+    void add_note(const Note& note, std::size_t first, std::size_t last);
+};
+
+}  // namespace piano_roll
@@ -36,10 +36,20 @@ struct HoverState {
     HoverEdge edge{HoverEdge::None};
 };
 
+// How dragging a note edge resizes the rest of the selection.
+enum class GroupResizeMode {
+    // Every selected note's dragged edge moves by the same tick delta.
+    Absolute,
+    // The selection is stretched in time about its opposite edge: starts and
+    // ends scale by the factor the dragged note's edge implies.
+    Proportional,
+};
+
 // Pointer-based interaction controller for basic editing:
 // - Click to select notes.
 // - Drag to move notes.
-// - Drag near edges to resize notes.
+// - Drag near edges to resize notes (the whole selection when several notes
+//   are selected, see GroupResizeMode).
 // - Drag in empty space to perform rectangle selection.
 // - Double-click to create/delete notes.
 //
@@ -57,6 +67,31 @@ public:
         snap_ = snap_system;
     }
 
+    // Edit another NoteManager (e.g. the pattern behind an instance note).
+    // Only call between gestures.
+    void set_note_manager(NoteManager& notes) noexcept { notes_ = &notes; }
+
+    // Snap-to-notes: while dragging, resizing or creating notes, starts and
+    // ends also snap magnetically to the edges of other notes on any key,
+    // within the same pixel range as grid snapping. The nearer of the grid
+    // line and the note edge wins. Shift disables both. Off by default.
+    void set_snap_to_notes(bool enabled) noexcept { snap_to_notes_ = enabled; }
+    bool snap_to_notes() const noexcept { return snap_to_notes_; }
+
+    // Group resize behaviour when an edge of a selected note is dragged.
+    // Each frame the whole selection is recomputed from its state at the
+    // start of the gesture, clamped so no note runs into a neighbour on its
+    // key or drops below the minimum length, and written as one batched
+    // NoteManager edit; the gesture is a single undo step. In absolute mode
+    // each note stops at its own neighbour; in proportional mode the whole
+    // selection stops when any note reaches one.
+    void set_group_resize_mode(GroupResizeMode mode) noexcept {
+        group_resize_mode_ = mode;
+    }
+    GroupResizeMode group_resize_mode() const noexcept {
+        return group_resize_mode_;
+    }
+
     // Mouse event handlers.
     void on_mouse_down(MouseButton button,
                        double screen_x,
@@ -169,8 +204,32 @@ private:
 
     // Configuration
     double edge_threshold_world_{5.0};  // pixels (world X units)
+    bool snap_to_notes_{false};
     Duration default_note_duration_{480};  // one beat at 480 TPB
 
+    GroupResizeMode group_resize_mode_{GroupResizeMode::Absolute};
+
+    // Per-note state captured when a resize gesture starts. lower/upper are
+    // the nearest obstacle edges on the note's key (the end of the note
+    // before it and the start of the note after it).
+    struct ResizeOrigin {
+        NoteId id{0};
+        Tick start{0};
+        Tick end{0};
+        MidiKey key{0};
+        Tick lower{0};
+        Tick upper{0};
+    };
+    std::vector<ResizeOrigin> resize_group_;
+    Tick resize_span_start_{0};
+    Tick resize_span_end_{0};
+    Duration resize_shortest_{0};
+    // Proportional mode: the scale factor range that keeps every note clear
+    // of its obstacles.
+    double resize_factor_min_{0.0};
+    double resize_factor_max_{0.0};
+    std::vector<NoteEdit> resize_edits_;
+
     bool enable_ctrl_drag_duplicate_{true};
     bool is_duplicating_{false};
     std::vector<NoteId> drag_original_selection_;
@@ -193,8 +252,23 @@ private:
     HoverState hover_{};
 
     // Internal helpers
+    // Snap raw_tick to the nearer of the magnetic grid line and (with
+    // snap-to-notes) the nearest note edge. A positive `length` also lets the
+    // end of a dragged span (raw_tick + length) pull the start onto an edge.
+    // Edges of selected notes are ignored when skip_selected is set (they are
+    // the ones being dragged), as are those of skip_id.
     Tick apply_snap(Tick raw_tick,
-                    const ModifierKeys& mods) const;
+                    const ModifierKeys& mods,
+                    Duration length = 0,
+                    bool skip_selected = false,
+                    NoteId skip_id = 0) const;
+
+    // Capture resize_group_ from the selection (or the active note alone).
+    void begin_group_resize();
+
+    // Resize the captured group so the active note's dragged edge lands on
+    // edge_tick.
+    void update_group_resize(Tick edge_tick);
 
     void begin_rectangle_selection(double world_x,
                                    double world_y,
@@ -66,6 +66,9 @@ private:
 
     // Clipboard stores copies of notes with absolute tick positions for now.
     std::vector<Note> clipboard_;
+    // Expression points for each clipboard entry (same order), since the
+    // notes' ExpressionRefs point into the NoteManager arena.
+    std::vector<std::vector<ExpressionPoint>> clipboard_expression_;
 
     void handle_delete();
     void handle_select_all();
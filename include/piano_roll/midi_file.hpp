@@ -0,0 +1,75 @@
+#pragma once
+
+#include "piano_roll/bounce.hpp"
+#include "piano_roll/cc_lane.hpp"
+#include "piano_roll/note_manager.hpp"
+#include "piano_roll/types.hpp"
+
+#include <cstddef>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+namespace piano_roll {
+
+// Standard MIDI File (SMF) import and export, so clips can be exchanged
+// with other tools. Per-note expression has no SMF equivalent and is not
+// written; CC curves are written as bounce_clips samples them, one event per
+// change of the integer value along each segment, and read back as
+// breakpoints joined by linear segments.
+
+struct SmfWriteOptions {
+    // Written as the file's ticks-per-quarter division. Event ticks are
+    // written unchanged, so this should match the source's ticks per beat.
+    int ticks_per_beat{480};
+
+    // Passed to bounce_clips, which produces the event stream.
+    BounceOptions bounce{};
+};
+
+// Write a format 0 (single track) file. Events come from bounce_clips in
+// tick order and are encoded as they arrive, with running status; only the
+// encoded track (a few bytes per event) is buffered, because the track
+// length precedes its data. Returns the number of MIDI events written.
+std::size_t write_smf(const std::vector<BounceClip>& clips,
+                      std::ostream& out,
+                      const SmfWriteOptions& options = {});
+
+// Convenience overload for a single clip.
+std::size_t write_smf(const NoteManager& notes,
+                      const std::vector<ControlLane>& lanes,
+                      std::ostream& out,
+                      const SmfWriteOptions& options = {});
+
+struct SmfReadOptions {
+    // Ticks are rescaled from the file's division to this resolution.
+    int ticks_per_beat{480};
+};
+
+struct SmfReadResult {
+    bool ok{false};
+    std::string error;  // set when ok is false
+
+    int format{0};
+    int tracks{0};
+    int division{0};  // the file's ticks per quarter note
+
+    std::size_t notes{0};
+    std::size_t control_points{0};
+    // Note-offs without a sounding note, and notes still sounding at the
+    // end of their track (closed at the track end).
+    std::size_t unmatched_note_offs{0};
+    std::size_t unterminated_notes{0};
+};
+
+// Read a format 0 or 1 file into `notes` and `lanes` (both cleared first).
+// Notes from all tracks are merged, keeping their MIDI channel; CC events
+// from every channel go to one lane per controller number. Overlapping
+// note-ons on the same key and channel are paired first in, first out.
+// SMPTE time divisions are not supported.
+SmfReadResult read_smf(NoteManager& notes,
+                       std::vector<ControlLane>& lanes,
+                       std::istream& in,
+                       const SmfReadOptions& options = {});
+
+}  // namespace piano_roll
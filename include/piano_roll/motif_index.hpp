@@ -0,0 +1,157 @@
+#pragma once
+
+#include "piano_roll/note_manager.hpp"
+#include "piano_roll/types.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+namespace piano_roll {
+
+struct MotifIndexOptions {
+    // Two onsets further apart than this are never paired; a query whose
+    // onsets are all further apart falls back to a linear scan.
+    Tick max_interval{1920};
+
+    // Each onset is paired with at most this many following onsets.
+    std::size_t fan_out{8};
+};
+
+struct MotifSearchOptions {
+    // Also report occurrences shifted to other keys.
+    bool transposed{true};
+    // Require every note of an occurrence to have its query note's duration.
+    bool match_duration{false};
+    // Report the query notes themselves (tick and key offset 0).
+    bool include_query{true};
+};
+
+// One occurrence of a motif: the query shifted by tick_offset and
+// key_offset. notes[i] is the note matching query[i].
+struct MotifMatch {
+    Tick tick_offset{0};
+    int key_offset{0};
+    std::vector<NoteId> notes;
+};
+
+// Fingerprint index for "find every occurrence of this phrase". The clip
+// is reduced to its distinct onsets (tick, key) in time order, and every
+// onset is paired with up to fan_out following onsets within max_interval.
+// Each pair is filed under its (inter-onset interval, pitch interval)
+// fingerprint, which is the same wherever and at whatever transposition the
+// phrase appears. A query looks up its rarest pair of consecutive onsets
+// and verifies only the occurrences filed under it, so search cost follows
+// the number of candidates instead of the clip size.
+//
+// An occurrence is found when fewer than fan_out other onsets fall between
+// the two query onsets used for the lookup; with dense accompaniment raise
+// fan_out (memory grows linearly with it).
+//
+// The index follows NoteManager::dirty_ranges_since: sync() re-pairs only
+// the onsets around the changed spans and rebuilds when the log no longer
+// reaches back far enough.
+class MotifIndex {
+public:
+    explicit MotifIndex(MotifIndexOptions options = {});
+
+    const MotifIndexOptions& options() const noexcept { return options_; }
+
+    // Bring the index up to date with `notes`. A different manager than the
+    // previous call causes a full rebuild.
+    void sync(const NoteManager& notes);
+    void rebuild(const NoteManager& notes);
+
+    // Occurrences of the notes in `query` (syncing first), ordered by tick
+    // offset, then key offset. Occurrences may overlap each other. Unknown
+    // ids are skipped (MotifMatch::notes then lines up with the known ones);
+    // an empty query finds nothing.
+    std::vector<MotifMatch> find(const NoteManager& notes,
+                                 std::span<const NoteId> query,
+                                 const MotifSearchOptions& options = {});
+
+    // find() with the current selection as the query.
+    std::vector<MotifMatch> find_selection(
+        const NoteManager& notes,
+        const MotifSearchOptions& options = {});
+
+    // Select every note of the matches (replacing the selection unless
+    // add_to_selection). Returns the number of notes selected.
+    static std::size_t select_matches(NoteManager& notes,
+                                      std::span<const MotifMatch> matches,
+                                      bool add_to_selection = false);
+
+    std::size_t onset_count() const noexcept { return onsets_.size(); }
+    std::size_t pair_count() const noexcept { return pair_count_; }
+    std::size_t memory_usage_bytes() const noexcept;
+
+private:
+    struct Onset {
+        Tick tick{0};
+        MidiKey key{0};
+
+        bool operator<(const Onset& other) const noexcept {
+            return tick != other.tick ? tick < other.tick : key < other.key;
+        }
+        bool operator==(const Onset& other) const noexcept = default;
+    };
+
+    MotifIndexOptions options_;
+    const NoteManager* source_{nullptr};
+    std::uint64_t revision_{0};
+
+    // Distinct onsets in (tick, key) order.
+    std::vector<Onset> onsets_;
+    // Fingerprint -> anchor onsets of the pairs filed under it, packed
+    // with pack() and in (tick, key) order, so the pairs of a tick span
+    // form one block.
+    std::unordered_map<std::uint64_t, std::vector<std::uint64_t>> pairs_;
+    std::size_t pair_count_{0};
+
+    std::vector<DirtyRange> dirty_scratch_;
+
+    // Order-preserving 8-byte form of an onset (ticks are never negative).
+    static std::uint64_t pack(const Onset& onset) noexcept {
+        return (static_cast<std::uint64_t>(onset.tick) << 7) |
+               static_cast<std::uint64_t>(onset.key);
+    }
+    static Onset unpack(std::uint64_t packed) noexcept {
+        return Onset{static_cast<Tick>(packed >> 7),
+                     static_cast<MidiKey>(packed & 0x7f)};
+    }
+
+    static std::uint64_t fingerprint(const Onset& from,
+                                     const Onset& to) noexcept;
+
+    // Call fn(fingerprint) for each pair anchored at onsets_[anchor].
+    template <typename Fn>
+    void for_each_pair(std::size_t anchor, Fn&& fn) const {
+        const Onset& from = onsets_[anchor];
+        std::size_t paired = 0;
+        for (std::size_t i = anchor + 1;
+             i < onsets_.size() && paired < options_.fan_out;
+             ++i, ++paired) {
+            if (onsets_[i].tick - from.tick > options_.max_interval) {
+                break;
+            }
+            fn(fingerprint(from, onsets_[i]));
+        }
+    }
+
+    // Re-read the onsets starting in [start, end) and re-pair the onsets
+    // whose pairs can reach them.
+    void update_span(const NoteManager& notes, Tick start, Tick end);
+    bool has_onset(Tick tick, MidiKey key) const noexcept;
+    // Resolve the notes of the occurrence at match's offsets into
+    // match.notes; query is in onset order and positions[i] is the slot of
+    // query[i] in match.notes. False if a note is missing.
+    bool collect_match(const NoteManager& notes,
+                       std::span<const Note* const> query,
+                       std::span<const std::size_t> positions,
+                       const MotifSearchOptions& options,
+                       MotifMatch& match) const;
+};
+
+}  // namespace piano_roll
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "piano_roll/expression.hpp"
 #include "piano_roll/types.hpp"
 
 #include <stdexcept>
@@ -15,6 +16,7 @@ struct Note {
     Velocity velocity{100};
     Channel channel{0};
     bool selected{false};
+    ExpressionRef expression{};  // Per-note MPE curves (NoteManager arena)
 
     Note() = default;
 
@@ -35,6 +37,15 @@ struct Note {
         validate();
     }
 
+    // Whether every field is in range (non-negative tick, positive
+    // duration, key and velocity 0-127, channel 0-15); the non-throwing
+    // form of the constructor's check.
+    bool is_valid() const noexcept {
+        return tick >= 0 && duration > 0 && key >= 0 && key <= 127 &&
+               velocity >= 0 && velocity <= 127 && channel >= 0 &&
+               channel <= 15;
+    }
+
     Tick end_tick() const noexcept {
         return tick + duration;
     }
@@ -92,6 +103,9 @@ struct Note {
 
 private:
     void validate() const {
+        if (is_valid()) {
+            return;
+        }
         if (tick < 0) {
             throw std::invalid_argument("Note tick must be non-negative");
         }
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "piano_roll/note_manager.hpp"
+#include "piano_roll/types.hpp"
+
+#include <cstddef>
+#include <vector>
+
+namespace piano_roll {
+
+struct CleanupOptions {
+    // Gaps shorter than or equal to this many ticks between consecutive
+    // notes on the same key are reported (and closed by legato). 0 disables
+    // gap detection.
+    Tick gap_threshold{0};
+
+    // Worker threads for the per-key sweep; 0 picks
+    // std::thread::hardware_concurrency(), 1 runs inline.
+    unsigned max_threads{0};
+};
+
+// Result of analyze_notes: problem notes as ID lists (each sorted by key,
+// then tick) plus the batched fix for each category.
+struct CleanupReport {
+    // Exact duplicates: same key, start tick and duration as another note.
+    // The first one is kept; the others are listed here.
+    std::vector<NoteId> duplicates;
+
+    // Notes that run into the next note on the same key.
+    std::vector<NoteId> overlaps;
+
+    // Notes followed on the same key by a gap of at most gap_threshold.
+    std::vector<NoteId> gaps;
+
+    // Fix plan. trims shorten overlapping notes so they end where the next
+    // note starts; covered lists shorter notes stacked on a longer one at the
+    // same start tick (nothing is left of them after trimming, so they are
+    // removed); legato extends notes to close small gaps.
+    std::vector<NoteEdit> trims;
+    std::vector<NoteId> covered;
+    std::vector<NoteEdit> legato;
+
+    bool empty() const noexcept {
+        return duplicates.empty() && overlaps.empty() && gaps.empty();
+    }
+};
+
+// Which categories apply_cleanup fixes.
+struct CleanupFixes {
+    bool dedupe{true};
+    bool trim_overlaps{true};
+    bool legato{true};
+};
+
+// Sweep every key's notes in tick order, in parallel across keys, and
+// collect duplicates, overlaps and small gaps. Linear in the number of notes
+// apart from the per-key sorts.
+CleanupReport analyze_notes(const NoteManager& notes,
+                            const CleanupOptions& options = {});
+
+// Apply the report's fix plan as one batched NoteManager edit (a single undo
+// step when record_undo is set). The report must come from analyze_notes on
+// the same, unchanged notes. Returns the number of notes changed or removed.
+std::size_t apply_cleanup(NoteManager& notes,
+                          const CleanupReport& report,
+                          const CleanupFixes& fixes = {},
+                          bool record_undo = true);
+
+}  // namespace piano_roll
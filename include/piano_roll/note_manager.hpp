@@ -2,14 +2,38 @@
 
 #include "piano_roll/note.hpp"
 
+#include <array>
 #include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <iterator>
 #include <optional>
+#include <ranges>
+#include <set>
+#include <span>
+#include <type_traits>
 #include <unordered_map>
 #include <unordered_set>
+#include <utility>
 #include <vector>
 
 namespace piano_roll {
 
+// Absolute target position/length for one note in a batched edit.
+struct NoteEdit {
+    NoteId id{0};
+    Tick tick{0};
+    Duration duration{0};
+    MidiKey key{60};
+};
+
+// Tick span [start, end) touched by one NoteManager change.
+struct DirtyRange {
+    std::uint64_t revision{0};
+    Tick start{0};
+    Tick end{0};
+};
+
 // Central manager for notes, providing CRUD operations,
 // simple spatial queries, and selection tracking.
 class NoteManager {
@@ -32,6 +56,13 @@ public:
                        bool record_undo = true,
                        bool allow_overlap = false);
 
+    // Bulk insert for loaders: append copies of `notes` (ids and expression
+    // references are ignored, the selected flag is kept) and build the
+    // indexes once instead of per note. Overlaps are allowed; notes that
+    // Note::validate would reject are skipped. Returns the assigned ids, parallel to `notes` (0 = skipped).
+    std::vector<NoteId> add_notes(std::span<const Note> notes,
+                                  bool record_undo = true);
+
     // Remove a note by ID. Returns true if a note was removed.
     bool remove_note(NoteId id, bool record_undo = true);
 
@@ -50,6 +81,47 @@ public:
                      bool record_undo = true,
                      bool allow_overlap = false);
 
+    // Batched update: apply every edit and remove every listed note as a
+    // single operation (one undo step, one index update), instead of one
+    // rebuild per note; batches without removals only re-sort the index
+    // lists of the keys they touch. Edits with unknown ids, non-positive
+    // durations, negative ticks or keys outside 0-127 are skipped; overlaps
+    // are not checked, so callers resolve them before building the batch.
+    // Returns the number of notes changed or removed.
+    std::size_t apply_note_edits(std::span<const NoteEdit> edits,
+                                 std::span<const NoteId> removals = {},
+                                 bool record_undo = true);
+
+    // Remove many notes at once (see apply_note_edits).
+    std::size_t remove_notes(std::span<const NoteId> ids,
+                             bool record_undo = true) {
+        return apply_note_edits({}, ids, record_undo);
+    }
+
+    // Ripple edits (arrangement-style insert/delete of time). Every note
+    // starting at or after the edit point moves by the same amount, which
+    // keeps the per-key index order, so the indexes are patched in one
+    // linear pass instead of being rebuilt. The undo entry stores only the
+    // notes the edit trimmed, split or removed; the shifted notes are
+    // restored by shifting them back.
+    //
+    // ripple_insert opens `length` ticks of empty time at `tick`. Notes
+    // crossing `tick` keep their start and length. Returns the number of
+    // notes moved.
+    std::size_t ripple_insert(Tick tick, Duration length, bool record_undo = true);
+
+    // ripple_delete removes [start_tick, end_tick) and pulls later notes
+    // back by its length. Notes inside the span are removed and notes
+    // crossing one of its edges are trimmed to it. A note covering the
+    // whole span is shortened by the span, or, with split_straddling,
+    // split into the part before the span and a new note for the part after
+    // it. Expression points follow the kept parts. Returns the number of
+    // notes moved, trimmed, split or removed.
+    std::size_t ripple_delete(Tick start_tick,
+                              Tick end_tick,
+                              bool split_straddling = false,
+                              bool record_undo = true);
+
     // Check if a note would overlap any existing note on the same key.
     bool would_overlap(const Note& probe,
                        std::optional<NoteId> exclude_id = std::nullopt) const;
@@ -61,6 +133,10 @@ public:
     Note* note_at(Tick tick, MidiKey key) noexcept;
     const Note* note_at(Tick tick, MidiKey key) const noexcept;
 
+    // Notes overlapping [start_tick, end_tick) on keys [min_key, max_key],
+    // key by key and in start-tick order within a key. The vector overloads
+    // allocate per call; the visitor, output-iterator and view forms below
+    // stream the same results without touching the heap.
     std::vector<Note*> notes_in_range(Tick start_tick,
                                       Tick end_tick,
                                       MidiKey min_key,
@@ -70,6 +146,123 @@ public:
                                             MidiKey min_key,
                                             MidiKey max_key) const noexcept;
 
+    // Write a pointer to each note in the range to `out`; returns the
+    // advanced iterator.
+    template <std::output_iterator<const Note*> Out>
+    Out notes_in_range(Tick start_tick,
+                       Tick end_tick,
+                       MidiKey min_key,
+                       MidiKey max_key,
+                       Out out) const {
+        for_each_in_range(start_tick,
+                          end_tick,
+                          min_key,
+                          max_key,
+                          [&out](const Note& note) { *out++ = &note; });
+        return out;
+    }
+
+    // Call fn(note) for each note in the range. If fn returns bool,
+    // returning false stops the walk. The non-const form must not change a
+    // note's tick, duration or key (use move_note / resize_note).
+    template <typename Fn>
+    void for_each_in_range(Tick start_tick,
+                           Tick end_tick,
+                           MidiKey min_key,
+                           MidiKey max_key,
+                           Fn&& fn) const {
+        visit_range(*this, start_tick, end_tick, min_key, max_key, fn);
+    }
+    template <typename Fn>
+    void for_each_in_range(Tick start_tick,
+                           Tick end_tick,
+                           MidiKey min_key,
+                           MidiKey max_key,
+                           Fn&& fn) {
+        visit_range(*this, start_tick, end_tick, min_key, max_key, fn);
+    }
+
+    // Lazy forward range over the same notes, walking the per-key index as
+    // it is iterated (const Note& elements). Invalidated by any change to
+    // the notes.
+    class RangeView : public std::ranges::view_interface<RangeView> {
+    public:
+        class iterator {
+        public:
+            using value_type = Note;
+            using difference_type = std::ptrdiff_t;
+            using iterator_concept = std::forward_iterator_tag;
+
+            iterator() = default;
+
+            const Note& operator*() const noexcept {
+                return manager_->notes_[*pos_];
+            }
+            const Note* operator->() const noexcept { return &**this; }
+
+            iterator& operator++() noexcept {
+                ++pos_;
+                settle();
+                return *this;
+            }
+            iterator operator++(int) noexcept {
+                iterator previous = *this;
+                ++*this;
+                return previous;
+            }
+
+            bool operator==(const iterator& other) const noexcept {
+                return pos_ == other.pos_;
+            }
+            bool operator==(std::default_sentinel_t) const noexcept {
+                return pos_ == nullptr;
+            }
+
+        private:
+            friend class RangeView;
+
+            const NoteManager* manager_{nullptr};
+            Tick start_tick_{0};
+            Tick end_tick_{0};
+            MidiKey key_{0};
+            MidiKey max_key_{-1};
+            const std::size_t* pos_{nullptr};
+            const std::size_t* last_{nullptr};
+
+            void enter_key() noexcept;
+            void settle() noexcept;
+        };
+
+        RangeView() = default;
+
+        iterator begin() const noexcept;
+        std::default_sentinel_t end() const noexcept { return {}; }
+
+    private:
+        friend class NoteManager;
+
+        const NoteManager* manager_{nullptr};
+        Tick start_tick_{0};
+        Tick end_tick_{0};
+        MidiKey min_key_{0};
+        MidiKey max_key_{-1};
+    };
+
+    RangeView notes_in_range_view(Tick start_tick,
+                                  Tick end_tick,
+                                  MidiKey min_key,
+                                  MidiKey max_key) const noexcept;
+
+    // Nearest note edge (start or end tick of any note, across all keys)
+    // within max_distance ticks of `tick`, for snap-to-notes. Edges of
+    // selected notes are skipped when skip_selected is set, and those of
+    // skip_id always. Ties prefer the later edge. O(log n) plus the number
+    // of skipped edges inside the range.
+    std::optional<Tick> nearest_note_edge(Tick tick,
+                                          Tick max_distance,
+                                          bool skip_selected = false,
+                                          NoteId skip_id = 0) const;
+
     // Selection operations (by NoteId).
     void select(NoteId id, bool add_to_selection = false);
     void deselect(NoteId id);
@@ -78,9 +271,77 @@ public:
     bool is_selected(NoteId id) const;
     std::vector<NoteId> selected_ids() const;
 
+    // Call fn(const Note&) for each selected note, in no particular order.
+    // Walks the selected ids, so the cost is O(selected), not O(notes).
+    template <typename Fn>
+    void for_each_selected(Fn&& fn) const {
+        for (NoteId id : selected_note_ids_) {
+            if (const Note* note = find_by_id(id)) {
+                fn(*note);
+            }
+        }
+    }
+
+    // Bounding box of the selected notes (earliest start, latest end,
+    // lowest and highest key); false when nothing is selected. Cached
+    // against revision() and recomputed in O(selected) after a change, so
+    // per-frame callers such as the spotlight band cost nothing while the
+    // notes are unchanged.
+    bool selection_bounds(Tick& min_tick,
+                          Tick& max_tick,
+                          MidiKey& min_key,
+                          MidiKey& max_key) const noexcept;
+
     // Clear all notes and state.
     void clear();
 
+    // Change tracking for caches built from the notes (e.g. the renderer's
+    // note tiles). revision() increases with every change to how notes look
+    // (position, length, key, selection, expression); each change also logs
+    // the tick span it touched. dirty_ranges_since appends the spans logged
+    // after `revision` and returns false when the bounded log no longer
+    // reaches back that far (or a change such as undo touched everything),
+    // in which case the caller must treat all ticks as dirty.
+    //
+    // Edits made in place through notes() or find_by_id bypass the log;
+    // report them with mark_dirty.
+    std::uint64_t revision() const noexcept { return revision_; }
+    bool dirty_ranges_since(std::uint64_t revision,
+                            std::vector<DirtyRange>& out) const;
+    void mark_dirty(Tick start, Tick end);
+    void mark_all_dirty();
+
+    // Per-note expression (MPE pitch bend / pressure / timbre). Points for
+    // all notes live in a single arena owned by the manager; each Note holds
+    // only a compact ExpressionRef. Tick offsets are relative to the note
+    // start, so expression follows the note through moves, and the arena is
+    // captured in undo snapshots together with the notes.
+    //
+    // set_note_expression replaces the note's points (sorted internally by
+    // dimension and tick); an empty vector clears them.
+    bool set_note_expression(NoteId id,
+                             std::vector<ExpressionPoint> points,
+                             bool record_undo = true);
+    std::span<const ExpressionPoint> note_expression(
+        const Note& note) const noexcept;
+    std::span<const ExpressionPoint> note_expression(NoteId id) const noexcept;
+
+    // Linearly interpolated value of one dimension at an absolute tick; the
+    // first/last point is held outside the curve. Returns the dimension's
+    // neutral value when the note has no points for it.
+    float expression_value_at(NoteId id,
+                              ExpressionDimension dimension,
+                              Tick tick) const noexcept;
+
+    // Rewrite the arena in storage order, dropping points orphaned by
+    // removed notes or replaced curves. Runs automatically once more than
+    // half of the arena is garbage; storage compaction performs the same
+    // relayout incrementally.
+    void compact_expression_arena();
+    std::size_t expression_arena_size() const noexcept {
+        return expression_arenas_[0].size() + expression_arenas_[1].size();
+    }
+
     // Undo / redo support (snapshot-based).
     void set_max_undo_levels(std::size_t levels) { max_undo_levels_ = levels; }
     bool undo();
@@ -92,20 +353,202 @@ public:
     // record_undo flags.
     void snapshot_for_undo();
 
+    // Undo groups tie a NoteManager undo step to changes the same edit made
+    // elsewhere (e.g. CC lanes or patterns changed by a widget arrangement
+    // edit), so the owner can undo and redo them together. set_undo_group
+    // tags the newest undo entry; the tag follows the entry between the
+    // undo and redo stacks. 0 means untagged.
+    void set_undo_group(std::uint64_t group) noexcept;
+    // Tag of the entry undo() / redo() would apply next, or 0.
+    std::uint64_t undo_group() const noexcept;
+    std::uint64_t redo_group() const noexcept;
+    // Whether an entry tagged `group` is still on either stack.
+    bool has_undo_group(std::uint64_t group) const noexcept;
+
+    std::size_t undo_levels() const noexcept { return undo_stack_.size(); }
+
+    // Approximate heap footprint (in bytes) of the live notes plus their
+    // indexes, and of the undo/redo snapshot stacks. Intended for
+    // diagnostics such as the widget's performance HUD.
+    std::size_t memory_usage_bytes() const noexcept;
+    std::size_t undo_memory_bytes() const noexcept;
+
+    // Storage compaction. notes() is kept in insertion order, so after long
+    // edit sessions notes that are adjacent in time end up scattered in
+    // memory. Compaction reorders storage by (tick, key) and remaps the
+    // internal indexes in place; NoteIds, selection and undo history are
+    // unaffected, but pointers/references into notes() are invalidated.
+    //
+    // compact_storage_step performs at most max_notes placements and returns
+    // true once storage is fully ordered, so it can be spread over idle
+    // frames. Placement merges the per-key index lists, then the notes'
+    // expression points are copied into storage order at the same rate.
+    // Any mutation restarts the pass on the next step.
+    bool compact_storage_step(std::size_t max_notes = 256);
+    void compact_storage();
+    bool storage_is_compact() const noexcept { return storage_compact_; }
+
 private:
     std::vector<Note> notes_;
     std::unordered_map<NoteId, std::size_t> id_to_index_;
     std::unordered_map<MidiKey, std::vector<std::size_t>> spatial_index_;
     std::unordered_set<NoteId> selected_note_ids_;
 
-    std::vector<std::vector<Note>> undo_stack_;
-    std::vector<std::vector<Note>> redo_stack_;
+    // selection_bounds result, valid while revision equals revision_.
+    struct SelectionBoundsCache {
+        std::uint64_t revision{~std::uint64_t{0}};
+        bool any{false};
+        Tick min_tick{0};
+        Tick max_tick{0};
+        MidiKey min_key{0};
+        MidiKey max_key{0};
+    };
+    mutable SelectionBoundsCache selection_bounds_cache_;
+
+    // Every note's start and end tick, tagged with the note id. Maintained
+    // incrementally by create/remove/move/resize and rebuilt on undo/redo.
+    std::multiset<std::pair<Tick, NoteId>> edge_index_;
+
+    // Upper bound on any note's duration, so range queries can binary search
+    // for the first note that may still reach into the range. Exact after
+    // each index rebuild, only ever raised in between.
+    Duration max_duration_{0};
+
+    // Dirty-range log: entries after log_floor_ are complete, oldest first.
+    static constexpr std::size_t kDirtyLogCapacity = 256;
+    std::uint64_t revision_{0};
+    std::uint64_t log_floor_{0};
+    std::deque<DirtyRange> dirty_log_;
+
+    // Shared expression arena and the number of points in it that are no
+    // longer referenced by any note. The arena has two buffers so storage
+    // compaction can lay points out again a few notes at a time: the top
+    // bit of ExpressionRef::offset selects the buffer, and new points are
+    // appended to the active one.
+    static constexpr std::uint32_t kArenaBufferBit = 0x80000000u;
+    std::array<std::vector<ExpressionPoint>, 2> expression_arenas_;
+    std::size_t active_arena_{0};
+    std::size_t expression_garbage_{0};
+
+    // Compact undo entry of a ripple edit. Applying it removes the `before`
+    // notes, shifts every note starting at or after `from` by `delta` and
+    // adds the `after` notes; reverting removes `after`, shifts back from
+    // from + delta and re-adds `before`. Expression references of both
+    // lists point into `expression`.
+    struct RippleRecord {
+        Tick from{0};
+        Tick delta{0};
+        std::vector<Note> before;
+        std::vector<Note> after;
+        std::vector<ExpressionPoint> expression;
+    };
+
+    // Undo entry: a full snapshot, or a ripple record (notes and expression
+    // left empty), plus its undo group tag.
+    struct Snapshot {
+        std::vector<Note> notes;
+        std::vector<ExpressionPoint> expression;
+        std::optional<RippleRecord> ripple;
+        std::uint64_t group{0};
+    };
+
+    std::vector<Snapshot> undo_stack_;
+    std::vector<Snapshot> redo_stack_;
     std::size_t max_undo_levels_{100};
     NoteId next_id_{1};
 
+    // Incremental compaction state, cleared whenever the note set changes.
+    // compaction_heads_ is a min-heap on (tick, key) holding each key's next
+    // unplaced position in its spatial_index_ list; slots before
+    // compaction_cursor_ hold their final notes. Once all notes are placed,
+    // compaction_arena_cursor_ walks storage copying expression points into
+    // the inactive arena buffer, which then becomes the active one.
+    struct CompactionHead {
+        Tick tick{0};
+        MidiKey key{0};
+        std::size_t position{0};
+        const std::vector<std::size_t>* list{nullptr};
+    };
+    std::vector<CompactionHead> compaction_heads_;
+    std::size_t compaction_cursor_{0};
+    std::size_t compaction_arena_cursor_{0};
+    std::size_t compaction_live_points_{0};
+    bool compaction_started_{false};
+    bool storage_compact_{true};
+
     void rebuild_indexes();
+    void sort_key_index(MidiKey key);
+    // First entry of a per-key index list whose note may end after `tick`.
+    std::vector<std::size_t>::const_iterator first_reaching(
+        const std::vector<std::size_t>& indices, Tick tick) const noexcept;
+
+    // Shared body of the const and non-const for_each_in_range.
+    template <typename Self, typename Fn>
+    static void visit_range(Self& self,
+                            Tick start_tick,
+                            Tick end_tick,
+                            MidiKey min_key,
+                            MidiKey max_key,
+                            Fn& fn) {
+        if (start_tick >= end_tick || min_key > max_key) {
+            return;
+        }
+        for (MidiKey key = min_key; key <= max_key; ++key) {
+            auto index_it = self.spatial_index_.find(key);
+            if (index_it == self.spatial_index_.end()) {
+                continue;
+            }
+            // Per-key indices are sorted by note start tick: skip notes that
+            // start too early to reach start_tick, and stop once notes start
+            // at or after end_tick.
+            const std::vector<std::size_t>& indices = index_it->second;
+            for (auto it = self.first_reaching(indices, start_tick);
+                 it != indices.end();
+                 ++it) {
+                if (*it >= self.notes_.size()) {
+                    continue;
+                }
+                auto& note = self.notes_[*it];
+                if (note.tick >= end_tick) {
+                    break;
+                }
+                if (note.end_tick() <= start_tick) {
+                    continue;
+                }
+                if constexpr (std::is_same_v<
+                                  std::invoke_result_t<Fn&, decltype(note)>,
+                                  bool>) {
+                    if (!fn(note)) {
+                        return;
+                    }
+                } else {
+                    fn(note);
+                }
+            }
+        }
+    }
+    void invalidate_compaction() noexcept;
+    void swap_storage_slots(std::size_t a, std::size_t b);
+    // Appends points to one arena buffer and returns the reference to them.
+    ExpressionRef append_expression(std::size_t buffer,
+                                    std::span<const ExpressionPoint> points);
     void rebuild_selection_from_notes();
+    void rebuild_edge_index();
+    void add_note_edges(const Note& note);
+    void remove_note_edges(const Note& note);
     void push_undo_state();
+    void push_undo_entry(Snapshot&& entry);
+    Snapshot make_snapshot() const;
+    void apply_ripple(const RippleRecord& record, bool forward);
+    // Append `note` to one of the record's lists, copying its expression
+    // points into the record. Points with offsets in [cut_from, cut_to) are
+    // dropped and later ones pulled back by the cut length.
+    void store_ripple_note(RippleRecord& record,
+                           std::vector<Note>& list,
+                           Note note,
+                           Tick cut_from = 0,
+                           Tick cut_to = 0) const;
+    void restore_snapshot(Snapshot&& snapshot);
 
     std::size_t allocate_index_for_new_note();
     NoteId allocate_id();
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <future>
+#include <thread>
+#include <vector>
+
+namespace piano_roll {
+
+// Worker count for a `max_threads` option where 0 means "one per hardware
+// thread".
+inline unsigned resolve_thread_count(unsigned max_threads) noexcept {
+    if (max_threads == 0) {
+        return std::max(1u, std::thread::hardware_concurrency());
+    }
+    return max_threads;
+}
+
+// Run fn(begin, end) over [0, count) split into contiguous chunks, one per
+// worker, on up to `threads` threads (the calling thread takes a chunk).
+// With one worker everything runs inline.
+template <typename Fn>
+void parallel_chunks(std::size_t count, unsigned threads, Fn&& fn) {
+    if (count == 0) {
+        return;
+    }
+    std::size_t workers = std::min<std::size_t>(threads, count);
+    if (workers <= 1) {
+        fn(std::size_t{0}, count);
+        return;
+    }
+
+    std::size_t chunk = (count + workers - 1) / workers;
+    std::vector<std::future<void>> pending;
+    pending.reserve(workers - 1);
+    for (std::size_t begin = chunk; begin < count; begin += chunk) {
+        std::size_t end = std::min(count, begin + chunk);
+        pending.push_back(std::async(std::launch::async,
+                                     [&fn, begin, end]() { fn(begin, end); }));
+    }
+    fn(std::size_t{0}, std::min(count, chunk));
+    for (auto& f : pending) {
+        f.get();
+    }
+}
+
+}  // namespace piano_roll
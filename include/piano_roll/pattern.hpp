@@ -0,0 +1,190 @@
+#pragma once
+
+#include "piano_roll/bounce.hpp"
+#include "piano_roll/note_manager.hpp"
+#include "piano_roll/types.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace piano_roll {
+
+// Identifiers for patterns and their instances. 0 is reserved as invalid.
+using PatternId = std::uint32_t;
+using PatternInstanceId = std::uint32_t;
+
+// A pattern owns its notes once, in pattern-local ticks starting at 0 and
+// absolute keys. length is the span each instance occupies on the timeline
+// (used for drawing and placing repeats); notes reaching past it are still
+// resolved.
+struct Pattern {
+    PatternId id{0};
+    std::string name;
+    Tick length{0};
+    NoteManager notes;
+
+    // End of the furthest-reaching note (at least length), cached against
+    // notes.revision() by PatternLibrary for instance culling.
+    mutable Tick cached_extent{0};
+    mutable std::uint64_t cached_extent_revision{~std::uint64_t{0}};
+};
+
+// One placement of a pattern: every pattern note appears shifted by
+// tick_offset and transposed by key_offset. Instances hold no notes.
+struct PatternInstance {
+    PatternInstanceId id{0};
+    PatternId pattern{0};
+    Tick tick_offset{0};
+    int key_offset{0};
+};
+
+// A pattern note as seen through one instance, in timeline coordinates.
+// `note` points into the pattern's NoteManager and is invalidated by edits
+// to that pattern.
+struct InstanceNote {
+    const Note* note{nullptr};
+    PatternId pattern{0};
+    PatternInstanceId instance{0};
+    Tick tick{0};
+    MidiKey key{0};
+
+    Tick end_tick() const noexcept { return tick + note->duration; }
+};
+
+// Linked pattern instances. Repeats of a pattern share its note data: a
+// 64-repeat pattern stores one copy of the notes plus 64 small instance
+// records, and editing the pattern's NoteManager updates every repeat.
+// Queries, hit tests and bounce clips resolve instances on the fly.
+class PatternLibrary {
+public:
+    PatternLibrary() = default;
+    PatternLibrary(const PatternLibrary&) = delete;
+    PatternLibrary& operator=(const PatternLibrary&) = delete;
+
+    // Create an empty pattern. Returns its id.
+    PatternId create_pattern(Tick length, std::string name = {});
+
+    // Create a pattern from existing notes (e.g. the selection about to be
+    // duplicated). Notes are copied with `origin` as pattern tick 0; the
+    // source is left untouched. Returns 0 if no id matched a note.
+    PatternId create_pattern_from_notes(const NoteManager& source,
+                                        std::span<const NoteId> ids,
+                                        Tick origin,
+                                        Tick length,
+                                        std::string name = {});
+
+    // Remove a pattern together with all of its instances.
+    bool remove_pattern(PatternId id);
+
+    Pattern* find_pattern(PatternId id) noexcept;
+    const Pattern* find_pattern(PatternId id) const noexcept;
+
+    // Changing a pattern's length changes the span of all its instances.
+    bool set_pattern_length(PatternId id, Tick length);
+
+    std::size_t pattern_count() const noexcept { return patterns_.size(); }
+
+    // Place an instance of `pattern`. Returns 0 if the pattern is unknown.
+    PatternInstanceId add_instance(PatternId pattern,
+                                   Tick tick_offset,
+                                   int key_offset = 0);
+    bool remove_instance(PatternInstanceId id);
+    bool move_instance(PatternInstanceId id, Tick tick_offset, int key_offset);
+
+    const PatternInstance* find_instance(PatternInstanceId id) const noexcept;
+
+    // All instances, ordered by tick_offset.
+    const std::vector<PatternInstance>& instances() const noexcept {
+        return instances_;
+    }
+
+    // The shared notes behind an instance; edits through it change every
+    // instance of the same pattern.
+    NoteManager* instance_notes(PatternInstanceId id) noexcept;
+
+    // Resolved notes overlapping [start_tick, end_tick) on keys
+    // [min_key, max_key], across all instances. Each overlapping instance
+    // costs one culled range query on its pattern.
+    std::vector<InstanceNote> notes_in_range(Tick start_tick,
+                                             Tick end_tick,
+                                             MidiKey min_key,
+                                             MidiKey max_key) const;
+
+    // Call fn(const InstanceNote&) for the same notes without building a
+    // list, instance by instance in tick_offset order.
+    template <typename Fn>
+    void for_each_in_range(Tick start_tick,
+                           Tick end_tick,
+                           MidiKey min_key,
+                           MidiKey max_key,
+                           Fn&& fn) const {
+        if (end_tick <= start_tick || min_key > max_key) {
+            return;
+        }
+        for (auto it = first_reaching(start_tick);
+             it != instances_.end() && it->tick_offset < end_tick;
+             ++it) {
+            const PatternInstance& instance = *it;
+            const Pattern* pattern = find_pattern(instance.pattern);
+            if (pattern == nullptr ||
+                instance.tick_offset + extent(*pattern) <= start_tick) {
+                continue;
+            }
+            pattern->notes.for_each_in_range(
+                start_tick - instance.tick_offset,
+                end_tick - instance.tick_offset,
+                min_key - instance.key_offset,
+                max_key - instance.key_offset,
+                [&](const Note& note) {
+                    const MidiKey key = note.key + instance.key_offset;
+                    if (key >= 0 && key <= 127) {
+                        fn(InstanceNote{&note,
+                                        instance.pattern,
+                                        instance.id,
+                                        note.tick + instance.tick_offset,
+                                        key});
+                    }
+                });
+        }
+    }
+
+    // Resolved note drawn at (tick, key), preferring the latest-placed
+    // instance when instances overlap.
+    std::optional<InstanceNote> note_at(Tick tick, MidiKey key) const;
+
+    // Copy the notes of one instance into `target` at their timeline
+    // positions ("make unique"). The instance itself is not removed.
+    // Returns the number of notes created.
+    std::size_t materialize_instance(PatternInstanceId id,
+                                     NoteManager& target,
+                                     bool record_undo = true) const;
+
+    // One bounce clip per instance, each referencing the shared pattern
+    // notes with the instance offsets, for bounce_clips playback/export.
+    void append_bounce_clips(std::vector<BounceClip>& out) const;
+
+    // Number of notes the instances represent on the timeline.
+    std::size_t resolved_note_count() const noexcept;
+
+    void clear();
+
+private:
+    std::vector<std::unique_ptr<Pattern>> patterns_;
+    std::vector<PatternInstance> instances_;
+    PatternId next_pattern_id_{1};
+    PatternInstanceId next_instance_id_{1};
+
+    void sort_instances();
+    Tick extent(const Pattern& pattern) const noexcept;
+    // First instance that can reach `tick`: instances are ordered by offset
+    // and none reaches further than the longest pattern extent.
+    std::vector<PatternInstance>::const_iterator first_reaching(
+        Tick tick) const noexcept;
+};
+
+}  // namespace piano_roll
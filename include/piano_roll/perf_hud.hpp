@@ -0,0 +1,118 @@
+#pragma once
+
+#include "piano_roll/render_config.hpp"
+
+#include <array>
+#include <cstddef>
+
+namespace piano_roll {
+
+// Logical stages of a PianoRollWidget frame that are timed individually for
+// the performance HUD. The order matches the HUD's breakdown rows.
+enum class FrameStage {
+    Input,
+    Background,
+    Notes,
+    Ruler,
+    CcLane,
+    Overlay,
+};
+
+inline constexpr std::size_t kFrameStageCount = 6;
+
+inline const char* frame_stage_label(FrameStage stage) noexcept {
+    switch (stage) {
+    case FrameStage::Input:
+        return "input";
+    case FrameStage::Background:
+        return "background";
+    case FrameStage::Notes:
+        return "notes";
+    case FrameStage::Ruler:
+        return "ruler";
+    case FrameStage::CcLane:
+        return "cc lane";
+    case FrameStage::Overlay:
+        return "overlay";
+    }
+    return "?";
+}
+
+// Timings and counters captured for a single widget frame. All durations are
+// in milliseconds of wall-clock time.
+struct FrameStats {
+    std::array<double, kFrameStageCount> stage_ms{};
+    double total_ms{0.0};
+
+    std::size_t visible_notes{0};
+    std::size_t total_notes{0};
+    std::size_t vertices_emitted{0};
+    std::size_t note_tiles_drawn{0};
+    std::size_t note_tiles_built{0};
+
+    // Heap allocations performed during the frame, as reported by the
+    // host-supplied allocation counter. has_allocation_count is false when no
+    // counter is installed.
+    std::size_t allocations{0};
+    bool has_allocation_count{false};
+
+    std::size_t note_manager_bytes{0};
+    std::size_t undo_bytes{0};
+    std::size_t undo_levels{0};
+
+    double& stage(FrameStage s) noexcept {
+        return stage_ms[static_cast<std::size_t>(s)];
+    }
+    double stage(FrameStage s) const noexcept {
+        return stage_ms[static_cast<std::size_t>(s)];
+    }
+};
+
+// Fixed-size ring buffer of recent frame times used for the HUD graph.
+class FrameTimeHistory {
+public:
+    static constexpr std::size_t kCapacity = 120;
+
+    void push(double frame_ms) noexcept {
+        samples_[head_] = static_cast<float>(frame_ms);
+        head_ = (head_ + 1) % kCapacity;
+        if (count_ < kCapacity) {
+            ++count_;
+        }
+    }
+
+    std::size_t size() const noexcept { return count_; }
+
+    // Sample i in chronological order (0 = oldest retained sample).
+    float at(std::size_t i) const noexcept {
+        std::size_t start = (head_ + kCapacity - count_) % kCapacity;
+        return samples_[(start + i) % kCapacity];
+    }
+
+    float max_value() const noexcept {
+        float m = 0.0f;
+        for (std::size_t i = 0; i < count_; ++i) {
+            m = at(i) > m ? at(i) : m;
+        }
+        return m;
+    }
+
+private:
+    std::array<float, kCapacity> samples_{};
+    std::size_t head_{0};
+    std::size_t count_{0};
+};
+
+// Draw a compact performance HUD in the top-left corner of the note grid of
+// the last rendered ImGui item (the piano roll canvas). The HUD lists the
+// per-stage frame time breakdown, note/vertex/allocation counters and
+// NoteManager memory, followed by a small rolling frame-time graph.
+//
+// When built without PIANO_ROLL_USE_IMGUI this function does nothing.
+void RenderPerfHud(const FrameStats& stats,
+                   const FrameTimeHistory& history,
+                   float grid_left_local,
+                   float grid_top_local,
+                   const PianoRollRenderConfig& config);
+
+}  // namespace piano_roll
@@ -4,8 +4,15 @@
 // Pulls in the main public types and the high-level widget.
 
 #include "piano_roll/types.hpp"
+#include "piano_roll/clock.hpp"
+#include "piano_roll/expression.hpp"
 #include "piano_roll/note.hpp"
 #include "piano_roll/note_manager.hpp"
+#include "piano_roll/note_cleanup.hpp"
+#include "piano_roll/clip_loop.hpp"
+#include "piano_roll/pattern.hpp"
+#include "piano_roll/motif_index.hpp"
+#include "piano_roll/harmony.hpp"
 #include "piano_roll/config.hpp"
 #include "piano_roll/coordinate_system.hpp"
 #include "piano_roll/grid_snap.hpp"
@@ -14,10 +21,17 @@
 #include "piano_roll/interaction.hpp"
 #include "piano_roll/keyboard.hpp"
 #include "piano_roll/overlay.hpp"
+#include "piano_roll/perf_hud.hpp"
 #include "piano_roll/playback.hpp"
+#include "piano_roll/playback_scheduler.hpp"
+#include "piano_roll/transport_clock.hpp"
 #include "piano_roll/cc_lane.hpp"
 #include "piano_roll/cc_lane_renderer.hpp"
 #include "piano_roll/loop_marker_rectangle.hpp"
 #include "piano_roll/demo.hpp"
 #include "piano_roll/serialization.hpp"
+#include "piano_roll/shared_snapshot.hpp"
+#include "piano_roll/command_channel.hpp"
+#include "piano_roll/midi_file.hpp"
+#include "piano_roll/bounce.hpp"
 #include "piano_roll/widget.hpp"
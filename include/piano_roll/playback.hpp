@@ -2,6 +2,10 @@
 
 #include "piano_roll/types.hpp"
 
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
 namespace piano_roll {
 
 // Lightweight helper for integrating transport-driven playback with the
@@ -59,12 +63,47 @@ inline Tick advance_playback_ticks(Tick current_position,
     return new_pos;
 }
 
+// Fractional variant of advance_playback_ticks: the position is kept in
+// fractional ticks, so repeated small steps do not lose the sub-tick part
+// of every step (which makes a frame-driven playhead drift behind the
+// tempo, more so at high frame rates).
+inline double advance_playback_position(double current_position,
+                                        double tempo_bpm,
+                                        int ticks_per_beat,
+                                        double delta_seconds,
+                                        bool loop_enabled,
+                                        Tick loop_start_tick,
+                                        Tick loop_end_tick) noexcept {
+    if (delta_seconds <= 0.0 || tempo_bpm <= 0.0 || ticks_per_beat <= 0) {
+        return current_position;
+    }
+
+    const double ticks_per_second =
+        (tempo_bpm * static_cast<double>(ticks_per_beat)) / 60.0;
+    double new_pos = current_position + ticks_per_second * delta_seconds;
+    if (new_pos < 0.0) {
+        new_pos = 0.0;
+    }
+
+    if (loop_enabled && loop_end_tick > loop_start_tick) {
+        const double loop_start = static_cast<double>(loop_start_tick);
+        const double loop_end = static_cast<double>(loop_end_tick);
+        if (new_pos >= loop_end) {
+            new_pos = std::max(loop_start, loop_start + (new_pos - loop_end));
+        }
+    }
+
+    return new_pos;
+}
+
 // Small stateful playback helper that keeps track of the current tick
 // position, tempo, ticks-per-beat, and optional loop range. Hosts are
 // expected to hold this alongside their transport state and call advance()
 // from their main update loop.
 struct PlaybackState {
     Tick position_ticks{0};
+    // Sub-tick part of the position carried between advance() calls.
+    double position_fraction{0.0};
     double tempo_bpm{120.0};
     int ticks_per_beat{480};
 
@@ -88,6 +127,7 @@ struct PlaybackState {
 
     void set_position(Tick tick) noexcept {
         position_ticks = tick >= 0 ? tick : 0;
+        position_fraction = 0.0;
     }
 
     void set_loop_range(Tick start, Tick end) noexcept {
@@ -118,14 +158,16 @@ struct PlaybackState {
         if (!playing) {
             return position_ticks;
         }
-        position_ticks = advance_playback_ticks(
-            position_ticks,
+        const double position = advance_playback_position(
+            static_cast<double>(position_ticks) + position_fraction,
             tempo_bpm,
             ticks_per_beat,
             delta_seconds,
             loop_enabled,
             loop_start_tick,
             loop_end_tick);
+        position_ticks = static_cast<Tick>(std::floor(position));
+        position_fraction = position - static_cast<double>(position_ticks);
         return position_ticks;
     }
 };
@@ -0,0 +1,293 @@
+#pragma once
+
+#include "piano_roll/bounce.hpp"
+#include "piano_roll/note_manager.hpp"
+#include "piano_roll/types.hpp"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+namespace piano_roll {
+
+// Bounded single-producer / single-consumer queue. push() is called by one
+// thread and pop() by one other thread; neither allocates or blocks. The
+// capacity is rounded up to a power of two.
+template <typename T>
+class SpscRing {
+public:
+    explicit SpscRing(std::size_t capacity) {
+        std::size_t size = 2;
+        while (size < capacity) {
+            size *= 2;
+        }
+        slots_.resize(size);
+        mask_ = size - 1;
+    }
+
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    bool push(const T& value) noexcept {
+        const std::size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_.load(std::memory_order_acquire) > mask_) {
+            return false;
+        }
+        slots_[tail & mask_] = value;
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T& out) noexcept {
+        const std::size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_.load(std::memory_order_acquire)) {
+            return false;
+        }
+        out = slots_[head & mask_];
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Approximate when called from neither end.
+    bool empty() const noexcept {
+        return head_.load(std::memory_order_acquire) ==
+               tail_.load(std::memory_order_acquire);
+    }
+    bool full() const noexcept {
+        return tail_.load(std::memory_order_acquire) -
+                   head_.load(std::memory_order_acquire) >
+               mask_;
+    }
+    std::size_t capacity() const noexcept { return mask_ + 1; }
+
+private:
+    std::vector<T> slots_;
+    std::size_t mask_{0};
+    alignas(64) std::atomic<std::size_t> head_{0};
+    alignas(64) std::atomic<std::size_t> tail_{0};
+};
+
+// One note as the scheduler sees it.
+struct PlaybackNote {
+    Tick start{0};
+    Tick end{0};
+    NoteId id{0};
+    MidiKey key{0};
+    Velocity velocity{0};
+    Channel channel{0};
+};
+
+// Immutable playback copy of a clip, built off the audio thread: the note
+// starts and ends as one time-ordered event list (note-offs before
+// note-ons on the same tick) and a centered interval tree over the notes,
+// so the notes sounding at any tick are found in O(log n + active)
+// without scanning the clip.
+class PlaybackSequence {
+public:
+    struct Event {
+        Tick tick{0};
+        std::uint32_t note{0};  // index into notes()
+        bool note_on{false};
+    };
+
+    PlaybackSequence() = default;
+    explicit PlaybackSequence(const NoteManager& notes) { build(notes); }
+    explicit PlaybackSequence(const std::vector<BounceClip>& clips) {
+        build(clips);
+    }
+
+    void build(const NoteManager& notes);
+
+    // Several clips on one timeline, each shifted by its tick_offset and
+    // transposed by its key_offset (notes leaving 0-127 are dropped), e.g.
+    // a clip's own notes plus PatternLibrary::append_bounce_clips for its
+    // pattern instances. CC lanes are ignored.
+    void build(const std::vector<BounceClip>& clips);
+
+    std::span<const PlaybackNote> notes() const noexcept { return notes_; }
+    std::span<const Event> events() const noexcept { return events_; }
+
+    // NoteManager::revision() the sequence was built from; for clips, the
+    // sum over the clips' notes, which changes whenever any of them does
+    // (but not when clips are only added or removed).
+    std::uint64_t revision() const noexcept { return revision_; }
+
+    // First event at or after `tick`.
+    std::size_t first_event_at(Tick tick) const noexcept;
+
+    // Call fn(const PlaybackNote&) for every note sounding at `tick`
+    // (start <= tick < end), in no particular order. Does not allocate.
+    template <typename Fn>
+    void active_notes_at(Tick tick, Fn&& fn) const {
+        std::int32_t node = nodes_.empty() ? -1 : 0;
+        while (node >= 0) {
+            const Node& n = nodes_[static_cast<std::size_t>(node)];
+            // Every note of the node contains n.center. Left of it only
+            // the starts can exclude a note, right of it only the ends.
+            if (tick < n.center) {
+                for (std::uint32_t i = n.begin; i < n.end; ++i) {
+                    const PlaybackNote& note = notes_[by_start_[i]];
+                    if (note.start > tick) {
+                        break;
+                    }
+                    fn(note);
+                }
+                node = n.left;
+            } else {
+                for (std::uint32_t i = n.begin; i < n.end; ++i) {
+                    const PlaybackNote& note = notes_[by_end_[i]];
+                    if (note.end <= tick) {
+                        break;
+                    }
+                    fn(note);
+                }
+                node = n.right;
+            }
+        }
+    }
+
+    std::size_t memory_usage_bytes() const noexcept;
+
+private:
+    // Notes containing `center` are stored at [begin, end) of by_start_
+    // (ascending start) and by_end_ (descending end); notes ending at or
+    // before it are in `left`, notes starting after it in `right`.
+    struct Node {
+        Tick center{0};
+        std::int32_t left{-1};
+        std::int32_t right{-1};
+        std::uint32_t begin{0};
+        std::uint32_t end{0};
+    };
+
+    std::vector<PlaybackNote> notes_;
+    std::vector<Event> events_;
+    std::vector<Node> nodes_;
+    std::vector<std::uint32_t> by_start_;
+    std::vector<std::uint32_t> by_end_;
+    std::uint64_t revision_{0};
+
+    void clear();
+    void append_notes(const NoteManager& notes,
+                      Tick tick_offset,
+                      int key_offset);
+    void finish_build();
+    std::int32_t build_node(std::span<std::uint32_t> items);
+};
+
+// Note event produced by PlaybackScheduler::render.
+struct PlaybackEvent {
+    Tick offset{0};  // ticks after the start of the rendered block
+    Tick tick{0};    // timeline position
+    NoteId id{0};    // 0 for releases that end a whole voice (stop, loop)
+    MidiKey key{0};
+    Velocity velocity{0};
+    Channel channel{0};
+    bool note_on{false};
+};
+
+struct PlaybackSchedulerOptions {
+    // Events one render() / stop() call can return. Note-ons that would
+    // leave no room for the note-offs of every sounding voice are dropped
+    // (and counted), so the buffer can never strand a voice.
+    std::size_t max_events{4096};
+    // Sequences published but not yet picked up by the audio thread.
+    std::size_t max_pending_sequences{4};
+};
+
+// Real-time note scheduler with chase and loop-boundary voice management.
+//
+// The UI (or any one non-audio thread) builds PlaybackSequences and hands
+// them over with publish(); the audio thread calls play / locate / stop /
+// render, which never allocate, lock or scan the whole clip. Sounding
+// voices are tracked per (channel, key):
+//   - starting or relocating mid-clip releases what is sounding and chases
+//     the notes already sounding at the new position (note-ons at offset
+//     0), found through PlaybackSequence::active_notes_at;
+//   - crossing the loop end releases every voice at the loop end and
+//     chases the notes sounding at the loop start, however many times the
+//     loop fits into one block;
+//   - a new sequence is adopted at the start of the next block by diffing
+//     the sounding voices against the notes sounding in the new sequence;
+//   - overlapping notes on one key retrigger (note-off then note-on), and
+//     the voice is released when the last of them ends, so note-ons and
+//     note-offs always pair up.
+class PlaybackScheduler {
+public:
+    explicit PlaybackScheduler(PlaybackSchedulerOptions options = {});
+    ~PlaybackScheduler();
+
+    PlaybackScheduler(const PlaybackScheduler&) = delete;
+    PlaybackScheduler& operator=(const PlaybackScheduler&) = delete;
+
+    // Non-audio thread. Returns false (and keeps ownership with the
+    // caller) while the handoff queue is full.
+    bool publish(std::unique_ptr<PlaybackSequence>& sequence);
+    // Non-audio thread: free sequences the audio thread has replaced.
+    void collect_garbage();
+
+    // Audio thread. The loop only applies while the position is before its
+    // end: playback started or located past loop_end runs on, as in most
+    // DAWs. (advance_playback_ticks differs here and wraps such positions
+    // back into the loop.)
+    void set_loop(bool enabled, Tick start_tick, Tick end_tick) noexcept;
+    void play(Tick tick) noexcept;
+    void locate(Tick tick) noexcept;
+    // Release every sounding voice; the returned note-offs are valid until
+    // the next call.
+    std::span<const PlaybackEvent> stop() noexcept;
+
+    // Advance the position by `length` ticks and return the block's
+    // events in order; valid until the next call.
+    std::span<const PlaybackEvent> render(Tick length) noexcept;
+
+    bool playing() const noexcept { return playing_; }
+    Tick position() const noexcept { return position_; }
+    std::size_t sounding_voices() const noexcept { return sounding_count_; }
+    std::uint64_t dropped_events() const noexcept { return dropped_; }
+
+private:
+    static constexpr std::size_t kVoiceSlots = 16 * 128;
+
+    PlaybackSchedulerOptions options_;
+    SpscRing<PlaybackSequence*> incoming_;
+    SpscRing<PlaybackSequence*> retired_;
+    PlaybackSequence* sequence_{nullptr};
+
+    bool playing_{false};
+    bool needs_chase_{false};
+    Tick position_{0};
+    std::size_t cursor_{0};
+    bool loop_enabled_{false};
+    Tick loop_start_{0};
+    Tick loop_end_{0};
+
+    // Notes sounding per voice slot (channel * 128 + key), and the slots
+    // with a non-zero count in no particular order.
+    std::array<std::uint16_t, kVoiceSlots> voice_count_{};
+    std::array<std::uint16_t, kVoiceSlots> target_count_{};
+    std::array<std::uint16_t, kVoiceSlots> sounding_{};
+    std::array<std::uint16_t, kVoiceSlots> sounding_pos_{};
+    std::size_t sounding_count_{0};
+
+    std::vector<PlaybackEvent> events_;
+    std::size_t event_count_{0};
+    std::uint64_t dropped_{0};
+
+    void adopt_published_sequence() noexcept;
+    void reposition(Tick tick) noexcept;
+    void emit_events_until(Tick end_tick, Tick block_tick) noexcept;
+    void note_on(const PlaybackNote& note, Tick tick, Tick offset) noexcept;
+    void note_off(const PlaybackNote& note, Tick tick, Tick offset) noexcept;
+    void release_all(Tick tick, Tick offset) noexcept;
+    void chase(Tick tick, Tick offset) noexcept;
+    void push(const PlaybackEvent& event) noexcept;
+    void add_sounding(std::size_t slot) noexcept;
+    void remove_sounding(std::size_t slot) noexcept;
+};
+
+}  // namespace piano_roll
@@ -96,8 +96,51 @@ struct PianoRollRenderConfig {
     float cc_lane_height{120.0f};  // pixels
     ColorRGBA cc_lane_background_color{0.08f, 0.08f, 0.08f, 1.0f};
     ColorRGBA cc_lane_border_color{0.25f, 0.25f, 0.25f, 1.0f};
+    // Border of the lane receiving edits when several lanes are stacked.
+    ColorRGBA cc_active_lane_border_color{0.55f, 0.55f, 0.60f, 1.0f};
+    ColorRGBA cc_lane_label_color{0.70f, 0.70f, 0.70f, 0.80f};
     ColorRGBA cc_curve_color{0.35f, 0.75f, 0.95f, 1.0f};
     ColorRGBA cc_point_color{1.0f, 1.0f, 1.0f, 1.0f};
+    ColorRGBA cc_selected_point_color{0.98f, 0.82f, 0.25f, 1.0f};
+
+    // Per-note expression (MPE) curves drawn inside visible notes once the
+    // zoom level leaves enough room: key rows at least
+    // note_expression_min_key_height pixels tall and notes at least
+    // note_expression_min_width pixels wide. Pitch bend is drawn around the
+    // note's vertical centre, pressure and timbre upwards from its bottom.
+    bool show_note_expression{true};
+    float note_expression_min_key_height{14.0f};
+    float note_expression_min_width{12.0f};
+    ColorRGBA note_expression_pitch_color{1.0f, 1.0f, 1.0f, 0.85f};
+    ColorRGBA note_expression_pressure_color{1.0f, 0.55f, 0.25f, 0.85f};
+    ColorRGBA note_expression_timbre_color{0.45f, 1.0f, 0.55f, 0.85f};
+
+    // Ghosted clip-loop repetitions (PianoRollRenderer::set_clip_loop) use
+    // the regular note colours with their alpha scaled by this factor.
+    float clip_loop_ghost_alpha{0.35f};
+
+    // Linked pattern instances (PianoRollRenderer::set_pattern_library): a
+    // tint behind each instance's span and the colours of its shared notes.
+    ColorRGBA pattern_instance_region_color{0.55f, 0.45f, 0.85f, 0.10f};
+    ColorRGBA pattern_note_fill_color{0.60f, 0.50f, 0.90f, 0.90f};
+    ColorRGBA pattern_note_border_color{0.20f, 0.15f, 0.35f, 1.0f};
+
+    // Harmony track (PianoRollRenderer::set_harmony): chord symbols in a row
+    // under the ruler, and the scale estimated for the visible time range
+    // marked on the key strip (tonic in its own colour).
+    bool show_chord_labels{true};
+    bool show_scale_highlight{true};
+    float chord_row_height{16.0f};
+    ColorRGBA chord_row_background_color{0.12f, 0.12f, 0.12f, 0.85f};
+    ColorRGBA chord_label_color{0.95f, 0.85f, 0.55f, 1.0f};
+    ColorRGBA scale_highlight_color{0.45f, 0.75f, 0.95f, 0.60f};
+    ColorRGBA scale_tonic_highlight_color{0.95f, 0.80f, 0.35f, 0.90f};
+
+    // Performance HUD overlay (PianoRollWidget::set_show_perf_hud).
+    ColorRGBA perf_hud_background_color{0.0f, 0.0f, 0.0f, 0.70f};
+    ColorRGBA perf_hud_text_color{0.85f, 0.95f, 0.85f, 1.0f};
+    ColorRGBA perf_hud_graph_color{0.40f, 0.90f, 0.40f, 1.0f};
+    ColorRGBA perf_hud_budget_line_color{1.0f, 0.35f, 0.35f, 0.60f};
 
     // Geometry
     float note_corner_radius{3.0f};
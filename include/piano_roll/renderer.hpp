@@ -1,12 +1,37 @@
 #pragma once
 
+#include "piano_roll/clip_loop.hpp"
 #include "piano_roll/coordinate_system.hpp"
 #include "piano_roll/grid_snap.hpp"
+#include "piano_roll/harmony.hpp"
 #include "piano_roll/note_manager.hpp"
+#include "piano_roll/pattern.hpp"
 #include "piano_roll/render_config.hpp"
 
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <span>
+#include <utility>
+#include <vector>
+
 namespace piano_roll {
 
+// Per-layer timings (milliseconds) and counters from the most recent
+// PianoRollRenderer::render call, consumed by the widget's performance HUD.
+struct RenderStats {
+    double background_ms{0.0};
+    double notes_ms{0.0};
+    double ruler_ms{0.0};
+    double playhead_ms{0.0};
+    std::size_t visible_notes{0};
+    std::size_t vertices{0};
+    // Note tiles re-emitted from the cache and rebuilt this frame.
+    std::size_t note_tiles_drawn{0};
+    std::size_t note_tiles_built{0};
+};
+
 // Basic renderer that draws the piano roll into a Dear ImGui window
 // when built with PIANO_ROLL_USE_IMGUI. Without ImGui, render() is a no-op.
 class PianoRollRenderer {
@@ -38,6 +63,40 @@ public:
     bool has_playhead() const noexcept { return has_playhead_; }
     Tick playhead_tick() const noexcept { return playhead_tick_; }
 
+    // Ghosted repetitions of the clip's notes after the clip end. Each
+    // visible repetition runs one culled range query over the matching part
+    // of the clip and draws the hits shifted by whole clip lengths, under
+    // the real notes; see ghost_note_at for hit-testing them.
+    void set_clip_loop(const ClipLoop& loop) noexcept { clip_loop_ = loop; }
+    const ClipLoop& clip_loop() const noexcept { return clip_loop_; }
+
+    // Linked pattern instances drawn under the regular notes, resolved per
+    // visible instance with one culled query on the shared pattern notes.
+    // The library is not owned; pass nullptr to stop drawing instances.
+    void set_pattern_library(const PatternLibrary* patterns) noexcept {
+        patterns_ = patterns;
+    }
+
+    // Chord symbols and scale highlighting from a harmony track, drawn from
+    // its cached per-beat results. The track is not owned and must be
+    // synced by the caller; pass nullptr to stop drawing them.
+    void set_harmony(const HarmonyAnalysis* harmony) noexcept {
+        harmony_ = harmony;
+    }
+    // Height of the chord row drawn under the ruler, 0 while it is hidden.
+    // Hosts add it to the ruler height so the grid starts below the row.
+    float chord_row_height() const noexcept {
+        return harmony_ != nullptr && harmony_->ticks_per_beat() > 0 &&
+                       config_.show_chord_labels
+                   ? config_.chord_row_height
+                   : 0.0f;
+    }
+
+    // Timings and counters captured during the last render() call.
+    const RenderStats& last_render_stats() const noexcept {
+        return last_stats_;
+    }
+
     // Render the entire piano roll into the current ImGui window.
     // The widget will consume a region of size (content_width, viewport.height),
     // where content_width is derived from the coordinate system.
@@ -61,6 +120,12 @@ private:
     bool has_playhead_{false};
     Tick playhead_tick_{0};
 
+    ClipLoop clip_loop_{};
+    const PatternLibrary* patterns_{nullptr};
+    const HarmonyAnalysis* harmony_{nullptr};
+
+    RenderStats last_stats_{};
+
 #ifdef PIANO_ROLL_USE_IMGUI
     // Layer-style helpers used internally by render() to mirror the logical
     // separation in the Python render_system: background, notes, ruler, etc.
@@ -70,11 +135,85 @@ private:
                                  const ImVec2& origin,
                                  const NoteManager& notes) const;
 
-    void render_notes_layer(ImDrawList* draw_list,
-                            const CoordinateSystem& coords,
-                            const Viewport& vp,
-                            const ImVec2& origin,
-                            const NoteManager& notes) const;
+    // Returns the number of notes starting inside the visible note tiles on
+    // visible keys, plus the pattern instance notes drawn.
+    std::size_t render_notes_layer(ImDrawList* draw_list,
+                                   const CoordinateSystem& coords,
+                                   const Viewport& vp,
+                                   const ImVec2& origin,
+                                   const NoteManager& notes);
+
+    // Note tile cache. The notes layer is split into fixed-width time tiles
+    // whose vertices are built once, in world space relative to the tile's
+    // left edge, and re-emitted with a translation while panning. A tile is
+    // rebuilt only when NoteManager reports a dirty range overlapping it or
+    // when anything its geometry depends on (zoom, key size, note style)
+    // changes, so scrolling at a fixed zoom costs a copy per visible vertex
+    // instead of regenerating every note.
+    struct NoteTile {
+        std::vector<ImDrawVert> vertices;
+        std::vector<ImDrawIdx> indices;
+        // (vertex end, index end) of each chunk; indices are relative to the
+        // chunk's first vertex so chunks stay within 16-bit index range.
+        std::vector<std::pair<std::uint32_t, std::uint32_t>> chunks;
+        // Notes starting inside the tile, per key, for the visible count.
+        std::array<std::uint32_t, 128> key_counts{};
+    };
+
+    // Everything tile geometry depends on apart from the notes.
+    struct NoteTileKey {
+        double pixels_per_beat{0.0};
+        int ticks_per_beat{0};
+        double key_height{0.0};
+        int total_keys{0};
+        float white_u{0.0f};
+        float white_v{0.0f};
+        float corner_radius{0.0f};
+        float border_thickness{0.0f};
+        std::array<ImU32, 5> colors{};
+        bool operator==(const NoteTileKey&) const = default;
+    };
+
+    void sync_note_tiles(const CoordinateSystem& coords,
+                         const NoteManager& notes);
+    void build_note_tile(NoteTile& tile,
+                         std::int64_t tile_index,
+                         const CoordinateSystem& coords,
+                         const NoteManager& notes);
+    void evict_note_tiles(std::int64_t first_visible,
+                          std::int64_t last_visible);
+
+    std::map<std::int64_t, NoteTile> note_tiles_;
+    NoteTileKey note_tile_key_{};
+    Tick note_tile_ticks_{1};
+    const NoteManager* note_tiles_source_{nullptr};
+    std::uint64_t note_tiles_revision_{0};
+    std::size_t note_tile_vertices_{0};
+    std::vector<DirtyRange> dirty_scratch_;
+
+    void render_clip_loop_ghosts(ImDrawList* draw_list,
+                                 const CoordinateSystem& coords,
+                                 const ImVec2& origin,
+                                 const ImVec2& clip_min,
+                                 const ImVec2& clip_max,
+                                 const NoteManager& notes) const;
+
+    // Returns the number of instance notes drawn.
+    std::size_t render_pattern_instances(ImDrawList* draw_list,
+                                         const CoordinateSystem& coords,
+                                         const ImVec2& origin,
+                                         const ImVec2& clip_min,
+                                         const ImVec2& clip_max) const;
+
+    // Inline expression curves for a single visible note. note_x1/note_x2
+    // are the unclipped note edges; drawing is clipped to clip_min/clip_max.
+    void render_note_expression(ImDrawList* draw_list,
+                                const Note& note,
+                                std::span<const ExpressionPoint> points,
+                                float note_x1,
+                                float note_x2,
+                                const ImVec2& clip_min,
+                                const ImVec2& clip_max) const;
 
     void render_ruler_layer(ImDrawList* draw_list,
                             const CoordinateSystem& coords,
@@ -4,7 +4,9 @@
 #include "piano_roll/note_manager.hpp"
 #include "piano_roll/types.hpp"
 
+#include <cstddef>
 #include <iosfwd>
+#include <string>
 #include <vector>
 
 namespace piano_roll {
@@ -13,9 +15,15 @@ namespace piano_roll {
 //
 //   PPR1
 //   N <tick> <duration> <key> <velocity> <channel>
-//   C <cc_number> <tick> <value>
+//   X <dimension> <tick_offset> <value>
+//   C <cc_number> <tick> <value> [<shape> <tension>]
 //
 // One event per line. Lines starting with any other character are ignored.
+// X lines carry per-note expression (dimension 0 = pitch bend, 1 = pressure,
+// 2 = timbre) and belong to the closest preceding N line; readers that do not
+// know them simply skip them. The optional C fields give the shape of the
+// segment starting at that point (see CurveShape: 1 = hold, 2 = exponential,
+// 3 = bezier) and are only written for non-linear segments.
 //
 // IDs are not preserved; NoteManager will assign new IDs when deserializing.
 void serialize_notes_and_cc(const NoteManager& notes,
@@ -24,10 +32,63 @@ void serialize_notes_and_cc(const NoteManager& notes,
 
 // Deserialize notes and CC lanes from the text format described above.
 // Existing notes and lanes in the destination containers are cleared.
-// Unknown line types are ignored.
+// Unknown line types are ignored, as are notes with out-of-range values.
+// Notes are inserted as one batch (NoteManager::add_notes).
 void deserialize_notes_and_cc(NoteManager& notes,
                               std::vector<ControlLane>& lanes,
                               std::istream& in);
 
+// Pull-style streaming reader for the PPR1 format: each next() call parses
+// one record, so files of any size are read in constant memory (tools use
+// it for validation, statistics and line-by-line transforms).
+//
+// Values are reported as written, without range checks, so callers can
+// validate them; notes are plain Note values with id 0. Lines that carry a
+// known type but cannot be parsed are reported as Malformed, lines of
+// unknown type are skipped and counted. X lines with an unknown dimension
+// or a negative offset are Malformed.
+class Ppr1Reader {
+public:
+    enum class RecordType {
+        Note,
+        Expression,  // belongs to the most recent Note record
+        Control,
+        Malformed,
+    };
+
+    struct Record {
+        RecordType type{RecordType::Malformed};
+        std::size_t line{0};  // 1-based line number
+        Note note;
+        ExpressionPoint expression;
+        int cc{0};
+        ControlPoint control;
+    };
+
+    explicit Ppr1Reader(std::istream& in);
+
+    // Read the next record. Returns false at end of input.
+    bool next(Record& record);
+
+    bool has_header() const noexcept { return has_header_; }
+    std::size_t line_number() const noexcept { return line_; }
+    std::size_t skipped_lines() const noexcept { return skipped_; }
+
+private:
+    std::istream& in_;
+    std::string buffer_;
+    std::size_t line_{0};
+    std::size_t skipped_{0};
+    bool first_line_{true};
+    bool has_header_{false};
+};
+
+// Streaming counterparts of serialize_notes_and_cc: write the header and
+// then records one at a time (expression points after their note).
+void write_ppr1_header(std::ostream& out);
+void write_ppr1_note(std::ostream& out, const Note& note);
+void write_ppr1_expression(std::ostream& out, const ExpressionPoint& point);
+void write_ppr1_control(std::ostream& out, int cc, const ControlPoint& point);
+
 }  // namespace piano_roll
 
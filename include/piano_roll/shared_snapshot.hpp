@@ -0,0 +1,204 @@
+#pragma once
+
+#include "piano_roll/cc_lane.hpp"
+#include "piano_roll/note_manager.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace piano_roll {
+
+// Read-only export of a clip to other local processes (sandboxed plugins,
+// analysis tools) through a POSIX shared-memory segment. The writer copies
+// the notes and CC lanes into a fixed binary layout; consumers map the
+// segment read-only and read the records in place, with no parsing.
+//
+// Layout (native byte order, all offsets from the segment start):
+//   SharedSnapshotHeader at 0
+//   SharedNoteRecord[note_count]           at notes_offset
+//   SharedLaneRecord[lane_count]           at lanes_offset
+//   SharedControlPointRecord[point_count]  at points_offset
+//
+// Consistency uses a seqlock: `generation` is odd while the writer is
+// updating the segment and advances by 2 per published snapshot. A
+// consumer reads the generation, reads the records, and accepts them only
+// if the generation is even and unchanged afterwards (SharedSnapshotReader
+// does this). Record sizes are fixed for a major version: minor versions
+// may only give meaning to reserved bytes, and anything else bumps the
+// major version, which readers reject.
+//
+// POSIX only; on other platforms create/open fail with an error message.
+
+inline constexpr std::uint32_t kSharedSnapshotMagic = 0x53525050;  // "PPRS"
+inline constexpr std::uint16_t kSharedSnapshotVersionMajor = 1;
+inline constexpr std::uint16_t kSharedSnapshotVersionMinor = 0;
+
+struct SharedSnapshotHeader {
+    std::uint32_t magic;
+    std::uint16_t version_major;
+    std::uint16_t version_minor;
+    std::uint32_t header_size;
+    std::uint32_t note_record_size;
+    std::uint32_t lane_record_size;
+    std::uint32_t point_record_size;
+    std::uint64_t segment_size;  // bytes; grows when a snapshot needs more
+
+    std::uint64_t generation;    // seqlock counter, accessed atomically
+    std::uint64_t revision;      // NoteManager::revision() of the snapshot
+
+    std::uint64_t note_count;
+    std::uint64_t notes_offset;
+    std::uint64_t lane_count;
+    std::uint64_t lanes_offset;
+    std::uint64_t point_count;
+    std::uint64_t points_offset;
+};
+
+// Flags in SharedNoteRecord::flags / SharedControlPointRecord::flags.
+inline constexpr std::uint8_t kSharedSelected = 0x01;
+
+struct SharedNoteRecord {
+    std::int64_t tick;
+    std::int64_t duration;
+    std::uint64_t id;  // NoteId
+    std::int16_t key;
+    std::uint8_t velocity;
+    std::uint8_t channel;
+    std::uint8_t flags;
+    std::uint8_t reserved[3];
+};
+
+// One CC lane; its points are points[first_point, first_point + point_count).
+struct SharedLaneRecord {
+    std::int32_t cc_number;
+    std::uint32_t point_count;
+    std::uint64_t first_point;
+};
+
+struct SharedControlPointRecord {
+    std::int64_t tick;
+    std::int32_t value;
+    float tension;
+    std::uint8_t shape;  // CurveShape
+    std::uint8_t flags;
+    std::uint8_t reserved[6];
+};
+
+static_assert(sizeof(SharedSnapshotHeader) == 96);
+static_assert(sizeof(SharedNoteRecord) == 32);
+static_assert(sizeof(SharedLaneRecord) == 16);
+static_assert(sizeof(SharedControlPointRecord) == 24);
+
+// Producer side; owns the segment and unlinks it on destruction.
+class SharedSnapshotWriter {
+public:
+    SharedSnapshotWriter() = default;
+    ~SharedSnapshotWriter();
+    SharedSnapshotWriter(const SharedSnapshotWriter&) = delete;
+    SharedSnapshotWriter& operator=(const SharedSnapshotWriter&) = delete;
+
+    // Create (or replace) the segment `name` (shm_open name, e.g.
+    // "/piano_roll.clip1"). initial_bytes is rounded up to hold at least the
+    // header. Returns false and sets error() on failure.
+    bool create(const std::string& name, std::size_t initial_bytes = 1 << 20);
+    void close();
+    bool is_open() const noexcept { return base_ != nullptr; }
+
+    // Copy the notes and lanes into the segment as the next generation,
+    // growing it first if needed. Returns false and sets error() if the
+    // segment could not be grown.
+    bool publish(const NoteManager& notes,
+                 const std::vector<ControlLane>& lanes);
+
+    std::uint64_t generation() const noexcept;
+    const std::string& error() const noexcept { return error_; }
+
+private:
+    std::string name_;
+    int fd_{-1};
+    unsigned char* base_{nullptr};
+    std::size_t size_{0};
+    std::string error_;
+
+    bool resize(std::size_t bytes);
+};
+
+// A consistent snapshot as seen by a consumer. The spans point into the
+// reader's mapping and stay valid until the next read() or close().
+struct SharedSnapshotView {
+    std::uint64_t generation{0};
+    std::uint64_t revision{0};
+    std::span<const SharedNoteRecord> notes;
+    std::span<const SharedLaneRecord> lanes;
+    std::span<const SharedControlPointRecord> points;
+
+    std::span<const SharedControlPointRecord> lane_points(
+        const SharedLaneRecord& lane) const noexcept {
+        if (lane.first_point > points.size() ||
+            lane.point_count > points.size() - lane.first_point) {
+            return {};
+        }
+        return points.subspan(static_cast<std::size_t>(lane.first_point),
+                              lane.point_count);
+    }
+};
+
+// Consumer side: maps an existing segment read-only.
+class SharedSnapshotReader {
+public:
+    SharedSnapshotReader() = default;
+    ~SharedSnapshotReader();
+    SharedSnapshotReader(const SharedSnapshotReader&) = delete;
+    SharedSnapshotReader& operator=(const SharedSnapshotReader&) = delete;
+
+    bool open(const std::string& name);
+    void close();
+    bool is_open() const noexcept { return base_ != nullptr; }
+
+    // Current generation (odd while the writer is mid-update); 0 if closed.
+    std::uint64_t generation() const noexcept;
+
+    // Call fn(const SharedSnapshotView&) on a consistent snapshot. fn may run
+    // more than once if the writer publishes meanwhile, so it should only
+    // read (or copy) the records; its results count once read() returns
+    // true. Returns false if the segment is invalid or no stable snapshot
+    // was seen within max_attempts.
+    template <typename Fn>
+    bool read(Fn&& fn, int max_attempts = 64) {
+        for (int attempt = 0; attempt < max_attempts; ++attempt) {
+            SharedSnapshotView view;
+            if (!begin_read(view)) {
+                if (error_.empty()) {
+                    continue;  // writer mid-update
+                }
+                return false;
+            }
+            fn(static_cast<const SharedSnapshotView&>(view));
+            if (end_read(view)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Copy a consistent snapshot into a NoteManager and lanes (cleared
+    // first), e.g. for a consumer that wants to run library code on it.
+    bool copy_to(NoteManager& notes, std::vector<ControlLane>& lanes);
+
+    const std::string& error() const noexcept { return error_; }
+
+private:
+    int fd_{-1};
+    const unsigned char* base_{nullptr};
+    std::size_t size_{0};
+    std::string error_;
+
+    bool begin_read(SharedSnapshotView& view);
+    bool end_read(const SharedSnapshotView& view) const noexcept;
+    bool remap(std::size_t bytes);
+};
+
+}  // namespace piano_roll
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "piano_roll/types.hpp"
+
+#include <atomic>
+#include <cstdint>
+
+namespace piano_roll {
+
+// Position report from the audio engine: which timeline position it was
+// rendering at which host time. host_time_seconds must come from the same
+// monotonic clock the UI passes to TransportClock::playhead (e.g.
+// std::chrono::steady_clock converted to seconds).
+struct TransportStamp {
+    std::int64_t sample_position{0};  // engine samples since transport start
+    double sample_rate{48000.0};
+    double tick{0.0};                 // timeline position, fractional ticks
+    double tempo_bpm{120.0};
+    double host_time_seconds{0.0};
+    bool playing{false};
+};
+
+struct TransportClockOptions {
+    int ticks_per_beat{480};
+
+    // Time between the engine rendering a sample and it being heard
+    // (output buffer plus device latency). The playhead is drawn this far
+    // behind the engine position.
+    double output_latency_seconds{0.0};
+
+    // How quickly the displayed playhead converges on the latest stamp.
+    // Frame-to-frame motion follows the tempo exactly; only the error
+    // against the stamps is corrected, with this time constant.
+    double smoothing_seconds{0.1};
+
+    // Errors larger than this (seeks, loop jumps, tempo changes) snap the
+    // playhead instead of gliding to it.
+    double snap_beats{0.5};
+};
+
+// Audio-clock-driven playhead. The audio thread publishes a TransportStamp
+// once per block through a seqlock (wait-free for the writer, lock-free for
+// readers, no allocation); the UI asks for the playhead at the host time of
+// each rendered frame and gets a fractional tick extrapolated from the
+// latest stamp, compensated for output latency and smoothed so that stamp
+// timing noise and uneven frame rates do not show up as jitter. The
+// position is never accumulated from frame deltas, so it cannot drift from
+// the engine.
+//
+// publish() may only be called from one thread at a time; every other
+// member is for the UI thread.
+class TransportClock {
+public:
+    explicit TransportClock(TransportClockOptions options = {}) noexcept
+        : options_(options) {}
+
+    TransportClock(const TransportClock&) = delete;
+    TransportClock& operator=(const TransportClock&) = delete;
+
+    // Audio thread.
+    void publish(const TransportStamp& stamp) noexcept;
+
+    // Latest published stamp; false before the first publish().
+    bool latest(TransportStamp& out) const noexcept;
+
+    const TransportClockOptions& options() const noexcept { return options_; }
+    void set_options(const TransportClockOptions& options) noexcept {
+        options_ = options;
+    }
+
+    // Loop region the engine wraps in, so extrapolation between stamps
+    // wraps at the same place.
+    void set_loop(bool enabled, Tick start_tick, Tick end_tick) noexcept;
+
+    // Playhead for a frame rendered at host_time_seconds, in fractional
+    // ticks (0 before the first stamp).
+    double playhead(double host_time_seconds) noexcept;
+    Tick playhead_tick(double host_time_seconds) noexcept;
+
+    bool playing() const noexcept;
+
+    // Drop the smoothing state so the next playhead() starts from the
+    // stamp (e.g. after the host switches audio devices).
+    void reset() noexcept { has_display_ = false; }
+
+private:
+    TransportClockOptions options_;
+
+    // Seqlock: odd while publish() is writing. Fields are relaxed atomics
+    // so concurrent reads are well defined; the sequence check discards
+    // torn reads.
+    std::atomic<std::uint64_t> sequence_{0};
+    std::atomic<std::int64_t> sample_position_{0};
+    std::atomic<double> sample_rate_{48000.0};
+    std::atomic<double> tick_{0.0};
+    std::atomic<double> tempo_bpm_{120.0};
+    std::atomic<double> host_time_{0.0};
+    std::atomic<bool> playing_{false};
+
+    bool loop_enabled_{false};
+    double loop_start_{0.0};
+    double loop_end_{0.0};
+
+    bool has_display_{false};
+    double displayed_{0.0};
+    double last_host_time_{0.0};
+
+    double wrap(double tick) const noexcept;
+};
+
+}  // namespace piano_roll
@@ -2,24 +2,40 @@
 
 #include "piano_roll/cc_lane.hpp"
 #include "piano_roll/cc_lane_renderer.hpp"
+#include "piano_roll/command_channel.hpp"
+#include "piano_roll/clip_loop.hpp"
+#include "piano_roll/clock.hpp"
 #include "piano_roll/config.hpp"
 #include "piano_roll/coordinate_system.hpp"
 #include "piano_roll/custom_scrollbar.hpp"
 #include "piano_roll/grid_snap.hpp"
+#include "piano_roll/harmony.hpp"
 #include "piano_roll/interaction.hpp"
 #include "piano_roll/keyboard.hpp"
 #include "piano_roll/playback.hpp"
 #include "piano_roll/note_manager.hpp"
 #include "piano_roll/loop_marker_rectangle.hpp"
+#include "piano_roll/motif_index.hpp"
 #include "piano_roll/overlay.hpp"
+#include "piano_roll/pattern.hpp"
+#include "piano_roll/perf_hud.hpp"
 #include "piano_roll/render_config.hpp"
 #include "piano_roll/renderer.hpp"
+#include "piano_roll/transport_clock.hpp"
 
+#include <algorithm>
 #include <functional>
+#include <optional>
 #include <vector>
 
 namespace piano_roll {
 
+// One CC lane in the stacked lane area under the notes grid.
+struct CcLaneView {
+    int lane_index{-1};  // index into PianoRollWidget::cc_lanes()
+    float height{0.0f};  // pixels; <= 0 uses the config's cc_lane_height
+};
+
 // High-level, self-contained piano roll widget that ties together the
 // core components (NoteManager, CoordinateSystem, snapping, renderer,
 // pointer tool, keyboard shortcuts). This is intended for standalone
@@ -92,6 +108,25 @@ public:
     int active_cc_lane_index() const noexcept { return active_cc_lane_; }
     void set_active_cc_lane_index(int index) noexcept;
 
+    // Lanes stacked under the grid, top to bottom, each with its own height.
+    // With no views only the active lane is shown (the single-lane layout).
+    // If the stack would take more than 80% of the widget height, all lanes
+    // are scaled down proportionally. Clicking a lane makes it active.
+    void set_visible_cc_lanes(std::vector<CcLaneView> views);
+    const std::vector<CcLaneView>& visible_cc_lanes() const noexcept {
+        return cc_lane_views_;
+    }
+
+    // When enabled (default), changing the note selection selects the CC
+    // points of every lane that fall inside the selected notes' time span,
+    // so notes and their controller data can be edited together.
+    void set_cc_selection_follows_notes(bool enabled) noexcept {
+        cc_selection_follows_notes_ = enabled;
+    }
+    bool cc_selection_follows_notes() const noexcept {
+        return cc_selection_follows_notes_;
+    }
+
     // Hover information for host overlays: returns true if a note is hovered
     // and fills out parameters with note id and edge classification.
     bool hovered_note(NoteId& id_out,
@@ -116,8 +151,23 @@ public:
         return pointer_.is_duplicating();
     }
 
+    // Magnetic snapping of note starts/ends to other notes' edges while
+    // dragging, resizing and creating notes (see PointerTool).
+    void set_snap_to_notes(bool enabled) noexcept {
+        pointer_.set_snap_to_notes(enabled);
+    }
+    bool snap_to_notes() const noexcept { return pointer_.snap_to_notes(); }
+
+    // Group resize behaviour for multi-note selections (see PointerTool).
+    void set_group_resize_mode(GroupResizeMode mode) noexcept {
+        pointer_.set_group_resize_mode(mode);
+    }
+    GroupResizeMode group_resize_mode() const noexcept {
+        return pointer_.group_resize_mode();
+    }
+
     // Bounds of the current note selection in tick/key space. Returns false
-    // if no notes are selected.
+    // if no notes are selected. Cached by NoteManager::selection_bounds.
     bool selection_bounds(Tick& min_tick,
                           Tick& max_tick,
                           MidiKey& min_key,
@@ -137,6 +187,46 @@ public:
         return show_debug_crosshair_;
     }
 
+    // Performance HUD: a compact overlay (sibling of the debug crosshair)
+    // showing the per-stage frame time breakdown, visible/total notes,
+    // vertices emitted, allocations, NoteManager memory and a rolling
+    // frame-time graph. Frame stats are collected on every draw() call and
+    // are also available to hosts through last_frame_stats().
+    void set_show_perf_hud(bool enabled) noexcept {
+        show_perf_hud_ = enabled;
+    }
+    bool show_perf_hud() const noexcept { return show_perf_hud_; }
+
+    const FrameStats& last_frame_stats() const noexcept {
+        return frame_stats_;
+    }
+
+    // Local command channel (see command_channel.hpp): while set, draw()
+    // applies the batches the server has queued to notes() at the start of
+    // each frame, before input handling and rendering. Not owned; pass
+    // nullptr to detach.
+    void set_command_server(CommandServer* server) noexcept {
+        command_server_ = server;
+    }
+
+    // Harmony track: chord symbols under the ruler and the visible range's
+    // scale on the key strip. While enabled, draw() syncs the analysis with
+    // the notes' dirty ranges (only changed beats are recomputed) before
+    // rendering. Off by default.
+    void set_show_harmony(bool enabled) noexcept { show_harmony_ = enabled; }
+    bool show_harmony() const noexcept { return show_harmony_; }
+    const HarmonyAnalysis& harmony() const noexcept { return harmony_; }
+
+    using AllocationCounter = std::function<std::size_t()>;
+
+    // Optional host hook returning a monotonically increasing heap
+    // allocation count (typically from a global operator new override in
+    // the application). The widget samples it at the start and end of each
+    // frame; without a counter the HUD reports allocations as "n/a".
+    void set_allocation_counter(AllocationCounter counter) noexcept {
+        allocation_counter_ = std::move(counter);
+    }
+
     // Last clicked grid cell (for debug/host tooling), mirroring the Python
     // last_clicked_cell behaviour. Returns false if no cell is recorded.
     bool last_clicked_cell(Tick& tick_start,
@@ -181,6 +271,69 @@ public:
         return {clip_start_tick_, clip_end_tick_};
     }
 
+    // Ghosted loop repetitions of the clip's notes drawn after the clip end
+    // (0 disables). They are read-only: ghost_note_at maps a position inside
+    // a repetition back to the clip note drawn there.
+    void set_clip_loop_repetitions(int repetitions) noexcept {
+        clip_loop_repetitions_ = std::max(0, repetitions);
+    }
+    int clip_loop_repetitions() const noexcept {
+        return clip_loop_repetitions_;
+    }
+    ClipLoop clip_loop() const noexcept {
+        return ClipLoop{clip_start_tick_, clip_end_tick_, clip_loop_repetitions_};
+    }
+    const Note* ghost_note_at(Tick tick,
+                              MidiKey key,
+                              int* repetition = nullptr) const {
+        return piano_roll::ghost_note_at(
+            notes_, clip_loop(), tick, key, repetition);
+    }
+
+    // Linked pattern instances drawn alongside the clip's own notes. Their
+    // notes are stored once per pattern; editing a pattern's NoteManager
+    // (e.g. via patterns().instance_notes(hit->instance)) updates every
+    // instance of it. Pointer gestures that start on an instance note (and
+    // not on a clip note) edit that pattern the same way, as one undo()
+    // step each.
+    PatternLibrary& patterns() noexcept { return patterns_; }
+    const PatternLibrary& patterns() const noexcept { return patterns_; }
+    std::optional<InstanceNote> pattern_note_at(Tick tick, MidiKey key) const {
+        return patterns_.note_at(tick, key);
+    }
+
+    // Instead of duplicating the selection, move its notes into a new
+    // pattern placed `repeats` times back to back from the selection start.
+    // One undo() step: undo puts the notes back and drops the pattern with
+    // its instances; redo rebuilds them (under a new pattern id). Returns
+    // the pattern id, or 0 without a selection.
+    PatternId instance_selection(int repeats);
+
+    // Arrangement edits on the clip's notes and every CC lane: open
+    // `length` ticks of empty time at `tick`, or cut [start_tick, end_tick)
+    // and close the gap (see NoteManager::ripple_insert / ripple_delete).
+    // Each records one compact undo entry on the notes and on each lane it
+    // changes, tied into one undo group so undo() reverts them together.
+    // Returns the number of notes affected.
+    std::size_t insert_time(Tick tick, Tick length);
+    std::size_t delete_time(Tick start_tick,
+                            Tick end_tick,
+                            bool split_straddling = false);
+
+    // Undo / redo the clip's last note edit (Ctrl+Z / Ctrl+Y outside the CC
+    // lane). Steps recorded by the arrangement edits above also revert or
+    // reapply their CC lane and pattern changes.
+    bool undo();
+    bool redo();
+
+    // Extend the selection to every occurrence of the selected phrase
+    // (transposed ones too unless options say otherwise). The widget keeps
+    // a MotifIndex that follows the notes incrementally between calls.
+    // Returns the number of occurrences found.
+    std::size_t select_motif_occurrences(
+        const MotifSearchOptions& options = {});
+    MotifIndex& motif_index() noexcept { return motif_index_; }
+
     // Convenience helper for host playback integration: advance a playback
     // position by delta_seconds at the given tempo (in BPM), applying the
     // widget's current ticks-per-beat and loop region (if enabled). The
@@ -195,11 +348,36 @@ public:
     //
     // Auto-scroll behaviour continues to be driven by the playhead value
     // inside draw(), mirroring the Python UnifiedPianoRoll.update_playback
-    // semantics.
+    // semantics. The sub-tick remainder of each step is carried over while
+    // current_tick is the tick returned by the previous call.
     Tick update_playback(Tick current_tick,
                          double tempo_bpm,
                          double delta_seconds) noexcept;
 
+    // Same, stepping by the time elapsed on the widget's clock (see
+    // set_clock) since the previous call; the first call does not move.
+    Tick update_playback(Tick current_tick, double tempo_bpm) noexcept;
+
+    // Time source for the widget's timing-dependent behaviour: scrollbar
+    // double-clicks, the piano-key flash, edge-scroll speed and the
+    // update_playback overload above. Defaults to a steady clock; replay
+    // and benchmark harnesses install a VirtualClock and advance it before
+    // each draw() so runs are reproducible and need not wait in real time.
+    // Not owned; nullptr restores the default.
+    void set_clock(const Clock* clock) noexcept;
+    const Clock& clock() const noexcept { return *clock_; }
+
+    // Seconds between the last two draw() calls on the widget's clock (0
+    // on the first frame).
+    double frame_delta_seconds() const noexcept { return frame_delta_; }
+
+    // Preferred when an audio engine is running: place the playhead from
+    // the engine's TransportClock for a frame rendered at
+    // host_time_seconds (same clock as the engine's stamps). The widget's
+    // ticks per beat and loop region are applied to the clock first.
+    Tick follow_transport(TransportClock& clock,
+                          double host_time_seconds) noexcept;
+
     // Enable or disable the widget's built-in input handling that reads
     // directly from Dear ImGui:
     //
@@ -224,6 +402,20 @@ public:
         return internal_keyboard_enabled_;
     }
 
+    // Idle-time storage compaction: while no pointer gesture is in progress,
+    // each draw() call runs NoteManager::compact_storage_step with the given
+    // budget so that note storage gradually returns to (tick, key) order
+    // after edits. Disabled by default; hosts can also call
+    // notes().compact_storage() explicitly (e.g. after loading a file).
+    void set_idle_compaction(bool enabled,
+                             std::size_t notes_per_frame = 256) noexcept {
+        idle_compaction_enabled_ = enabled;
+        idle_compaction_budget_ = notes_per_frame;
+    }
+    bool idle_compaction_enabled() const noexcept {
+        return idle_compaction_enabled_;
+    }
+
     // Hide inline ImGui controls (zoom slider, snap combo, CC lane selector)
     // when the widget is embedded in a host panel that provides its own chrome.
     // When hidden, these controls don't consume space at the top of the widget,
@@ -292,18 +484,95 @@ public:
 
 private:
     NoteManager notes_;
+    PatternLibrary patterns_;
+    MotifIndex motif_index_;
     CoordinateSystem coords_;
     GridSnapSystem snap_;
     PianoRollRenderConfig config_;
     PianoRollRenderer renderer_;
     PointerTool pointer_;
+    // Gestures on pattern instance notes: a second tool edits the pattern's
+    // NoteManager through pattern_coords_, coords_ shifted by the offsets
+    // of pattern_edit_instance_ (0 while pointer_ handles the clip).
+    CoordinateSystem pattern_coords_;
+    PointerTool pattern_pointer_;
+    PatternInstanceId pattern_edit_instance_{0};
     KeyboardController keyboard_;
     LoopMarkerRectangle loop_markers_;
     std::vector<ControlLane> cc_lanes_;
     int active_cc_lane_{-1};
+    // Tag for the next widget edit spanning the notes and other undo
+    // stacks (NoteManager::set_undo_group).
+    std::uint64_t next_undo_group_{1};
+
+    // Pattern side of an undo group. With repeats > 0 it is an
+    // instance_selection (undo drops `pattern`, redo rebuilds it from `ids`
+    // and places the repeats again); otherwise an edit recorded on
+    // `pattern`'s own undo stack under the same group.
+    struct PatternUndo {
+        std::uint64_t group{0};
+        PatternId pattern{0};
+        int repeats{0};
+        std::vector<NoteId> ids;
+        Tick origin{0};
+        Tick length{0};
+    };
+    std::vector<PatternUndo> pattern_undo_;
+    void record_pattern_undo(PatternUndo&& step);
+
+    // Route a grid click to pointer_ or, on an instance note, to
+    // pattern_pointer_; active_pointer() keeps pattern_coords_ in step with
+    // scrolling. finish_pattern_edit() ties a pattern edit into an undo
+    // group once the gesture ends.
+    void begin_pointer_gesture(float local_x, float local_y);
+    PointerTool& active_pointer();
+    void finish_pattern_edit();
+
     bool cc_dragging_{false};
     int cc_drag_index_{-1};
 
+    // CC point selection gestures. A drag moves the whole selection by the
+    // mouse delta, re-applied each frame to the points captured at drag
+    // start (one undo step per drag, none for a click that only selects).
+    // Dragging on empty lane space draws a selection rectangle; a click
+    // without movement adds a point.
+    std::vector<ControlPoint> cc_drag_origin_;
+    Tick cc_drag_start_tick_{0};
+    int cc_drag_start_value_{0};
+    bool cc_drag_moved_{false};
+    bool cc_rect_selecting_{false};
+    float cc_rect_start_x_{0.0f};
+    float cc_rect_start_y_{0.0f};
+    float cc_rect_end_x_{0.0f};
+    float cc_rect_end_y_{0.0f};
+    bool cc_lane_focused_{false};
+
+    // Stacked lane layout, recomputed from cc_lane_views_ (or the active
+    // lane) whenever the widget height is known. Rows are canvas-local.
+    struct CcLaneSlot {
+        int lane_index{-1};
+        float top{0.0f};
+        float bottom{0.0f};
+    };
+    std::vector<CcLaneView> cc_lane_views_;
+    std::vector<CcLaneSlot> cc_lane_slots_;
+    ControlLaneFrame cc_lane_frame_;
+    // Rows of the lane that received the click starting a CC gesture.
+    float cc_gesture_top_{0.0f};
+    float cc_gesture_bottom_{0.0f};
+
+    bool cc_selection_follows_notes_{true};
+    // Tick span of the note selection last mirrored onto the CC lanes, and
+    // the notes_.revision() it was taken at (checked every frame).
+    struct SelectionSpan {
+        bool any{false};
+        Tick start{0};
+        Tick end{0};
+        bool operator==(const SelectionSpan&) const = default;
+    };
+    SelectionSpan last_note_selection_span_{};
+    std::uint64_t cc_sync_revision_{~std::uint64_t{0}};
+
     bool dragging_playback_start_{false};
     bool dragging_cue_left_{false};
     bool dragging_cue_right_{false};
@@ -312,6 +581,9 @@ private:
     bool internal_keyboard_enabled_{true};
     bool inline_controls_visible_{true};
 
+    bool idle_compaction_enabled_{false};
+    std::size_t idle_compaction_budget_{256};
+
     void handle_cc_pointer_events(float local_x,
                                   float local_y,
                                   float lane_top_local,
@@ -320,6 +592,11 @@ private:
 
     void handle_pointer_events();
     void handle_keyboard_events();
+    void sync_cc_selection_with_notes();
+    ControlLane* active_cc_lane() noexcept;
+    // Fill cc_lane_slots_ for a widget of the given height and return the
+    // total height taken by the lane area (0 when lanes are hidden).
+    float layout_cc_lanes(float total_height);
 
     // Scrollbar-related helpers.
     void update_scrollbar_geometry();
@@ -336,11 +613,15 @@ private:
     // Clip boundaries for scrollbar double-click behaviour.
     Tick clip_start_tick_{0};
     Tick clip_end_tick_{4 * 4 * 480};  // Default 4 bars at 480 TPB
+    int clip_loop_repetitions_{0};
 
     // Playback markers (start and cue positions); purely visual and driven by
     // the host transport for now.
     Tick playback_start_tick_{0};
     bool show_playback_start_marker_{false};
+    double playback_fraction_{0.0};  // sub-tick remainder of update_playback
+    bool has_playback_time_{false};
+    double last_playback_time_{0.0};  // clock time of update_playback
     Tick cue_left_tick_{0};
     Tick cue_right_tick_{0};
     bool show_cue_markers_{false};
@@ -397,11 +678,33 @@ private:
     float footer_height_{0.0f};
     float note_label_width_{180.0f}; // left label column
 
+    // Local y where the note grid starts: padding, ruler and, when shown,
+    // the renderer's chord row.
+    float grid_top() const noexcept {
+        return top_padding_ + ruler_height_ + renderer_.chord_row_height();
+    }
+
     // Debug crosshair overlay (partial port of Python debug layer).
     bool show_debug_crosshair_{true};
     float debug_mouse_x_local_{-1.0f};
     float debug_mouse_y_local_{-1.0f};
 
+    CommandServer* command_server_{nullptr};
+
+    // Injected time source and the frame delta measured on it.
+    const Clock* clock_{&default_clock()};
+    bool has_frame_time_{false};
+    double last_frame_time_{0.0};
+    double frame_delta_{0.0};
+    bool show_harmony_{false};
+    HarmonyAnalysis harmony_;
+
+    // Performance HUD state.
+    bool show_perf_hud_{false};
+    FrameStats frame_stats_{};
+    FrameTimeHistory frame_history_{};
+    AllocationCounter allocation_counter_{};
+
     // Debug clicked-cell highlight (for coordinate verification).
     bool has_last_clicked_cell_{false};
     Tick last_clicked_tick_start_{0};
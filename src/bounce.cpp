@@ -0,0 +1,376 @@
+#include "piano_roll/bounce.hpp"
+
+#include "piano_roll/parallel.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace piano_roll {
+
+namespace {
+
+constexpr Tick kNoMoreEvents = std::numeric_limits<Tick>::max();
+
+bool event_less(const BounceEvent& a, const BounceEvent& b) noexcept {
+    if (a.tick != b.tick) {
+        return a.tick < b.tick;
+    }
+    if (a.type != b.type) {
+        return a.type < b.type;
+    }
+    if (a.clip != b.clip) {
+        return a.clip < b.clip;
+    }
+    if (a.data1 != b.data1) {
+        return a.data1 < b.data1;
+    }
+    return a.channel < b.channel;
+}
+
+// Min-heap order for pending note-offs (std heap functions build max-heaps).
+bool event_greater(const BounceEvent& a, const BounceEvent& b) noexcept {
+    return event_less(b, a);
+}
+
+// Position in one CC lane: the next breakpoint to emit, the first tick of
+// its incoming segment not yet sampled, and the last value sent.
+struct LaneCursor {
+    std::size_t pos{0};
+    Tick sample_from{0};
+    int last_value{-1};
+    bool sampled{false};  // the incoming segment emitted a sampled value
+};
+
+// Next CC event of a lane in clip-local ticks: the first tick inside the
+// segment ending at points[pos] whose rounded value differs from the last
+// one sent, else the breakpoint itself. Hold segments are not sampled.
+// Returns false once the lane is exhausted.
+bool next_lane_event(const ControlLane& lane,
+                     const LaneCursor& cursor,
+                     Tick& tick,
+                     int& value) noexcept {
+    const auto& points = lane.points();
+    if (cursor.pos >= points.size()) {
+        return false;
+    }
+    const ControlPoint& to = points[cursor.pos];
+    if (cursor.pos > 0 && cursor.sample_from < to.tick &&
+        points[cursor.pos - 1].shape != CurveShape::Hold) {
+        const ControlPoint& from = points[cursor.pos - 1];
+        auto level = [&from, &to](Tick t) {
+            return std::clamp(
+                static_cast<int>(std::lround(
+                    segment_value(from, to, static_cast<double>(t)))),
+                0,
+                127);
+        };
+        // Every curve shape is monotonic over a segment, so the ticks whose
+        // level differs from the last value form a suffix of it.
+        Tick lo = cursor.sample_from;
+        Tick hi = to.tick - 1;
+        if (level(hi) != cursor.last_value) {
+            while (lo < hi) {
+                const Tick mid = lo + (hi - lo) / 2;
+                if (level(mid) != cursor.last_value) {
+                    hi = mid;
+                } else {
+                    lo = mid + 1;
+                }
+            }
+            tick = lo;
+            value = level(lo);
+            return true;
+        }
+    }
+    tick = to.tick;
+    value = to.value;
+    return true;
+}
+
+// Per-clip streaming state. Note-ons are pulled from the NoteManager's
+// per-key index one window at a time; the note-off of every note-on already
+// taken waits in a small min-heap until its window comes. Nothing is
+// materialized per note up front.
+struct ClipCursor {
+    const BounceClip* clip{nullptr};
+    std::uint32_t clip_index{0};
+
+    // Source keys whose transposed key stays inside 0-127.
+    MidiKey min_key{0};
+    MidiKey max_key{-1};
+    // Clip-local tick from which note-ons have not been taken yet, and the
+    // timeline tick of the next such note-on (kNoMoreEvents if none).
+    Tick on_from{0};
+    Tick next_on{kNoMoreEvents};
+    std::vector<BounceEvent> pending_offs;  // heap ordered by event_greater
+    std::vector<LaneCursor> lanes;
+
+    // Events of the current window, sorted; merge_pos is the merge cursor.
+    std::vector<BounceEvent> window_events;
+    std::size_t merge_pos{0};
+};
+
+// Timeline tick of the earliest note-on at or after clip-local tick `from`.
+// Per-key lists are sorted by start tick, so each key only walks the notes
+// still sounding at `from` before its first later start.
+Tick next_note_on(const ClipCursor& cursor, Tick from) {
+    const BounceClip& clip = *cursor.clip;
+    Tick best = kNoMoreEvents;
+    for (MidiKey key = cursor.min_key; key <= cursor.max_key; ++key) {
+        clip.notes->for_each_in_range(
+            from, kNoMoreEvents, key, key, [&best, from](const Note& n) {
+                if (n.tick < from) {
+                    return true;
+                }
+                best = std::min(best, n.tick);
+                return false;
+            });
+    }
+    return best == kNoMoreEvents ? best : best + clip.tick_offset;
+}
+
+void prepare_cursor(ClipCursor& cursor) {
+    const BounceClip& clip = *cursor.clip;
+    if (clip.notes != nullptr) {
+        cursor.min_key = static_cast<MidiKey>(std::max(0, -clip.key_offset));
+        cursor.max_key =
+            static_cast<MidiKey>(std::min(127, 127 - clip.key_offset));
+        cursor.next_on = next_note_on(cursor, cursor.on_from);
+    }
+    if (clip.lanes != nullptr) {
+        cursor.lanes.assign(clip.lanes->size(), LaneCursor{});
+    }
+}
+
+// Earliest timeline tick of any not-yet-extracted event in the clip.
+Tick next_event_tick(const ClipCursor& cursor) noexcept {
+    const BounceClip& clip = *cursor.clip;
+    Tick next = cursor.next_on;
+    if (!cursor.pending_offs.empty()) {
+        next = std::min(next, cursor.pending_offs.front().tick);
+    }
+    if (clip.lanes != nullptr) {
+        for (std::size_t l = 0; l < clip.lanes->size(); ++l) {
+            Tick tick = 0;
+            int value = 0;
+            if (next_lane_event(
+                    (*clip.lanes)[l], cursor.lanes[l], tick, value)) {
+                next = std::min(next, tick + clip.tick_offset);
+            }
+        }
+    }
+    return next;
+}
+
+void extract_window(ClipCursor& cursor, Tick window_end) {
+    const BounceClip& clip = *cursor.clip;
+    cursor.window_events.clear();
+    cursor.merge_pos = 0;
+
+    // Notes and CC points are walked in clip-local ticks.
+    const Tick local_end = window_end == kNoMoreEvents
+                               ? kNoMoreEvents
+                               : window_end - clip.tick_offset;
+
+    if (clip.notes != nullptr && cursor.next_on < window_end) {
+        const Tick from = cursor.on_from;
+        clip.notes->for_each_in_range(
+            from,
+            local_end,
+            cursor.min_key,
+            cursor.max_key,
+            [&cursor, &clip, from](const Note& n) {
+                if (n.tick < from) {
+                    return;  // started in an earlier window
+                }
+                const MidiKey key = n.key + clip.key_offset;
+                cursor.window_events.push_back(
+                    BounceEvent{n.tick + clip.tick_offset,
+                                BounceEventType::NoteOn,
+                                n.channel,
+                                key,
+                                n.velocity,
+                                cursor.clip_index});
+                cursor.pending_offs.push_back(
+                    BounceEvent{n.end_tick() + clip.tick_offset,
+                                BounceEventType::NoteOff,
+                                n.channel,
+                                key,
+                                0,
+                                cursor.clip_index});
+                std::push_heap(cursor.pending_offs.begin(),
+                               cursor.pending_offs.end(),
+                               event_greater);
+            });
+        cursor.on_from = local_end;
+        cursor.next_on = next_note_on(cursor, local_end);
+    }
+    while (!cursor.pending_offs.empty() &&
+           cursor.pending_offs.front().tick < window_end) {
+        std::pop_heap(cursor.pending_offs.begin(),
+                      cursor.pending_offs.end(),
+                      event_greater);
+        cursor.window_events.push_back(cursor.pending_offs.back());
+        cursor.pending_offs.pop_back();
+    }
+
+    if (clip.lanes != nullptr) {
+        for (std::size_t l = 0; l < clip.lanes->size(); ++l) {
+            const ControlLane& lane = (*clip.lanes)[l];
+            const auto& points = lane.points();
+            LaneCursor& lane_cursor = cursor.lanes[l];
+            Tick tick = 0;
+            int value = 0;
+            while (next_lane_event(lane, lane_cursor, tick, value) &&
+                   tick < local_end) {
+                const bool breakpoint = tick == points[lane_cursor.pos].tick;
+                // A ramp that already reached the breakpoint's value does
+                // not repeat it.
+                if (!breakpoint || !lane_cursor.sampled ||
+                    value != lane_cursor.last_value) {
+                    cursor.window_events.push_back(
+                        BounceEvent{tick + clip.tick_offset,
+                                    BounceEventType::ControlChange,
+                                    clip.cc_channel,
+                                    lane.cc_number(),
+                                    value,
+                                    cursor.clip_index});
+                }
+                lane_cursor.last_value = value;
+                lane_cursor.sample_from = tick + 1;
+                lane_cursor.sampled = !breakpoint;
+                if (breakpoint) {
+                    ++lane_cursor.pos;
+                }
+            }
+        }
+    }
+
+    // The window buffer is small, so a plain sort orders it.
+    std::sort(cursor.window_events.begin(),
+              cursor.window_events.end(),
+              event_less);
+}
+
+}  // namespace
+
+std::size_t bounce_clips(const std::vector<BounceClip>& clips,
+                         const BounceSink& sink,
+                         const BounceOptions& options) {
+    const unsigned threads = resolve_thread_count(options.max_threads);
+    const Tick window_ticks = std::max<Tick>(1, options.window_ticks);
+
+    std::vector<ClipCursor> cursors(clips.size());
+    for (std::size_t i = 0; i < clips.size(); ++i) {
+        cursors[i].clip = &clips[i];
+        cursors[i].clip_index = static_cast<std::uint32_t>(i);
+    }
+    parallel_chunks(cursors.size(),
+                    threads,
+                    [&cursors](std::size_t begin, std::size_t end) {
+                        for (std::size_t i = begin; i < end; ++i) {
+                            prepare_cursor(cursors[i]);
+                        }
+                    });
+
+    auto earliest_pending = [&cursors]() {
+        Tick next = kNoMoreEvents;
+        for (const ClipCursor& cursor : cursors) {
+            next = std::min(next, next_event_tick(cursor));
+        }
+        return next;
+    };
+
+    // Min-heap of clips keyed by a copy of their next buffered event, so
+    // comparisons never chase into the per-clip buffers.
+    struct HeapEntry {
+        BounceEvent head;
+        std::size_t cursor;
+    };
+    std::vector<HeapEntry> heap;
+    heap.reserve(cursors.size());
+    auto sift_down = [&heap](std::size_t i) {
+        const std::size_t n = heap.size();
+        HeapEntry entry = heap[i];
+        while (true) {
+            std::size_t child = 2 * i + 1;
+            if (child >= n) {
+                break;
+            }
+            if (child + 1 < n &&
+                event_less(heap[child + 1].head, heap[child].head)) {
+                ++child;
+            }
+            if (!event_less(heap[child].head, entry.head)) {
+                break;
+            }
+            heap[i] = heap[child];
+            i = child;
+        }
+        heap[i] = entry;
+    };
+
+    std::size_t emitted = 0;
+    Tick window_start = earliest_pending();
+    while (window_start != kNoMoreEvents) {
+        // Empty stretches of the timeline are skipped by starting each
+        // window at the earliest pending event.
+        Tick window_end = window_start > kNoMoreEvents - window_ticks
+                              ? kNoMoreEvents
+                              : window_start + window_ticks;
+
+        parallel_chunks(cursors.size(),
+                        threads,
+                        [&cursors, window_end](std::size_t begin,
+                                               std::size_t end) {
+                            for (std::size_t i = begin; i < end; ++i) {
+                                extract_window(cursors[i], window_end);
+                            }
+                        });
+
+        heap.clear();
+        for (std::size_t i = 0; i < cursors.size(); ++i) {
+            if (!cursors[i].window_events.empty()) {
+                heap.push_back(HeapEntry{cursors[i].window_events.front(), i});
+            }
+        }
+        for (std::size_t i = heap.size() / 2; i-- > 0;) {
+            sift_down(i);
+        }
+
+        // Emit the smallest head, then replace it in place with that clip's
+        // next event (or drop the clip for this window) and restore order.
+        while (!heap.empty()) {
+            sink(heap.front().head);
+            ++emitted;
+            ClipCursor& cursor = cursors[heap.front().cursor];
+            if (++cursor.merge_pos < cursor.window_events.size()) {
+                heap.front().head = cursor.window_events[cursor.merge_pos];
+            } else {
+                heap.front() = heap.back();
+                heap.pop_back();
+                if (heap.empty()) {
+                    break;
+                }
+            }
+            sift_down(0);
+        }
+
+        window_start = earliest_pending();
+    }
+
+    return emitted;
+}
+
+std::vector<BounceEvent> bounce_clips_to_vector(
+    const std::vector<BounceClip>& clips,
+    const BounceOptions& options) {
+    std::vector<BounceEvent> events;
+    bounce_clips(clips,
+                 [&events](const BounceEvent& e) { events.push_back(e); },
+                 options);
+    return events;
+}
+
+}  // namespace piano_roll
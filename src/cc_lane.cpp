@@ -0,0 +1,435 @@
+#include "piano_roll/cc_lane.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+
+namespace piano_roll {
+
+namespace {
+
+// Curvature of an Exponential segment at tension +-1.
+constexpr double kExponentialCurvature = 6.0;
+
+// Linear swinging-door pass over points[begin..end] (inclusive). The caller
+// has already kept points[begin]; every point kept after it is appended,
+// ending with points[end].
+void simplify_linear_run(const std::vector<ControlPoint>& points,
+                         std::size_t begin,
+                         std::size_t end,
+                         double error,
+                         Tick min_spacing,
+                         std::vector<ControlPoint>& kept) {
+    // Invariant: the segment anchor -> last stays within `error` of every
+    // point between them. [lower, upper] is the range of slopes from the
+    // anchor that satisfy all of those intermediate points, so checking a
+    // new endpoint is O(1) and the whole pass is linear.
+    std::size_t anchor = begin;
+    std::size_t last = begin;
+    double lower = -std::numeric_limits<double>::infinity();
+    double upper = std::numeric_limits<double>::infinity();
+
+    auto restart_from = [&](std::size_t index) {
+        anchor = index;
+        last = index;
+        lower = -std::numeric_limits<double>::infinity();
+        upper = std::numeric_limits<double>::infinity();
+    };
+
+    for (std::size_t i = begin + 1; i <= end; ++i) {
+        const ControlPoint& a = points[anchor];
+        const ControlPoint& p = points[i];
+        const Tick dt = p.tick - a.tick;
+
+        if (dt <= 0) {
+            // Same tick as the anchor: a vertical jump is kept, a repeat
+            // within the error bound is dropped.
+            if (std::abs(static_cast<double>(p.value - a.value)) > error) {
+                kept.push_back(p);
+                restart_from(i);
+            }
+            continue;
+        }
+
+        const double slope = static_cast<double>(p.value - a.value) /
+                             static_cast<double>(dt);
+        const bool spacing_ok =
+            points[last].tick - a.tick >= min_spacing || last == anchor;
+        if ((slope < lower || slope > upper) && last != anchor &&
+            spacing_ok) {
+            // p cannot end the current segment: keep the last valid
+            // endpoint and start a new segment there.
+            kept.push_back(points[last]);
+            restart_from(last);
+            --i;  // re-evaluate p against the new anchor
+            continue;
+        }
+
+        // p becomes an intermediate point for any later endpoint.
+        const double dt_d = static_cast<double>(dt);
+        lower = std::max(lower,
+                         (static_cast<double>(p.value) - error -
+                          static_cast<double>(a.value)) / dt_d);
+        upper = std::min(upper,
+                         (static_cast<double>(p.value) + error -
+                          static_cast<double>(a.value)) / dt_d);
+        last = i;
+    }
+
+    if (last != anchor) {
+        kept.push_back(points[last]);
+    }
+}
+
+// Largest deviation of points strictly between a and e from the segment
+// a -> e drawn with the given shape.
+double segment_fit_error(const std::vector<ControlPoint>& points,
+                         std::size_t a,
+                         std::size_t e,
+                         CurveShape shape,
+                         float tension) {
+    ControlPoint from = points[a];
+    from.shape = shape;
+    from.tension = tension;
+    double worst = 0.0;
+    for (std::size_t i = a + 1; i < e; ++i) {
+        double v = segment_value(
+            from, points[e], static_cast<double>(points[i].tick));
+        worst = std::max(worst,
+                         std::abs(v - static_cast<double>(points[i].value)));
+    }
+    return worst;
+}
+
+struct ShapeFit {
+    CurveShape shape{CurveShape::Linear};
+    float tension{0.0f};
+};
+
+// Find a shape for the segment a -> e that keeps every point between them
+// within `error`, trying the cheap shapes first. Tension is searched with a
+// golden-section minimization of the maximum error.
+bool fit_segment(const std::vector<ControlPoint>& points,
+                 std::size_t a,
+                 std::size_t e,
+                 double error,
+                 ShapeFit& fit) {
+    if (segment_fit_error(points, a, e, CurveShape::Linear, 0.0f) <= error) {
+        fit = ShapeFit{};
+        return true;
+    }
+    if (segment_fit_error(points, a, e, CurveShape::Hold, 0.0f) <= error) {
+        fit = ShapeFit{CurveShape::Hold, 0.0f};
+        return true;
+    }
+    for (CurveShape shape : {CurveShape::Exponential, CurveShape::Bezier}) {
+        constexpr double kInvPhi = 0.6180339887498949;
+        double lo = -1.0;
+        double hi = 1.0;
+        double x1 = hi - kInvPhi * (hi - lo);
+        double x2 = lo + kInvPhi * (hi - lo);
+        double f1 = segment_fit_error(points, a, e, shape,
+                                      static_cast<float>(x1));
+        double f2 = segment_fit_error(points, a, e, shape,
+                                      static_cast<float>(x2));
+        for (int iter = 0; iter < 24; ++iter) {
+            if (f1 <= error || f2 <= error) {
+                break;
+            }
+            if (f1 < f2) {
+                hi = x2;
+                x2 = x1;
+                f2 = f1;
+                x1 = hi - kInvPhi * (hi - lo);
+                f1 = segment_fit_error(points, a, e, shape,
+                                       static_cast<float>(x1));
+            } else {
+                lo = x1;
+                x1 = x2;
+                f1 = f2;
+                x2 = lo + kInvPhi * (hi - lo);
+                f2 = segment_fit_error(points, a, e, shape,
+                                       static_cast<float>(x2));
+            }
+        }
+        if (f1 <= error || f2 <= error) {
+            fit = ShapeFit{shape, static_cast<float>(f1 <= f2 ? x1 : x2)};
+            return true;
+        }
+    }
+    return false;
+}
+
+// Greedy shaped reduction: from each kept point, grow the segment end by
+// doubling while some shape still fits, then binary-search the last end
+// that fits. Every accepted segment is verified against the error bound.
+std::vector<ControlPoint> fit_shaped_segments(
+    const std::vector<ControlPoint>& points,
+    double error) {
+    std::vector<ControlPoint> kept;
+    kept.push_back(points.front());
+    kept.back().shape = CurveShape::Linear;
+    kept.back().tension = 0.0f;
+
+    const std::size_t n = points.size();
+    std::size_t anchor = 0;
+    while (anchor + 1 < n) {
+        // A segment without intermediate points always fits.
+        std::size_t good = anchor + 1;
+        ShapeFit good_fit{};
+        std::size_t bad = n;
+
+        std::size_t span = 2;
+        while (true) {
+            std::size_t probe = std::min(n - 1, anchor + span);
+            if (probe <= good) {
+                break;
+            }
+            ShapeFit fit;
+            if (!fit_segment(points, anchor, probe, error, fit)) {
+                bad = probe;
+                break;
+            }
+            good = probe;
+            good_fit = fit;
+            if (probe == n - 1) {
+                break;
+            }
+            span *= 2;
+        }
+        while (bad - good > 1 && bad < n) {
+            std::size_t mid = good + (bad - good) / 2;
+            ShapeFit fit;
+            if (fit_segment(points, anchor, mid, error, fit)) {
+                good = mid;
+                good_fit = fit;
+            } else {
+                bad = mid;
+            }
+        }
+
+        kept.back().shape = good_fit.shape;
+        kept.back().tension = good_fit.tension;
+        kept.push_back(points[good]);
+        kept.back().shape = CurveShape::Linear;
+        kept.back().tension = 0.0f;
+        anchor = good;
+    }
+    return kept;
+}
+
+// Points describe the same curve; selection flags are not compared.
+bool same_curve(const std::vector<ControlPoint>& a,
+                const std::vector<ControlPoint>& b) noexcept {
+    return std::equal(a.begin(),
+                      a.end(),
+                      b.begin(),
+                      b.end(),
+                      [](const ControlPoint& p, const ControlPoint& q) {
+                          return p.tick == q.tick && p.value == q.value &&
+                                 p.shape == q.shape && p.tension == q.tension;
+                      });
+}
+
+// Copy the selection flags of `current` onto the kept points, which are a
+// subsequence of it by (tick, value).
+void carry_selection(const std::vector<ControlPoint>& current,
+                     std::vector<ControlPoint>& kept) noexcept {
+    std::size_t j = 0;
+    for (ControlPoint& point : kept) {
+        while (j < current.size() && (current[j].tick != point.tick ||
+                                      current[j].value != point.value)) {
+            ++j;
+        }
+        if (j == current.size()) {
+            return;
+        }
+        point.selected = current[j++].selected;
+    }
+}
+
+}  // namespace
+
+double curve_shape_fraction(CurveShape shape,
+                            float tension,
+                            double u) noexcept {
+    u = std::clamp(u, 0.0, 1.0);
+    switch (shape) {
+    case CurveShape::Linear:
+        return u;
+    case CurveShape::Hold:
+        return u >= 1.0 ? 1.0 : 0.0;
+    case CurveShape::Exponential: {
+        double k = static_cast<double>(tension) * kExponentialCurvature;
+        if (std::abs(k) < 1e-6) {
+            return u;
+        }
+        return std::expm1(k * u) / std::expm1(k);
+    }
+    case CurveShape::Bezier: {
+        // 1-D cubic Bezier with control values a and 1 - a; a = 1/3 is the
+        // straight line, a = 0 a smoothstep-like ease in/out.
+        double a = (1.0 - static_cast<double>(tension)) / 3.0;
+        double v = 1.0 - u;
+        return 3.0 * a * u * v * v + 3.0 * (1.0 - a) * u * u * v +
+               u * u * u;
+    }
+    }
+    return u;
+}
+
+double segment_value(const ControlPoint& from,
+                     const ControlPoint& to,
+                     double tick) noexcept {
+    const double span = static_cast<double>(to.tick - from.tick);
+    if (span <= 0.0) {
+        return static_cast<double>(to.value);
+    }
+    const double u = (tick - static_cast<double>(from.tick)) / span;
+    return static_cast<double>(from.value) +
+           static_cast<double>(to.value - from.value) *
+               curve_shape_fraction(from.shape, from.tension, u);
+}
+
+double ControlLane::value_at(double tick) const noexcept {
+    if (points_.empty()) {
+        return 0.0;
+    }
+    // Last point at or before `tick`; for a jump (several points on one
+    // tick) that is the final value of the jump.
+    auto next = std::upper_bound(
+        points_.begin(), points_.end(), tick,
+        [](double t, const ControlPoint& p) {
+            return t < static_cast<double>(p.tick);
+        });
+    if (next == points_.begin()) {
+        return static_cast<double>(points_.front().value);
+    }
+    if (next == points_.end()) {
+        return static_cast<double>(points_.back().value);
+    }
+    return segment_value(*(next - 1), *next, tick);
+}
+
+void ControlLane::sample_block(double start_tick,
+                               double step_ticks,
+                               std::span<float> out) const noexcept {
+    if (out.empty()) {
+        return;
+    }
+    if (points_.empty()) {
+        std::fill(out.begin(), out.end(), 0.0f);
+        return;
+    }
+
+    auto next = std::upper_bound(
+        points_.begin(), points_.end(), start_tick,
+        [](double t, const ControlPoint& p) {
+            return t < static_cast<double>(p.tick);
+        });
+    for (std::size_t i = 0; i < out.size(); ++i) {
+        const double tick =
+            start_tick + static_cast<double>(i) * step_ticks;
+        while (next != points_.end() &&
+               static_cast<double>(next->tick) <= tick) {
+            ++next;
+        }
+        double v = 0.0;
+        if (next == points_.begin()) {
+            v = static_cast<double>(points_.front().value);
+        } else if (next == points_.end()) {
+            v = static_cast<double>(points_.back().value);
+        } else {
+            v = segment_value(*(next - 1), *next, tick);
+        }
+        out[i] = static_cast<float>(v);
+    }
+}
+
+std::vector<ControlPoint> simplify_control_points(
+    const std::vector<ControlPoint>& points,
+    const SimplifyOptions& options) {
+    if (points.size() <= 2) {
+        return points;
+    }
+
+    const double error = std::max(0.0, options.max_value_error);
+    if (options.fit_shapes) {
+        return fit_shaped_segments(points, error);
+    }
+    const Tick min_spacing = std::max<Tick>(0, options.min_tick_spacing);
+
+    std::vector<ControlPoint> kept;
+    kept.reserve(points.size() / 4 + 2);
+    kept.push_back(points.front());
+
+    // Points that start or end a shaped segment are fixed; the linear
+    // reduction runs on the stretches between them.
+    std::size_t run_begin = 0;
+    for (std::size_t i = 1; i < points.size(); ++i) {
+        const bool fixed = points[i].shape != CurveShape::Linear ||
+                           points[i - 1].shape != CurveShape::Linear;
+        if (fixed || i + 1 == points.size()) {
+            simplify_linear_run(
+                points, run_begin, i, error, min_spacing, kept);
+            if (fixed && !(kept.back() == points[i])) {
+                kept.push_back(points[i]);
+            }
+            run_begin = i;
+        }
+    }
+    return kept;
+}
+
+void LaneSimplifyJob::start(const std::vector<ControlLane>& lanes,
+                            const SimplifyOptions& options) {
+    inputs_.clear();
+    inputs_.reserve(lanes.size());
+    for (const ControlLane& lane : lanes) {
+        inputs_.push_back(lane.points());
+    }
+    result_ = std::async(
+        std::launch::async,
+        [inputs = inputs_, options]() {
+            std::vector<std::vector<ControlPoint>> outputs;
+            outputs.reserve(inputs.size());
+            for (const auto& points : inputs) {
+                outputs.push_back(simplify_control_points(points, options));
+            }
+            return outputs;
+        });
+}
+
+bool LaneSimplifyJob::ready() const {
+    return result_.valid() &&
+           result_.wait_for(std::chrono::seconds(0)) ==
+               std::future_status::ready;
+}
+
+std::vector<SimplifyResult> LaneSimplifyJob::apply(
+    std::vector<ControlLane>& lanes) {
+    std::vector<SimplifyResult> results;
+    if (!result_.valid()) {
+        return results;
+    }
+    std::vector<std::vector<ControlPoint>> outputs = result_.get();
+
+    results.reserve(inputs_.size());
+    for (std::size_t i = 0; i < inputs_.size(); ++i) {
+        SimplifyResult r{inputs_[i].size(), inputs_[i].size()};
+        // Selection changes while the job ran do not count as edits; the
+        // current flags are kept on the surviving points.
+        if (i < lanes.size() && same_curve(lanes[i].points(), inputs_[i]) &&
+            outputs[i].size() != inputs_[i].size()) {
+            carry_selection(lanes[i].points(), outputs[i]);
+            lanes[i].replace_points(std::move(outputs[i]));
+            r.points_after = lanes[i].points().size();
+        }
+        results.push_back(r);
+    }
+    inputs_.clear();
+    return results;
+}
+
+}  // namespace piano_roll
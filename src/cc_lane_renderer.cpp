@@ -1,11 +1,99 @@
 #include "piano_roll/cc_lane_renderer.hpp"
 
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <string>
+
 #ifdef PIANO_ROLL_USE_IMGUI
 #include <imgui.h>
 #endif
 
 namespace piano_roll {
 
+#ifdef PIANO_ROLL_USE_IMGUI
+namespace {
+
+// Append the interior vertices of a shaped segment drawn from screen point
+// (x0, y0) to (x1, y1). The segment is split at parameter midpoints until
+// the curve stays within a quarter pixel of its chords (or a piece is
+// narrower than a pixel), so flat stretches cost a few vertices and tight
+// bends get as many as they need on screen.
+template <typename Push>
+void tessellate_segment(const ControlPoint& from,
+                        float x0,
+                        float y0,
+                        float x1,
+                        float y1,
+                        Push&& push) {
+    const float dx = x1 - x0;
+    const float dy = y1 - y0;
+    if (std::abs(dy) < 0.5f) {
+        return;
+    }
+    auto subdivide = [&](auto&& self,
+                         double u0,
+                         double f0,
+                         double u1,
+                         double f1,
+                         int depth) -> void {
+        const double um = 0.5 * (u0 + u1);
+        const double fm = curve_shape_fraction(from.shape, from.tension, um);
+        const double deviation =
+            std::abs((fm - 0.5 * (f0 + f1)) * static_cast<double>(dy));
+        const double width = static_cast<double>(dx) * (u1 - u0);
+        // Two forced levels catch S-curves, whose midpoint lies on the chord.
+        if (depth >= 2 && (deviation <= 0.25 || width <= 1.0 || depth >= 10)) {
+            return;
+        }
+        self(self, u0, f0, um, fm, depth + 1);
+        push(ImVec2(x0 + dx * static_cast<float>(um),
+                    y0 + dy * static_cast<float>(fm)));
+        self(self, um, fm, u1, f1, depth + 1);
+    };
+    subdivide(subdivide, 0.0, 0.0, 1.0, 1.0, 0);
+}
+
+}  // namespace
+#endif
+
+void update_control_lane_frame(ControlLaneFrame& frame,
+                               const CoordinateSystem& coords,
+                               float canvas_min_x,
+                               float canvas_max_x) {
+    const double key_width = coords.piano_key_width();
+    frame.left = canvas_min_x + static_cast<float>(key_width);
+    frame.right = std::max(frame.left, canvas_max_x);
+
+    // The tick -> screen mapping is linear, so two constants replace the
+    // per-point tick_to_world / world_to_screen round trip.
+    auto [tick0_screen, _] = coords.world_to_screen(coords.tick_to_world(0), 0.0);
+    frame.x_at_tick_zero = static_cast<double>(canvas_min_x) + tick0_screen;
+    frame.pixels_per_tick =
+        coords.pixels_per_beat() / static_cast<double>(coords.ticks_per_beat());
+
+    auto [world_left, wy_left] = coords.screen_to_world(key_width, 0.0);
+    auto [world_right, wy_right] = coords.screen_to_world(
+        static_cast<double>(frame.right - canvas_min_x), 0.0);
+    (void)wy_left;
+    (void)wy_right;
+    frame.visible_start = coords.world_to_tick(world_left);
+    frame.visible_end = coords.world_to_tick(world_right) + 1;
+
+    const auto columns = static_cast<std::size_t>(
+        std::ceil(static_cast<double>(frame.right - frame.left)));
+    frame.column_ticks.resize(columns + 1);
+    if (frame.pixels_per_tick <= 0.0) {
+        std::fill(frame.column_ticks.begin(), frame.column_ticks.end(), 0);
+        return;
+    }
+    for (std::size_t c = 0; c <= columns; ++c) {
+        double edge = static_cast<double>(frame.left) + static_cast<double>(c);
+        frame.column_ticks[c] = static_cast<Tick>(
+            std::ceil((edge - frame.x_at_tick_zero) / frame.pixels_per_tick));
+    }
+}
+
 void RenderControlLane(const ControlLane& lane,
                        const CoordinateSystem& coords,
                        const PianoRollRenderConfig& config) {
@@ -14,11 +102,6 @@ void RenderControlLane(const ControlLane& lane,
         return;
     }
 
-    ImDrawList* draw_list = ImGui::GetWindowDrawList();
-    if (!draw_list) {
-        return;
-    }
-
     // Use the rect of the last item (the piano roll) as the overall area.
     ImVec2 canvas_min = ImGui::GetItemRectMin();
     ImVec2 canvas_max = ImGui::GetItemRectMax();
@@ -29,12 +112,31 @@ void RenderControlLane(const ControlLane& lane,
         lane_height = total_height * 0.25f;
     }
 
-    float lane_bottom = canvas_max.y;
-    float lane_top = lane_bottom - lane_height;
+    ControlLaneFrame frame;
+    update_control_lane_frame(frame, coords, canvas_min.x, canvas_max.x);
+    RenderControlLane(
+        lane, frame, canvas_max.y - lane_height, canvas_max.y, config, true);
+#else
+    (void)lane;
+    (void)coords;
+    (void)config;
+#endif
+}
 
-    float left = canvas_min.x +
-                 static_cast<float>(coords.piano_key_width());
-    float right = canvas_max.x;
+void RenderControlLane(const ControlLane& lane,
+                       const ControlLaneFrame& frame,
+                       float lane_top,
+                       float lane_bottom,
+                       const PianoRollRenderConfig& config,
+                       bool active) {
+#ifdef PIANO_ROLL_USE_IMGUI
+    ImDrawList* draw_list = ImGui::GetWindowDrawList();
+    if (!draw_list || lane_bottom <= lane_top) {
+        return;
+    }
+
+    const float left = frame.left;
+    const float right = frame.right;
 
     auto to_imvec4 = [](const ColorRGBA& c) {
         return ImVec4(c.r, c.g, c.b, c.a);
@@ -49,77 +151,172 @@ void RenderControlLane(const ControlLane& lane,
                              to_color(config.cc_lane_background_color));
     draw_list->AddRect(ImVec2(left, lane_top),
                        ImVec2(right, lane_bottom),
-                       to_color(config.cc_lane_border_color),
+                       to_color(active ? config.cc_active_lane_border_color
+                                       : config.cc_lane_border_color),
                        0.0f,
                        0,
                        1.0f);
 
-    // Draw the curve connecting points.
+    // Only points inside the visible tick range (plus one neighbour on
+    // each side, so the curve reaches the lane edges) are drawn; points are
+    // sorted by tick, so the range is found by binary search.
     const auto& points = lane.points();
-    if (points.size() >= 2) {
-        ImVec2 prev{};
-        bool has_prev = false;
-
-        for (const ControlPoint& p : points) {
-            double world_x = coords.tick_to_world(p.tick);
-            auto [screen_x_local, _] =
-                coords.world_to_screen(world_x, 0.0);
-            float x = canvas_min.x +
-                      static_cast<float>(screen_x_local);
-
-            float t = 0.0f;
-            if (p.value <= 0) {
-                t = 1.0f;
-            } else if (p.value >= 127) {
-                t = 0.0f;
+    auto first = std::lower_bound(
+        points.begin(), points.end(), frame.visible_start,
+        [](const ControlPoint& p, Tick tick) { return p.tick < tick; });
+    auto last = std::lower_bound(
+        first, points.end(), frame.visible_end,
+        [](const ControlPoint& p, Tick tick) { return p.tick < tick; });
+    if (first != points.begin()) {
+        --first;
+    }
+    if (last != points.end()) {
+        ++last;
+    }
+
+    // Value 127 maps to the top of the lane, 0 to the bottom.
+    const float value_scale = (lane_bottom - lane_top) / 127.0f;
+    auto value_y = [&](int value) {
+        return lane_bottom -
+               static_cast<float>(std::clamp(value, 0, 127)) * value_scale;
+    };
+    auto point_pos = [&](const ControlPoint& p) {
+        return ImVec2(frame.tick_to_x(p.tick), value_y(p.value));
+    };
+
+    draw_list->PushClipRect(ImVec2(left, lane_top),
+                            ImVec2(right, lane_bottom),
+                            true);
+
+    const ImU32 curve_col = to_color(config.cc_curve_color);
+    const ImU32 point_col = to_color(config.cc_point_color);
+    const ImU32 selected_col = to_color(config.cc_selected_point_color);
+    const std::size_t visible_count =
+        static_cast<std::size_t>(last - first);
+    const std::size_t columns = frame.column_count();
+
+    std::vector<ImVec2> path;
+    auto push_path = [&path](ImVec2 p) {
+        if (path.empty() || path.back().x != p.x || path.back().y != p.y) {
+            path.push_back(p);
+        }
+    };
+
+    if (visible_count <= columns) {
+        // Sparse lane: a polyline through every point, following each
+        // segment's shape, plus point handles; selected points are larger
+        // and use the selection colour.
+        path.reserve(visible_count * 2);
+        for (auto it = first; it != last; ++it) {
+            const ImVec2 p = point_pos(*it);
+            push_path(p);
+            if (it + 1 == last || it->shape == CurveShape::Linear) {
+                continue;
+            }
+            const ImVec2 q = point_pos(*(it + 1));
+            if (it->shape == CurveShape::Hold) {
+                push_path(ImVec2(q.x, p.y));
             } else {
-                t = 1.0f - static_cast<float>(p.value) / 127.0f;
+                tessellate_segment(*it, p.x, p.y, q.x, q.y, push_path);
             }
-            float y = lane_top +
-                      t * (lane_bottom - lane_top);
-
-            ImVec2 current(x, y);
-            if (has_prev) {
-                draw_list->AddLine(prev,
-                                   current,
-                                   to_color(config.cc_curve_color),
+        }
+        if (path.size() >= 2) {
+            draw_list->AddPolyline(path.data(),
+                                   static_cast<int>(path.size()),
+                                   curve_col,
+                                   0,
                                    2.0f);
+        }
+        for (auto it = first; it != last; ++it) {
+            draw_list->AddCircleFilled(point_pos(*it),
+                                       it->selected ? 5.0f : 4.0f,
+                                       it->selected ? selected_col
+                                                    : point_col);
+        }
+    } else {
+        // Dense lane: walk the points once against the shared column
+        // boundaries and reduce each pixel column to its first, extreme and
+        // last values. The polyline visits them in that order, so a single
+        // stroke covers the column's whole value range. Columns between
+        // points take one sample of the segment's shape.
+        path.reserve(columns * 4 + 2);
+        auto it = first;
+        while (it != last && it->tick < frame.column_ticks.front()) {
+            path.clear();
+            push_path(point_pos(*it));  // leading off-screen neighbour
+            ++it;
+        }
+        for (std::size_t c = 0; c < columns && it != last; ++c) {
+            const Tick column_end = frame.column_ticks[c + 1];
+            const float x = left + static_cast<float>(c) + 0.5f;
+            if (it->tick >= column_end) {
+                // No point in this column: sample the segment crossing it
+                // unless it is linear (the stroke to the next column's
+                // first value already is), so shapes survive zooming out.
+                if (it != first && std::prev(it)->shape != CurveShape::Linear) {
+                    const double mid =
+                        0.5 * static_cast<double>(frame.column_ticks[c] +
+                                                  column_end);
+                    push_path(ImVec2(
+                        x,
+                        value_y(static_cast<int>(std::lround(
+                            segment_value(*std::prev(it), *it, mid))))));
+                }
+                continue;
+            }
+            int first_value = it->value;
+            int min_value = it->value;
+            int max_value = it->value;
+            int last_value = it->value;
+            bool any_selected = false;
+            for (; it != last && it->tick < column_end; ++it) {
+                min_value = std::min(min_value, it->value);
+                max_value = std::max(max_value, it->value);
+                last_value = it->value;
+                any_selected = any_selected || it->selected;
+            }
+            push_path(ImVec2(x, value_y(first_value)));
+            if (last_value >= first_value) {
+                push_path(ImVec2(x, value_y(min_value)));
+                push_path(ImVec2(x, value_y(max_value)));
+            } else {
+                push_path(ImVec2(x, value_y(max_value)));
+                push_path(ImVec2(x, value_y(min_value)));
             }
-            prev = current;
-            has_prev = true;
+            push_path(ImVec2(x, value_y(last_value)));
+            if (any_selected) {
+                draw_list->AddRectFilled(
+                    ImVec2(x - 1.5f, value_y(max_value) - 1.5f),
+                    ImVec2(x + 1.5f, value_y(min_value) + 1.5f),
+                    selected_col);
+            }
+        }
+        if (it != last) {
+            push_path(point_pos(*it));  // trailing off-screen neighbour
+        }
+        if (path.size() >= 2) {
+            draw_list->AddPolyline(path.data(),
+                                   static_cast<int>(path.size()),
+                                   curve_col,
+                                   0,
+                                   1.5f);
         }
     }
 
-    // Draw individual points as small circles.
-    for (const ControlPoint& p : lane.points()) {
-        double world_x = coords.tick_to_world(p.tick);
-        auto [screen_x_local, _] =
-            coords.world_to_screen(world_x, 0.0);
-        float x = canvas_min.x +
-                  static_cast<float>(screen_x_local);
-
-        float t = 0.0f;
-        if (p.value <= 0) {
-            t = 1.0f;
-        } else if (p.value >= 127) {
-            t = 0.0f;
-        } else {
-            t = 1.0f - static_cast<float>(p.value) / 127.0f;
-        }
-        float y = lane_top +
-                  t * (lane_bottom - lane_top);
+    const std::string label = "CC " + std::to_string(lane.cc_number());
+    draw_list->AddText(ImVec2(left + 4.0f, lane_top + 2.0f),
+                       to_color(config.cc_lane_label_color),
+                       label.c_str());
 
-        float radius = 4.0f;
-        draw_list->AddCircleFilled(ImVec2(x, y),
-                                   radius,
-                                   to_color(config.cc_point_color));
-    }
+    draw_list->PopClipRect();
 #else
     (void)lane;
-    (void)coords;
+    (void)frame;
+    (void)lane_top;
+    (void)lane_bottom;
     (void)config;
+    (void)active;
 #endif
 }
 
 }  // namespace piano_roll
-
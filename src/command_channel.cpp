@@ -0,0 +1,923 @@
+#include "piano_roll/command_channel.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <limits>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define PIANO_ROLL_HAS_POSIX_SOCKETS 1
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace piano_roll {
+
+namespace {
+
+std::uint64_t now_ns() noexcept {
+    return static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch())
+            .count());
+}
+
+SharedNoteRecord to_record(const Note& note) noexcept {
+    SharedNoteRecord record{};
+    record.tick = note.tick;
+    record.duration = note.duration;
+    record.id = note.id;
+    record.key = static_cast<std::int16_t>(note.key);
+    record.velocity = static_cast<std::uint8_t>(note.velocity);
+    record.channel = static_cast<std::uint8_t>(note.channel);
+    record.flags = note.selected ? kSharedSelected : 0;
+    return record;
+}
+
+Note from_record(const SharedNoteRecord& record) noexcept {
+    Note note;
+    note.tick = record.tick;
+    note.duration = record.duration;
+    note.key = record.key;
+    note.velocity = record.velocity;
+    note.channel = record.channel;
+    note.selected = (record.flags & kSharedSelected) != 0;
+    return note;
+}
+
+template <typename T>
+void append_bytes(std::vector<unsigned char>& out, const T& value) {
+    const auto* bytes = reinterpret_cast<const unsigned char*>(&value);
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+template <typename T>
+T read_bytes(const unsigned char* data) noexcept {
+    T value;
+    std::memcpy(&value, data, sizeof(T));
+    return value;
+}
+
+// Size check for a command's payload, before anything is applied.
+bool payload_fits(CommandOpcode opcode, std::size_t size) noexcept {
+    switch (opcode) {
+    case CommandOpcode::InsertNotes:
+        return size % sizeof(SharedNoteRecord) == 0;
+    case CommandOpcode::MoveNotes:
+        return size % sizeof(CommandNoteMove) == 0;
+    case CommandOpcode::SelectWhere:
+        return size == sizeof(CommandNoteFilter);
+    case CommandOpcode::QueryRange:
+        return size == sizeof(CommandRange);
+    case CommandOpcode::Snapshot:
+        return size == 0;
+    }
+    return false;
+}
+
+bool known_opcode(std::uint16_t opcode) noexcept {
+    return opcode >= static_cast<std::uint16_t>(CommandOpcode::InsertNotes) &&
+           opcode <= static_cast<std::uint16_t>(CommandOpcode::Snapshot);
+}
+
+#ifdef PIANO_ROLL_HAS_POSIX_SOCKETS
+std::string system_error(const char* what) {
+    return std::string(what) + ": " + std::strerror(errno);
+}
+
+#ifdef MSG_NOSIGNAL
+constexpr int kSendFlags = MSG_NOSIGNAL;
+#else
+constexpr int kSendFlags = 0;
+#endif
+
+// Writes to a peer that went away must fail with EPIPE rather than raise
+// SIGPIPE in the host.
+void suppress_sigpipe(int fd) noexcept {
+#ifdef SO_NOSIGPIPE
+    int on = 1;
+    ::setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#else
+    (void)fd;
+#endif
+}
+
+bool set_nonblocking(int fd) noexcept {
+    const int flags = ::fcntl(fd, F_GETFL, 0);
+    return flags >= 0 && ::fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+bool make_address(const std::string& path, sockaddr_un& address) noexcept {
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(address.sun_path)) {
+        return false;
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
+#endif
+
+}  // namespace
+
+// ---------------------------------------------------------------------------
+// Batch builder
+
+void CommandBatch::append(CommandOpcode opcode,
+                          const void* data,
+                          std::size_t size) {
+    CommandHeader header{};
+    header.opcode = static_cast<std::uint16_t>(opcode);
+    header.size = static_cast<std::uint32_t>(size);
+    append_bytes(payload_, header);
+    const auto* bytes = static_cast<const unsigned char*>(data);
+    payload_.insert(payload_.end(), bytes, bytes + size);
+    ++command_count_;
+}
+
+void CommandBatch::insert_notes(std::span<const Note> notes) {
+    std::vector<SharedNoteRecord> records;
+    records.reserve(notes.size());
+    for (const Note& note : notes) {
+        records.push_back(to_record(note));
+    }
+    append(CommandOpcode::InsertNotes,
+           records.data(),
+           records.size() * sizeof(SharedNoteRecord));
+}
+
+void CommandBatch::move_notes(std::span<const CommandNoteMove> moves) {
+    append(CommandOpcode::MoveNotes, moves.data(), moves.size_bytes());
+}
+
+void CommandBatch::select_where(const CommandNoteFilter& filter) {
+    append(CommandOpcode::SelectWhere, &filter, sizeof(filter));
+}
+
+void CommandBatch::query_range(Tick start_tick,
+                               Tick end_tick,
+                               MidiKey min_key,
+                               MidiKey max_key) {
+    CommandRange range{};
+    range.start_tick = start_tick;
+    range.end_tick = end_tick;
+    range.min_key = static_cast<std::int16_t>(min_key);
+    range.max_key = static_cast<std::int16_t>(max_key);
+    append(CommandOpcode::QueryRange, &range, sizeof(range));
+}
+
+void CommandBatch::snapshot() {
+    append(CommandOpcode::Snapshot, nullptr, 0);
+}
+
+CommandNoteFilter CommandBatch::match_all() noexcept {
+    CommandNoteFilter filter{};
+    filter.start_tick = 0;
+    filter.end_tick = std::numeric_limits<std::int64_t>::max();
+    filter.min_key = 0;
+    filter.max_key = 127;
+    filter.min_velocity = 0;
+    filter.max_velocity = 127;
+    filter.channel = kCommandAnyChannel;
+    filter.add_to_selection = 0;
+    return filter;
+}
+
+void CommandBatch::clear() noexcept {
+    payload_.clear();
+    command_count_ = 0;
+}
+
+std::vector<unsigned char> CommandBatch::encode(std::uint32_t batch_id) const {
+    CommandBatchHeader header{};
+    header.magic = kCommandBatchMagic;
+    header.version = kCommandProtocolVersion;
+    header.command_count = static_cast<std::uint16_t>(command_count_);
+    header.batch_id = batch_id;
+    header.payload_size = static_cast<std::uint32_t>(payload_.size());
+    std::vector<unsigned char> bytes(sizeof(header) + payload_.size());
+    std::memcpy(bytes.data(), &header, sizeof(header));
+    std::copy(payload_.begin(), payload_.end(), bytes.begin() + sizeof(header));
+    return bytes;
+}
+
+// ---------------------------------------------------------------------------
+// Server
+
+CommandServer::CommandServer(CommandServerOptions options)
+    : options_(options) {}
+
+CommandServer::~CommandServer() {
+    stop();
+}
+
+bool CommandServer::start(const std::string& socket_path) {
+    stop();
+    error_.clear();
+#ifdef PIANO_ROLL_HAS_POSIX_SOCKETS
+    sockaddr_un address;
+    if (!make_address(socket_path, address)) {
+        error_ = "socket path is empty or too long";
+        return false;
+    }
+    struct stat info {};
+    if (::lstat(socket_path.c_str(), &info) == 0) {
+        if (!S_ISSOCK(info.st_mode)) {
+            error_ = socket_path + " exists and is not a socket";
+            return false;
+        }
+        ::unlink(socket_path.c_str());
+    }
+
+    listen_fd_ = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd_ < 0) {
+        error_ = system_error("socket");
+        return false;
+    }
+    if (::bind(listen_fd_,
+               reinterpret_cast<const sockaddr*>(&address),
+               sizeof(address)) != 0) {
+        error_ = system_error("bind");
+        ::close(listen_fd_);
+        listen_fd_ = -1;
+        return false;
+    }
+    path_ = socket_path;
+    if (::chmod(socket_path.c_str(), 0600) != 0) {
+        error_ = system_error("chmod");
+        stop();
+        return false;
+    }
+    int wake_fds[2];
+    if (::listen(listen_fd_, 16) != 0 || !set_nonblocking(listen_fd_) ||
+        ::pipe(wake_fds) != 0) {
+        error_ = system_error("listen");
+        stop();
+        return false;
+    }
+    wake_read_fd_ = wake_fds[0];
+    wake_write_fd_ = wake_fds[1];
+    set_nonblocking(wake_read_fd_);
+    set_nonblocking(wake_write_fd_);
+
+    stopping_ = false;
+    io_thread_ = std::thread(&CommandServer::io_loop, this);
+    return true;
+#else
+    (void)socket_path;
+    error_ = "the command channel needs POSIX Unix-domain sockets";
+    return false;
+#endif
+}
+
+void CommandServer::stop() {
+#ifdef PIANO_ROLL_HAS_POSIX_SOCKETS
+    if (io_thread_.joinable()) {
+        stopping_ = true;
+        wake();
+        io_thread_.join();
+    }
+    for (int* fd : {&listen_fd_, &wake_read_fd_, &wake_write_fd_}) {
+        if (*fd >= 0) {
+            ::close(*fd);
+            *fd = -1;
+        }
+    }
+    if (!path_.empty()) {
+        ::unlink(path_.c_str());
+        path_.clear();
+    }
+#endif
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_.clear();
+    outgoing_.clear();
+}
+
+void CommandServer::wake() noexcept {
+#ifdef PIANO_ROLL_HAS_POSIX_SOCKETS
+    if (wake_write_fd_ >= 0) {
+        const unsigned char byte = 1;
+        // A full pipe already guarantees a wake-up.
+        [[maybe_unused]] auto written = ::write(wake_write_fd_, &byte, 1);
+    }
+#endif
+}
+
+std::size_t CommandServer::pending_batches() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return pending_.size();
+}
+
+void CommandServer::io_loop() {
+#ifdef PIANO_ROLL_HAS_POSIX_SOCKETS
+    std::vector<pollfd> fds;
+    std::vector<std::uint64_t> ids;
+    while (!stopping_) {
+        bool reading = true;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            // Back-pressure: process() wakes the loop once it drains pending_.
+            reading = pending_.size() < options_.max_pending_batches;
+            for (auto& [id, bytes] : outgoing_) {
+                auto it = connections_.find(id);
+                if (it != connections_.end()) {
+                    std::vector<unsigned char>& output = it->second.output;
+                    output.insert(output.end(), bytes.begin(), bytes.end());
+                }
+            }
+            outgoing_.clear();
+        }
+        // Flush eagerly; poll only waits for what could not be written.
+        for (auto it = connections_.begin(); it != connections_.end();) {
+            if (!write_connection(it->second)) {
+                ::close(it->second.fd);
+                it = connections_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+
+        fds.clear();
+        ids.clear();
+        fds.push_back(pollfd{listen_fd_, POLLIN, 0});
+        fds.push_back(pollfd{wake_read_fd_, POLLIN, 0});
+        for (const auto& [id, connection] : connections_) {
+            short events = reading ? POLLIN : 0;
+            if (connection.output_sent < connection.output.size()) {
+                events |= POLLOUT;
+            }
+            fds.push_back(pollfd{connection.fd, events, 0});
+            ids.push_back(id);
+        }
+        if (::poll(fds.data(), static_cast<nfds_t>(fds.size()), -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+
+        if ((fds[1].revents & POLLIN) != 0) {
+            unsigned char drain[64];
+            while (::read(wake_read_fd_, drain, sizeof(drain)) > 0) {
+            }
+        }
+        if ((fds[0].revents & POLLIN) != 0) {
+            for (;;) {
+                const int fd = ::accept(listen_fd_, nullptr, nullptr);
+                if (fd < 0) {
+                    break;
+                }
+                if (connections_.size() >= options_.max_clients ||
+                    !set_nonblocking(fd)) {
+                    ::close(fd);
+                    continue;
+                }
+                suppress_sigpipe(fd);
+                connections_[next_client_++].fd = fd;
+            }
+        }
+        for (std::size_t i = 0; i < ids.size(); ++i) {
+            const short revents = fds[i + 2].revents;
+            if (revents == 0) {
+                continue;
+            }
+            auto it = connections_.find(ids[i]);
+            if (it == connections_.end()) {
+                continue;
+            }
+            bool keep = true;
+            if ((revents & (POLLIN | POLLHUP | POLLERR)) != 0) {
+                keep = read_connection(ids[i], it->second);
+            }
+            if (keep && (revents & POLLOUT) != 0) {
+                keep = write_connection(it->second);
+            }
+            if (!keep) {
+                ::close(it->second.fd);
+                connections_.erase(it);
+            }
+        }
+    }
+    for (auto& [id, connection] : connections_) {
+        (void)id;
+        ::close(connection.fd);
+    }
+    connections_.clear();
+#endif
+}
+
+bool CommandServer::read_connection(std::uint64_t id, Connection& connection) {
+#ifdef PIANO_ROLL_HAS_POSIX_SOCKETS
+    unsigned char buffer[1 << 16];
+    bool open = true;
+    for (;;) {
+        const ssize_t n = ::read(connection.fd, buffer, sizeof(buffer));
+        if (n > 0) {
+            connection.input.insert(
+                connection.input.end(), buffer, buffer + n);
+            continue;
+        }
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+            open = false;
+        }
+        break;
+    }
+
+    // Split off complete batches; only framing is checked here, the
+    // commands are validated on the UI thread.
+    std::vector<PendingBatch> batches;
+    std::size_t offset = 0;
+    while (connection.input.size() - offset >= sizeof(CommandBatchHeader)) {
+        const auto header =
+            read_bytes<CommandBatchHeader>(connection.input.data() + offset);
+        if (header.magic != kCommandBatchMagic ||
+            header.version != kCommandProtocolVersion) {
+            return false;
+        }
+        const std::size_t total =
+            sizeof(CommandBatchHeader) + header.payload_size;
+        if (total > options_.max_batch_bytes) {
+            return false;
+        }
+        if (connection.input.size() - offset < total) {
+            break;
+        }
+        PendingBatch batch;
+        batch.client = id;
+        batch.received_ns = now_ns();
+        const auto first =
+            connection.input.begin() + static_cast<std::ptrdiff_t>(offset);
+        batch.bytes.assign(first, first + static_cast<std::ptrdiff_t>(total));
+        batches.push_back(std::move(batch));
+        offset += total;
+    }
+    connection.input.erase(
+        connection.input.begin(),
+        connection.input.begin() + static_cast<std::ptrdiff_t>(offset));
+    if (!batches.empty()) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (PendingBatch& batch : batches) {
+            pending_.push_back(std::move(batch));
+        }
+    }
+    return open;
+#else
+    (void)id;
+    (void)connection;
+    return false;
+#endif
+}
+
+bool CommandServer::write_connection(Connection& connection) {
+#ifdef PIANO_ROLL_HAS_POSIX_SOCKETS
+    while (connection.output_sent < connection.output.size()) {
+        const ssize_t n =
+            ::send(connection.fd,
+                   connection.output.data() + connection.output_sent,
+                   connection.output.size() - connection.output_sent,
+                   kSendFlags);
+        if (n > 0) {
+            connection.output_sent += static_cast<std::size_t>(n);
+            continue;
+        }
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return true;
+        }
+        return false;
+    }
+    connection.output.clear();
+    connection.output_sent = 0;
+    return true;
+#else
+    (void)connection;
+    return false;
+#endif
+}
+
+std::size_t CommandServer::process(NoteManager& notes,
+                                   std::size_t max_batches) {
+    work_.clear();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        while (!pending_.empty() && work_.size() < max_batches) {
+            work_.push_back(std::move(pending_.front()));
+            pending_.pop_front();
+        }
+    }
+    if (work_.empty()) {
+        return 0;
+    }
+    std::vector<std::vector<unsigned char>> responses;
+    responses.reserve(work_.size());
+    for (const PendingBatch& batch : work_) {
+        responses.push_back(apply_batch(notes, batch));
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (std::size_t i = 0; i < work_.size(); ++i) {
+            std::vector<unsigned char>& out = outgoing_[work_[i].client];
+            out.insert(out.end(), responses[i].begin(), responses[i].end());
+        }
+    }
+    wake();
+    return work_.size();
+}
+
+std::vector<unsigned char> CommandServer::apply_batch(
+    NoteManager& notes,
+    const PendingBatch& batch) {
+    const std::uint64_t start = now_ns();
+    const auto header = read_bytes<CommandBatchHeader>(batch.bytes.data());
+
+    struct Command {
+        CommandOpcode opcode;
+        const unsigned char* data;
+        std::size_t size;
+    };
+    std::vector<Command> commands;
+    commands.reserve(header.command_count);
+    CommandStatus status = CommandStatus::Ok;
+    std::size_t offset = sizeof(CommandBatchHeader);
+    for (std::size_t i = 0; i < header.command_count; ++i) {
+        if (batch.bytes.size() - offset < sizeof(CommandHeader)) {
+            status = CommandStatus::Malformed;
+            break;
+        }
+        const auto command =
+            read_bytes<CommandHeader>(batch.bytes.data() + offset);
+        offset += sizeof(CommandHeader);
+        if (command.size > batch.bytes.size() - offset) {
+            status = CommandStatus::Malformed;
+            break;
+        }
+        if (!known_opcode(command.opcode)) {
+            status = CommandStatus::UnknownOpcode;
+            break;
+        }
+        const auto opcode = static_cast<CommandOpcode>(command.opcode);
+        if (!payload_fits(opcode, command.size)) {
+            status = CommandStatus::Malformed;
+            break;
+        }
+        commands.push_back(
+            Command{opcode, batch.bytes.data() + offset, command.size});
+        offset += command.size;
+    }
+    if (status == CommandStatus::Ok && offset != batch.bytes.size()) {
+        status = CommandStatus::Malformed;
+    }
+
+    std::vector<unsigned char> results;
+    std::uint16_t result_count = 0;
+    if (status == CommandStatus::Ok) {
+        // One undo step per batch, taken just before the first command that
+        // will change a note, so batches whose edits are all skipped leave
+        // the undo stack alone.
+        bool undo_taken = !options_.record_undo;
+        auto snapshot_once = [&] {
+            if (!undo_taken) {
+                notes.snapshot_for_undo();
+                undo_taken = true;
+            }
+        };
+
+        auto append_result = [&](CommandOpcode opcode,
+                                 std::uint32_t count,
+                                 const void* data,
+                                 std::size_t size) {
+            CommandResultHeader result{};
+            result.opcode = static_cast<std::uint16_t>(opcode);
+            result.status = static_cast<std::uint16_t>(CommandStatus::Ok);
+            result.count = count;
+            result.size = static_cast<std::uint32_t>(size);
+            append_bytes(results, result);
+            const auto* bytes = static_cast<const unsigned char*>(data);
+            results.insert(results.end(), bytes, bytes + size);
+            ++result_count;
+        };
+        std::vector<SharedNoteRecord> records;
+
+        for (const Command& command : commands) {
+            switch (command.opcode) {
+            case CommandOpcode::InsertNotes: {
+                std::vector<Note> inserted(command.size /
+                                           sizeof(SharedNoteRecord));
+                for (std::size_t i = 0; i < inserted.size(); ++i) {
+                    inserted[i] = from_record(read_bytes<SharedNoteRecord>(
+                        command.data + i * sizeof(SharedNoteRecord)));
+                }
+                if (std::any_of(inserted.begin(),
+                                inserted.end(),
+                                [](const Note& note) {
+                                    return note.is_valid();
+                                })) {
+                    snapshot_once();
+                }
+                const std::vector<NoteId> ids =
+                    notes.add_notes(inserted, /*record_undo=*/false);
+                const auto added = static_cast<std::uint32_t>(
+                    std::count_if(ids.begin(), ids.end(), [](NoteId id) {
+                        return id != 0;
+                    }));
+                stats_.notes_inserted += added;
+                append_result(command.opcode,
+                              added,
+                              ids.data(),
+                              ids.size() * sizeof(NoteId));
+                break;
+            }
+            case CommandOpcode::MoveNotes: {
+                const std::size_t count =
+                    command.size / sizeof(CommandNoteMove);
+                std::vector<NoteEdit> edits;
+                edits.reserve(count);
+                for (std::size_t i = 0; i < count; ++i) {
+                    const auto move = read_bytes<CommandNoteMove>(
+                        command.data + i * sizeof(CommandNoteMove));
+                    const Note* note = notes.find_by_id(move.id);
+                    if (note == nullptr ||
+                        (move.delta_tick == 0 && move.delta_key == 0)) {
+                        continue;
+                    }
+                    // Skip what apply_note_edits would reject.
+                    const Tick tick = note->tick + move.delta_tick;
+                    const MidiKey key = note->key + move.delta_key;
+                    if (tick < 0 || key < 0 || key > 127) {
+                        continue;
+                    }
+                    edits.push_back(
+                        NoteEdit{note->id, tick, note->duration, key});
+                }
+                if (!edits.empty()) {
+                    snapshot_once();
+                }
+                const auto moved = static_cast<std::uint32_t>(
+                    notes.apply_note_edits(edits, {}, /*record_undo=*/false));
+                stats_.notes_moved += moved;
+                append_result(command.opcode, moved, nullptr, 0);
+                break;
+            }
+            case CommandOpcode::SelectWhere: {
+                const auto filter =
+                    read_bytes<CommandNoteFilter>(command.data);
+                std::vector<NoteId> matched;
+                notes.for_each_in_range(
+                    filter.start_tick,
+                    filter.end_tick,
+                    filter.min_key,
+                    filter.max_key,
+                    [&](const Note& note) {
+                        if (note.velocity >= filter.min_velocity &&
+                            note.velocity <= filter.max_velocity &&
+                            (filter.channel == kCommandAnyChannel ||
+                             note.channel == filter.channel)) {
+                            matched.push_back(note.id);
+                        }
+                    });
+                if (filter.add_to_selection == 0) {
+                    notes.clear_selection();
+                }
+                for (NoteId id : matched) {
+                    notes.select(id, true);
+                }
+                append_result(command.opcode,
+                              static_cast<std::uint32_t>(matched.size()),
+                              nullptr,
+                              0);
+                break;
+            }
+            case CommandOpcode::QueryRange: {
+                const auto range = read_bytes<CommandRange>(command.data);
+                records.clear();
+                notes.for_each_in_range(range.start_tick,
+                                        range.end_tick,
+                                        range.min_key,
+                                        range.max_key,
+                                        [&](const Note& note) {
+                                            records.push_back(to_record(note));
+                                        });
+                append_result(command.opcode,
+                              static_cast<std::uint32_t>(records.size()),
+                              records.data(),
+                              records.size() * sizeof(SharedNoteRecord));
+                break;
+            }
+            case CommandOpcode::Snapshot: {
+                records.clear();
+                records.reserve(notes.notes().size());
+                for (const Note& note : notes.notes()) {
+                    records.push_back(to_record(note));
+                }
+                append_result(command.opcode,
+                              static_cast<std::uint32_t>(records.size()),
+                              records.data(),
+                              records.size() * sizeof(SharedNoteRecord));
+                break;
+            }
+            }
+        }
+        ++stats_.batches;
+        stats_.commands += commands.size();
+    } else {
+        ++stats_.rejected;
+    }
+
+    const std::uint64_t queued =
+        start > batch.received_ns ? start - batch.received_ns : 0;
+    const std::uint64_t applied = now_ns() - start;
+    stats_.last_queued_ns = queued;
+    stats_.last_apply_ns = applied;
+    stats_.max_apply_ns = std::max(stats_.max_apply_ns, applied);
+    stats_.total_queued_ns += queued;
+    stats_.total_apply_ns += applied;
+
+    CommandResponseHeader response{};
+    response.magic = kCommandResponseMagic;
+    response.version = kCommandProtocolVersion;
+    response.result_count = result_count;
+    response.batch_id = header.batch_id;
+    response.status = static_cast<std::uint16_t>(status);
+    response.queued_ns = queued;
+    response.apply_ns = applied;
+    response.revision = notes.revision();
+    response.payload_size = static_cast<std::uint32_t>(results.size());
+    std::vector<unsigned char> bytes(sizeof(response) + results.size());
+    std::memcpy(bytes.data(), &response, sizeof(response));
+    std::copy(results.begin(), results.end(), bytes.begin() + sizeof(response));
+    return bytes;
+}
+
+// ---------------------------------------------------------------------------
+// Client
+
+CommandClient::~CommandClient() {
+    close();
+}
+
+bool CommandClient::connect(const std::string& socket_path) {
+    close();
+    error_.clear();
+#ifdef PIANO_ROLL_HAS_POSIX_SOCKETS
+    sockaddr_un address;
+    if (!make_address(socket_path, address)) {
+        error_ = "socket path is empty or too long";
+        return false;
+    }
+    fd_ = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd_ < 0) {
+        error_ = system_error("socket");
+        return false;
+    }
+    if (::connect(fd_,
+                  reinterpret_cast<const sockaddr*>(&address),
+                  sizeof(address)) != 0) {
+        error_ = system_error("connect");
+        close();
+        return false;
+    }
+    suppress_sigpipe(fd_);
+    return true;
+#else
+    (void)socket_path;
+    error_ = "the command channel needs POSIX Unix-domain sockets";
+    return false;
+#endif
+}
+
+void CommandClient::close() {
+#ifdef PIANO_ROLL_HAS_POSIX_SOCKETS
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+#endif
+    fd_ = -1;
+}
+
+std::uint32_t CommandClient::send(const CommandBatch& batch) {
+    if (fd_ < 0) {
+        error_ = "not connected";
+        return 0;
+    }
+#ifdef PIANO_ROLL_HAS_POSIX_SOCKETS
+    const std::uint32_t id = next_batch_id_++;
+    const std::vector<unsigned char> bytes = batch.encode(id);
+    std::size_t sent = 0;
+    while (sent < bytes.size()) {
+        const ssize_t n =
+            ::send(fd_, bytes.data() + sent, bytes.size() - sent, kSendFlags);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            error_ = system_error("send");
+            close();
+            return 0;
+        }
+        sent += static_cast<std::size_t>(n);
+    }
+    return id;
+#else
+    (void)batch;
+    return 0;
+#endif
+}
+
+bool CommandClient::read_exact(void* data, std::size_t size) {
+#ifdef PIANO_ROLL_HAS_POSIX_SOCKETS
+    auto* out = static_cast<unsigned char*>(data);
+    std::size_t received = 0;
+    while (received < size) {
+        const ssize_t n = ::read(fd_, out + received, size - received);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            error_ = n == 0 ? "connection closed" : system_error("read");
+            close();
+            return false;
+        }
+        received += static_cast<std::size_t>(n);
+    }
+    return true;
+#else
+    (void)data;
+    (void)size;
+    return false;
+#endif
+}
+
+bool CommandClient::receive(CommandBatchResult& result) {
+    if (fd_ < 0) {
+        error_ = "not connected";
+        return false;
+    }
+    CommandResponseHeader header;
+    if (!read_exact(&header, sizeof(header))) {
+        return false;
+    }
+    if (header.magic != kCommandResponseMagic ||
+        header.version != kCommandProtocolVersion) {
+        error_ = "unexpected response header";
+        close();
+        return false;
+    }
+    buffer_.resize(header.payload_size);
+    if (!read_exact(buffer_.data(), buffer_.size())) {
+        return false;
+    }
+
+    result.batch_id = header.batch_id;
+    result.status = static_cast<CommandStatus>(header.status);
+    result.queued_ns = header.queued_ns;
+    result.apply_ns = header.apply_ns;
+    result.revision = header.revision;
+    result.results.assign(header.result_count, CommandResult{});
+    std::size_t offset = 0;
+    for (CommandResult& out : result.results) {
+        if (buffer_.size() - offset < sizeof(CommandResultHeader)) {
+            error_ = "truncated response";
+            return false;
+        }
+        const auto item =
+            read_bytes<CommandResultHeader>(buffer_.data() + offset);
+        offset += sizeof(CommandResultHeader);
+        if (item.size > buffer_.size() - offset) {
+            error_ = "truncated response";
+            return false;
+        }
+        out.opcode = static_cast<CommandOpcode>(item.opcode);
+        out.status = static_cast<CommandStatus>(item.status);
+        out.count = item.count;
+        const unsigned char* data = buffer_.data() + offset;
+        if (out.opcode == CommandOpcode::InsertNotes) {
+            out.ids.resize(item.size / sizeof(NoteId));
+            std::memcpy(out.ids.data(), data, out.ids.size() * sizeof(NoteId));
+        } else if (out.opcode == CommandOpcode::QueryRange ||
+                   out.opcode == CommandOpcode::Snapshot) {
+            out.notes.resize(item.size / sizeof(SharedNoteRecord));
+            std::memcpy(out.notes.data(),
+                        data,
+                        out.notes.size() * sizeof(SharedNoteRecord));
+        }
+        offset += item.size;
+    }
+    return true;
+}
+
+bool CommandClient::execute(const CommandBatch& batch,
+                            CommandBatchResult& result) {
+    return send(batch) != 0 && receive(result);
+}
+
+}  // namespace piano_roll
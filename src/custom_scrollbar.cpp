@@ -2,7 +2,6 @@
 
 #include <algorithm>
 #include <cmath>
-#include <ctime>
 
 #ifdef PIANO_ROLL_USE_IMGUI
 #include <imgui.h>
@@ -193,19 +192,21 @@ bool CustomScrollbar::handle_mouse_down(double mouse_x,
     last_mouse_y_ = mouse_y;
 
     // Double-click detection on thumb.
-    double now = static_cast<double>(std::time(nullptr));
+    const double now = clock_->now_seconds();
     bool within_thumb =
         bounds.left <= mouse_x && mouse_x <= bounds.right &&
         bounds.top <= mouse_y && mouse_y <= bounds.bottom;
     if (within_thumb) {
-        double time_diff = now - last_click_time_;
-        if (time_diff < double_click_threshold_ && time_diff > 0.05) {
+        const double time_diff = now - last_click_time_;
+        if (has_last_click_ && time_diff < double_click_threshold_ &&
+            time_diff > 0.05) {
             if (on_double_click) {
                 on_double_click();
             }
-            last_click_time_ = 0.0;
+            has_last_click_ = false;
             return true;
         }
+        has_last_click_ = true;
         last_click_time_ = now;
     }
 
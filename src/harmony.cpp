@@ -0,0 +1,331 @@
+#include "piano_roll/harmony.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace piano_roll {
+
+namespace {
+
+constexpr MidiKey kLowestKey = 0;
+constexpr MidiKey kHighestKey = 127;
+
+struct ChordTemplate {
+    ChordQuality quality;
+    const char* suffix;
+    std::array<int, 4> intervals;
+    int size;
+};
+
+// Simpler templates first: on equal scores the earlier one wins, so a
+// triad is not reported as a seventh chord it only partly fills.
+constexpr std::array<ChordTemplate, 11> kChordTemplates{{
+    {ChordQuality::Power, "5", {0, 7, 0, 0}, 2},
+    {ChordQuality::Major, "", {0, 4, 7, 0}, 3},
+    {ChordQuality::Minor, "m", {0, 3, 7, 0}, 3},
+    {ChordQuality::Diminished, "dim", {0, 3, 6, 0}, 3},
+    {ChordQuality::Augmented, "aug", {0, 4, 8, 0}, 3},
+    {ChordQuality::Sus2, "sus2", {0, 2, 7, 0}, 3},
+    {ChordQuality::Sus4, "sus4", {0, 5, 7, 0}, 3},
+    {ChordQuality::Dominant7, "7", {0, 4, 7, 10}, 4},
+    {ChordQuality::Major7, "maj7", {0, 4, 7, 11}, 4},
+    {ChordQuality::Minor7, "m7", {0, 3, 7, 10}, 4},
+    {ChordQuality::HalfDiminished7, "m7b5", {0, 3, 6, 10}, 4},
+}};
+
+constexpr std::array<const char*, 12> kPitchClassNames{
+    "C", "C#", "D", "Eb", "E", "F", "F#", "G", "Ab", "A", "Bb", "B"};
+
+constexpr std::array<double, 12> kMajorKeyProfile{
+    6.35, 2.23, 3.48, 2.33, 4.38, 4.09, 2.52, 5.19, 2.39, 3.66, 2.29, 2.88};
+constexpr std::array<double, 12> kMinorKeyProfile{
+    6.33, 2.68, 3.52, 5.38, 2.60, 3.53, 2.54, 4.75, 3.98, 2.69, 3.34, 3.17};
+
+double correlation(const PitchClassProfile& profile,
+                   const std::array<double, 12>& reference,
+                   int tonic) noexcept {
+    double mean_x = 0.0;
+    double mean_y = 0.0;
+    for (int i = 0; i < 12; ++i) {
+        mean_x += profile[static_cast<std::size_t>(i)];
+        mean_y += reference[static_cast<std::size_t>(i)];
+    }
+    mean_x /= 12.0;
+    mean_y /= 12.0;
+    double sxy = 0.0;
+    double sxx = 0.0;
+    double syy = 0.0;
+    for (int i = 0; i < 12; ++i) {
+        const double x =
+            profile[static_cast<std::size_t>((tonic + i) % 12)] - mean_x;
+        const double y = reference[static_cast<std::size_t>(i)] - mean_y;
+        sxy += x * y;
+        sxx += x * x;
+        syy += y * y;
+    }
+    return sxx > 0.0 ? sxy / std::sqrt(sxx * syy) : 0.0;
+}
+
+}  // namespace
+
+std::string chord_name(const Chord& chord) {
+    if (!chord.valid() || chord.root < 0 || chord.root > 11) {
+        return {};
+    }
+    std::string name = kPitchClassNames[static_cast<std::size_t>(chord.root)];
+    for (const ChordTemplate& t : kChordTemplates) {
+        if (t.quality == chord.quality) {
+            name += t.suffix;
+            break;
+        }
+    }
+    return name;
+}
+
+Chord label_chord(const PitchClassProfile& profile, int bass_pitch_class) {
+    double total = 0.0;
+    double strongest = 0.0;
+    for (double weight : profile) {
+        total += weight;
+        strongest = std::max(strongest, weight);
+    }
+    if (total <= 0.0) {
+        return {};
+    }
+    // Pitch classes weaker than this count as missing from a template.
+    const double present = strongest * 0.1;
+
+    Chord best;
+    double best_score = -std::numeric_limits<double>::infinity();
+    for (const ChordTemplate& t : kChordTemplates) {
+        for (int root = 0; root < 12; ++root) {
+            if (profile[static_cast<std::size_t>(root)] < present) {
+                continue;
+            }
+            double inside = 0.0;
+            int missing = 0;
+            for (int i = 0; i < t.size; ++i) {
+                const double weight = profile[static_cast<std::size_t>(
+                    (root + t.intervals[static_cast<std::size_t>(i)]) % 12)];
+                inside += weight;
+                if (weight < present) {
+                    ++missing;
+                }
+            }
+            if (t.size - missing < 2 || missing > 1) {
+                continue;
+            }
+            double score = inside - (total - inside) -
+                           static_cast<double>(missing) * total * 0.25;
+            if (root == bass_pitch_class) {
+                score += total * 0.1;
+            }
+            if (score > best_score) {
+                best_score = score;
+                best = Chord{root, t.quality};
+            }
+        }
+    }
+    return best;
+}
+
+std::uint16_t KeyEstimate::scale_mask() const noexcept {
+    if (tonic < 0) {
+        return 0;
+    }
+    static constexpr std::array<int, 7> kMajor{0, 2, 4, 5, 7, 9, 11};
+    static constexpr std::array<int, 7> kMinor{0, 2, 3, 5, 7, 8, 10};
+    std::uint16_t mask = 0;
+    for (int step : minor ? kMinor : kMajor) {
+        mask = static_cast<std::uint16_t>(mask | (1u << ((tonic + step) % 12)));
+    }
+    return mask;
+}
+
+KeyEstimate estimate_key(const PitchClassProfile& profile) {
+    KeyEstimate best;
+    bool any = false;
+    for (double weight : profile) {
+        any = any || weight > 0.0;
+    }
+    if (!any) {
+        return best;
+    }
+    best.correlation = -2.0;
+    for (int tonic = 0; tonic < 12; ++tonic) {
+        for (bool minor : {false, true}) {
+            const double r = correlation(
+                profile, minor ? kMinorKeyProfile : kMajorKeyProfile, tonic);
+            if (r > best.correlation) {
+                best = KeyEstimate{tonic, minor, r};
+            }
+        }
+    }
+    return best;
+}
+
+void HarmonyAnalysis::rebuild(const NoteManager& notes, int ticks_per_beat) {
+    source_ = &notes;
+    revision_ = notes.revision();
+    ticks_per_beat_ = std::max(ticks_per_beat, 1);
+
+    Tick extent = 0;
+    for (const Note& note : notes.notes()) {
+        extent = std::max(extent, note.end_tick());
+    }
+    beats_.assign(static_cast<std::size_t>(
+                      (extent + ticks_per_beat_ - 1) / ticks_per_beat_),
+                  BeatHarmony{});
+    for (const Note& note : notes.notes()) {
+        add_note(note, 0, beats_.size());
+    }
+    for (BeatHarmony& beat : beats_) {
+        PitchClassProfile profile{};
+        std::copy(beat.weights.begin(), beat.weights.end(), profile.begin());
+        beat.chord = label_chord(profile, beat.bass < 0 ? -1 : beat.bass % 12);
+    }
+    beats_updated_ = beats_.size();
+}
+
+void HarmonyAnalysis::sync(const NoteManager& notes, int ticks_per_beat) {
+    beats_updated_ = 0;
+    if (source_ != &notes || ticks_per_beat_ != std::max(ticks_per_beat, 1)) {
+        rebuild(notes, ticks_per_beat);
+        return;
+    }
+    if (revision_ == notes.revision()) {
+        return;
+    }
+    dirty_scratch_.clear();
+    if (!notes.dirty_ranges_since(revision_, dirty_scratch_)) {
+        rebuild(notes, ticks_per_beat);
+        return;
+    }
+    revision_ = notes.revision();
+
+    // Runs of dirty beats, each recomputed with one range query.
+    std::sort(dirty_scratch_.begin(),
+              dirty_scratch_.end(),
+              [](const DirtyRange& a, const DirtyRange& b) {
+                  return a.start < b.start;
+              });
+    const Tick tpb = ticks_per_beat_;
+    std::size_t first = 0;
+    std::size_t last = 0;
+    for (const DirtyRange& range : dirty_scratch_) {
+        if (range.start >= range.end || range.end <= 0) {
+            continue;
+        }
+        const auto range_first =
+            static_cast<std::size_t>(std::max<Tick>(range.start, 0) / tpb);
+        const auto range_last =
+            static_cast<std::size_t>((range.end + tpb - 1) / tpb);
+        if (range_last > beats_.size()) {
+            beats_.resize(range_last);
+        }
+        if (first < last && range_first <= last) {
+            last = std::max(last, range_last);
+            continue;
+        }
+        if (first < last) {
+            update_beats(notes, first, last);
+        }
+        first = range_first;
+        last = range_last;
+    }
+    if (first < last) {
+        update_beats(notes, first, last);
+    }
+}
+
+void HarmonyAnalysis::add_note(const Note& note,
+                               std::size_t first,
+                               std::size_t last) {
+    const Tick tpb = ticks_per_beat_;
+    const Tick start =
+        std::max(note.tick, static_cast<Tick>(first) * tpb);
+    const Tick end =
+        std::min(note.end_tick(), static_cast<Tick>(last) * tpb);
+    const auto pitch_class = static_cast<std::size_t>(note.key % 12);
+    for (Tick beat_start = start - start % tpb; beat_start < end;
+         beat_start += tpb) {
+        const Tick overlap =
+            std::min(end, beat_start + tpb) - std::max(start, beat_start);
+        if (overlap <= 0) {
+            continue;
+        }
+        BeatHarmony& beat = beats_[static_cast<std::size_t>(beat_start / tpb)];
+        beat.weights[pitch_class] += static_cast<std::uint32_t>(overlap);
+        if (beat.bass < 0 || note.key < beat.bass) {
+            beat.bass = note.key;
+        }
+    }
+}
+
+void HarmonyAnalysis::update_beats(const NoteManager& notes,
+                                   std::size_t first,
+                                   std::size_t last) {
+    last = std::min(last, beats_.size());
+    if (first >= last) {
+        return;
+    }
+    previous_.assign(beats_.begin() + static_cast<std::ptrdiff_t>(first),
+                     beats_.begin() + static_cast<std::ptrdiff_t>(last));
+    std::fill(beats_.begin() + static_cast<std::ptrdiff_t>(first),
+              beats_.begin() + static_cast<std::ptrdiff_t>(last),
+              BeatHarmony{});
+    const Tick tpb = ticks_per_beat_;
+    notes.for_each_in_range(static_cast<Tick>(first) * tpb,
+                            static_cast<Tick>(last) * tpb,
+                            kLowestKey,
+                            kHighestKey,
+                            [&](const Note& note) {
+                                add_note(note, first, last);
+                            });
+    // Most logged changes (selection, velocity) leave the histogram as it
+    // was; those beats keep their label.
+    for (std::size_t i = first; i < last; ++i) {
+        BeatHarmony& beat = beats_[i];
+        const BeatHarmony& before = previous_[i - first];
+        if (beat.weights == before.weights && beat.bass == before.bass) {
+            beat.chord = before.chord;
+            continue;
+        }
+        PitchClassProfile profile{};
+        std::copy(beat.weights.begin(), beat.weights.end(), profile.begin());
+        beat.chord = label_chord(profile, beat.bass < 0 ? -1 : beat.bass % 12);
+        ++beats_updated_;
+    }
+}
+
+const BeatHarmony* HarmonyAnalysis::beat_at(Tick tick) const noexcept {
+    if (tick < 0 || ticks_per_beat_ <= 0) {
+        return nullptr;
+    }
+    const auto index = static_cast<std::size_t>(tick / ticks_per_beat_);
+    return index < beats_.size() ? &beats_[index] : nullptr;
+}
+
+PitchClassProfile HarmonyAnalysis::profile(Tick start_tick,
+                                           Tick end_tick) const noexcept {
+    PitchClassProfile profile{};
+    if (ticks_per_beat_ <= 0 || end_tick <= start_tick) {
+        return profile;
+    }
+    const auto first = static_cast<std::size_t>(
+        std::max<Tick>(start_tick, 0) / ticks_per_beat_);
+    const auto last = std::min(
+        beats_.size(),
+        static_cast<std::size_t>(std::max<Tick>(end_tick + ticks_per_beat_ - 1,
+                                                0) /
+                                 ticks_per_beat_));
+    for (std::size_t i = first; i < last; ++i) {
+        for (std::size_t pc = 0; pc < 12; ++pc) {
+            profile[pc] += beats_[i].weights[pc];
+        }
+    }
+    return profile;
+}
+
+}  // namespace piano_roll
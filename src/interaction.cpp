@@ -1,9 +1,23 @@
 #include "piano_roll/interaction.hpp"
 
 #include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <optional>
+#include <unordered_map>
 
 namespace piano_roll {
 
+namespace {
+
+// Enforce a small minimum note length while resizing, mirroring the Python
+// MIN_NOTE_LENGTH_TICKS behaviour.
+constexpr Duration MIN_NOTE_LENGTH_TICKS = 10;
+
+}  // namespace
+
 PointerTool::PointerTool(NoteManager& notes,
                          CoordinateSystem& coords,
                          GridSnapSystem* snap_system)
@@ -29,20 +43,314 @@ void PointerTool::selection_rectangle_world(double& x1,
 }
 
 Tick PointerTool::apply_snap(Tick raw_tick,
-                             const ModifierKeys& mods) const {
-    if (!snap_) {
-        return raw_tick;
-    }
+                             const ModifierKeys& mods,
+                             Duration length,
+                             bool skip_selected,
+                             NoteId skip_id) const {
     // Shift disables snapping (matches Python magnetic_snap_tick).
     if (mods.shift) {
         return raw_tick;
     }
 
     double ppb = coords_ ? coords_->pixels_per_beat() : 0.0;
-    auto [snapped, snapped_flag] =
-        snap_->magnetic_snap(raw_tick, ppb);
-    (void)snapped_flag;
-    return snapped;
+    // Note edges use the grid's magnetic range so both snaps agree.
+    const double range_pixels =
+        snap_ ? snap_->magnetic_range_pixels()
+              : GridSnapSystem::kDefaultMagneticRangePixels;
+    Tick best = raw_tick;
+    Tick best_distance = 0;
+    bool found = false;
+    if (snap_) {
+        auto [snapped, snapped_flag] =
+            snap_->magnetic_snap(raw_tick, ppb);
+        if (snapped_flag) {
+            best = snapped;
+            best_distance = std::abs(snapped - raw_tick);
+            found = true;
+        }
+    }
+
+    if (snap_to_notes_ && notes_ && ppb > 0.0) {
+        const Tick range = static_cast<Tick>(
+            range_pixels / ppb *
+            static_cast<double>(coords_->ticks_per_beat()));
+        // `offset` maps a snapped probe back to the span start.
+        auto consider = [&](Tick probe, Tick offset) {
+            std::optional<Tick> edge = notes_->nearest_note_edge(
+                probe, range, skip_selected, skip_id);
+            if (!edge) {
+                return;
+            }
+            Tick distance = std::abs(*edge - probe);
+            if (!found || distance < best_distance) {
+                best = *edge - offset;
+                best_distance = distance;
+                found = true;
+            }
+        };
+        consider(raw_tick, 0);
+        if (length > 0) {
+            consider(raw_tick + length, length);
+        }
+    }
+    return best;
+}
+
+void PointerTool::begin_group_resize() {
+    resize_group_.clear();
+    std::vector<NoteId> ids = notes_->selected_ids();
+    if (std::find(ids.begin(), ids.end(), active_note_id_) == ids.end()) {
+        ids.assign(1, active_note_id_);
+    }
+
+    // The active note goes first so update_group_resize can find it.
+    std::unordered_map<NoteId, std::size_t> slot_of;
+    slot_of.reserve(ids.size());
+    std::array<bool, 128> group_keys{};
+    resize_group_.reserve(ids.size());
+    auto capture = [&](NoteId id) {
+        const Note* note = notes_->find_by_id(id);
+        if (!note || slot_of.count(id) != 0) {
+            return;
+        }
+        slot_of.emplace(id, resize_group_.size());
+        resize_group_.push_back(ResizeOrigin{id,
+                                             note->tick,
+                                             note->end_tick(),
+                                             note->key,
+                                             0,
+                                             std::numeric_limits<Tick>::max()});
+        if (note->key >= 0 && note->key < 128) {
+            group_keys[static_cast<std::size_t>(note->key)] = true;
+        }
+    };
+    capture(active_note_id_);
+    if (resize_group_.empty()) {
+        return;
+    }
+    for (NoteId id : ids) {
+        capture(id);
+    }
+
+    resize_span_start_ = resize_group_.front().start;
+    resize_span_end_ = resize_group_.front().end;
+    resize_shortest_ = resize_group_.front().end - resize_group_.front().start;
+    for (const ResizeOrigin& origin : resize_group_) {
+        resize_span_start_ = std::min(resize_span_start_, origin.start);
+        resize_span_end_ = std::max(resize_span_end_, origin.end);
+        resize_shortest_ = std::min(resize_shortest_, origin.end - origin.start);
+    }
+
+    // Find each note's obstacles once for the whole gesture. With absolute
+    // resizing only one edge of each note moves, so every other note on the
+    // key is an obstacle; proportional resizing moves the group as a whole
+    // without reordering it, so only unselected notes are.
+    const bool proportional =
+        group_resize_mode_ == GroupResizeMode::Proportional;
+    constexpr std::size_t kNotInGroup = std::numeric_limits<std::size_t>::max();
+    struct KeyEntry {
+        MidiKey key;
+        Tick start;
+        Tick end;
+        std::size_t slot;
+    };
+    std::vector<KeyEntry> entries;
+    for (const Note& note : notes_->notes()) {
+        if (note.key < 0 || note.key >= 128 ||
+            !group_keys[static_cast<std::size_t>(note.key)]) {
+            continue;
+        }
+        auto it = slot_of.find(note.id);
+        entries.push_back(KeyEntry{note.key,
+                                   note.tick,
+                                   note.end_tick(),
+                                   it == slot_of.end() ? kNotInGroup
+                                                       : it->second});
+    }
+    std::sort(entries.begin(), entries.end(),
+              [](const KeyEntry& a, const KeyEntry& b) {
+                  return a.key != b.key ? a.key < b.key : a.start < b.start;
+              });
+    auto is_obstacle = [&](const KeyEntry& e) {
+        return !proportional || e.slot == kNotInGroup;
+    };
+
+    // Walk each key's notes in blocks sharing a start tick: a note's lower
+    // bound is the latest obstacle end among earlier starts, its upper bound
+    // the first obstacle start after it.
+    std::size_t key_begin = 0;
+    while (key_begin < entries.size()) {
+        std::size_t key_end = key_begin;
+        while (key_end < entries.size() &&
+               entries[key_end].key == entries[key_begin].key) {
+            ++key_end;
+        }
+
+        Tick latest_end = 0;
+        for (std::size_t i = key_begin; i < key_end;) {
+            std::size_t j = i;
+            while (j < key_end && entries[j].start == entries[i].start) {
+                if (entries[j].slot != kNotInGroup) {
+                    resize_group_[entries[j].slot].lower = latest_end;
+                }
+                ++j;
+            }
+            for (std::size_t k = i; k < j; ++k) {
+                if (is_obstacle(entries[k])) {
+                    latest_end = std::max(latest_end, entries[k].end);
+                }
+            }
+            i = j;
+        }
+
+        Tick next_start = std::numeric_limits<Tick>::max();
+        for (std::size_t i = key_end; i > key_begin;) {
+            std::size_t j = i;
+            while (j > key_begin &&
+                   entries[j - 1].start == entries[i - 1].start) {
+                --j;
+                if (entries[j].slot != kNotInGroup) {
+                    resize_group_[entries[j].slot].upper = next_start;
+                }
+            }
+            for (std::size_t k = j; k < i; ++k) {
+                if (is_obstacle(entries[k])) {
+                    next_start = entries[k].start;
+                    break;
+                }
+            }
+            i = j;
+        }
+
+        key_begin = key_end;
+    }
+
+    // Each scaled tick moves monotonically with the factor, so every note
+    // bounds it to an interval; the intersection keeps the whole group clear
+    // of its obstacles. Neighbours a note already overlapped when the gesture
+    // began only bound it at its starting position.
+    resize_factor_min_ = 0.0;
+    resize_factor_max_ = std::numeric_limits<double>::infinity();
+    const bool left = action_ == Action::ResizingLeft;
+    const double pivot = static_cast<double>(left ? resize_span_end_
+                                                  : resize_span_start_);
+    for (const ResizeOrigin& origin : resize_group_) {
+        const double start = static_cast<double>(origin.start);
+        const double end = static_cast<double>(origin.end);
+        const double lower =
+            static_cast<double>(std::min(origin.lower, origin.start));
+        const double upper =
+            origin.upper == std::numeric_limits<Tick>::max()
+                ? std::numeric_limits<double>::infinity()
+                : static_cast<double>(std::max(origin.upper, origin.end));
+        if (left) {
+            // start' = pivot - (pivot - start) * f, likewise for end.
+            if (pivot > start) {
+                resize_factor_max_ = std::min(resize_factor_max_,
+                                              (pivot - lower) / (pivot - start));
+            }
+            if (pivot > end && pivot > upper) {
+                resize_factor_min_ = std::max(resize_factor_min_,
+                                              (pivot - upper) / (pivot - end));
+            }
+        } else {
+            // start' = pivot + (start - pivot) * f, likewise for end.
+            if (start > pivot && lower > pivot) {
+                resize_factor_min_ = std::max(resize_factor_min_,
+                                              (lower - pivot) / (start - pivot));
+            }
+            if (end > pivot) {
+                resize_factor_max_ = std::min(resize_factor_max_,
+                                              (upper - pivot) / (end - pivot));
+            }
+        }
+    }
+}
+
+void PointerTool::update_group_resize(Tick edge_tick) {
+    const ResizeOrigin& anchor = resize_group_.front();
+    const bool left = action_ == Action::ResizingLeft;
+    const bool proportional =
+        group_resize_mode_ == GroupResizeMode::Proportional;
+
+    // Absolute: one delta for every note, limited so the shortest note keeps
+    // the minimum length. Proportional: a scale factor about the selection's
+    // opposite edge, limited the same way (one extra tick absorbs rounding)
+    // and then to the obstacle-free range, which wins any conflict. The
+    // limit only stops shrinking: a selection whose shortest note is already
+    // under the minimum (e.g. imported drum hits) cannot shrink, but is not
+    // lengthened either until the mouse asks for it.
+    Tick delta = 0;
+    double factor = 1.0;
+    Tick pivot = left ? resize_span_end_ : resize_span_start_;
+    if (proportional) {
+        const double reach = static_cast<double>(
+            left ? pivot - anchor.start : anchor.end - pivot);
+        const double target =
+            static_cast<double>(left ? pivot - edge_tick : edge_tick - pivot);
+        factor = std::max(
+            target / reach,
+            std::min(1.0,
+                     static_cast<double>(MIN_NOTE_LENGTH_TICKS + 1) /
+                         static_cast<double>(resize_shortest_)));
+        factor = std::max(std::min(factor, resize_factor_max_),
+                          resize_factor_min_);
+    } else if (left) {
+        delta = std::min(
+            edge_tick - anchor.start,
+            std::max<Tick>(0, resize_shortest_ - MIN_NOTE_LENGTH_TICKS));
+    } else {
+        delta = std::max(
+            edge_tick - anchor.end,
+            std::min<Tick>(0, MIN_NOTE_LENGTH_TICKS - resize_shortest_));
+    }
+    auto scale = [&](Tick tick) {
+        return pivot + static_cast<Tick>(std::llround(
+                           static_cast<double>(tick - pivot) * factor));
+    };
+
+    resize_edits_.clear();
+    Duration anchor_duration = 0;
+    for (const ResizeOrigin& origin : resize_group_) {
+        Tick start = origin.start;
+        Tick end = origin.end;
+        if (proportional) {
+            start = scale(origin.start);
+            end = scale(origin.end);
+        } else if (left) {
+            // Single overlap-resolution pass: each moving edge stops at the
+            // obstacle found at gesture start (or where it began, if it
+            // already overlapped one).
+            start = std::max({origin.start + delta,
+                              std::min(origin.lower, origin.start),
+                              Tick{0}});
+        } else {
+            end = std::min(origin.end + delta,
+                           std::max(origin.upper, origin.end));
+        }
+        if (origin.id == anchor.id) {
+            anchor_duration = end - start;
+        }
+
+        const Note* note = notes_->find_by_id(origin.id);
+        if (!note || (note->tick == start && note->end_tick() == end)) {
+            continue;
+        }
+        resize_edits_.push_back(
+            NoteEdit{origin.id, start, end - start, origin.key});
+    }
+
+    if (resize_edits_.empty()) {
+        return;
+    }
+    if (!edit_snapshot_taken_) {
+        notes_->snapshot_for_undo();
+        edit_snapshot_taken_ = true;
+    }
+    notes_->apply_note_edits(resize_edits_, {}, /*record_undo=*/false);
+
+    // Remember the last resized length for subsequent note creation.
+    default_note_duration_ = anchor_duration;
 }
 
 void PointerTool::begin_rectangle_selection(double world_x,
@@ -234,6 +542,13 @@ void PointerTool::on_mouse_down(MouseButton button,
                                             /*record_undo=*/false,
                                             /*allow_overlap=*/false);
                     if (new_id != 0) {
+                        auto points = notes_->note_expression(id);
+                        if (!points.empty()) {
+                            notes_->set_note_expression(
+                                new_id,
+                                {points.begin(), points.end()},
+                                /*record_undo=*/false);
+                        }
                         new_ids.push_back(new_id);
                     }
                 }
@@ -268,6 +583,7 @@ void PointerTool::on_mouse_down(MouseButton button,
         } else {
             action_ = Action::DraggingNote;
         }
+        resize_group_.clear();
         rect_active_ = false;
         hover_ = {};
         return;
@@ -361,7 +677,13 @@ void PointerTool::on_mouse_move(double screen_x,
 
         Tick new_tick = coords_->world_to_tick(new_world_x);
         MidiKey new_key = coords_->world_y_to_key(new_world_y);
-        new_tick = apply_snap(new_tick, mods);
+        // The dragged notes (selection or the anchor alone) must not snap
+        // to their own edges; either end of the anchor may snap.
+        new_tick = apply_snap(new_tick,
+                              mods,
+                              anchor->duration,
+                              /*skip_selected=*/true,
+                              active_note_id_);
 
         // Compute deltas relative to current position of the anchor.
         Tick delta_tick = new_tick - anchor->tick;
@@ -437,70 +759,21 @@ void PointerTool::on_mouse_move(double screen_x,
     }
     case Action::ResizingLeft:
     case Action::ResizingRight: {
-        Note* note = notes_->find_by_id(active_note_id_);
-        if (!note) {
-            return;
-        }
-
-        double note_x1 = coords_->tick_to_world(initial_tick_);
-        double note_x2 = coords_->tick_to_world(initial_tick_ + initial_duration_);
-
-        double new_world_x_left =
-            (action_ == Action::ResizingLeft) ? world_x : note_x1;
-        double new_world_x_right =
-            (action_ == Action::ResizingRight) ? world_x : note_x2;
-
-        Tick new_tick_left =
-            coords_->world_to_tick(new_world_x_left);
-        Tick new_tick_right =
-            coords_->world_to_tick(new_world_x_right);
-
-        new_tick_left = apply_snap(new_tick_left, mods);
-        new_tick_right = apply_snap(new_tick_right, mods);
-
-        // Enforce a small minimum note length, mirroring the Python
-        // MIN_NOTE_LENGTH_TICKS behaviour.
-        const Duration MIN_NOTE_LENGTH_TICKS = 10;
-        if (action_ == Action::ResizingLeft) {
-            Tick max_left =
-                initial_tick_ + initial_duration_ -
-                MIN_NOTE_LENGTH_TICKS;
-            if (new_tick_left > max_left) {
-                new_tick_left = max_left;
-            }
-        } else {
-            Tick min_right =
-                initial_tick_ + MIN_NOTE_LENGTH_TICKS;
-            if (new_tick_right < min_right) {
-                new_tick_right = min_right;
+        if (resize_group_.empty()) {
+            begin_group_resize();
+            if (resize_group_.empty()) {
+                return;
             }
         }
 
-        if (new_tick_right <= new_tick_left) {
-            return;
-        }
-
-        if (!edit_snapshot_taken_ && notes_) {
-            notes_->snapshot_for_undo();
-            edit_snapshot_taken_ = true;
-        }
-
-        // Update note tick/duration directly through NoteManager.
-        Tick delta_tick = new_tick_left - note->tick;
-        Duration new_duration = new_tick_right - new_tick_left;
-
-        notes_->move_note(active_note_id_,
-                          delta_tick,
-                          0,
-                          /*record_undo=*/false,
-                          /*allow_overlap=*/false);
-        notes_->resize_note(active_note_id_,
-                            new_duration,
-                            /*record_undo=*/false,
-                            /*allow_overlap=*/false);
-
-        // Remember the last resized length for subsequent note creation.
-        default_note_duration_ = new_duration;
+        // Every selected note's edge follows the pointer, so selected notes
+        // are not snap targets.
+        Tick edge_tick = apply_snap(coords_->world_to_tick(world_x),
+                                    mods,
+                                    0,
+                                    /*skip_selected=*/true,
+                                    active_note_id_);
+        update_group_resize(edge_tick);
         break;
     }
     case Action::RectangleSelection: {
@@ -568,6 +841,7 @@ void PointerTool::on_mouse_up(MouseButton button,
     pending_click_ = false;
     pending_toggle_on_release_ = false;
     edit_snapshot_taken_ = false;
+    resize_group_.clear();
 }
 
 void PointerTool::on_double_click(MouseButton button,
@@ -178,9 +178,12 @@ void KeyboardController::handle_copy() {
     }
 
     clipboard_.clear();
+    clipboard_expression_.clear();
     for (const Note& n : notes_->notes()) {
         if (n.selected) {
             clipboard_.push_back(n);
+            auto points = notes_->note_expression(n);
+            clipboard_expression_.emplace_back(points.begin(), points.end());
         }
     }
 }
@@ -194,15 +197,20 @@ void KeyboardController::handle_paste() {
     // More advanced behaviour (e.g. paste at playhead) can be implemented
     // at a higher layer by adjusting ticks before creating notes.
     notes_->snapshot_for_undo();
-    for (const Note& src : clipboard_) {
-        notes_->create_note(src.tick,
-                            src.duration,
-                            src.key,
-                            src.velocity,
-                            src.channel,
-                            /*selected=*/true,
-                            /*record_undo=*/false,
-                            /*allow_overlap=*/false);
+    for (std::size_t i = 0; i < clipboard_.size(); ++i) {
+        const Note& src = clipboard_[i];
+        NoteId id = notes_->create_note(src.tick,
+                                        src.duration,
+                                        src.key,
+                                        src.velocity,
+                                        src.channel,
+                                        /*selected=*/true,
+                                        /*record_undo=*/false,
+                                        /*allow_overlap=*/false);
+        if (id != 0 && !clipboard_expression_[i].empty()) {
+            notes_->set_note_expression(
+                id, clipboard_expression_[i], /*record_undo=*/false);
+        }
     }
 }
 
@@ -224,7 +232,8 @@ bool KeyboardController::paste_at_tick(Tick target_tick) {
 
     notes_->snapshot_for_undo();
     bool created_any = false;
-    for (const Note& src : clipboard_) {
+    for (std::size_t i = 0; i < clipboard_.size(); ++i) {
+        const Note& src = clipboard_[i];
         Tick new_tick = src.tick + delta;
         if (new_tick < 0) {
             new_tick = 0;
@@ -239,6 +248,10 @@ bool KeyboardController::paste_at_tick(Tick target_tick) {
                                         /*allow_overlap=*/false);
         if (id != 0) {
             created_any = true;
+            if (!clipboard_expression_[i].empty()) {
+                notes_->set_note_expression(
+                    id, clipboard_expression_[i], /*record_undo=*/false);
+            }
         }
     }
     return created_any;
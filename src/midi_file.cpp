@@ -0,0 +1,364 @@
+#include "piano_roll/midi_file.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <istream>
+#include <map>
+#include <ostream>
+#include <string_view>
+
+namespace piano_roll {
+
+namespace {
+
+constexpr std::uint8_t kNoteOff = 0x80;
+constexpr std::uint8_t kNoteOn = 0x90;
+constexpr std::uint8_t kControlChange = 0xB0;
+constexpr std::uint8_t kMeta = 0xFF;
+constexpr std::uint8_t kMetaEndOfTrack = 0x2F;
+
+int clamp_data(int value) noexcept {
+    return std::clamp(value, 0, 127);
+}
+
+void put_u16(std::ostream& out, std::uint32_t value) {
+    out.put(static_cast<char>((value >> 8) & 0xFF));
+    out.put(static_cast<char>(value & 0xFF));
+}
+
+void put_u32(std::ostream& out, std::uint32_t value) {
+    put_u16(out, value >> 16);
+    put_u16(out, value & 0xFFFF);
+}
+
+void put_vlq(std::vector<std::uint8_t>& out, std::uint64_t value) {
+    std::array<std::uint8_t, 10> bytes{};
+    std::size_t count = 0;
+    do {
+        bytes[count++] = static_cast<std::uint8_t>(value & 0x7F);
+        value >>= 7;
+    } while (value != 0 && count < bytes.size());
+    while (count > 0) {
+        --count;
+        out.push_back(static_cast<std::uint8_t>(
+            bytes[count] | (count > 0 ? 0x80 : 0x00)));
+    }
+}
+
+// Cursor over one track chunk's bytes.
+struct TrackReader {
+    const std::vector<std::uint8_t>& data;
+    std::size_t pos{0};
+
+    bool done() const noexcept { return pos >= data.size(); }
+
+    bool byte(std::uint8_t& value) noexcept {
+        if (pos >= data.size()) {
+            return false;
+        }
+        value = data[pos++];
+        return true;
+    }
+
+    bool vlq(std::uint32_t& value) noexcept {
+        value = 0;
+        for (int i = 0; i < 4; ++i) {
+            std::uint8_t b = 0;
+            if (!byte(b)) {
+                return false;
+            }
+            value = (value << 7) | (b & 0x7F);
+            if ((b & 0x80) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool skip(std::uint32_t count) noexcept {
+        if (data.size() - pos < count) {
+            return false;
+        }
+        pos += count;
+        return true;
+    }
+};
+
+bool read_u32(std::istream& in, std::uint32_t& value) {
+    std::array<unsigned char, 4> b{};
+    if (!in.read(reinterpret_cast<char*>(b.data()), 4)) {
+        return false;
+    }
+    value = (std::uint32_t{b[0]} << 24) | (std::uint32_t{b[1]} << 16) |
+            (std::uint32_t{b[2]} << 8) | std::uint32_t{b[3]};
+    return true;
+}
+
+struct SoundingNote {
+    Tick tick;
+    Velocity velocity;
+};
+
+}  // namespace
+
+std::size_t write_smf(const std::vector<BounceClip>& clips,
+                      std::ostream& out,
+                      const SmfWriteOptions& options) {
+    std::vector<std::uint8_t> track;
+    Tick last_tick = 0;
+    std::uint8_t running_status = 0;
+    std::size_t events = 0;
+
+    bounce_clips(
+        clips,
+        [&](const BounceEvent& event) {
+            const Tick tick = std::max(event.tick, last_tick);
+            put_vlq(track, static_cast<std::uint64_t>(tick - last_tick));
+            last_tick = tick;
+
+            const auto channel =
+                static_cast<std::uint8_t>(std::clamp(event.channel, 0, 15));
+            std::uint8_t status = 0;
+            int data2 = 0;
+            switch (event.type) {
+            case BounceEventType::NoteOff:
+                // Note-on with velocity 0 keeps running status across
+                // note-ons and note-offs.
+                status = kNoteOn | channel;
+                data2 = 0;
+                break;
+            case BounceEventType::ControlChange:
+                status = kControlChange | channel;
+                data2 = clamp_data(event.data2);
+                break;
+            case BounceEventType::NoteOn:
+                status = kNoteOn | channel;
+                data2 = std::max(1, clamp_data(event.data2));
+                break;
+            }
+            if (status != running_status) {
+                track.push_back(status);
+                running_status = status;
+            }
+            track.push_back(static_cast<std::uint8_t>(clamp_data(event.data1)));
+            track.push_back(static_cast<std::uint8_t>(data2));
+            ++events;
+        },
+        options.bounce);
+
+    track.push_back(0);
+    track.push_back(kMeta);
+    track.push_back(kMetaEndOfTrack);
+    track.push_back(0);
+
+    out.write("MThd", 4);
+    put_u32(out, 6);
+    put_u16(out, 0);  // format 0
+    put_u16(out, 1);  // one track
+    put_u16(out,
+            static_cast<std::uint32_t>(
+                std::clamp(options.ticks_per_beat, 1, 0x7FFF)));
+    out.write("MTrk", 4);
+    put_u32(out, static_cast<std::uint32_t>(track.size()));
+    out.write(reinterpret_cast<const char*>(track.data()),
+              static_cast<std::streamsize>(track.size()));
+    return events;
+}
+
+std::size_t write_smf(const NoteManager& notes,
+                      const std::vector<ControlLane>& lanes,
+                      std::ostream& out,
+                      const SmfWriteOptions& options) {
+    BounceClip clip;
+    clip.notes = &notes;
+    clip.lanes = &lanes;
+    return write_smf(std::vector<BounceClip>{clip}, out, options);
+}
+
+SmfReadResult read_smf(NoteManager& notes,
+                       std::vector<ControlLane>& lanes,
+                       std::istream& in,
+                       const SmfReadOptions& options) {
+    notes.clear();
+    lanes.clear();
+
+    SmfReadResult result;
+    auto fail = [&result](const char* message) {
+        result.ok = false;
+        result.error = message;
+        return result;
+    };
+
+    char id[4];
+    std::uint32_t length = 0;
+    if (!in.read(id, 4) || std::string_view(id, 4) != "MThd" ||
+        !read_u32(in, length) || length < 6) {
+        return fail("missing MThd header");
+    }
+    std::array<unsigned char, 6> header{};
+    if (!in.read(reinterpret_cast<char*>(header.data()), 6)) {
+        return fail("truncated MThd header");
+    }
+    in.ignore(static_cast<std::streamsize>(length - 6));
+    result.format = (header[0] << 8) | header[1];
+    const int declared_tracks = (header[2] << 8) | header[3];
+    result.division = (header[4] << 8) | header[5];
+    if (result.format > 1) {
+        return fail("only format 0 and 1 files are supported");
+    }
+    if ((result.division & 0x8000) != 0 || result.division == 0) {
+        return fail("SMPTE time division is not supported");
+    }
+
+    const std::int64_t target_tpb = std::max(1, options.ticks_per_beat);
+    auto rescale = [&](std::uint64_t tick) {
+        return static_cast<Tick>(
+            (static_cast<std::int64_t>(tick) * target_tpb +
+             result.division / 2) /
+            result.division);
+    };
+
+    std::vector<Note> parsed_notes;
+    std::map<int, std::vector<ControlPoint>> parsed_cc;
+    std::vector<std::uint8_t> data;
+
+    while (result.tracks < declared_tracks && in.read(id, 4)) {
+        if (!read_u32(in, length)) {
+            return fail("truncated chunk header");
+        }
+        if (std::string_view(id, 4) != "MTrk") {
+            in.ignore(static_cast<std::streamsize>(length));
+            continue;
+        }
+        data.resize(length);
+        if (!in.read(reinterpret_cast<char*>(data.data()),
+                     static_cast<std::streamsize>(length))) {
+            return fail("truncated track");
+        }
+        ++result.tracks;
+
+        // Sounding notes per (channel, key), oldest first.
+        std::map<int, std::deque<SoundingNote>> sounding;
+        auto close_note = [&](int channel, int key, Tick end) {
+            auto it = sounding.find(channel * 128 + key);
+            if (it == sounding.end() || it->second.empty()) {
+                ++result.unmatched_note_offs;
+                return;
+            }
+            const SoundingNote started = it->second.front();
+            it->second.pop_front();
+            Note note;
+            note.tick = started.tick;
+            note.duration = std::max<Duration>(1, end - started.tick);
+            note.key = key;
+            note.velocity = started.velocity;
+            note.channel = channel;
+            parsed_notes.push_back(note);
+        };
+
+        TrackReader track{data};
+        std::uint64_t abs_tick = 0;
+        std::uint8_t running_status = 0;
+        while (!track.done()) {
+            std::uint32_t delta = 0;
+            std::uint8_t status = 0;
+            if (!track.vlq(delta) || !track.byte(status)) {
+                return fail("truncated event");
+            }
+            abs_tick += delta;
+            const Tick tick = rescale(abs_tick);
+
+            if (status == kMeta) {
+                std::uint8_t type = 0;
+                std::uint32_t size = 0;
+                if (!track.byte(type) || !track.vlq(size) ||
+                    !track.skip(size)) {
+                    return fail("truncated meta event");
+                }
+                running_status = 0;
+                if (type == kMetaEndOfTrack) {
+                    break;
+                }
+                continue;
+            }
+            if (status == 0xF0 || status == 0xF7) {
+                std::uint32_t size = 0;
+                if (!track.vlq(size) || !track.skip(size)) {
+                    return fail("truncated sysex event");
+                }
+                running_status = 0;
+                continue;
+            }
+
+            std::uint8_t data1 = 0;
+            if (status < 0x80) {
+                if (running_status == 0) {
+                    return fail("data byte without running status");
+                }
+                data1 = status;
+                status = running_status;
+            } else if (!track.byte(data1)) {
+                return fail("truncated channel event");
+            }
+            running_status = status;
+
+            const std::uint8_t kind = status & 0xF0;
+            const int channel = status & 0x0F;
+            if (kind == 0xC0 || kind == 0xD0) {
+                continue;  // program change / channel pressure
+            }
+            std::uint8_t data2 = 0;
+            if (!track.byte(data2)) {
+                return fail("truncated channel event");
+            }
+            if (kind == kNoteOn && data2 > 0) {
+                sounding[channel * 128 + data1].push_back(
+                    SoundingNote{tick, data2});
+            } else if (kind == kNoteOn || kind == kNoteOff) {
+                close_note(channel, data1, tick);
+            } else if (kind == kControlChange) {
+                ControlPoint point;
+                point.tick = tick;
+                point.value = data2;
+                parsed_cc[data1].push_back(point);
+            }
+        }
+
+        const Tick track_end = rescale(abs_tick);
+        for (auto& [slot, queue] : sounding) {
+            while (!queue.empty()) {
+                ++result.unterminated_notes;
+                close_note(slot / 128, slot % 128, track_end);
+            }
+        }
+    }
+
+    // Notes close in end order; store them in (tick, key) order.
+    std::stable_sort(parsed_notes.begin(),
+                     parsed_notes.end(),
+                     [](const Note& a, const Note& b) {
+                         if (a.tick != b.tick) {
+                             return a.tick < b.tick;
+                         }
+                         return a.key < b.key;
+                     });
+    notes.add_notes(parsed_notes, /*record_undo=*/false);
+    for (auto& [cc, points] : parsed_cc) {
+        std::stable_sort(points.begin(),
+                         points.end(),
+                         [](const ControlPoint& a, const ControlPoint& b) {
+                             return a.tick < b.tick;
+                         });
+        lanes.push_back(ControlLane{cc});
+        lanes.back().replace_points(std::move(points), /*record_undo=*/false);
+        result.control_points += lanes.back().points().size();
+    }
+
+    result.notes = parsed_notes.size();
+    result.ok = true;
+    return result;
+}
+
+}  // namespace piano_roll
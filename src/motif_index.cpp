@@ -0,0 +1,386 @@
+#include "piano_roll/motif_index.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
+#include <utility>
+
+namespace piano_roll {
+
+namespace {
+
+constexpr MidiKey kLowestKey = 0;
+constexpr MidiKey kHighestKey = 127;
+
+}  // namespace
+
+MotifIndex::MotifIndex(MotifIndexOptions options) : options_(options) {
+    options_.max_interval = std::max<Tick>(options_.max_interval, 0);
+    options_.fan_out = std::max<std::size_t>(options_.fan_out, 1);
+}
+
+std::uint64_t MotifIndex::fingerprint(const Onset& from,
+                                      const Onset& to) noexcept {
+    // Inter-onset interval in the high bits, pitch interval (-127..127,
+    // biased) in the low byte.
+    const auto interval = static_cast<std::uint64_t>(to.tick - from.tick);
+    const auto pitch = static_cast<std::uint64_t>(to.key - from.key + 128);
+    return (interval << 8) | pitch;
+}
+
+void MotifIndex::rebuild(const NoteManager& notes) {
+    source_ = &notes;
+    revision_ = notes.revision();
+
+    onsets_.clear();
+    onsets_.reserve(notes.notes().size());
+    for (const Note& note : notes.notes()) {
+        onsets_.push_back(Onset{note.tick, note.key});
+    }
+    std::sort(onsets_.begin(), onsets_.end());
+    onsets_.erase(std::unique(onsets_.begin(), onsets_.end()), onsets_.end());
+
+    // Anchors are visited in order, so every bucket comes out sorted.
+    pairs_.clear();
+    pair_count_ = 0;
+    for (std::size_t anchor = 0; anchor < onsets_.size(); ++anchor) {
+        for_each_pair(anchor, [&](std::uint64_t key) {
+            pairs_[key].push_back(pack(onsets_[anchor]));
+            ++pair_count_;
+        });
+    }
+}
+
+void MotifIndex::sync(const NoteManager& notes) {
+    if (source_ != &notes) {
+        rebuild(notes);
+        return;
+    }
+    if (revision_ == notes.revision()) {
+        return;
+    }
+    dirty_scratch_.clear();
+    if (!notes.dirty_ranges_since(revision_, dirty_scratch_)) {
+        rebuild(notes);
+        return;
+    }
+    revision_ = notes.revision();
+
+    // Coalesce overlapping spans so each region is re-read once.
+    std::sort(dirty_scratch_.begin(),
+              dirty_scratch_.end(),
+              [](const DirtyRange& a, const DirtyRange& b) {
+                  return a.start < b.start;
+              });
+    Tick start = 0;
+    Tick end = 0;
+    bool open = false;
+    for (const DirtyRange& range : dirty_scratch_) {
+        if (range.start >= range.end) {
+            continue;
+        }
+        if (open && range.start <= end) {
+            end = std::max(end, range.end);
+            continue;
+        }
+        if (open) {
+            update_span(notes, start, end);
+        }
+        start = range.start;
+        end = range.end;
+        open = true;
+    }
+    if (open) {
+        update_span(notes, start, end);
+    }
+}
+
+void MotifIndex::update_span(const NoteManager& notes, Tick start, Tick end) {
+    constexpr MidiKey kBeforeAnyKey = std::numeric_limits<MidiKey>::min();
+    auto onset_position = [this](Tick tick) {
+        return static_cast<std::size_t>(
+            std::lower_bound(onsets_.begin(),
+                             onsets_.end(),
+                             Onset{tick, kBeforeAnyKey}) -
+            onsets_.begin());
+    };
+
+    // Onsets now starting in the span. Most logged changes (selection,
+    // velocity, expression, length) leave them as they were.
+    std::vector<Onset> fresh;
+    notes.for_each_in_range(
+        start, end, kLowestKey, kHighestKey, [&](const Note& note) {
+            if (note.tick >= start) {
+                fresh.push_back(Onset{note.tick, note.key});
+            }
+        });
+    std::sort(fresh.begin(), fresh.end());
+    fresh.erase(std::unique(fresh.begin(), fresh.end()), fresh.end());
+
+    const std::size_t span_first = onset_position(start);
+    const std::size_t span_last = onset_position(end);
+    if (std::equal(fresh.begin(),
+                   fresh.end(),
+                   onsets_.begin() + static_cast<std::ptrdiff_t>(span_first),
+                   onsets_.begin() + static_cast<std::ptrdiff_t>(span_last))) {
+        return;
+    }
+
+    // Anchors whose pairs can reach an onset in the span. Their entries
+    // form one block in every bucket, which is cut out here and refilled
+    // below.
+    const Tick anchor_start = std::max<Tick>(start - options_.max_interval, 0);
+    const std::uint64_t block_first = pack(Onset{anchor_start, 0});
+    const std::uint64_t block_end = pack(Onset{std::max<Tick>(end, 0), 0});
+
+    std::vector<std::uint64_t> stale;
+    for (std::size_t anchor = onset_position(anchor_start);
+         anchor < span_last;
+         ++anchor) {
+        for_each_pair(anchor,
+                      [&](std::uint64_t key) { stale.push_back(key); });
+    }
+    std::sort(stale.begin(), stale.end());
+    stale.erase(std::unique(stale.begin(), stale.end()), stale.end());
+    for (std::uint64_t key : stale) {
+        auto bucket_it = pairs_.find(key);
+        if (bucket_it == pairs_.end()) {
+            continue;
+        }
+        std::vector<std::uint64_t>& bucket = bucket_it->second;
+        auto first =
+            std::lower_bound(bucket.begin(), bucket.end(), block_first);
+        auto last = std::lower_bound(first, bucket.end(), block_end);
+        pair_count_ -= static_cast<std::size_t>(last - first);
+        bucket.erase(first, last);
+        if (bucket.empty()) {
+            pairs_.erase(bucket_it);
+        }
+    }
+
+    onsets_.erase(onsets_.begin() + static_cast<std::ptrdiff_t>(span_first),
+                  onsets_.begin() + static_cast<std::ptrdiff_t>(span_last));
+    onsets_.insert(onsets_.begin() + static_cast<std::ptrdiff_t>(span_first),
+                   fresh.begin(),
+                   fresh.end());
+
+    std::vector<std::pair<std::uint64_t, std::uint64_t>> added;
+    const std::size_t anchors_end = span_first + fresh.size();
+    for (std::size_t anchor = onset_position(anchor_start);
+         anchor < anchors_end;
+         ++anchor) {
+        for_each_pair(anchor, [&](std::uint64_t key) {
+            added.emplace_back(key, pack(onsets_[anchor]));
+        });
+    }
+    std::sort(added.begin(), added.end());
+    for (std::size_t i = 0; i < added.size();) {
+        std::size_t j = i;
+        while (j < added.size() && added[j].first == added[i].first) {
+            ++j;
+        }
+        std::vector<std::uint64_t>& bucket = pairs_[added[i].first];
+        auto at = std::lower_bound(bucket.begin(), bucket.end(), block_first);
+        std::vector<std::uint64_t> block;
+        block.reserve(j - i);
+        for (std::size_t k = i; k < j; ++k) {
+            block.push_back(added[k].second);
+        }
+        bucket.insert(at, block.begin(), block.end());
+        pair_count_ += j - i;
+        i = j;
+    }
+}
+
+bool MotifIndex::has_onset(Tick tick, MidiKey key) const noexcept {
+    if (key < kLowestKey || key > kHighestKey) {
+        return false;
+    }
+    return std::binary_search(onsets_.begin(), onsets_.end(), Onset{tick, key});
+}
+
+bool MotifIndex::collect_match(const NoteManager& notes,
+                               std::span<const Note* const> query,
+                               std::span<const std::size_t> positions,
+                               const MotifSearchOptions& options,
+                               MotifMatch& match) const {
+    match.notes.assign(query.size(), 0);
+    std::size_t group_first = 0;
+    for (std::size_t i = 0; i < query.size(); ++i) {
+        const Note& wanted = *query[i];
+        if (i > 0 && (query[i - 1]->tick != wanted.tick ||
+                      query[i - 1]->key != wanted.key)) {
+            group_first = i;
+        }
+        const Tick tick = wanted.tick + match.tick_offset;
+        const MidiKey key = wanted.key + match.key_offset;
+
+        // Query notes sharing an onset (stacked duplicates) each need their
+        // own note.
+        NoteId found = 0;
+        notes.for_each_in_range(tick, tick + 1, key, key, [&](const Note& note) {
+            if (note.tick != tick) {
+                return true;
+            }
+            if (options.match_duration && note.duration != wanted.duration) {
+                return true;
+            }
+            for (std::size_t k = group_first; k < i; ++k) {
+                if (match.notes[positions[k]] == note.id) {
+                    return true;
+                }
+            }
+            found = note.id;
+            return false;
+        });
+        if (found == 0) {
+            return false;
+        }
+        match.notes[positions[i]] = found;
+    }
+    return true;
+}
+
+std::vector<MotifMatch> MotifIndex::find(const NoteManager& notes,
+                                         std::span<const NoteId> query,
+                                         const MotifSearchOptions& options) {
+    sync(notes);
+
+    // Query notes in onset order; positions maps them back to the caller's
+    // order for MotifMatch::notes.
+    std::vector<const Note*> sorted;
+    sorted.reserve(query.size());
+    for (NoteId id : query) {
+        if (const Note* note = notes.find_by_id(id)) {
+            sorted.push_back(note);
+        }
+    }
+    if (sorted.empty()) {
+        return {};
+    }
+    std::vector<std::size_t> positions(sorted.size());
+    std::iota(positions.begin(), positions.end(), std::size_t{0});
+    std::vector<const Note*> by_caller = sorted;
+    std::sort(positions.begin(),
+              positions.end(),
+              [&](std::size_t a, std::size_t b) {
+                  const Note& x = *by_caller[a];
+                  const Note& y = *by_caller[b];
+                  return x.tick != y.tick ? x.tick < y.tick
+                         : x.key != y.key ? x.key < y.key
+                                          : a < b;
+              });
+    for (std::size_t i = 0; i < positions.size(); ++i) {
+        sorted[i] = by_caller[positions[i]];
+    }
+
+    std::vector<Onset> motif;
+    motif.reserve(sorted.size());
+    for (const Note* note : sorted) {
+        const Onset onset{note->tick, note->key};
+        if (motif.empty() || !(motif.back() == onset)) {
+            motif.push_back(onset);
+        }
+    }
+
+    // Lookup pair: the consecutive motif onsets with the fewest filed
+    // occurrences, among the pairs the index holds for the query itself
+    // (fewer than fan_out other onsets in between), so the query is always
+    // among the candidates.
+    const std::vector<std::uint64_t>* candidates = nullptr;
+    const Onset* anchor = &motif.front();
+    for (std::size_t i = 0; i + 1 < motif.size(); ++i) {
+        if (motif[i + 1].tick - motif[i].tick > options_.max_interval) {
+            continue;
+        }
+        const auto from =
+            std::lower_bound(onsets_.begin(), onsets_.end(), motif[i]);
+        const auto to =
+            std::lower_bound(onsets_.begin(), onsets_.end(), motif[i + 1]);
+        if (to - from > static_cast<std::ptrdiff_t>(options_.fan_out)) {
+            continue;
+        }
+        auto bucket_it = pairs_.find(fingerprint(motif[i], motif[i + 1]));
+        if (bucket_it == pairs_.end()) {
+            continue;
+        }
+        if (candidates == nullptr ||
+            bucket_it->second.size() < candidates->size()) {
+            candidates = &bucket_it->second;
+            anchor = &motif[i];
+        }
+    }
+    std::vector<MotifMatch> matches;
+    MotifMatch match;
+    auto try_candidate = [&](const Onset& candidate) {
+        match.tick_offset = candidate.tick - anchor->tick;
+        match.key_offset = candidate.key - anchor->key;
+        if (!options.transposed && match.key_offset != 0) {
+            return;
+        }
+        if (!options.include_query && match.tick_offset == 0 &&
+            match.key_offset == 0) {
+            return;
+        }
+        const bool complete =
+            std::all_of(motif.begin(), motif.end(), [&](const Onset& onset) {
+                return has_onset(onset.tick + match.tick_offset,
+                                 onset.key + match.key_offset);
+            });
+        if (complete &&
+            collect_match(notes, sorted, positions, options, match)) {
+            matches.push_back(match);
+        }
+    };
+    if (candidates != nullptr) {
+        for (std::uint64_t candidate : *candidates) {
+            try_candidate(unpack(candidate));
+        }
+    } else {
+        // No usable pair (a single onset, or onsets too far apart): every
+        // onset is a candidate anchor.
+        for (const Onset& candidate : onsets_) {
+            try_candidate(candidate);
+        }
+    }
+    return matches;
+}
+
+std::vector<MotifMatch> MotifIndex::find_selection(
+    const NoteManager& notes,
+    const MotifSearchOptions& options) {
+    const std::vector<NoteId> selected = notes.selected_ids();
+    return find(notes, selected, options);
+}
+
+std::size_t MotifIndex::select_matches(NoteManager& notes,
+                                       std::span<const MotifMatch> matches,
+                                       bool add_to_selection) {
+    if (!add_to_selection) {
+        notes.clear_selection();
+    }
+    std::size_t selected = 0;
+    for (const MotifMatch& match : matches) {
+        for (NoteId id : match.notes) {
+            if (!notes.is_selected(id)) {
+                notes.select(id, true);
+                ++selected;
+            }
+        }
+    }
+    return selected;
+}
+
+std::size_t MotifIndex::memory_usage_bytes() const noexcept {
+    std::size_t bytes = onsets_.capacity() * sizeof(Onset);
+    for (const auto& [key, bucket] : pairs_) {
+        (void)key;
+        bytes += sizeof(std::pair<const std::uint64_t,
+                                  std::vector<std::uint64_t>>) +
+                 sizeof(void*) + bucket.capacity() * sizeof(std::uint64_t);
+    }
+    bytes += pairs_.bucket_count() * sizeof(void*);
+    return bytes;
+}
+
+}  // namespace piano_roll
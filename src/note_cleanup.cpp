@@ -0,0 +1,160 @@
+#include "piano_roll/note_cleanup.hpp"
+
+#include "piano_roll/parallel.hpp"
+
+#include <algorithm>
+#include <array>
+
+namespace piano_roll {
+
+namespace {
+
+constexpr int kKeyCount = 128;
+
+struct SweepEntry {
+    Tick tick;
+    Duration duration;
+    NoteId id;
+};
+
+// Sort order for the sweep: identical notes end up adjacent, and among
+// notes sharing a start tick the longest comes first and is the one kept.
+bool sweep_less(const SweepEntry& a, const SweepEntry& b) noexcept {
+    if (a.tick != b.tick) {
+        return a.tick < b.tick;
+    }
+    if (a.duration != b.duration) {
+        return a.duration > b.duration;
+    }
+    return a.id < b.id;
+}
+
+void sweep_key(std::vector<SweepEntry>::iterator begin,
+               std::vector<SweepEntry>::iterator end,
+               MidiKey key,
+               Tick gap_threshold,
+               CleanupReport& out) {
+    std::sort(begin, end, sweep_less);
+
+    const SweepEntry* previous = nullptr;
+    const SweepEntry* kept = nullptr;
+    for (auto it = begin; it != end; ++it) {
+        const SweepEntry& entry = *it;
+        if (previous != nullptr && entry.tick == previous->tick &&
+            entry.duration == previous->duration) {
+            out.duplicates.push_back(entry.id);
+            previous = &entry;
+            continue;
+        }
+        previous = &entry;
+
+        if (kept != nullptr) {
+            const Tick kept_end = kept->tick + kept->duration;
+            if (entry.tick == kept->tick) {
+                // Shorter note stacked on the kept one.
+                out.overlaps.push_back(entry.id);
+                out.covered.push_back(entry.id);
+                continue;
+            }
+            if (entry.tick < kept_end) {
+                out.overlaps.push_back(kept->id);
+                out.trims.push_back(NoteEdit{
+                    kept->id, kept->tick, entry.tick - kept->tick, key});
+            } else if (gap_threshold > 0) {
+                const Tick gap = entry.tick - kept_end;
+                if (gap > 0 && gap <= gap_threshold) {
+                    out.gaps.push_back(kept->id);
+                    out.legato.push_back(NoteEdit{
+                        kept->id, kept->tick, entry.tick - kept->tick, key});
+                }
+            }
+        }
+        kept = &entry;
+    }
+}
+
+template <typename T>
+void append(std::vector<T>& dst, const std::vector<T>& src) {
+    dst.insert(dst.end(), src.begin(), src.end());
+}
+
+}  // namespace
+
+CleanupReport analyze_notes(const NoteManager& notes,
+                            const CleanupOptions& options) {
+    const std::vector<Note>& all = notes.notes();
+
+    // Counting-sort the notes into one flat buffer grouped by key.
+    std::array<std::size_t, kKeyCount + 1> offsets{};
+    for (const Note& n : all) {
+        if (n.key >= 0 && n.key < kKeyCount) {
+            ++offsets[static_cast<std::size_t>(n.key) + 1];
+        }
+    }
+    for (int k = 0; k < kKeyCount; ++k) {
+        offsets[k + 1] += offsets[k];
+    }
+    std::vector<SweepEntry> entries(offsets[kKeyCount]);
+    std::array<std::size_t, kKeyCount> fill{};
+    std::copy(offsets.begin(), offsets.end() - 1, fill.begin());
+    for (const Note& n : all) {
+        if (n.key >= 0 && n.key < kKeyCount) {
+            entries[fill[static_cast<std::size_t>(n.key)]++] =
+                SweepEntry{n.tick, n.duration, n.id};
+        }
+    }
+
+    // Keys are independent: sort and sweep them in parallel, each into its
+    // own partial report.
+    std::array<CleanupReport, kKeyCount> per_key;
+    parallel_chunks(
+        kKeyCount,
+        resolve_thread_count(options.max_threads),
+        [&](std::size_t first_key, std::size_t last_key) {
+            for (std::size_t k = first_key; k < last_key; ++k) {
+                auto begin =
+                    entries.begin() + static_cast<std::ptrdiff_t>(offsets[k]);
+                auto end = entries.begin() +
+                           static_cast<std::ptrdiff_t>(offsets[k + 1]);
+                if (end - begin >= 2) {
+                    sweep_key(begin,
+                              end,
+                              static_cast<MidiKey>(k),
+                              options.gap_threshold,
+                              per_key[k]);
+                }
+            }
+        });
+
+    CleanupReport report;
+    for (const CleanupReport& part : per_key) {
+        append(report.duplicates, part.duplicates);
+        append(report.overlaps, part.overlaps);
+        append(report.gaps, part.gaps);
+        append(report.trims, part.trims);
+        append(report.covered, part.covered);
+        append(report.legato, part.legato);
+    }
+    return report;
+}
+
+std::size_t apply_cleanup(NoteManager& notes,
+                          const CleanupReport& report,
+                          const CleanupFixes& fixes,
+                          bool record_undo) {
+    std::vector<NoteEdit> edits;
+    std::vector<NoteId> removals;
+    if (fixes.dedupe) {
+        append(removals, report.duplicates);
+    }
+    if (fixes.trim_overlaps) {
+        append(edits, report.trims);
+        append(removals, report.covered);
+    }
+    if (fixes.legato) {
+        append(edits, report.legato);
+    }
+    return notes.apply_note_edits(edits, removals, record_undo);
+}
+
+}  // namespace piano_roll
@@ -1,6 +1,9 @@
 #include "piano_roll/note_manager.hpp"
 
 #include <algorithm>
+#include <array>
+#include <iterator>
+#include <limits>
 
 namespace piano_roll {
 
@@ -24,12 +27,34 @@ NoteId NoteManager::create_note(Tick tick,
         push_undo_state();
     }
 
+    // Appending in (tick, key) order keeps compacted storage compact.
+    bool appends_in_order =
+        notes_.empty() ||
+        (notes_.back().tick < new_note.tick ||
+         (notes_.back().tick == new_note.tick &&
+          notes_.back().key <= new_note.key));
+    if (!appends_in_order) {
+        invalidate_compaction();
+    }
+
     std::size_t index = allocate_index_for_new_note();
     notes_[index] = new_note;
 
-    // Update indexes for the new note only.
+    // Update indexes for the new note only, keeping the per-key index sorted
+    // by start tick.
     id_to_index_[new_note.id] = index;
-    spatial_index_[new_note.key].push_back(index);
+    std::vector<std::size_t>& indices_for_key = spatial_index_[new_note.key];
+    auto insert_it = std::upper_bound(
+        indices_for_key.begin(),
+        indices_for_key.end(),
+        new_note.tick,
+        [this](Tick tick, std::size_t note_index) {
+            return tick < notes_[note_index].tick;
+        });
+    indices_for_key.insert(insert_it, index);
+    add_note_edges(new_note);
+    max_duration_ = std::max(max_duration_, new_note.duration);
+    mark_dirty(new_note.tick, new_note.end_tick());
 
     if (selected) {
         selected_note_ids_.insert(new_note.id);
@@ -38,6 +63,41 @@ NoteId NoteManager::create_note(Tick tick,
     return new_note.id;
 }
 
+std::vector<NoteId> NoteManager::add_notes(std::span<const Note> notes,
+                                           bool record_undo) {
+    std::vector<NoteId> ids(notes.size(), 0);
+    if (record_undo) {
+        push_undo_state();
+    }
+
+    notes_.reserve(notes_.size() + notes.size());
+    Tick dirty_start = 0;
+    Tick dirty_end = 0;
+    bool any = false;
+    for (std::size_t i = 0; i < notes.size(); ++i) {
+        Note note = notes[i];
+        if (!note.is_valid()) {
+            continue;
+        }
+        note.id = allocate_id();
+        note.expression = {};
+        if (note.selected) {
+            selected_note_ids_.insert(note.id);
+        }
+        dirty_start = any ? std::min(dirty_start, note.tick) : note.tick;
+        dirty_end = any ? std::max(dirty_end, note.end_tick()) : note.end_tick();
+        any = true;
+        ids[i] = note.id;
+        notes_.push_back(note);
+    }
+    if (any) {
+        rebuild_indexes();
+        rebuild_edge_index();
+        mark_dirty(dirty_start, dirty_end);
+    }
+    return ids;
+}
+
 bool NoteManager::remove_note(NoteId id, bool record_undo) {
     auto id_it = id_to_index_.find(id);
     if (id_it == id_to_index_.end()) {
@@ -53,6 +113,11 @@ bool NoteManager::remove_note(NoteId id, bool record_undo) {
         return false;
     }
 
+    expression_garbage_ += notes_[index_to_remove].expression.count;
+    remove_note_edges(notes_[index_to_remove]);
+    mark_dirty(notes_[index_to_remove].tick,
+               notes_[index_to_remove].end_tick());
+
     notes_.erase(notes_.begin() + static_cast<std::ptrdiff_t>(index_to_remove));
 
     // Rebuild indexes and selection after removal.
@@ -72,17 +137,24 @@ bool NoteManager::move_note(NoteId id,
         return false;
     }
 
-    Note original = *note;
-    note->move_by(delta_tick, key_delta);
+    Note moved = *note;
+    moved.move_by(delta_tick, key_delta);
 
-    if (!allow_overlap && would_overlap(*note, id)) {
-        *note = original;
+    if (!allow_overlap && would_overlap(moved, id)) {
         return false;
     }
 
+    // Snapshot before applying so undo restores the original position.
     if (record_undo) {
         push_undo_state();
     }
+    if (moved.tick != note->tick) {
+        remove_note_edges(*note);
+        add_note_edges(moved);
+    }
+    mark_dirty(std::min(note->tick, moved.tick),
+               std::max(note->end_tick(), moved.end_tick()));
+    *note = moved;
 
     rebuild_indexes();
     return true;
@@ -101,22 +173,239 @@ bool NoteManager::resize_note(NoteId id,
         return false;
     }
 
-    Note original = *note;
-    note->resize_to(new_duration);
+    Note resized = *note;
+    resized.resize_to(new_duration);
 
-    if (!allow_overlap && would_overlap(*note, id)) {
-        *note = original;
+    if (!allow_overlap && would_overlap(resized, id)) {
         return false;
     }
 
     if (record_undo) {
         push_undo_state();
     }
+    remove_note_edges(*note);
+    add_note_edges(resized);
+    max_duration_ = std::max(max_duration_, resized.duration);
+    mark_dirty(note->tick, std::max(note->end_tick(), resized.end_tick()));
+    *note = resized;
 
     rebuild_indexes();
     return true;
 }
 
+std::size_t NoteManager::apply_note_edits(std::span<const NoteEdit> edits,
+                                          std::span<const NoteId> removals,
+                                          bool record_undo) {
+    if (edits.empty() && removals.empty()) {
+        return 0;
+    }
+    if (record_undo) {
+        push_undo_state();
+    }
+
+    // Large batches rebuild the edge index once instead of patching it
+    // entry by entry.
+    const bool rebuild_edges =
+        (edits.size() + removals.size()) * 4 > notes_.size();
+
+    // Without removals the storage slots stay put, so only the per-key
+    // index lists of touched keys need re-sorting (notes changing key move
+    // between lists first). This keeps per-frame batches such as a group
+    // resize proportional to the keys they touch rather than to the score.
+    const bool patch_indexes = removals.empty();
+    std::array<bool, 128> touched_keys{};
+
+    // One dirty range covering the old and new extent of every change.
+    Tick dirty_start = std::numeric_limits<Tick>::max();
+    Tick dirty_end = std::numeric_limits<Tick>::min();
+    auto extend_dirty = [&](Tick start, Tick end) {
+        dirty_start = std::min(dirty_start, start);
+        dirty_end = std::max(dirty_end, end);
+    };
+
+    std::size_t changed = 0;
+    bool reordered = false;
+    for (const NoteEdit& edit : edits) {
+        auto it = id_to_index_.find(edit.id);
+        if (it == id_to_index_.end() || edit.duration <= 0 || edit.tick < 0 ||
+            edit.key < 0 || edit.key > 127) {
+            continue;
+        }
+        Note& note = notes_[it->second];
+        if (!rebuild_edges) {
+            remove_note_edges(note);
+        }
+        extend_dirty(note.tick, note.end_tick());
+        extend_dirty(edit.tick, edit.tick + edit.duration);
+        max_duration_ = std::max(max_duration_, edit.duration);
+        if (patch_indexes) {
+            if (note.key != edit.key) {
+                std::vector<std::size_t>& from = spatial_index_[note.key];
+                from.erase(std::find(from.begin(), from.end(), it->second));
+                spatial_index_[edit.key].push_back(it->second);
+            }
+            if (note.key >= 0 && note.key < 128) {
+                touched_keys[static_cast<std::size_t>(note.key)] = true;
+            }
+            touched_keys[static_cast<std::size_t>(edit.key)] = true;
+        }
+        reordered = reordered || note.tick != edit.tick || note.key != edit.key;
+        note.tick = edit.tick;
+        note.duration = edit.duration;
+        note.key = edit.key;
+        if (!rebuild_edges) {
+            add_note_edges(note);
+        }
+        ++changed;
+    }
+
+    if (!removals.empty()) {
+        std::unordered_set<NoteId> doomed(removals.begin(), removals.end());
+        const std::size_t before = notes_.size();
+        auto new_end = std::remove_if(
+            notes_.begin(), notes_.end(), [&](const Note& note) {
+                if (doomed.count(note.id) == 0) {
+                    return false;
+                }
+                expression_garbage_ += note.expression.count;
+                extend_dirty(note.tick, note.end_tick());
+                if (!rebuild_edges) {
+                    remove_note_edges(note);
+                }
+                return true;
+            });
+        notes_.erase(new_end, notes_.end());
+        changed += before - notes_.size();
+        rebuild_selection_from_notes();
+    }
+
+    if (patch_indexes) {
+        for (std::size_t key = 0; key < touched_keys.size(); ++key) {
+            if (touched_keys[key]) {
+                sort_key_index(static_cast<MidiKey>(key));
+            }
+        }
+        // Moved notes leave (tick, key) storage order; length-only edits
+        // keep it.
+        if (reordered) {
+            invalidate_compaction();
+        }
+    } else {
+        rebuild_indexes();
+    }
+    if (rebuild_edges) {
+        rebuild_edge_index();
+    }
+    if (changed > 0) {
+        mark_dirty(dirty_start, dirty_end);
+    }
+    return changed;
+}
+
+std::size_t NoteManager::ripple_insert(Tick tick,
+                                       Duration length,
+                                       bool record_undo) {
+    if (length <= 0) {
+        return 0;
+    }
+    tick = std::max<Tick>(tick, 0);
+    const std::size_t moved = static_cast<std::size_t>(
+        std::count_if(notes_.begin(), notes_.end(), [tick](const Note& note) {
+            return note.tick >= tick;
+        }));
+    if (moved == 0) {
+        return 0;
+    }
+
+    RippleRecord record;
+    record.from = tick;
+    record.delta = length;
+    apply_ripple(record, true);
+    if (record_undo) {
+        Snapshot entry;
+        entry.ripple = std::move(record);
+        push_undo_entry(std::move(entry));
+    }
+    return moved;
+}
+
+std::size_t NoteManager::ripple_delete(Tick start_tick,
+                                       Tick end_tick,
+                                       bool split_straddling,
+                                       bool record_undo) {
+    start_tick = std::max<Tick>(start_tick, 0);
+    if (end_tick <= start_tick) {
+        return 0;
+    }
+    const Tick span = end_tick - start_tick;
+
+    // Notes touching the span are replaced as a whole (before -> after);
+    // everything starting at or after its end only shifts.
+    RippleRecord record;
+    record.from = end_tick;
+    record.delta = -span;
+    std::size_t changed = 0;
+    for (const Note& note : notes_) {
+        if (note.tick >= end_tick) {
+            ++changed;
+            continue;
+        }
+        if (note.end_tick() <= start_tick) {
+            continue;
+        }
+        ++changed;
+        store_ripple_note(record, record.before, note);
+        const Tick head_cut = end_tick - note.tick;
+        if (note.tick >= start_tick) {
+            if (note.end_tick() > end_tick) {
+                // Crosses the span end: keep the tail, moved to the start.
+                Note tail = note;
+                tail.tick = start_tick;
+                tail.duration = note.end_tick() - end_tick;
+                store_ripple_note(record, record.after, tail, 0, head_cut);
+            }
+            continue;
+        }
+        if (note.end_tick() <= end_tick) {
+            // Crosses the span start: cut at it.
+            Note head = note;
+            head.duration = start_tick - note.tick;
+            store_ripple_note(record, record.after, head);
+            continue;
+        }
+        // Covers the whole span.
+        if (split_straddling) {
+            Note head = note;
+            head.duration = start_tick - note.tick;
+            store_ripple_note(record, record.after, head);
+            Note tail = note;
+            tail.id = allocate_id();
+            tail.tick = start_tick;
+            tail.duration = note.end_tick() - end_tick;
+            store_ripple_note(record, record.after, tail, 0, head_cut);
+        } else {
+            Note shortened = note;
+            shortened.duration -= span;
+            store_ripple_note(record,
+                              record.after,
+                              shortened,
+                              start_tick - note.tick,
+                              head_cut);
+        }
+    }
+    if (changed == 0) {
+        return 0;
+    }
+
+    apply_ripple(record, true);
+    if (record_undo) {
+        Snapshot entry;
+        entry.ripple = std::move(record);
+        push_undo_entry(std::move(entry));
+    }
+    return changed;
+}
+
 bool NoteManager::would_overlap(const Note& probe,
                                 std::optional<NoteId> exclude_id) const {
     auto index_it = spatial_index_.find(probe.key);
@@ -166,46 +455,34 @@ const Note* NoteManager::find_by_id(NoteId id) const noexcept {
 }
 
 Note* NoteManager::note_at(Tick tick, MidiKey key) noexcept {
-    auto index_it = spatial_index_.find(key);
-    if (index_it == spatial_index_.end()) {
-        return nullptr;
-    }
-
-    const std::vector<std::size_t>& indices_for_key = index_it->second;
-    for (std::size_t note_index : indices_for_key) {
-        if (note_index >= notes_.size()) {
-            continue;
-        }
-        Note& note = notes_[note_index];
-        if (note.contains_tick(tick)) {
-            return &note;
-        }
-    }
-    return nullptr;
+    Note* hit = nullptr;
+    for_each_in_range(tick, tick + 1, key, key, [&hit](Note& note) {
+        hit = &note;
+        return false;
+    });
+    return hit;
 }
 
 const Note* NoteManager::note_at(Tick tick, MidiKey key) const noexcept {
-    auto index_it = spatial_index_.find(key);
-    if (index_it == spatial_index_.end()) {
-        return nullptr;
-    }
+    const Note* hit = nullptr;
+    for_each_in_range(tick, tick + 1, key, key, [&hit](const Note& note) {
+        hit = &note;
+        return false;
+    });
+    return hit;
+}
 
-    const std::vector<std::size_t>& indices_for_key = index_it->second;
-    for (std::size_t note_index : indices_for_key) {
-        if (note_index >= notes_.size()) {
-            continue;
-        }
-        const Note& note = notes_[note_index];
-        // Notes are sorted by start tick within each key; we can break once
-        // we pass the target tick since later notes cannot contain it.
-        if (note.tick > tick) {
-            break;
-        }
-        if (note.contains_tick(tick)) {
-            return &note;
-        }
-    }
-    return nullptr;
+std::vector<std::size_t>::const_iterator NoteManager::first_reaching(
+    const std::vector<std::size_t>& indices, Tick tick) const noexcept {
+    // No note is longer than max_duration_, so anything starting before
+    // tick - max_duration_ ends before tick.
+    const Tick earliest = tick - max_duration_;
+    return std::lower_bound(indices.begin(),
+                            indices.end(),
+                            earliest,
+                            [this](std::size_t note_index, Tick t) {
+                                return notes_[note_index].tick < t;
+                            });
 }
 
 std::vector<Note*> NoteManager::notes_in_range(Tick start_tick,
@@ -213,33 +490,11 @@ std::vector<Note*> NoteManager::notes_in_range(Tick start_tick,
                                                MidiKey min_key,
                                                MidiKey max_key) noexcept {
     std::vector<Note*> result;
-    if (start_tick >= end_tick || min_key > max_key) {
-        return result;
-    }
-
-    for (MidiKey key = min_key; key <= max_key; ++key) {
-        auto index_it = spatial_index_.find(key);
-        if (index_it == spatial_index_.end()) {
-            continue;
-        }
-
-        const std::vector<std::size_t>& indices_for_key = index_it->second;
-        for (std::size_t note_index : indices_for_key) {
-            if (note_index >= notes_.size()) {
-                continue;
-            }
-            Note& note = notes_[note_index];
-            // Per-key indices are sorted by note start tick, so we can stop
-            // once we reach notes that start at or after end_tick.
-            if (note.tick >= end_tick) {
-                break;
-            }
-            if (note.end_tick() > start_tick) {
-                result.push_back(&note);
-            }
-        }
-    }
-
+    for_each_in_range(start_tick,
+                      end_tick,
+                      min_key,
+                      max_key,
+                      [&result](Note& note) { result.push_back(&note); });
     return result;
 }
 
@@ -248,32 +503,113 @@ std::vector<const Note*> NoteManager::notes_in_range(Tick start_tick,
                                                      MidiKey min_key,
                                                      MidiKey max_key) const noexcept {
     std::vector<const Note*> result;
-    if (start_tick >= end_tick || min_key > max_key) {
-        return result;
+    notes_in_range(
+        start_tick, end_tick, min_key, max_key, std::back_inserter(result));
+    return result;
+}
+
+NoteManager::RangeView NoteManager::notes_in_range_view(
+    Tick start_tick,
+    Tick end_tick,
+    MidiKey min_key,
+    MidiKey max_key) const noexcept {
+    RangeView view;
+    view.manager_ = this;
+    view.start_tick_ = start_tick;
+    view.end_tick_ = end_tick;
+    view.min_key_ = min_key;
+    view.max_key_ = max_key;
+    return view;
+}
+
+NoteManager::RangeView::iterator NoteManager::RangeView::begin()
+    const noexcept {
+    iterator it;
+    // Empty or inverted ranges yield nothing, as in for_each_in_range.
+    if (manager_ == nullptr || start_tick_ >= end_tick_ ||
+        min_key_ > max_key_) {
+        return it;
     }
+    it.manager_ = manager_;
+    it.start_tick_ = start_tick_;
+    it.end_tick_ = end_tick_;
+    it.key_ = min_key_;
+    it.max_key_ = max_key_;
+    it.enter_key();
+    it.settle();
+    return it;
+}
 
-    for (MidiKey key = min_key; key <= max_key; ++key) {
-        auto index_it = spatial_index_.find(key);
-        if (index_it == spatial_index_.end()) {
-            continue;
-        }
+void NoteManager::RangeView::iterator::enter_key() noexcept {
+    pos_ = last_ = nullptr;
+    auto index_it = manager_->spatial_index_.find(key_);
+    if (index_it == manager_->spatial_index_.end()) {
+        return;
+    }
+    const std::vector<std::size_t>& indices = index_it->second;
+    auto first = manager_->first_reaching(indices, start_tick_);
+    pos_ = indices.data() + (first - indices.begin());
+    last_ = indices.data() + indices.size();
+}
 
-        const std::vector<std::size_t>& indices_for_key = index_it->second;
-        for (std::size_t note_index : indices_for_key) {
-            if (note_index >= notes_.size()) {
+void NoteManager::RangeView::iterator::settle() noexcept {
+    // Advance to the next note in range, moving on to the following keys
+    // when the current key's list is exhausted; pos_ is null at the end.
+    for (;;) {
+        for (; pos_ != last_; ++pos_) {
+            if (*pos_ >= manager_->notes_.size()) {
                 continue;
             }
-            const Note& note = notes_[note_index];
-            if (note.tick >= end_tick) {
+            const Note& note = manager_->notes_[*pos_];
+            if (note.tick >= end_tick_) {
+                pos_ = last_;
                 break;
             }
-            if (note.end_tick() > start_tick) {
-                result.push_back(&note);
+            if (note.end_tick() > start_tick_) {
+                return;
             }
         }
+        if (key_ >= max_key_) {
+            pos_ = last_ = nullptr;
+            return;
+        }
+        ++key_;
+        enter_key();
     }
+}
 
-    return result;
+std::optional<Tick> NoteManager::nearest_note_edge(Tick tick,
+                                                   Tick max_distance,
+                                                   bool skip_selected,
+                                                   NoteId skip_id) const {
+    auto skipped = [&](NoteId id) {
+        return id == skip_id ||
+               (skip_selected && selected_note_ids_.count(id) != 0);
+    };
+
+    std::optional<Tick> best;
+    auto right = edge_index_.lower_bound(std::make_pair(tick, NoteId{0}));
+    for (auto it = right;
+         it != edge_index_.end() && it->first - tick <= max_distance;
+         ++it) {
+        if (!skipped(it->second)) {
+            best = it->first;
+            break;
+        }
+    }
+    for (auto it = right; it != edge_index_.begin();) {
+        --it;
+        Tick distance = tick - it->first;
+        if (distance > max_distance ||
+            (best.has_value() && distance >= *best - tick)) {
+            break;
+        }
+        if (!skipped(it->second)) {
+            best = it->first;
+            break;
+        }
+    }
+    return best;
 }
 
 void NoteManager::select(NoteId id, bool add_to_selection) {
@@ -288,6 +624,7 @@ void NoteManager::select(NoteId id, bool add_to_selection) {
 
     note->selected = true;
     selected_note_ids_.insert(id);
+    mark_dirty(note->tick, note->end_tick());
 }
 
 void NoteManager::deselect(NoteId id) {
@@ -297,13 +634,26 @@ void NoteManager::deselect(NoteId id) {
     }
     note->selected = false;
     selected_note_ids_.erase(id);
+    mark_dirty(note->tick, note->end_tick());
 }
 
 void NoteManager::clear_selection() {
+    if (selected_note_ids_.empty()) {
+        return;
+    }
+    Tick dirty_start = std::numeric_limits<Tick>::max();
+    Tick dirty_end = std::numeric_limits<Tick>::min();
     for (Note& note : notes_) {
+        if (note.selected) {
+            dirty_start = std::min(dirty_start, note.tick);
+            dirty_end = std::max(dirty_end, note.end_tick());
+        }
         note.selected = false;
     }
     selected_note_ids_.clear();
+    if (dirty_start < dirty_end) {
+        mark_dirty(dirty_start, dirty_end);
+    }
 }
 
 void NoteManager::select_all() {
@@ -312,6 +662,7 @@ void NoteManager::select_all() {
         note.selected = true;
         selected_note_ids_.insert(note.id);
     }
+    mark_all_dirty();
 }
 
 bool NoteManager::is_selected(NoteId id) const {
@@ -327,13 +678,53 @@ std::vector<NoteId> NoteManager::selected_ids() const {
     return result;
 }
 
+bool NoteManager::selection_bounds(Tick& min_tick,
+                                   Tick& max_tick,
+                                   MidiKey& min_key,
+                                   MidiKey& max_key) const noexcept {
+    SelectionBoundsCache& cache = selection_bounds_cache_;
+    if (cache.revision != revision_) {
+        cache = SelectionBoundsCache{revision_};
+        for_each_selected([&cache](const Note& note) {
+            if (!cache.any) {
+                cache.any = true;
+                cache.min_tick = note.tick;
+                cache.max_tick = note.end_tick();
+                cache.min_key = note.key;
+                cache.max_key = note.key;
+                return;
+            }
+            cache.min_tick = std::min(cache.min_tick, note.tick);
+            cache.max_tick = std::max(cache.max_tick, note.end_tick());
+            cache.min_key = std::min(cache.min_key, note.key);
+            cache.max_key = std::max(cache.max_key, note.key);
+        });
+    }
+    if (!cache.any) {
+        return false;
+    }
+    min_tick = cache.min_tick;
+    max_tick = cache.max_tick;
+    min_key = cache.min_key;
+    max_key = cache.max_key;
+    return true;
+}
+
 void NoteManager::clear() {
     notes_.clear();
+    expression_arenas_[0].clear();
+    expression_arenas_[1].clear();
+    active_arena_ = 0;
+    expression_garbage_ = 0;
     id_to_index_.clear();
     spatial_index_.clear();
     selected_note_ids_.clear();
+    edge_index_.clear();
+    max_duration_ = 0;
     undo_stack_.clear();
     redo_stack_.clear();
+    invalidate_compaction();
+    mark_all_dirty();
 }
 
 bool NoteManager::undo() {
@@ -341,15 +732,21 @@ bool NoteManager::undo() {
         return false;
     }
 
-    // Save current state to redo stack.
-    redo_stack_.push_back(notes_);
-
-    // Restore previous state.
-    notes_ = undo_stack_.back();
+    Snapshot entry = std::move(undo_stack_.back());
     undo_stack_.pop_back();
+    if (entry.ripple.has_value()) {
+        // Ripple entries are reverted in place and move to the redo stack
+        // as they are.
+        apply_ripple(*entry.ripple, false);
+        redo_stack_.push_back(std::move(entry));
+        return true;
+    }
 
-    rebuild_indexes();
-    rebuild_selection_from_notes();
+    // Save current state to redo stack, then restore the previous state.
+    Snapshot current = make_snapshot();
+    current.group = entry.group;
+    redo_stack_.push_back(std::move(current));
+    restore_snapshot(std::move(entry));
 
     return true;
 }
@@ -359,15 +756,19 @@ bool NoteManager::redo() {
         return false;
     }
 
-    // Save current state to undo stack.
-    undo_stack_.push_back(notes_);
-
-    // Restore next state.
-    notes_ = redo_stack_.back();
+    Snapshot entry = std::move(redo_stack_.back());
     redo_stack_.pop_back();
+    if (entry.ripple.has_value()) {
+        apply_ripple(*entry.ripple, true);
+        undo_stack_.push_back(std::move(entry));
+        return true;
+    }
 
-    rebuild_indexes();
-    rebuild_selection_from_notes();
+    // Save current state to undo stack, then restore the next state.
+    Snapshot current = make_snapshot();
+    current.group = entry.group;
+    undo_stack_.push_back(std::move(current));
+    restore_snapshot(std::move(entry));
 
     return true;
 }
@@ -376,28 +777,412 @@ void NoteManager::snapshot_for_undo() {
     push_undo_state();
 }
 
+void NoteManager::set_undo_group(std::uint64_t group) noexcept {
+    if (!undo_stack_.empty()) {
+        undo_stack_.back().group = group;
+    }
+}
+
+std::uint64_t NoteManager::undo_group() const noexcept {
+    return undo_stack_.empty() ? 0 : undo_stack_.back().group;
+}
+
+std::uint64_t NoteManager::redo_group() const noexcept {
+    return redo_stack_.empty() ? 0 : redo_stack_.back().group;
+}
+
+bool NoteManager::has_undo_group(std::uint64_t group) const noexcept {
+    auto tagged = [group](const Snapshot& entry) {
+        return entry.group == group;
+    };
+    return group != 0 &&
+           (std::any_of(undo_stack_.begin(), undo_stack_.end(), tagged) ||
+            std::any_of(redo_stack_.begin(), redo_stack_.end(), tagged));
+}
+
+bool NoteManager::set_note_expression(NoteId id,
+                                      std::vector<ExpressionPoint> points,
+                                      bool record_undo) {
+    Note* note = find_by_id(id);
+    if (note == nullptr) {
+        return false;
+    }
+
+    if (record_undo) {
+        push_undo_state();
+    }
+
+    std::stable_sort(points.begin(),
+                     points.end(),
+                     [](const ExpressionPoint& a, const ExpressionPoint& b) {
+                         if (a.dimension != b.dimension) {
+                             return a.dimension < b.dimension;
+                         }
+                         return a.tick_offset < b.tick_offset;
+                     });
+
+    mark_dirty(note->tick, note->end_tick());
+
+    // Replaced points become garbage; new points are appended so existing
+    // references (including those in undo snapshots) stay untouched.
+    expression_garbage_ += note->expression.count;
+    note->expression = append_expression(active_arena_, points);
+
+    if (expression_garbage_ > 64 &&
+        expression_garbage_ * 2 > expression_arena_size()) {
+        compact_expression_arena();
+    }
+    return true;
+}
+
+std::span<const ExpressionPoint> NoteManager::note_expression(
+    const Note& note) const noexcept {
+    if (note.expression.empty()) {
+        return {};
+    }
+    const std::vector<ExpressionPoint>& arena =
+        expression_arenas_[(note.expression.offset & kArenaBufferBit) != 0];
+    const std::size_t first = note.expression.offset & ~kArenaBufferBit;
+    if (first + note.expression.count > arena.size()) {
+        return {};
+    }
+    return std::span<const ExpressionPoint>(arena.data() + first,
+                                            note.expression.count);
+}
+
+ExpressionRef NoteManager::append_expression(
+    std::size_t buffer, std::span<const ExpressionPoint> points) {
+    if (points.empty()) {
+        return ExpressionRef{};
+    }
+    std::vector<ExpressionPoint>& arena = expression_arenas_[buffer];
+    ExpressionRef ref{static_cast<std::uint32_t>(arena.size()) |
+                          (buffer != 0 ? kArenaBufferBit : 0u),
+                      static_cast<std::uint32_t>(points.size())};
+    arena.insert(arena.end(), points.begin(), points.end());
+    return ref;
+}
+
+std::span<const ExpressionPoint> NoteManager::note_expression(
+    NoteId id) const noexcept {
+    const Note* note = find_by_id(id);
+    if (note == nullptr) {
+        return {};
+    }
+    return note_expression(*note);
+}
+
+float NoteManager::expression_value_at(NoteId id,
+                                       ExpressionDimension dimension,
+                                       Tick tick) const noexcept {
+    const Note* note = find_by_id(id);
+    if (note == nullptr) {
+        return expression_default_value(dimension);
+    }
+
+    std::span<const ExpressionPoint> points = note_expression(*note);
+    auto first = std::find_if(points.begin(),
+                              points.end(),
+                              [dimension](const ExpressionPoint& p) {
+                                  return p.dimension == dimension;
+                              });
+    auto last = std::find_if(first,
+                             points.end(),
+                             [dimension](const ExpressionPoint& p) {
+                                 return p.dimension != dimension;
+                             });
+    if (first == last) {
+        return expression_default_value(dimension);
+    }
+
+    double offset = static_cast<double>(tick - note->tick);
+    if (offset <= static_cast<double>(first->tick_offset)) {
+        return first->value;
+    }
+    for (auto it = first + 1; it != last; ++it) {
+        if (offset <= static_cast<double>(it->tick_offset)) {
+            const ExpressionPoint& a = *(it - 1);
+            double span = static_cast<double>(it->tick_offset) -
+                          static_cast<double>(a.tick_offset);
+            double t = span > 0.0
+                           ? (offset - static_cast<double>(a.tick_offset)) /
+                                 span
+                           : 1.0;
+            return static_cast<float>(a.value + (it->value - a.value) * t);
+        }
+    }
+    return (last - 1)->value;
+}
+
+void NoteManager::compact_expression_arena() {
+    std::vector<ExpressionPoint> compacted;
+    compacted.reserve(expression_arena_size() - expression_garbage_);
+    for (Note& note : notes_) {
+        std::span<const ExpressionPoint> points = note_expression(note);
+        if (points.empty()) {
+            note.expression = ExpressionRef{};
+            continue;
+        }
+        note.expression.offset = static_cast<std::uint32_t>(compacted.size());
+        compacted.insert(compacted.end(), points.begin(), points.end());
+    }
+    expression_arenas_[0] = std::move(compacted);
+    expression_arenas_[1].clear();
+    active_arena_ = 0;
+    expression_garbage_ = 0;
+    // A relayout in progress would copy from the old buffers.
+    compaction_arena_cursor_ = 0;
+    compaction_live_points_ = 0;
+}
+
+std::size_t NoteManager::memory_usage_bytes() const noexcept {
+    std::size_t bytes = notes_.capacity() * sizeof(Note) +
+                        (expression_arenas_[0].capacity() +
+                         expression_arenas_[1].capacity()) *
+                            sizeof(ExpressionPoint);
+
+    // Hash containers: one node per entry plus the bucket array.
+    bytes += id_to_index_.size() *
+                 (sizeof(std::pair<const NoteId, std::size_t>) +
+                  sizeof(void*)) +
+             id_to_index_.bucket_count() * sizeof(void*);
+    bytes += selected_note_ids_.size() * (sizeof(NoteId) + sizeof(void*)) +
+             selected_note_ids_.bucket_count() * sizeof(void*);
+    for (const auto& [key, indices] : spatial_index_) {
+        (void)key;
+        bytes += sizeof(std::vector<std::size_t>) + sizeof(void*) +
+                 indices.capacity() * sizeof(std::size_t);
+    }
+    // Tree nodes: value plus parent/child pointers and colour.
+    bytes += edge_index_.size() *
+             (sizeof(std::pair<Tick, NoteId>) + 4 * sizeof(void*));
+    return bytes;
+}
+
+std::size_t NoteManager::undo_memory_bytes() const noexcept {
+    auto snapshot_bytes = [](const Snapshot& snapshot) {
+        std::size_t bytes =
+            sizeof(snapshot) + snapshot.notes.capacity() * sizeof(Note) +
+            snapshot.expression.capacity() * sizeof(ExpressionPoint);
+        if (snapshot.ripple.has_value()) {
+            const RippleRecord& ripple = *snapshot.ripple;
+            bytes += (ripple.before.capacity() + ripple.after.capacity()) *
+                         sizeof(Note) +
+                     ripple.expression.capacity() * sizeof(ExpressionPoint);
+        }
+        return bytes;
+    };
+    std::size_t bytes = 0;
+    for (const auto& snapshot : undo_stack_) {
+        bytes += snapshot_bytes(snapshot);
+    }
+    for (const auto& snapshot : redo_stack_) {
+        bytes += snapshot_bytes(snapshot);
+    }
+    return bytes;
+}
+
+bool NoteManager::compact_storage_step(std::size_t max_notes) {
+    if (storage_compact_) {
+        return true;
+    }
+
+    // Min-heap on (tick, key) over the per-key lists.
+    auto later = [](const CompactionHead& a, const CompactionHead& b) {
+        if (a.tick != b.tick) {
+            return a.tick > b.tick;
+        }
+        return a.key > b.key;
+    };
+
+    if (!compaction_started_) {
+        compaction_heads_.clear();
+        for (const auto& [key, indices] : spatial_index_) {
+            if (!indices.empty()) {
+                compaction_heads_.push_back(
+                    CompactionHead{notes_[indices.front()].tick,
+                                   key,
+                                   0,
+                                   &indices});
+            }
+        }
+        std::make_heap(
+            compaction_heads_.begin(), compaction_heads_.end(), later);
+        compaction_cursor_ = 0;
+        compaction_arena_cursor_ = 0;
+        compaction_live_points_ = 0;
+        compaction_started_ = true;
+    }
+
+    // Fill storage slots front to back with the next note of the merged
+    // per-key lists, swapping the current occupant into the vacated slot.
+    // swap_storage_slots only rewrites list values, never list positions,
+    // so the heads stay valid and each step touches only the notes it
+    // moves. Slots before the cursor are final.
+    std::size_t budget = max_notes > 0 ? max_notes : 1;
+    while (!compaction_heads_.empty() && budget > 0) {
+        std::pop_heap(
+            compaction_heads_.begin(), compaction_heads_.end(), later);
+        CompactionHead& head = compaction_heads_.back();
+        const std::size_t current = (*head.list)[head.position];
+        if (current != compaction_cursor_) {
+            swap_storage_slots(compaction_cursor_, current);
+        }
+        ++compaction_cursor_;
+        --budget;
+
+        if (++head.position < head.list->size()) {
+            head.tick = notes_[(*head.list)[head.position]].tick;
+            std::push_heap(
+                compaction_heads_.begin(), compaction_heads_.end(), later);
+        } else {
+            compaction_heads_.pop_back();
+        }
+    }
+    if (!compaction_heads_.empty()) {
+        return false;
+    }
+
+    // Copy expression points into the inactive arena buffer in storage
+    // order. Notes read from whichever buffer their reference names, so a
+    // partially copied arena stays consistent between steps.
+    const std::size_t target = 1 - active_arena_;
+    if (expression_arena_size() > 0) {
+        while (compaction_arena_cursor_ < notes_.size() && budget > 0) {
+            Note& note = notes_[compaction_arena_cursor_++];
+            --budget;
+            if (note.expression.empty()) {
+                continue;
+            }
+            std::span<const ExpressionPoint> points = note_expression(note);
+            expression_garbage_ += note.expression.count;
+            compaction_live_points_ += points.size();
+            note.expression = append_expression(target, points);
+        }
+        if (compaction_arena_cursor_ < notes_.size()) {
+            return false;
+        }
+
+        // Every live point is now in the target buffer; the only garbage
+        // left is what an interrupted earlier pass copied there.
+        expression_arenas_[active_arena_].clear();
+        active_arena_ = target;
+        expression_garbage_ =
+            expression_arenas_[target].size() - compaction_live_points_;
+    }
+
+    compaction_heads_.clear();
+    compaction_heads_.shrink_to_fit();
+    compaction_cursor_ = 0;
+    compaction_arena_cursor_ = 0;
+    compaction_live_points_ = 0;
+    compaction_started_ = false;
+    storage_compact_ = true;
+    return true;
+}
+
+void NoteManager::compact_storage() {
+    while (!compact_storage_step(notes_.size())) {
+    }
+}
+
+void NoteManager::invalidate_compaction() noexcept {
+    // An interrupted arena relayout leaves some references in the inactive
+    // buffer; they stay valid and the next pass copies them again.
+    compaction_heads_.clear();
+    compaction_cursor_ = 0;
+    compaction_arena_cursor_ = 0;
+    compaction_live_points_ = 0;
+    compaction_started_ = false;
+    storage_compact_ = notes_.size() <= 1;
+}
+
+void NoteManager::swap_storage_slots(std::size_t a, std::size_t b) {
+    // Patch the per-key index entries (values a and b trade places); the
+    // lists stay sorted by tick because the notes themselves do not change.
+    auto locate = [this](std::size_t slot) -> std::size_t* {
+        const Note& note = notes_[slot];
+        std::vector<std::size_t>& indices = spatial_index_[note.key];
+        auto it = std::lower_bound(
+            indices.begin(),
+            indices.end(),
+            note.tick,
+            [this](std::size_t note_index, Tick tick) {
+                return notes_[note_index].tick < tick;
+            });
+        for (; it != indices.end(); ++it) {
+            if (*it == slot) {
+                return &*it;
+            }
+        }
+        return nullptr;
+    };
+    std::size_t* entry_a = locate(a);
+    std::size_t* entry_b = locate(b);
+    if (entry_a != nullptr) {
+        *entry_a = b;
+    }
+    if (entry_b != nullptr) {
+        *entry_b = a;
+    }
+
+    std::swap(notes_[a], notes_[b]);
+    id_to_index_[notes_[a].id] = a;
+    id_to_index_[notes_[b].id] = b;
+}
+
 void NoteManager::rebuild_indexes() {
+    invalidate_compaction();
     id_to_index_.clear();
     spatial_index_.clear();
 
+    id_to_index_.reserve(notes_.size());
+    max_duration_ = 0;
     for (std::size_t index = 0; index < notes_.size(); ++index) {
-        Note& note = notes_[index];
-        id_to_index_[note.id] = index;
-        spatial_index_[note.key].push_back(index);
+        id_to_index_[notes_[index].id] = index;
+        max_duration_ = std::max(max_duration_, notes_[index].duration);
     }
 
     // Keep per-key index sorted by note start tick so that queries can
-    // short-circuit once ticks exceed the requested range.
-    for (auto& [key, indices] : spatial_index_) {
-        (void)key;
-        std::sort(indices.begin(),
-                  indices.end(),
-                  [this](std::size_t a, std::size_t b) {
-                      if (a >= notes_.size() || b >= notes_.size()) {
-                          return a < b;
-                      }
-                      return notes_[a].tick < notes_[b].tick;
-                  });
+    // short-circuit once ticks exceed the requested range. Notes are first
+    // bucketed by key, then each bucket sorts packed (tick, index) pairs,
+    // which compares contiguous data instead of chasing each index back
+    // into notes_.
+    std::unordered_map<MidiKey, std::vector<std::pair<Tick, std::size_t>>>
+        buckets;
+    for (std::size_t index = 0; index < notes_.size(); ++index) {
+        buckets[notes_[index].key].emplace_back(notes_[index].tick, index);
+    }
+    for (auto& [key, entries] : buckets) {
+        std::sort(entries.begin(), entries.end());
+        std::vector<std::size_t>& indices = spatial_index_[key];
+        indices.reserve(entries.size());
+        for (const auto& entry : entries) {
+            indices.push_back(entry.second);
+        }
+    }
+}
+
+void NoteManager::sort_key_index(MidiKey key) {
+    auto index_it = spatial_index_.find(key);
+    if (index_it == spatial_index_.end()) {
+        return;
+    }
+    std::vector<std::size_t>& indices = index_it->second;
+    std::vector<std::pair<Tick, std::size_t>> entries;
+    entries.reserve(indices.size());
+    for (std::size_t index : indices) {
+        entries.emplace_back(notes_[index].tick, index);
+    }
+    // Stable on tick so notes whose tick did not change keep their list
+    // positions, which an in-progress storage compaction relies on.
+    std::stable_sort(entries.begin(),
+                     entries.end(),
+                     [](const auto& a, const auto& b) {
+                         return a.first < b.first;
+                     });
+    for (std::size_t i = 0; i < entries.size(); ++i) {
+        indices[i] = entries[i].second;
     }
 }
 
@@ -410,8 +1195,279 @@ void NoteManager::rebuild_selection_from_notes() {
     }
 }
 
+NoteManager::Snapshot NoteManager::make_snapshot() const {
+    Snapshot snapshot;
+    snapshot.notes = notes_;
+    if (expression_garbage_ > 0 || active_arena_ != 0 ||
+        !expression_arenas_[1].empty()) {
+        // Store only live points so snapshots do not pin garbage; this also
+        // gives every reference a plain offset into snapshot.expression.
+        snapshot.expression.reserve(expression_arena_size() -
+                                    expression_garbage_);
+        for (Note& note : snapshot.notes) {
+            std::span<const ExpressionPoint> points = note_expression(note);
+            note.expression.offset =
+                static_cast<std::uint32_t>(snapshot.expression.size());
+            snapshot.expression.insert(
+                snapshot.expression.end(), points.begin(), points.end());
+        }
+    } else {
+        snapshot.expression = expression_arenas_[0];
+    }
+    return snapshot;
+}
+
+void NoteManager::restore_snapshot(Snapshot&& snapshot) {
+    notes_ = std::move(snapshot.notes);
+    expression_arenas_[0] = std::move(snapshot.expression);
+    expression_arenas_[1].clear();
+    active_arena_ = 0;
+    expression_garbage_ = 0;
+
+    rebuild_indexes();
+    rebuild_selection_from_notes();
+    rebuild_edge_index();
+    mark_all_dirty();
+}
+
+void NoteManager::store_ripple_note(RippleRecord& record,
+                                    std::vector<Note>& list,
+                                    Note note,
+                                    Tick cut_from,
+                                    Tick cut_to) const {
+    std::span<const ExpressionPoint> points = note_expression(note);
+    const auto offset = static_cast<std::uint32_t>(record.expression.size());
+    const Tick cut = cut_to - cut_from;
+    for (ExpressionPoint point : points) {
+        const auto tick = static_cast<Tick>(point.tick_offset);
+        if (cut > 0 && tick >= cut_from) {
+            if (tick < cut_to) {
+                continue;
+            }
+            point.tick_offset = static_cast<std::uint32_t>(tick - cut);
+        }
+        record.expression.push_back(point);
+    }
+    note.expression = ExpressionRef{
+        offset,
+        static_cast<std::uint32_t>(record.expression.size() - offset)};
+    if (note.expression.count == 0) {
+        note.expression = ExpressionRef{};
+    }
+    list.push_back(note);
+}
+
+void NoteManager::apply_ripple(const RippleRecord& record, bool forward) {
+    const std::vector<Note>& leaving = forward ? record.before : record.after;
+    const std::vector<Note>& entering = forward ? record.after : record.before;
+    const Tick from = forward ? record.from : record.from + record.delta;
+    const Tick delta = forward ? record.delta : -record.delta;
+
+    // Everything between the lowest tick involved and the furthest end of a
+    // moved or replaced note is redrawn.
+    Tick dirty_start = std::min(from, from + delta);
+    Tick dirty_end = dirty_start;
+    auto extend_dirty = [&](const Note& note) {
+        dirty_start = std::min(dirty_start, note.tick);
+        dirty_end = std::max(dirty_end, note.end_tick());
+    };
+
+    // 1. Take the replaced notes out. Storage is compacted stably, so the
+    //    per-key lists only need their slot numbers remapped.
+    if (!leaving.empty()) {
+        std::unordered_set<NoteId> doomed;
+        doomed.reserve(leaving.size());
+        for (const Note& gone : leaving) {
+            auto it = id_to_index_.find(gone.id);
+            if (it == id_to_index_.end()) {
+                continue;
+            }
+            const Note& note = notes_[it->second];
+            extend_dirty(note);
+            remove_note_edges(note);
+            expression_garbage_ += note.expression.count;
+            selected_note_ids_.erase(note.id);
+            id_to_index_.erase(it);
+            doomed.insert(note.id);
+        }
+
+        constexpr std::size_t kGone = std::numeric_limits<std::size_t>::max();
+        std::vector<std::size_t> remap(notes_.size(), kGone);
+        std::size_t write = 0;
+        for (std::size_t read = 0; read < notes_.size(); ++read) {
+            if (doomed.count(notes_[read].id) != 0) {
+                continue;
+            }
+            if (write != read) {
+                notes_[write] = notes_[read];
+                id_to_index_[notes_[write].id] = write;
+            }
+            remap[read] = write++;
+        }
+        notes_.resize(write);
+        for (auto& [key, indices] : spatial_index_) {
+            (void)key;
+            std::size_t kept = 0;
+            for (std::size_t index : indices) {
+                if (remap[index] != kGone) {
+                    indices[kept++] = remap[index];
+                }
+            }
+            indices.resize(kept);
+        }
+    }
+
+    // 2. Shift. No remaining note starts between from + delta and from, so
+    //    the moved notes keep their place in every per-key list.
+    for (Note& note : notes_) {
+        if (note.tick >= from) {
+            dirty_end = std::max(dirty_end, note.end_tick());
+            note.tick += delta;
+            dirty_end = std::max(dirty_end, note.end_tick());
+        }
+    }
+
+    // Edges at or after the lowest shifted position: those of moved notes
+    // shift together (staying sorted), the rest are ends of earlier notes.
+    // The tree nodes are detached, patched, and re-attached at the back in
+    // merged order, so the update is linear in the number of edges involved
+    // and allocates no nodes.
+    using EdgeNode = std::multiset<std::pair<Tick, NoteId>>::node_type;
+    const Tick moved_from = std::min(from, from + delta);
+    std::vector<EdgeNode> moved_edges;
+    std::vector<EdgeNode> kept_edges;
+    for (auto it = edge_index_.lower_bound(
+             std::make_pair(moved_from, NoteId{0}));
+         it != edge_index_.end();) {
+        auto next = std::next(it);
+        EdgeNode node = edge_index_.extract(it);
+        auto note_it = id_to_index_.find(node.value().second);
+        if (note_it != id_to_index_.end() &&
+            notes_[note_it->second].tick >= moved_from) {
+            node.value().first += delta;
+            moved_edges.push_back(std::move(node));
+        } else {
+            kept_edges.push_back(std::move(node));
+        }
+        it = next;
+    }
+    auto moved_it = moved_edges.begin();
+    auto kept_it = kept_edges.begin();
+    while (moved_it != moved_edges.end() || kept_it != kept_edges.end()) {
+        const bool take_moved =
+            kept_it == kept_edges.end() ||
+            (moved_it != moved_edges.end() &&
+             moved_it->value() < kept_it->value());
+        EdgeNode& node = take_moved ? *moved_it++ : *kept_it++;
+        edge_index_.insert(edge_index_.end(), std::move(node));
+    }
+
+    // 3. Add the replacement notes with their expression points.
+    for (Note note : entering) {
+        const std::size_t count = note.expression.count;
+        if (count > 0 &&
+            static_cast<std::size_t>(note.expression.offset) + count <=
+                record.expression.size()) {
+            note.expression = append_expression(
+                active_arena_,
+                std::span<const ExpressionPoint>(
+                    record.expression.data() + note.expression.offset, count));
+        } else {
+            note.expression = ExpressionRef{};
+        }
+
+        const std::size_t index = allocate_index_for_new_note();
+        notes_[index] = note;
+        id_to_index_[note.id] = index;
+        std::vector<std::size_t>& indices = spatial_index_[note.key];
+        indices.insert(std::upper_bound(indices.begin(),
+                                        indices.end(),
+                                        note.tick,
+                                        [this](Tick tick, std::size_t slot) {
+                                            return tick < notes_[slot].tick;
+                                        }),
+                       index);
+        add_note_edges(note);
+        max_duration_ = std::max(max_duration_, note.duration);
+        if (note.selected) {
+            selected_note_ids_.insert(note.id);
+        }
+        extend_dirty(note);
+    }
+
+    invalidate_compaction();
+    mark_dirty(dirty_start, dirty_end);
+    if (expression_garbage_ > 64 &&
+        expression_garbage_ * 2 > expression_arena_size()) {
+        compact_expression_arena();
+    }
+}
+
+bool NoteManager::dirty_ranges_since(std::uint64_t revision,
+                                     std::vector<DirtyRange>& out) const {
+    if (revision < log_floor_) {
+        return false;
+    }
+    auto first = std::upper_bound(
+        dirty_log_.begin(), dirty_log_.end(), revision,
+        [](std::uint64_t r, const DirtyRange& entry) {
+            return r < entry.revision;
+        });
+    out.insert(out.end(), first, dirty_log_.end());
+    return true;
+}
+
+void NoteManager::mark_dirty(Tick start, Tick end) {
+    ++revision_;
+    dirty_log_.push_back(DirtyRange{revision_, start, end});
+    if (dirty_log_.size() > kDirtyLogCapacity) {
+        log_floor_ = dirty_log_.front().revision;
+        dirty_log_.pop_front();
+    }
+}
+
+void NoteManager::mark_all_dirty() {
+    ++revision_;
+    dirty_log_.clear();
+    log_floor_ = revision_;
+}
+
+void NoteManager::rebuild_edge_index() {
+    // Sorted input with an end hint inserts in amortized O(1) per edge,
+    // avoiding a cache-missing tree descent for each of the 2n entries.
+    std::vector<std::pair<Tick, NoteId>> edges;
+    edges.reserve(notes_.size() * 2);
+    for (const Note& note : notes_) {
+        edges.emplace_back(note.tick, note.id);
+        edges.emplace_back(note.end_tick(), note.id);
+    }
+    std::sort(edges.begin(), edges.end());
+    edge_index_.clear();
+    for (const auto& edge : edges) {
+        edge_index_.emplace_hint(edge_index_.end(), edge);
+    }
+}
+
+void NoteManager::add_note_edges(const Note& note) {
+    edge_index_.emplace(note.tick, note.id);
+    edge_index_.emplace(note.end_tick(), note.id);
+}
+
+void NoteManager::remove_note_edges(const Note& note) {
+    for (Tick edge : {note.tick, note.end_tick()}) {
+        auto it = edge_index_.find(std::make_pair(edge, note.id));
+        if (it != edge_index_.end()) {
+            edge_index_.erase(it);
+        }
+    }
+}
+
 void NoteManager::push_undo_state() {
-    undo_stack_.push_back(notes_);
+    push_undo_entry(make_snapshot());
+}
+
+void NoteManager::push_undo_entry(Snapshot&& entry) {
+    undo_stack_.push_back(std::move(entry));
     if (undo_stack_.size() > max_undo_levels_) {
         undo_stack_.erase(undo_stack_.begin());
     }
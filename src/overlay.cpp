@@ -119,18 +119,15 @@ void RenderSelectionOverlay(const NoteManager& notes,
     }
 
     // Drag preview for moving / duplicating notes: draw overlays for all
-    // selected notes with different colours for duplication.
+    // selected notes with different colours for duplication. Only the
+    // selected notes are visited, not the whole clip.
     if (tool.is_dragging_note() || tool.is_resizing_note()) {
         bool duplicating = tool.is_duplicating();
         ColorRGBA base =
             duplicating ? config.drag_preview_duplicate_color
                         : config.drag_preview_move_color;
 
-        for (const Note& n : notes.notes()) {
-            if (!n.selected) {
-                continue;
-            }
-
+        notes.for_each_selected([&](const Note& n) {
             double wx1 = coords.tick_to_world(n.tick);
             double wx2 = coords.tick_to_world(n.end_tick());
             double wy1 = coords.key_to_world_y(n.key);
@@ -146,7 +143,7 @@ void RenderSelectionOverlay(const NoteManager& notes,
             float y1_local = static_cast<float>(sy1_local);
             float y2_local = static_cast<float>(sy2_local);
             if (x2_local <= x1_local || y2_local <= y1_local) {
-                continue;
+                return;
             }
 
             ImVec2 pmin(origin.x + x1_local,
@@ -156,7 +153,7 @@ void RenderSelectionOverlay(const NoteManager& notes,
             draw_list->AddRectFilled(pmin,
                                      pmax,
                                      to_color(base));
-        }
+        });
     }
 
     // Optional magnetic snap debug zones (Bitwig-style visualization of
@@ -0,0 +1,291 @@
+#include "piano_roll/pattern.hpp"
+
+#include <algorithm>
+#include <utility>
+
+namespace piano_roll {
+
+PatternId PatternLibrary::create_pattern(Tick length, std::string name) {
+    auto pattern = std::make_unique<Pattern>();
+    pattern->id = next_pattern_id_++;
+    pattern->name = std::move(name);
+    pattern->length = std::max<Tick>(length, 0);
+    const PatternId id = pattern->id;
+    patterns_.push_back(std::move(pattern));
+    return id;
+}
+
+PatternId PatternLibrary::create_pattern_from_notes(
+    const NoteManager& source,
+    std::span<const NoteId> ids,
+    Tick origin,
+    Tick length,
+    std::string name) {
+    std::vector<const Note*> picked;
+    picked.reserve(ids.size());
+    for (NoteId note_id : ids) {
+        const Note* note = source.find_by_id(note_id);
+        if (note != nullptr && note->tick >= origin) {
+            picked.push_back(note);
+        }
+    }
+    if (picked.empty()) {
+        return 0;
+    }
+
+    PatternId id = create_pattern(length, std::move(name));
+    NoteManager& notes = find_pattern(id)->notes;
+    for (const Note* note : picked) {
+        NoteId copy = notes.create_note(note->tick - origin,
+                                        note->duration,
+                                        note->key,
+                                        note->velocity,
+                                        note->channel,
+                                        false,
+                                        false,
+                                        true);
+        std::span<const ExpressionPoint> points = source.note_expression(*note);
+        if (copy != 0 && !points.empty()) {
+            notes.set_note_expression(
+                copy,
+                std::vector<ExpressionPoint>(points.begin(), points.end()),
+                false);
+        }
+    }
+    return id;
+}
+
+bool PatternLibrary::remove_pattern(PatternId id) {
+    auto it = std::find_if(patterns_.begin(),
+                           patterns_.end(),
+                           [id](const auto& p) { return p->id == id; });
+    if (it == patterns_.end()) {
+        return false;
+    }
+    patterns_.erase(it);
+    std::erase_if(instances_, [id](const PatternInstance& instance) {
+        return instance.pattern == id;
+    });
+    return true;
+}
+
+Pattern* PatternLibrary::find_pattern(PatternId id) noexcept {
+    for (auto& pattern : patterns_) {
+        if (pattern->id == id) {
+            return pattern.get();
+        }
+    }
+    return nullptr;
+}
+
+const Pattern* PatternLibrary::find_pattern(PatternId id) const noexcept {
+    for (const auto& pattern : patterns_) {
+        if (pattern->id == id) {
+            return pattern.get();
+        }
+    }
+    return nullptr;
+}
+
+bool PatternLibrary::set_pattern_length(PatternId id, Tick length) {
+    Pattern* pattern = find_pattern(id);
+    if (pattern == nullptr) {
+        return false;
+    }
+    pattern->length = std::max<Tick>(length, 0);
+    pattern->cached_extent_revision = ~std::uint64_t{0};
+    return true;
+}
+
+PatternInstanceId PatternLibrary::add_instance(PatternId pattern,
+                                               Tick tick_offset,
+                                               int key_offset) {
+    if (find_pattern(pattern) == nullptr) {
+        return 0;
+    }
+    PatternInstance instance;
+    instance.id = next_instance_id_++;
+    instance.pattern = pattern;
+    instance.tick_offset = tick_offset;
+    instance.key_offset = key_offset;
+    instances_.push_back(instance);
+    sort_instances();
+    return instance.id;
+}
+
+bool PatternLibrary::remove_instance(PatternInstanceId id) {
+    return std::erase_if(instances_, [id](const PatternInstance& instance) {
+               return instance.id == id;
+           }) > 0;
+}
+
+bool PatternLibrary::move_instance(PatternInstanceId id,
+                                   Tick tick_offset,
+                                   int key_offset) {
+    for (PatternInstance& instance : instances_) {
+        if (instance.id == id) {
+            instance.tick_offset = tick_offset;
+            instance.key_offset = key_offset;
+            sort_instances();
+            return true;
+        }
+    }
+    return false;
+}
+
+const PatternInstance* PatternLibrary::find_instance(
+    PatternInstanceId id) const noexcept {
+    for (const PatternInstance& instance : instances_) {
+        if (instance.id == id) {
+            return &instance;
+        }
+    }
+    return nullptr;
+}
+
+NoteManager* PatternLibrary::instance_notes(PatternInstanceId id) noexcept {
+    const PatternInstance* instance = find_instance(id);
+    if (instance == nullptr) {
+        return nullptr;
+    }
+    Pattern* pattern = find_pattern(instance->pattern);
+    return pattern != nullptr ? &pattern->notes : nullptr;
+}
+
+std::vector<InstanceNote> PatternLibrary::notes_in_range(Tick start_tick,
+                                                         Tick end_tick,
+                                                         MidiKey min_key,
+                                                         MidiKey max_key) const {
+    std::vector<InstanceNote> result;
+    for_each_in_range(start_tick,
+                      end_tick,
+                      min_key,
+                      max_key,
+                      [&result](const InstanceNote& hit) {
+                          result.push_back(hit);
+                      });
+    return result;
+}
+
+std::optional<InstanceNote> PatternLibrary::note_at(Tick tick,
+                                                    MidiKey key) const {
+    std::optional<InstanceNote> hit;
+    for_each_in_range(tick, tick + 1, key, key, [&hit](const InstanceNote& c) {
+        if (!hit.has_value() || c.instance > hit->instance) {
+            hit = c;
+        }
+    });
+    return hit;
+}
+
+std::size_t PatternLibrary::materialize_instance(PatternInstanceId id,
+                                                 NoteManager& target,
+                                                 bool record_undo) const {
+    const PatternInstance* instance = find_instance(id);
+    const Pattern* pattern =
+        instance != nullptr ? find_pattern(instance->pattern) : nullptr;
+    if (pattern == nullptr) {
+        return 0;
+    }
+    if (record_undo) {
+        target.snapshot_for_undo();
+    }
+    std::size_t created = 0;
+    for (const Note& note : pattern->notes.notes()) {
+        const Tick tick = note.tick + instance->tick_offset;
+        const MidiKey key = note.key + instance->key_offset;
+        if (tick < 0 || key < 0 || key > 127) {
+            continue;
+        }
+        NoteId copy = target.create_note(tick,
+                                         note.duration,
+                                         key,
+                                         note.velocity,
+                                         note.channel,
+                                         false,
+                                         false,
+                                         true);
+        if (copy == 0) {
+            continue;
+        }
+        std::span<const ExpressionPoint> points =
+            pattern->notes.note_expression(note);
+        if (!points.empty()) {
+            target.set_note_expression(
+                copy,
+                std::vector<ExpressionPoint>(points.begin(), points.end()),
+                false);
+        }
+        ++created;
+    }
+    return created;
+}
+
+void PatternLibrary::append_bounce_clips(std::vector<BounceClip>& out) const {
+    out.reserve(out.size() + instances_.size());
+    for (const PatternInstance& instance : instances_) {
+        const Pattern* pattern = find_pattern(instance.pattern);
+        if (pattern == nullptr) {
+            continue;
+        }
+        BounceClip clip;
+        clip.notes = &pattern->notes;
+        clip.tick_offset = instance.tick_offset;
+        clip.key_offset = instance.key_offset;
+        out.push_back(clip);
+    }
+}
+
+std::size_t PatternLibrary::resolved_note_count() const noexcept {
+    std::size_t count = 0;
+    for (const PatternInstance& instance : instances_) {
+        if (const Pattern* pattern = find_pattern(instance.pattern)) {
+            count += pattern->notes.notes().size();
+        }
+    }
+    return count;
+}
+
+void PatternLibrary::clear() {
+    patterns_.clear();
+    instances_.clear();
+}
+
+void PatternLibrary::sort_instances() {
+    std::sort(instances_.begin(),
+              instances_.end(),
+              [](const PatternInstance& a, const PatternInstance& b) {
+                  if (a.tick_offset != b.tick_offset) {
+                      return a.tick_offset < b.tick_offset;
+                  }
+                  return a.id < b.id;
+              });
+}
+
+Tick PatternLibrary::extent(const Pattern& pattern) const noexcept {
+    if (pattern.cached_extent_revision != pattern.notes.revision()) {
+        Tick reach = pattern.length;
+        for (const Note& note : pattern.notes.notes()) {
+            reach = std::max(reach, note.end_tick());
+        }
+        pattern.cached_extent = reach;
+        pattern.cached_extent_revision = pattern.notes.revision();
+    }
+    return pattern.cached_extent;
+}
+
+std::vector<PatternInstance>::const_iterator PatternLibrary::first_reaching(
+    Tick tick) const noexcept {
+    Tick max_extent = 0;
+    for (const auto& pattern : patterns_) {
+        max_extent = std::max(max_extent, extent(*pattern));
+    }
+    return std::upper_bound(instances_.begin(),
+                            instances_.end(),
+                            tick - max_extent,
+                            [](Tick t, const PatternInstance& instance) {
+                                return t < instance.tick_offset;
+                            });
+}
+
+}  // namespace piano_roll
@@ -0,0 +1,126 @@
+#include "piano_roll/perf_hud.hpp"
+
+#include <cstdio>
+
+#ifdef PIANO_ROLL_USE_IMGUI
+#include <imgui.h>
+#endif
+
+namespace piano_roll {
+
+void RenderPerfHud(const FrameStats& stats,
+                   const FrameTimeHistory& history,
+                   float grid_left_local,
+                   float grid_top_local,
+                   const PianoRollRenderConfig& config) {
+#ifdef PIANO_ROLL_USE_IMGUI
+    ImDrawList* draw_list = ImGui::GetWindowDrawList();
+    if (!draw_list) {
+        return;
+    }
+
+    auto to_imvec4 = [](const ColorRGBA& c) {
+        return ImVec4(c.r, c.g, c.b, c.a);
+    };
+    auto to_color = [&](const ColorRGBA& c) {
+        return ImGui::ColorConvertFloat4ToU32(to_imvec4(c));
+    };
+
+    ImVec2 canvas_min = ImGui::GetItemRectMin();
+    const float padding = 6.0f;
+    const float line_height = ImGui::GetFontSize() + 1.0f;
+    const float panel_width = 210.0f;
+    const float graph_height = 36.0f;
+
+    // Text rows: header, one row per stage, then counters.
+    char lines[kFrameStageCount + 6][96];
+    int line_count = 0;
+    std::snprintf(lines[line_count++], sizeof(lines[0]),
+                  "frame %.2f ms", stats.total_ms);
+    for (std::size_t i = 0; i < kFrameStageCount; ++i) {
+        std::snprintf(lines[line_count++], sizeof(lines[0]),
+                      "  %-10s %6.2f ms",
+                      frame_stage_label(static_cast<FrameStage>(i)),
+                      stats.stage_ms[i]);
+    }
+    std::snprintf(lines[line_count++], sizeof(lines[0]),
+                  "notes %zu / %zu", stats.visible_notes,
+                  stats.total_notes);
+    std::snprintf(lines[line_count++], sizeof(lines[0]),
+                  "vertices %zu", stats.vertices_emitted);
+    std::snprintf(lines[line_count++], sizeof(lines[0]),
+                  "note tiles %zu (%zu built)", stats.note_tiles_drawn,
+                  stats.note_tiles_built);
+    if (stats.has_allocation_count) {
+        std::snprintf(lines[line_count++], sizeof(lines[0]),
+                      "allocations %zu", stats.allocations);
+    } else {
+        std::snprintf(lines[line_count++], sizeof(lines[0]),
+                      "allocations n/a");
+    }
+    std::snprintf(lines[line_count++], sizeof(lines[0]),
+                  "notes mem %.1f KiB, undo %.1f KiB (%zu)",
+                  static_cast<double>(stats.note_manager_bytes) / 1024.0,
+                  static_cast<double>(stats.undo_bytes) / 1024.0,
+                  stats.undo_levels);
+
+    float x0 = canvas_min.x + grid_left_local + padding;
+    float y0 = canvas_min.y + grid_top_local + padding;
+    float panel_height = padding * 3.0f +
+                         line_height * static_cast<float>(line_count) +
+                         graph_height;
+    draw_list->AddRectFilled(ImVec2(x0, y0),
+                             ImVec2(x0 + panel_width, y0 + panel_height),
+                             to_color(config.perf_hud_background_color),
+                             3.0f);
+
+    ImU32 text_col = to_color(config.perf_hud_text_color);
+    float text_y = y0 + padding;
+    for (int i = 0; i < line_count; ++i) {
+        draw_list->AddText(ImVec2(x0 + padding, text_y), text_col, lines[i]);
+        text_y += line_height;
+    }
+
+    // Rolling frame-time graph, scaled so that the worst retained frame (or
+    // the 60 fps budget, whichever is larger) spans the full graph height.
+    float gx1 = x0 + padding;
+    float gx2 = x0 + panel_width - padding;
+    float gy2 = y0 + panel_height - padding;
+    float gy1 = gy2 - graph_height;
+    draw_list->AddRect(ImVec2(gx1, gy1), ImVec2(gx2, gy2),
+                       to_color(config.perf_hud_text_color), 0.0f, 0,
+                       1.0f);
+
+    const float budget_ms = 1000.0f / 60.0f;
+    float scale_ms = history.max_value();
+    if (scale_ms < budget_ms) {
+        scale_ms = budget_ms;
+    }
+    float budget_y = gy2 - (budget_ms / scale_ms) * graph_height;
+    draw_list->AddLine(ImVec2(gx1, budget_y), ImVec2(gx2, budget_y),
+                       to_color(config.perf_hud_budget_line_color), 1.0f);
+
+    std::size_t n = history.size();
+    if (n >= 2) {
+        float step = (gx2 - gx1) /
+                     static_cast<float>(FrameTimeHistory::kCapacity - 1);
+        float start_x = gx2 - step * static_cast<float>(n - 1);
+        ImU32 graph_col = to_color(config.perf_hud_graph_color);
+        ImVec2 prev(start_x, gy2 - (history.at(0) / scale_ms) * graph_height);
+        for (std::size_t i = 1; i < n; ++i) {
+            ImVec2 cur(start_x + step * static_cast<float>(i),
+                       gy2 - (history.at(i) / scale_ms) * graph_height);
+            draw_list->AddLine(prev, cur, graph_col, 1.0f);
+            prev = cur;
+        }
+    }
+#else
+    (void)stats;
+    (void)history;
+    (void)grid_left_local;
+    (void)grid_top_local;
+    (void)config;
+#endif
+}
+
+}  // namespace piano_roll
@@ -0,0 +1,447 @@
+#include "piano_roll/playback_scheduler.hpp"
+
+#include <algorithm>
+
+namespace piano_roll {
+
+void PlaybackSequence::build(const NoteManager& notes) {
+    clear();
+    revision_ = notes.revision();
+    notes_.reserve(notes.notes().size());
+    append_notes(notes, 0, 0);
+    finish_build();
+}
+
+void PlaybackSequence::build(const std::vector<BounceClip>& clips) {
+    clear();
+    std::size_t total = 0;
+    for (const BounceClip& clip : clips) {
+        if (clip.notes != nullptr) {
+            revision_ += clip.notes->revision();
+            total += clip.notes->notes().size();
+        }
+    }
+    notes_.reserve(total);
+    for (const BounceClip& clip : clips) {
+        if (clip.notes != nullptr) {
+            append_notes(*clip.notes, clip.tick_offset, clip.key_offset);
+        }
+    }
+    finish_build();
+}
+
+void PlaybackSequence::clear() {
+    revision_ = 0;
+    notes_.clear();
+    events_.clear();
+    nodes_.clear();
+    by_start_.clear();
+    by_end_.clear();
+}
+
+void PlaybackSequence::append_notes(const NoteManager& notes,
+                                    Tick tick_offset,
+                                    int key_offset) {
+    for (const Note& note : notes.notes()) {
+        const MidiKey key = note.key + key_offset;
+        if (!note.is_valid() || key < 0 || key > 127) {
+            continue;
+        }
+        notes_.push_back(PlaybackNote{note.tick + tick_offset,
+                                      note.end_tick() + tick_offset,
+                                      note.id,
+                                      key,
+                                      note.velocity,
+                                      note.channel});
+    }
+}
+
+void PlaybackSequence::finish_build() {
+    events_.reserve(notes_.size() * 2);
+    for (std::size_t i = 0; i < notes_.size(); ++i) {
+        const auto index = static_cast<std::uint32_t>(i);
+        events_.push_back(Event{notes_[i].start, index, true});
+        events_.push_back(Event{notes_[i].end, index, false});
+    }
+    std::sort(events_.begin(),
+              events_.end(),
+              [this](const Event& a, const Event& b) {
+                  if (a.tick != b.tick) {
+                      return a.tick < b.tick;
+                  }
+                  if (a.note_on != b.note_on) {
+                      return !a.note_on;
+                  }
+                  const PlaybackNote& na = notes_[a.note];
+                  const PlaybackNote& nb = notes_[b.note];
+                  if (na.channel != nb.channel) {
+                      return na.channel < nb.channel;
+                  }
+                  if (na.key != nb.key) {
+                      return na.key < nb.key;
+                  }
+                  return a.note < b.note;
+              });
+
+    std::vector<std::uint32_t> items(notes_.size());
+    for (std::size_t i = 0; i < items.size(); ++i) {
+        items[i] = static_cast<std::uint32_t>(i);
+    }
+    by_start_.reserve(items.size());
+    by_end_.reserve(items.size());
+    build_node(items);
+}
+
+std::int32_t PlaybackSequence::build_node(std::span<std::uint32_t> items) {
+    if (items.empty()) {
+        return -1;
+    }
+    // Centre on the median start: at most half of the notes start after it
+    // and at most half end at or before it, so the tree stays balanced.
+    const auto middle =
+        items.begin() + static_cast<std::ptrdiff_t>(items.size() / 2);
+    std::nth_element(items.begin(),
+                     middle,
+                     items.end(),
+                     [this](std::uint32_t a, std::uint32_t b) {
+                         return notes_[a].start < notes_[b].start;
+                     });
+    const Tick center = notes_[*middle].start;
+    const auto left_end =
+        std::partition(items.begin(), items.end(), [&](std::uint32_t i) {
+            return notes_[i].end <= center;
+        });
+    const auto containing_end =
+        std::partition(left_end, items.end(), [&](std::uint32_t i) {
+            return notes_[i].start <= center;
+        });
+
+    const auto index = static_cast<std::int32_t>(nodes_.size());
+    nodes_.push_back(Node{center,
+                          -1,
+                          -1,
+                          static_cast<std::uint32_t>(by_start_.size()),
+                          0});
+    by_start_.insert(by_start_.end(), left_end, containing_end);
+    by_end_.insert(by_end_.end(), left_end, containing_end);
+    std::sort(by_start_.begin() + nodes_.back().begin,
+              by_start_.end(),
+              [this](std::uint32_t a, std::uint32_t b) {
+                  return notes_[a].start < notes_[b].start;
+              });
+    std::sort(by_end_.begin() + nodes_.back().begin,
+              by_end_.end(),
+              [this](std::uint32_t a, std::uint32_t b) {
+                  return notes_[a].end > notes_[b].end;
+              });
+    nodes_.back().end = static_cast<std::uint32_t>(by_start_.size());
+
+    const std::int32_t left = build_node(
+        items.subspan(0, static_cast<std::size_t>(left_end - items.begin())));
+    const std::int32_t right = build_node(items.subspan(
+        static_cast<std::size_t>(containing_end - items.begin())));
+    nodes_[static_cast<std::size_t>(index)].left = left;
+    nodes_[static_cast<std::size_t>(index)].right = right;
+    return index;
+}
+
+std::size_t PlaybackSequence::first_event_at(Tick tick) const noexcept {
+    const auto it = std::lower_bound(
+        events_.begin(),
+        events_.end(),
+        tick,
+        [](const Event& event, Tick t) { return event.tick < t; });
+    return static_cast<std::size_t>(it - events_.begin());
+}
+
+std::size_t PlaybackSequence::memory_usage_bytes() const noexcept {
+    return notes_.capacity() * sizeof(PlaybackNote) +
+           events_.capacity() * sizeof(Event) +
+           nodes_.capacity() * sizeof(Node) +
+           (by_start_.capacity() + by_end_.capacity()) *
+               sizeof(std::uint32_t);
+}
+
+PlaybackScheduler::PlaybackScheduler(PlaybackSchedulerOptions options)
+    : options_(options),
+      incoming_(std::max<std::size_t>(options.max_pending_sequences, 1)),
+      retired_(std::max<std::size_t>(options.max_pending_sequences, 1) + 1) {
+    events_.resize(std::max<std::size_t>(options_.max_events, 2));
+}
+
+PlaybackScheduler::~PlaybackScheduler() {
+    collect_garbage();
+    PlaybackSequence* sequence = nullptr;
+    while (incoming_.pop(sequence)) {
+        delete sequence;
+    }
+    delete sequence_;
+}
+
+bool PlaybackScheduler::publish(std::unique_ptr<PlaybackSequence>& sequence) {
+    if (!sequence || !incoming_.push(sequence.get())) {
+        return false;
+    }
+    sequence.release();
+    return true;
+}
+
+void PlaybackScheduler::collect_garbage() {
+    PlaybackSequence* sequence = nullptr;
+    while (retired_.pop(sequence)) {
+        delete sequence;
+    }
+}
+
+void PlaybackScheduler::set_loop(bool enabled,
+                                 Tick start_tick,
+                                 Tick end_tick) noexcept {
+    loop_enabled_ = enabled;
+    loop_start_ = std::max<Tick>(start_tick, 0);
+    loop_end_ = end_tick;
+}
+
+void PlaybackScheduler::play(Tick tick) noexcept {
+    playing_ = true;
+    locate(tick);
+}
+
+void PlaybackScheduler::locate(Tick tick) noexcept {
+    position_ = std::max<Tick>(tick, 0);
+    needs_chase_ = true;
+}
+
+std::span<const PlaybackEvent> PlaybackScheduler::stop() noexcept {
+    event_count_ = 0;
+    release_all(position_, 0);
+    playing_ = false;
+    needs_chase_ = false;
+    return {events_.data(), event_count_};
+}
+
+std::span<const PlaybackEvent> PlaybackScheduler::render(Tick length) noexcept {
+    event_count_ = 0;
+    adopt_published_sequence();
+    if (!playing_) {
+        return {};
+    }
+    if (needs_chase_) {
+        release_all(position_, 0);
+        reposition(position_);
+        chase(position_, 0);
+        needs_chase_ = false;
+    }
+
+    Tick offset = 0;
+    Tick remaining = std::max<Tick>(length, 0);
+    while (remaining > 0) {
+        const bool looping = loop_enabled_ && loop_end_ > loop_start_ &&
+                             position_ < loop_end_;
+        Tick segment_end = position_ + remaining;
+        const bool wraps = looping && segment_end >= loop_end_;
+        if (wraps) {
+            segment_end = loop_end_;
+        }
+        emit_events_until(segment_end, position_ - offset);
+        remaining -= segment_end - position_;
+        offset += segment_end - position_;
+        if (wraps) {
+            release_all(loop_end_, offset);
+            reposition(loop_start_);
+            chase(loop_start_, offset);
+        } else {
+            position_ = segment_end;
+        }
+    }
+    return {events_.data(), event_count_};
+}
+
+void PlaybackScheduler::adopt_published_sequence() noexcept {
+    bool changed = false;
+    PlaybackSequence* next = nullptr;
+    // Only take a sequence when the replaced one can be handed back.
+    while (!retired_.full() && incoming_.pop(next)) {
+        if (sequence_ != nullptr) {
+            retired_.push(sequence_);
+        }
+        sequence_ = next;
+        changed = true;
+    }
+    if (!changed) {
+        return;
+    }
+    reposition(position_);
+    if (!playing_ || needs_chase_) {
+        return;
+    }
+
+    // Diff the sounding voices against the notes sounding in the new
+    // sequence: release voices it no longer has, start the ones it adds.
+    const Tick tick = position_;
+    sequence_->active_notes_at(tick, [&](const PlaybackNote& note) {
+        if (note.start < tick) {
+            ++target_count_[static_cast<std::size_t>(note.channel * 128 +
+                                                     note.key)];
+        }
+    });
+    for (std::size_t i = sounding_count_; i > 0; --i) {
+        const std::size_t slot = sounding_[i - 1];
+        if (target_count_[slot] != 0) {
+            voice_count_[slot] = target_count_[slot];
+            continue;
+        }
+        push(PlaybackEvent{0,
+                           tick,
+                           0,
+                           static_cast<MidiKey>(slot % 128),
+                           0,
+                           static_cast<Channel>(slot / 128),
+                           false});
+        voice_count_[slot] = 0;
+        remove_sounding(slot);
+    }
+    sequence_->active_notes_at(tick, [&](const PlaybackNote& note) {
+        const auto slot =
+            static_cast<std::size_t>(note.channel * 128 + note.key);
+        if (note.start >= tick || target_count_[slot] == 0) {
+            return;
+        }
+        if (voice_count_[slot] == 0) {
+            if (event_count_ + sounding_count_ + 2 > events_.size()) {
+                dropped_ += target_count_[slot];
+            } else {
+                push(PlaybackEvent{0,
+                                   tick,
+                                   note.id,
+                                   note.key,
+                                   note.velocity,
+                                   note.channel,
+                                   true});
+                voice_count_[slot] = target_count_[slot];
+                add_sounding(slot);
+            }
+        }
+        target_count_[slot] = 0;
+    });
+}
+
+void PlaybackScheduler::reposition(Tick tick) noexcept {
+    position_ = tick;
+    cursor_ = 0;
+    if (sequence_ == nullptr) {
+        return;
+    }
+    // Note-offs at `tick` end notes that were not chased; replaying them
+    // would cut a chased voice on the same key.
+    const auto events = sequence_->events();
+    cursor_ = sequence_->first_event_at(tick);
+    while (cursor_ < events.size() && events[cursor_].tick == tick &&
+           !events[cursor_].note_on) {
+        ++cursor_;
+    }
+}
+
+void PlaybackScheduler::emit_events_until(Tick end_tick,
+                                          Tick block_tick) noexcept {
+    if (sequence_ == nullptr) {
+        return;
+    }
+    const auto events = sequence_->events();
+    const auto notes = sequence_->notes();
+    for (; cursor_ < events.size() && events[cursor_].tick < end_tick;
+         ++cursor_) {
+        const PlaybackSequence::Event& event = events[cursor_];
+        const PlaybackNote& note = notes[event.note];
+        if (event.note_on) {
+            note_on(note, event.tick, event.tick - block_tick);
+        } else {
+            note_off(note, event.tick, event.tick - block_tick);
+        }
+    }
+}
+
+void PlaybackScheduler::note_on(const PlaybackNote& note,
+                                Tick tick,
+                                Tick offset) noexcept {
+    const auto slot = static_cast<std::size_t>(note.channel * 128 + note.key);
+    const std::uint16_t count = voice_count_[slot];
+    // Keep room for a note-off per sounding voice after this note-on.
+    const std::size_t needed = count != 0 ? 2 : 1;
+    const std::size_t voices = sounding_count_ + (count != 0 ? 0 : 1);
+    if (count == 0xffff || event_count_ + needed + voices > events_.size()) {
+        ++dropped_;
+        return;
+    }
+    if (count != 0) {
+        push(PlaybackEvent{
+            offset, tick, 0, note.key, 0, note.channel, false});
+    } else {
+        add_sounding(slot);
+    }
+    push(PlaybackEvent{
+        offset, tick, note.id, note.key, note.velocity, note.channel, true});
+    voice_count_[slot] = static_cast<std::uint16_t>(count + 1);
+}
+
+void PlaybackScheduler::note_off(const PlaybackNote& note,
+                                 Tick tick,
+                                 Tick offset) noexcept {
+    const auto slot = static_cast<std::size_t>(note.channel * 128 + note.key);
+    if (voice_count_[slot] == 0) {
+        return;
+    }
+    if (--voice_count_[slot] == 0) {
+        push(PlaybackEvent{
+            offset, tick, note.id, note.key, 0, note.channel, false});
+        remove_sounding(slot);
+    }
+}
+
+void PlaybackScheduler::release_all(Tick tick, Tick offset) noexcept {
+    for (std::size_t i = 0; i < sounding_count_; ++i) {
+        const std::size_t slot = sounding_[i];
+        push(PlaybackEvent{offset,
+                           tick,
+                           0,
+                           static_cast<MidiKey>(slot % 128),
+                           0,
+                           static_cast<Channel>(slot / 128),
+                           false});
+        voice_count_[slot] = 0;
+    }
+    sounding_count_ = 0;
+}
+
+void PlaybackScheduler::chase(Tick tick, Tick offset) noexcept {
+    if (sequence_ == nullptr) {
+        return;
+    }
+    // Notes starting exactly at `tick` are played from the event list.
+    sequence_->active_notes_at(tick, [&](const PlaybackNote& note) {
+        if (note.start < tick) {
+            note_on(note, tick, offset);
+        }
+    });
+}
+
+void PlaybackScheduler::push(const PlaybackEvent& event) noexcept {
+    if (event_count_ < events_.size()) {
+        events_[event_count_++] = event;
+    } else {
+        ++dropped_;
+    }
+}
+
+void PlaybackScheduler::add_sounding(std::size_t slot) noexcept {
+    sounding_pos_[slot] = static_cast<std::uint16_t>(sounding_count_);
+    sounding_[sounding_count_++] = static_cast<std::uint16_t>(slot);
+}
+
+void PlaybackScheduler::remove_sounding(std::size_t slot) noexcept {
+    const std::uint16_t pos = sounding_pos_[slot];
+    const std::uint16_t last = sounding_[--sounding_count_];
+    sounding_[pos] = last;
+    sounding_pos_[last] = pos;
+}
+
+}  // namespace piano_roll
@@ -1,6 +1,10 @@
 #include "piano_roll/renderer.hpp"
 
 #include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iterator>
+#include <string>
 
 #ifdef PIANO_ROLL_USE_IMGUI
 #include <imgui.h>
@@ -69,24 +73,57 @@ void PianoRollRenderer::render(const CoordinateSystem& coords,
 
     draw_list->ChannelsSplit(4);
 
+    // Each layer is timed individually for the performance HUD. Vertex
+    // counts are sampled per channel since each channel owns its own buffer
+    // until ChannelsMerge(). HUD timings measure real elapsed time, so they
+    // use the steady clock rather than the widget's injectable Clock.
+    using FrameClock = std::chrono::steady_clock;
+    auto elapsed_ms = [](FrameClock::time_point start) {
+        return std::chrono::duration<double, std::milli>(
+                   FrameClock::now() - start)
+            .count();
+    };
+    last_stats_ = RenderStats{};
+
     draw_list->ChannelsSetCurrent(kLayerBackground);
     if (draw_background) {
+        int vtx_before = draw_list->VtxBuffer.Size;
+        auto start = FrameClock::now();
         render_background_layer(draw_list, coords, vp, origin, notes);
+        last_stats_.background_ms = elapsed_ms(start);
+        last_stats_.vertices +=
+            static_cast<std::size_t>(draw_list->VtxBuffer.Size - vtx_before);
     }
 
     draw_list->ChannelsSetCurrent(kLayerNotes);
     if (draw_notes) {
-        render_notes_layer(draw_list, coords, vp, origin, notes);
+        int vtx_before = draw_list->VtxBuffer.Size;
+        auto start = FrameClock::now();
+        last_stats_.visible_notes =
+            render_notes_layer(draw_list, coords, vp, origin, notes);
+        last_stats_.notes_ms = elapsed_ms(start);
+        last_stats_.vertices +=
+            static_cast<std::size_t>(draw_list->VtxBuffer.Size - vtx_before);
     }
 
     draw_list->ChannelsSetCurrent(kLayerRuler);
     if (draw_ruler) {
+        int vtx_before = draw_list->VtxBuffer.Size;
+        auto start = FrameClock::now();
         render_ruler_layer(draw_list, coords, vp, origin);
+        last_stats_.ruler_ms = elapsed_ms(start);
+        last_stats_.vertices +=
+            static_cast<std::size_t>(draw_list->VtxBuffer.Size - vtx_before);
     }
 
     draw_list->ChannelsSetCurrent(kLayerPlayhead);
     if (draw_playhead) {
+        int vtx_before = draw_list->VtxBuffer.Size;
+        auto start = FrameClock::now();
         render_playhead_layer(draw_list, coords, vp, origin);
+        last_stats_.playhead_ms = elapsed_ms(start);
+        last_stats_.vertices +=
+            static_cast<std::size_t>(draw_list->VtxBuffer.Size - vtx_before);
     }
 
     draw_list->ChannelsMerge();
@@ -128,6 +165,15 @@ void PianoRollRenderer::render_background_layer(
     float keys_right =
         origin.x + static_cast<float>(coords.piano_key_width());
 
+    // Scale of the visible time range, from the harmony track's cached
+    // per-beat histograms.
+    KeyEstimate scale;
+    if (harmony_ != nullptr && config_.show_scale_highlight) {
+        auto [start_tick, end_tick] = coords.visible_tick_range();
+        scale = estimate_key(harmony_->profile(start_tick, end_tick));
+    }
+    const std::uint16_t scale_mask = scale.scale_mask();
+
     auto key_range = coords.visible_key_range();
     MidiKey min_key = key_range.first;
     MidiKey max_key = key_range.second;
@@ -163,6 +209,15 @@ void PianoRollRenderer::render_background_layer(
             ImVec2(keys_right, y2),
             to_color(is_black ? config_.black_key_color
                               : config_.white_key_color));
+
+        if ((scale_mask >> (key % 12)) & 1u) {
+            draw_list->AddRectFilled(
+                ImVec2(keys_right - 4.0f, y1 + 1.0f),
+                ImVec2(keys_right - 1.0f, y2 - 1.0f),
+                to_color(key % 12 == scale.tonic
+                             ? config_.scale_tonic_highlight_color
+                             : config_.scale_highlight_color));
+        }
     }
 
     // Key row zebra stripes in grid area.
@@ -214,26 +269,18 @@ void PianoRollRenderer::render_background_layer(
             to_color(is_black ? row_dark : row_light));
     }
 
-    // Spotlight band behind selected notes.
-    const auto& all_notes = notes.notes();
-    double min_x_world = 0.0;
-    double max_x_world = 0.0;
-    bool have_selection = false;
-    for (const Note& n : all_notes) {
-        if (!n.selected) {
-            continue;
-        }
-        double x1w = coords.tick_to_world(n.tick);
-        double x2w = coords.tick_to_world(n.end_tick());
-        if (!have_selection) {
-            min_x_world = x1w;
-            max_x_world = x2w;
-            have_selection = true;
-        } else {
-            min_x_world = std::min(min_x_world, x1w);
-            max_x_world = std::max(max_x_world, x2w);
-        }
-    }
+    // Spotlight band behind selected notes, from the manager's cached
+    // selection bounds (no per-frame scan of the notes).
+    Tick selection_start = 0;
+    Tick selection_end = 0;
+    MidiKey selection_low_key = 0;
+    MidiKey selection_high_key = 0;
+    const bool have_selection = notes.selection_bounds(selection_start,
+                                                       selection_end,
+                                                       selection_low_key,
+                                                       selection_high_key);
+    const double min_x_world = coords.tick_to_world(selection_start);
+    const double max_x_world = coords.tick_to_world(selection_end);
     if (have_selection && max_x_world > min_x_world) {
         auto [sx1_local, sy1_local] =
             coords.world_to_screen(min_x_world, 0.0);
@@ -272,185 +319,586 @@ void PianoRollRenderer::render_background_layer(
     }
 }
 
-void PianoRollRenderer::render_notes_layer(
+namespace {
+
+// Width of one note tile in screen pixels at the zoom it was built for.
+constexpr double kNoteTilePixels = 512.0;
+
+// Note shadows reach this far past the note's right edge.
+constexpr double kNoteShadowPixels = 2.0;
+
+// Vertices per cached chunk; keeps chunk-relative indices within 16 bits.
+constexpr int kNoteTileChunkVertices = 16384;
+
+// Cached vertices kept across frames before far-away tiles are evicted.
+constexpr std::size_t kNoteTileVertexBudget = std::size_t{1} << 22;
+
+std::int64_t floor_div(Tick value, Tick divisor) noexcept {
+    std::int64_t q = value / divisor;
+    return (value % divisor != 0 && value < 0) ? q - 1 : q;
+}
+
+}  // namespace
+
+std::size_t PianoRollRenderer::render_notes_layer(
     ImDrawList* draw_list,
     const CoordinateSystem& coords,
     const Viewport& vp,
     const ImVec2& origin,
-    const NoteManager& notes) const {
-    auto to_imvec4 = [](const ColorRGBA& c) {
-        return ImVec4(c.r, c.g, c.b, c.a);
-    };
-    auto to_color = [&](const ColorRGBA& c) {
-        return ImGui::ColorConvertFloat4ToU32(to_imvec4(c));
-    };
-
+    const NoteManager& notes) {
     float left_limit = origin.x +
                        static_cast<float>(coords.piano_key_width());
     float right_limit = origin.x +
                         static_cast<float>(coords.piano_key_width() +
                                            vp.width);
+    const float top_limit = origin.y;
+    const float bottom_limit = origin.y + static_cast<float>(vp.height);
+
+    sync_note_tiles(coords, notes);
+    render_clip_loop_ghosts(draw_list,
+                            coords,
+                            origin,
+                            ImVec2(left_limit, top_limit),
+                            ImVec2(right_limit, bottom_limit),
+                            notes);
+    std::size_t visible_count =
+        render_pattern_instances(draw_list,
+                                 coords,
+                                 origin,
+                                 ImVec2(left_limit, top_limit),
+                                 ImVec2(right_limit, bottom_limit));
+
+    auto [visible_start, visible_end] = coords.visible_tick_range();
+    auto [min_key, max_key] = coords.visible_key_range();
+    const std::int64_t first_tile = floor_div(visible_start, note_tile_ticks_);
+    const std::int64_t last_tile = floor_div(visible_end, note_tile_ticks_);
+
+    // Re-emit each visible tile, translated from its world-space origin to
+    // the screen and clipped to its own span so notes crossing tile
+    // boundaries (present in every tile they touch) are drawn once.
+    for (std::int64_t index = first_tile; index <= last_tile; ++index) {
+        auto it = note_tiles_.find(index);
+        if (it == note_tiles_.end()) {
+            it = note_tiles_.emplace(index, NoteTile{}).first;
+            build_note_tile(it->second, index, coords, notes);
+            note_tile_vertices_ += it->second.vertices.size();
+            ++last_stats_.note_tiles_built;
+        }
+        const NoteTile& tile = it->second;
+
+        const Tick tile_start = index * note_tile_ticks_;
+        auto [tile_x, tile_y] =
+            coords.world_to_screen(coords.tick_to_world(tile_start), 0.0);
+        auto [tile_x_end, unused_y] = coords.world_to_screen(
+            coords.tick_to_world(tile_start + note_tile_ticks_), 0.0);
+        (void)unused_y;
+        const float dx = origin.x + static_cast<float>(tile_x);
+        const float dy = origin.y + static_cast<float>(tile_y);
+        ImVec2 clip_min(std::max(dx, left_limit), top_limit);
+        ImVec2 clip_max(
+            std::min(origin.x + static_cast<float>(tile_x_end), right_limit),
+            bottom_limit);
+        for (MidiKey key = std::max<MidiKey>(min_key, 0);
+             key <= std::min<MidiKey>(max_key, 127);
+             ++key) {
+            visible_count += tile.key_counts[static_cast<std::size_t>(key)];
+        }
+        if (clip_max.x <= clip_min.x || tile.chunks.empty()) {
+            continue;
+        }
 
-    auto draw_single_note = [&](const Note& note) {
-        double world_x1 = coords.tick_to_world(note.tick);
-        double world_x2 = coords.tick_to_world(note.end_tick());
-        double world_y = coords.key_to_world_y(note.key);
-        double world_y2 = world_y + coords.key_height();
-
-        auto [screen_x1_local, screen_y1_local] =
-            coords.world_to_screen(world_x1, world_y);
-        auto [screen_x2_local, screen_y2_local] =
-            coords.world_to_screen(world_x2, world_y2);
-
-        float x1 = origin.x + static_cast<float>(screen_x1_local);
-        float x2 = origin.x + static_cast<float>(screen_x2_local);
-        float y1 = origin.y + static_cast<float>(screen_y1_local);
-        float y2 = origin.y + static_cast<float>(screen_y2_local);
-
-        x1 = std::max(x1, left_limit);
-        x2 = std::min(x2, right_limit);
-        if (x2 <= x1) {
+        draw_list->PushClipRect(clip_min, clip_max, true);
+        std::uint32_t vtx_begin = 0;
+        std::uint32_t idx_begin = 0;
+        for (const auto& [vtx_end, idx_end] : tile.chunks) {
+            const int vtx_count = static_cast<int>(vtx_end - vtx_begin);
+            const int idx_count = static_cast<int>(idx_end - idx_begin);
+            draw_list->PrimReserve(idx_count, vtx_count);
+            ImDrawVert* vtx_out = draw_list->_VtxWritePtr;
+            for (std::uint32_t v = vtx_begin; v < vtx_end; ++v) {
+                ImDrawVert vert = tile.vertices[v];
+                vert.pos.x += dx;
+                vert.pos.y += dy;
+                *vtx_out++ = vert;
+            }
+            ImDrawIdx* idx_out = draw_list->_IdxWritePtr;
+            const auto base = static_cast<ImDrawIdx>(draw_list->_VtxCurrentIdx);
+            for (std::uint32_t i = idx_begin; i < idx_end; ++i) {
+                *idx_out++ = static_cast<ImDrawIdx>(base + tile.indices[i]);
+            }
+            draw_list->_VtxWritePtr = vtx_out;
+            draw_list->_IdxWritePtr = idx_out;
+            draw_list->_VtxCurrentIdx += static_cast<unsigned int>(vtx_count);
+            vtx_begin = vtx_end;
+            idx_begin = idx_end;
+        }
+        draw_list->PopClipRect();
+        ++last_stats_.note_tiles_drawn;
+    }
+    evict_note_tiles(first_tile, last_tile);
+
+    // Expression curves and note names depend on the exact on-screen note
+    // width, so they are drawn live, for visible notes only, and only at
+    // zoom levels where they show.
+    const bool show_expression =
+        config_.show_note_expression &&
+        coords.key_height() >= config_.note_expression_min_key_height;
+    const bool show_labels = coords.key_height() >= 16.0;
+    if (!show_expression && !show_labels) {
+        return visible_count;
+    }
+
+    ImFont* font = ImGui::GetFont();
+    float font_size = font ? font->FontSize : ImGui::GetFontSize();
+    auto note_name = [](MidiKey key) {
+        static const char* names[12] = {
+            "C", "C#", "D", "D#",
+            "E", "F",  "F#", "G",
+            "G#", "A", "A#", "B"};
+        int idx = key % 12;
+        int octave = key / 12 - 2;
+        std::string s = names[idx];
+        s += std::to_string(octave);
+        return s;
+    };
+    ImU32 label_col = ImGui::ColorConvertFloat4ToU32(
+        ImVec4(config_.note_label_text_color.r,
+               config_.note_label_text_color.g,
+               config_.note_label_text_color.b,
+               config_.note_label_text_color.a));
+
+    for (const Note& note : notes.notes_in_range_view(
+             visible_start, visible_end + 1, min_key, max_key)) {
+        auto [sx1_local, sy1_local] = coords.world_to_screen(
+            coords.tick_to_world(note.tick), coords.key_to_world_y(note.key));
+        auto [sx2_local, sy2_local] = coords.world_to_screen(
+            coords.tick_to_world(note.end_tick()),
+            coords.key_to_world_y(note.key) + coords.key_height());
+        const float note_x1 = origin.x + static_cast<float>(sx1_local);
+        const float note_x2 = origin.x + static_cast<float>(sx2_local);
+        const float y1 = origin.y + static_cast<float>(sy1_local);
+        const float y2 = origin.y + static_cast<float>(sy2_local);
+        const float x1 = std::max(note_x1, left_limit);
+        const float x2 = std::min(note_x2, right_limit);
+        if (x2 <= x1 || y2 <= top_limit || y1 >= bottom_limit) {
+            continue;
+        }
+
+        if (show_expression && !note.expression.empty() &&
+            x2 - x1 >= config_.note_expression_min_width) {
+            render_note_expression(draw_list,
+                                   note,
+                                   notes.note_expression(note),
+                                   note_x1,
+                                   note_x2,
+                                   ImVec2(x1, y1),
+                                   ImVec2(x2, y2));
+        }
+
+        if (show_labels && x2 - x1 >= 30.0f) {
+            std::string label = note_name(note.key);
+            draw_list->AddText(font,
+                               font_size,
+                               ImVec2(note_x1 + 4.0f,
+                                      y1 + (y2 - y1 - font_size) * 0.5f),
+                               label_col,
+                               label.c_str());
+        }
+    }
+
+    return visible_count;
+}
+
+void PianoRollRenderer::render_clip_loop_ghosts(
+    ImDrawList* draw_list,
+    const CoordinateSystem& coords,
+    const ImVec2& origin,
+    const ImVec2& clip_min,
+    const ImVec2& clip_max,
+    const NoteManager& notes) const {
+    auto [visible_start, visible_end] = coords.visible_tick_range();
+    int first = 0;
+    int last = 0;
+    if (!clip_loop_.repetitions_in(
+            visible_start, visible_end + 1, first, last)) {
+        return;
+    }
+    auto [min_key, max_key] = coords.visible_key_range();
+
+    auto ghost_color = [&](const ColorRGBA& c) {
+        return ImGui::ColorConvertFloat4ToU32(
+            ImVec4(c.r, c.g, c.b, c.a * config_.clip_loop_ghost_alpha));
+    };
+    const ImU32 fill_col = ghost_color(config_.note_fill_color);
+    const ImU32 border_col = ghost_color(config_.note_border_color);
+    auto screen_x = [&](Tick tick) {
+        auto [sx, sy] = coords.world_to_screen(coords.tick_to_world(tick), 0.0);
+        (void)sy;
+        return origin.x + static_cast<float>(sx);
+    };
+
+    const Tick length = clip_loop_.length();
+    for (int repetition = first; repetition <= last; ++repetition) {
+        const Tick rep_start = clip_loop_.repetition_start(repetition);
+        const Tick rep_end = rep_start + length;
+        const Tick offset = static_cast<Tick>(repetition) * length;
+
+        // Notes crossing the clip end are cut at the repetition boundary,
+        // like the clip's own content.
+        ImVec2 rep_min(std::max(screen_x(rep_start), clip_min.x), clip_min.y);
+        ImVec2 rep_max(std::min(screen_x(rep_end), clip_max.x), clip_max.y);
+        if (rep_max.x <= rep_min.x) {
+            continue;
+        }
+        draw_list->PushClipRect(rep_min, rep_max, true);
+        for (const Note& note : notes.notes_in_range_view(
+                 std::max(visible_start, rep_start) - offset,
+                 std::min(visible_end + 1, rep_end) - offset,
+                 min_key,
+                 max_key)) {
+            auto [sx, sy1] = coords.world_to_screen(
+                0.0, coords.key_to_world_y(note.key));
+            (void)sx;
+            const float y1 = origin.y + static_cast<float>(sy1);
+            ImVec2 min(screen_x(note.tick + offset), y1);
+            ImVec2 max(screen_x(note.end_tick() + offset),
+                       y1 + static_cast<float>(coords.key_height()));
+            draw_list->AddRectFilled(
+                min, max, fill_col, config_.note_corner_radius);
+            draw_list->AddRect(min,
+                               max,
+                               border_col,
+                               config_.note_corner_radius,
+                               0,
+                               config_.note_border_thickness);
+        }
+        draw_list->PopClipRect();
+    }
+}
+
+std::size_t PianoRollRenderer::render_pattern_instances(
+    ImDrawList* draw_list,
+    const CoordinateSystem& coords,
+    const ImVec2& origin,
+    const ImVec2& clip_min,
+    const ImVec2& clip_max) const {
+    if (patterns_ == nullptr || patterns_->instances().empty()) {
+        return 0;
+    }
+    auto [visible_start, visible_end] = coords.visible_tick_range();
+    auto [min_key, max_key] = coords.visible_key_range();
+
+    auto to_color = [](const ColorRGBA& c) {
+        return ImGui::ColorConvertFloat4ToU32(ImVec4(c.r, c.g, c.b, c.a));
+    };
+    const ImU32 region_col = to_color(config_.pattern_instance_region_color);
+    const ImU32 fill_col = to_color(config_.pattern_note_fill_color);
+    const ImU32 border_col = to_color(config_.pattern_note_border_color);
+    auto screen_x = [&](Tick tick) {
+        auto [sx, sy] = coords.world_to_screen(coords.tick_to_world(tick), 0.0);
+        (void)sy;
+        return origin.x + static_cast<float>(sx);
+    };
+
+    draw_list->PushClipRect(clip_min, clip_max, true);
+    for (const PatternInstance& instance : patterns_->instances()) {
+        if (instance.tick_offset > visible_end) {
+            break;
+        }
+        const Pattern* pattern = patterns_->find_pattern(instance.pattern);
+        if (pattern == nullptr ||
+            instance.tick_offset + pattern->length <= visible_start) {
+            continue;
+        }
+        draw_list->AddRectFilled(
+            ImVec2(screen_x(instance.tick_offset), clip_min.y),
+            ImVec2(screen_x(instance.tick_offset + pattern->length),
+                   clip_max.y),
+            region_col);
+    }
+
+    std::size_t visible = 0;
+    patterns_->for_each_in_range(
+        visible_start, visible_end + 1, min_key, max_key,
+        [&](const InstanceNote& hit) {
+            auto [sx, sy1] =
+                coords.world_to_screen(0.0, coords.key_to_world_y(hit.key));
+            (void)sx;
+            const float y1 = origin.y + static_cast<float>(sy1);
+            ImVec2 min(screen_x(hit.tick), y1);
+            ImVec2 max(screen_x(hit.end_tick()),
+                       y1 + static_cast<float>(coords.key_height()));
+            draw_list->AddRectFilled(
+                min, max, fill_col, config_.note_corner_radius);
+            draw_list->AddRect(min,
+                               max,
+                               border_col,
+                               config_.note_corner_radius,
+                               0,
+                               config_.note_border_thickness);
+            ++visible;
+        });
+    draw_list->PopClipRect();
+    return visible;
+}
+
+void PianoRollRenderer::sync_note_tiles(const CoordinateSystem& coords,
+                                        const NoteManager& notes) {
+    auto to_color = [](const ColorRGBA& c) {
+        return ImGui::ColorConvertFloat4ToU32(ImVec4(c.r, c.g, c.b, c.a));
+    };
+    const ImVec2 white_uv = ImGui::GetFontTexUvWhitePixel();
+    NoteTileKey key;
+    key.pixels_per_beat = coords.pixels_per_beat();
+    key.ticks_per_beat = coords.ticks_per_beat();
+    key.key_height = coords.key_height();
+    key.total_keys = coords.total_keys();
+    key.white_u = white_uv.x;
+    key.white_v = white_uv.y;
+    key.corner_radius = config_.note_corner_radius;
+    key.border_thickness = config_.note_border_thickness;
+    key.colors = {to_color(config_.note_fill_color),
+                  to_color(config_.selected_note_fill_color),
+                  to_color(config_.note_border_color),
+                  to_color(config_.selected_note_border_color),
+                  to_color(config_.selected_note_inner_border_color)};
+
+    const double ticks_per_pixel =
+        static_cast<double>(key.ticks_per_beat) / key.pixels_per_beat;
+    const Tick shadow_ticks =
+        static_cast<Tick>(std::ceil(kNoteShadowPixels * ticks_per_pixel));
+
+    bool reset = !(key == note_tile_key_) || &notes != note_tiles_source_;
+    if (!reset && notes.revision() != note_tiles_revision_) {
+        dirty_scratch_.clear();
+        if (notes.dirty_ranges_since(note_tiles_revision_, dirty_scratch_)) {
+            // A note is cached in every tile its body or shadow touches.
+            for (const DirtyRange& range : dirty_scratch_) {
+                auto first = note_tiles_.lower_bound(
+                    floor_div(range.start, note_tile_ticks_));
+                auto last = note_tiles_.upper_bound(floor_div(
+                    range.end + shadow_ticks, note_tile_ticks_));
+                for (auto it = first; it != last; ++it) {
+                    note_tile_vertices_ -= it->second.vertices.size();
+                }
+                note_tiles_.erase(first, last);
+            }
+        } else {
+            reset = true;
+        }
+    }
+    if (reset) {
+        note_tiles_.clear();
+        note_tile_vertices_ = 0;
+        note_tile_key_ = key;
+        note_tiles_source_ = &notes;
+        note_tile_ticks_ = std::max<Tick>(
+            1, static_cast<Tick>(std::ceil(kNoteTilePixels * ticks_per_pixel)));
+    }
+    note_tiles_revision_ = notes.revision();
+}
+
+void PianoRollRenderer::build_note_tile(NoteTile& tile,
+                                        std::int64_t tile_index,
+                                        const CoordinateSystem& coords,
+                                        const NoteManager& notes) {
+    const Tick tile_start = tile_index * note_tile_ticks_;
+    const Tick tile_end = tile_start + note_tile_ticks_;
+    const double tile_world_x = coords.tick_to_world(tile_start);
+    const double ticks_per_pixel =
+        static_cast<double>(coords.ticks_per_beat()) / coords.pixels_per_beat();
+    const Tick shadow_ticks =
+        static_cast<Tick>(std::ceil(kNoteShadowPixels * ticks_per_pixel));
+
+    // Geometry is generated by a scratch draw list so it matches ImGui's own
+    // primitives exactly; its commands are discarded and only the vertices
+    // and indices are kept. Lines are tessellated without the font atlas so
+    // cached UVs only depend on the white pixel (part of the tile key).
+    ImDrawList builder(ImGui::GetDrawListSharedData());
+    auto reset_builder = [&builder]() {
+        builder._ResetForNewFrame();
+        builder.Flags &= ~ImDrawListFlags_AntiAliasedLinesUseTex;
+        builder.PushClipRectFullScreen();
+    };
+    auto flush_chunk = [&]() {
+        if (builder.VtxBuffer.Size == 0) {
             return;
         }
+        tile.vertices.insert(tile.vertices.end(),
+                             builder.VtxBuffer.begin(),
+                             builder.VtxBuffer.end());
+        tile.indices.insert(tile.indices.end(),
+                            builder.IdxBuffer.begin(),
+                            builder.IdxBuffer.end());
+        tile.chunks.emplace_back(
+            static_cast<std::uint32_t>(tile.vertices.size()),
+            static_cast<std::uint32_t>(tile.indices.size()));
+        reset_builder();
+    };
+    reset_builder();
 
-        ImVec2 min{x1, y1};
-        ImVec2 max{x2, y2};
+    const ImU32 fill_col = note_tile_key_.colors[0];
+    const ImU32 selected_fill_col = note_tile_key_.colors[1];
+    const ImU32 border_col = note_tile_key_.colors[2];
+    const ImU32 selected_border_col = note_tile_key_.colors[3];
+    const ImU32 inner_border_col = note_tile_key_.colors[4];
+    const ImU32 shadow_fill =
+        ImGui::GetColorU32(ImVec4(0.0f, 0.0f, 0.0f, 0.12f));
 
-        const bool selected = note.selected;
-        const ColorRGBA& fill =
-            selected ? config_.selected_note_fill_color
-                     : config_.note_fill_color;
-        const ColorRGBA& border =
-            selected ? config_.selected_note_border_color
-                     : config_.note_border_color;
+    auto draw_single_note = [&](const Note& note) {
+        ImVec2 min(static_cast<float>(coords.tick_to_world(note.tick) -
+                                      tile_world_x),
+                   static_cast<float>(coords.key_to_world_y(note.key)));
+        ImVec2 max(static_cast<float>(coords.tick_to_world(note.end_tick()) -
+                                      tile_world_x),
+                   min.y + static_cast<float>(coords.key_height()));
+        if (max.x <= min.x) {
+            return;
+        }
 
+        const bool selected = note.selected;
         if (!selected) {
             float shadow_offset = 1.0f;
-            ImVec2 smin(min.x + shadow_offset,
-                        min.y + shadow_offset);
-            ImVec2 smax(max.x + shadow_offset,
-                        max.y + shadow_offset);
-            ImU32 shadow_fill =
-                ImGui::GetColorU32(
-                    ImVec4(0.0f, 0.0f, 0.0f, 0.12f));
-            draw_list->AddRectFilled(smin,
-                                     smax,
-                                     shadow_fill,
-                                     config_.note_corner_radius);
+            builder.AddRectFilled(
+                ImVec2(min.x + shadow_offset, min.y + shadow_offset),
+                ImVec2(max.x + shadow_offset, max.y + shadow_offset),
+                shadow_fill,
+                config_.note_corner_radius);
         }
-
-        draw_list->AddRectFilled(min, max,
-                                 to_color(fill),
-                                 config_.note_corner_radius);
-        draw_list->AddRect(min, max,
-                           to_color(border),
-                           config_.note_corner_radius,
-                           0,
-                           config_.note_border_thickness);
-
+        builder.AddRectFilled(min,
+                              max,
+                              selected ? selected_fill_col : fill_col,
+                              config_.note_corner_radius);
+        builder.AddRect(min,
+                        max,
+                        selected ? selected_border_col : border_col,
+                        config_.note_corner_radius,
+                        0,
+                        config_.note_border_thickness);
         if (selected) {
             float inset = 2.0f;
-            ImVec2 inner_min(min.x + inset, min.y + inset);
-            ImVec2 inner_max(max.x - inset, max.y - inset);
-            draw_list->AddRect(
-                inner_min,
-                inner_max,
-                to_color(
-                    config_.selected_note_inner_border_color),
-                config_.note_corner_radius,
-                0,
-                1.0f);
+            builder.AddRect(ImVec2(min.x + inset, min.y + inset),
+                            ImVec2(max.x - inset, max.y - inset),
+                            inner_border_col,
+                            config_.note_corner_radius,
+                            0,
+                            1.0f);
+        }
+        if (builder.VtxBuffer.Size >= kNoteTileChunkVertices) {
+            flush_chunk();
         }
     };
 
+    // Notes ending just before the tile still cast their shadow into it.
     // Draw non-selected notes first, then selected notes so that selected
-    // notes (and their borders) appear on top of overlapping unselected notes.
-    for (const Note& note : notes.notes()) {
-        if (!note.selected) {
-            draw_single_note(note);
-        }
-    }
-    for (const Note& note : notes.notes()) {
-        if (note.selected) {
-            draw_single_note(note);
+    // notes (and their borders) appear on top of overlapping unselected
+    // notes; the two passes walk the index directly instead of collecting
+    // the tile's notes into a temporary list.
+    const Tick shadow_start = tile_start - shadow_ticks;
+    notes.for_each_in_range(
+        shadow_start, tile_end, 0, 127, [&](const Note& note) {
+            if (note.tick >= tile_start && note.key >= 0 && note.key < 128) {
+                ++tile.key_counts[static_cast<std::size_t>(note.key)];
+            }
+            if (!note.selected) {
+                draw_single_note(note);
+            }
+        });
+    notes.for_each_in_range(
+        shadow_start, tile_end, 0, 127, [&](const Note& note) {
+            if (note.selected) {
+                draw_single_note(note);
+            }
+        });
+    flush_chunk();
+}
+
+void PianoRollRenderer::evict_note_tiles(std::int64_t first_visible,
+                                         std::int64_t last_visible) {
+    // Drop the tiles farthest from the view until the cache fits its budget.
+    while (note_tile_vertices_ > kNoteTileVertexBudget && !note_tiles_.empty()) {
+        auto front = note_tiles_.begin();
+        auto back = std::prev(note_tiles_.end());
+        const std::int64_t front_distance = first_visible - front->first;
+        const std::int64_t back_distance = back->first - last_visible;
+        if (front_distance <= 0 && back_distance <= 0) {
+            break;  // only visible tiles left
         }
+        auto victim = front_distance >= back_distance ? front : back;
+        note_tile_vertices_ -= victim->second.vertices.size();
+        note_tiles_.erase(victim);
     }
+}
 
-    if (coords.key_height() >= 16.0) {
-        ImFont* font = ImGui::GetFont();
-        float font_size =
-            font ? font->FontSize : ImGui::GetFontSize();
-        auto note_name = [](MidiKey key) {
-            static const char* names[12] = {
-                "C", "C#", "D", "D#",
-                "E", "F",  "F#", "G",
-                "G#", "A", "A#", "B"};
-            int idx = key % 12;
-            int octave = key / 12 - 2;
-            std::string s = names[idx];
-            s += std::to_string(octave);
-            return s;
-        };
+void PianoRollRenderer::render_note_expression(
+    ImDrawList* draw_list,
+    const Note& note,
+    std::span<const ExpressionPoint> points,
+    float note_x1,
+    float note_x2,
+    const ImVec2& clip_min,
+    const ImVec2& clip_max) const {
+    auto to_imvec4 = [](const ColorRGBA& c) {
+        return ImVec4(c.r, c.g, c.b, c.a);
+    };
+    auto to_color = [&](const ColorRGBA& c) {
+        return ImGui::ColorConvertFloat4ToU32(to_imvec4(c));
+    };
 
-        for (const Note& note : notes.notes()) {
-            double world_x1 = coords.tick_to_world(note.tick);
-            double world_x2 =
-                coords.tick_to_world(note.end_tick());
-            double world_y = coords.key_to_world_y(note.key);
-            double world_y2 = world_y + coords.key_height();
-
-            auto [sx1_local, sy1_local] =
-                coords.world_to_screen(world_x1, world_y);
-            auto [sx2_local, sy2_local] =
-                coords.world_to_screen(world_x2, world_y2);
-
-            float x1 = origin.x +
-                       static_cast<float>(sx1_local);
-            float x2 = origin.x +
-                       static_cast<float>(sx2_local);
-            float y1 = origin.y +
-                       static_cast<float>(sy1_local);
-            float y2 = origin.y +
-                       static_cast<float>(sy2_local);
-
-            float left_limit = origin.x +
-                               static_cast<float>(
-                                   coords.piano_key_width());
-            float right_limit =
-                origin.x +
-                static_cast<float>(coords.piano_key_width() +
-                                   vp.width);
-            if (x2 <= left_limit || x1 >= right_limit) {
-                continue;
-            }
-            if (x1 < left_limit) x1 = left_limit;
-            if (x2 > right_limit) x2 = right_limit;
+    const float inset = 2.0f;
+    const float top = clip_min.y + inset;
+    const float bottom = clip_max.y - inset;
+    if (bottom <= top || note.duration <= 0) {
+        return;
+    }
+    const float px_per_tick =
+        (note_x2 - note_x1) / static_cast<float>(note.duration);
+    const float mid = 0.5f * (top + bottom);
+    const float half = 0.5f * (bottom - top);
+
+    draw_list->PushClipRect(clip_min, clip_max, true);
+
+    // Points are sorted by dimension, so each curve is a contiguous run.
+    std::size_t begin = 0;
+    while (begin < points.size()) {
+        ExpressionDimension dimension = points[begin].dimension;
+        std::size_t end = begin;
+        while (end < points.size() && points[end].dimension == dimension) {
+            ++end;
+        }
 
-            float width = x2 - x1;
-            if (width < 30.0f) {
-                continue;
+        auto value_to_y = [&](float v) {
+            if (dimension == ExpressionDimension::PitchBend) {
+                v = std::clamp(v, -1.0f, 1.0f);
+                return mid - v * half;
             }
-
-            std::string label = note_name(note.key);
-            float text_x =
-                origin.x + static_cast<float>(sx1_local) +
-                4.0f;
-            float text_y =
-                y1 + (y2 - y1 - font_size) * 0.5f;
-
-            ImU32 col = ImGui::ColorConvertFloat4ToU32(
-                ImVec4(config_.note_label_text_color.r,
-                       config_.note_label_text_color.g,
-                       config_.note_label_text_color.b,
-                       config_.note_label_text_color.a));
-            draw_list->AddText(
-                font,
-                font_size,
-                ImVec2(text_x, text_y),
-                col,
-                label.c_str());
+            v = std::clamp(v, 0.0f, 1.0f);
+            return bottom - v * (bottom - top);
+        };
+        const ColorRGBA& color =
+            dimension == ExpressionDimension::PitchBend
+                ? config_.note_expression_pitch_color
+            : dimension == ExpressionDimension::Pressure
+                ? config_.note_expression_pressure_color
+                : config_.note_expression_timbre_color;
+        ImU32 col = to_color(color);
+
+        // Hold the first and last values to the note edges.
+        ImVec2 prev(note_x1, value_to_y(points[begin].value));
+        for (std::size_t i = begin; i < end; ++i) {
+            ImVec2 cur(note_x1 + px_per_tick *
+                                     static_cast<float>(points[i].tick_offset),
+                       value_to_y(points[i].value));
+            cur.x = std::min(cur.x, note_x2);
+            draw_list->AddLine(prev, cur, col, 1.0f);
+            prev = cur;
         }
+        draw_list->AddLine(prev, ImVec2(note_x2, prev.y), col, 1.0f);
+
+        begin = end;
     }
+
+    draw_list->PopClipRect();
 }
 
 void PianoRollRenderer::render_ruler_layer(
@@ -571,6 +1019,52 @@ void PianoRollRenderer::render_ruler_layer(
             to_color(config_.ruler_text_color),
             label.text.c_str());
     }
+
+    // Chord symbols under the ruler, one per run of beats with the same
+    // chord. A run that began left of the view keeps its label pinned to
+    // the left edge; labels that would overlap the previous one are skipped.
+    const Tick beat_ticks =
+        harmony_ != nullptr ? harmony_->ticks_per_beat() : 0;
+    if (beat_ticks > 0 && config_.show_chord_labels) {
+        ImVec2 row_min{ruler_min.x, ruler_max.y};
+        ImVec2 row_max{ruler_max.x, ruler_max.y + config_.chord_row_height};
+        draw_list->AddRectFilled(
+            row_min, row_max, to_color(config_.chord_row_background_color));
+        draw_list->PushClipRect(row_min, row_max, true);
+
+        const auto beats = harmony_->beats();
+        const auto first =
+            static_cast<std::size_t>(std::max<Tick>(start_tick, 0) / beat_ticks);
+        const auto last = std::min(
+            beats.size(),
+            static_cast<std::size_t>(
+                std::max<Tick>(end_tick + beat_ticks - 1, 0) / beat_ticks));
+        const ImU32 chord_color = to_color(config_.chord_label_color);
+        const float text_y =
+            row_min.y +
+            std::max(0.0f, (config_.chord_row_height - ImGui::GetFontSize()) *
+                               0.5f);
+        float free_x = row_min.x;
+        for (std::size_t i = first; i < last; ++i) {
+            const Chord& chord = beats[i].chord;
+            if (!chord.valid() ||
+                (i > first && beats[i - 1].chord == chord)) {
+                continue;
+            }
+            auto [screen_x_local, _] = coords.world_to_screen(
+                coords.tick_to_world(static_cast<Tick>(i) * beat_ticks), 0.0);
+            const float x = std::max(
+                origin.x + static_cast<float>(screen_x_local) + 2.0f,
+                row_min.x + 2.0f);
+            if (x < free_x) {
+                continue;
+            }
+            const std::string name = chord_name(chord);
+            draw_list->AddText(ImVec2(x, text_y), chord_color, name.c_str());
+            free_x = x + ImGui::CalcTextSize(name.c_str()).x + 6.0f;
+        }
+        draw_list->PopClipRect();
+    }
 }
 
 void PianoRollRenderer::render_playhead_layer(
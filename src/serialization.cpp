@@ -1,102 +1,246 @@
 #include "piano_roll/serialization.hpp"
 
+#include <charconv>
+#include <cstdint>
 #include <istream>
 #include <ostream>
-#include <sstream>
 #include <string>
+#include <string_view>
 #include <unordered_map>
+#include <utility>
 
 namespace piano_roll {
 
+namespace {
+
+// Whitespace-separated field cursor over one line.
+class FieldParser {
+public:
+    explicit FieldParser(std::string_view text) : text_(text) {}
+
+    template <typename T>
+    bool read(T& value) {
+        skip_space();
+        const char* first = text_.data() + pos_;
+        const char* last = text_.data() + text_.size();
+        auto [ptr, ec] = std::from_chars(first, last, value);
+        if (ec != std::errc{} || (ptr != last && !is_space(*ptr))) {
+            return false;
+        }
+        pos_ = static_cast<std::size_t>(ptr - text_.data());
+        return true;
+    }
+
+private:
+    static bool is_space(char c) noexcept {
+        return c == ' ' || c == '\t' || c == '\r' || c == '\n' ||
+               c == '\v' || c == '\f';
+    }
+
+    void skip_space() noexcept {
+        while (pos_ < text_.size() && is_space(text_[pos_])) {
+            ++pos_;
+        }
+        // Accept an explicit '+' sign like stream extraction does.
+        if (pos_ + 1 < text_.size() && text_[pos_] == '+' &&
+            text_[pos_ + 1] != '-') {
+            ++pos_;
+        }
+    }
+
+    std::string_view text_;
+    std::size_t pos_{0};
+};
+
+}  // namespace
+
+void write_ppr1_header(std::ostream& out) {
+    out << "PPR1\n";
+}
+
+void write_ppr1_note(std::ostream& out, const Note& note) {
+    out << "N " << note.tick << " " << note.duration << " "
+        << note.key << " " << note.velocity << " "
+        << note.channel << "\n";
+}
+
+void write_ppr1_expression(std::ostream& out, const ExpressionPoint& point) {
+    out << "X " << static_cast<int>(point.dimension) << " "
+        << point.tick_offset << " "
+        << point.value << "\n";
+}
+
+void write_ppr1_control(std::ostream& out, int cc, const ControlPoint& point) {
+    out << "C " << cc << " "
+        << point.tick << " "
+        << point.value;
+    if (point.shape != CurveShape::Linear) {
+        out << " " << static_cast<int>(point.shape) << " "
+            << point.tension;
+    }
+    out << "\n";
+}
+
 void serialize_notes_and_cc(const NoteManager& notes,
                             const std::vector<ControlLane>& lanes,
                             std::ostream& out) {
-    out << "PPR1\n";
+    write_ppr1_header(out);
 
     for (const Note& n : notes.notes()) {
-        out << "N " << n.tick << " " << n.duration << " "
-            << n.key << " " << n.velocity << " "
-            << n.channel << "\n";
+        write_ppr1_note(out, n);
+        for (const ExpressionPoint& p : notes.note_expression(n)) {
+            write_ppr1_expression(out, p);
+        }
     }
 
     for (const ControlLane& lane : lanes) {
         int cc = lane.cc_number();
         for (const ControlPoint& p : lane.points()) {
-            out << "C " << cc << " "
-                << p.tick << " "
-                << p.value << "\n";
+            write_ppr1_control(out, cc, p);
         }
     }
 }
 
-void deserialize_notes_and_cc(NoteManager& notes,
-                              std::vector<ControlLane>& lanes,
-                              std::istream& in) {
-    notes.clear();
-    lanes.clear();
+Ppr1Reader::Ppr1Reader(std::istream& in) : in_(in) {}
 
-    std::unordered_map<int, std::size_t> cc_to_index;
-
-    std::string line;
-    bool first_line = true;
-    while (std::getline(in, line)) {
-        if (line.empty()) {
-            continue;
-        }
-        std::istringstream iss(line);
-        char type = 0;
-        iss >> type;
-        if (!iss) {
+bool Ppr1Reader::next(Record& record) {
+    while (std::getline(in_, buffer_)) {
+        ++line_;
+        std::string_view text(buffer_);
+        std::size_t start = text.find_first_not_of(" \t\r\v\f");
+        if (start == std::string_view::npos) {
             continue;
         }
+        const char type = text[start];
+        FieldParser fields(text.substr(start + 1));
 
-        if (first_line && type == 'P') {
+        if (first_line_ && type == 'P') {
             // Expecting "PPR1"; ignore content.
-            first_line = false;
+            first_line_ = false;
+            has_header_ = true;
             continue;
         }
-        first_line = false;
+        first_line_ = false;
 
+        record.line = line_;
         if (type == 'N') {
-            Tick tick{};
-            Duration dur{};
-            int key{};
-            int vel{};
-            int chan{};
-            if (!(iss >> tick >> dur >> key >> vel >> chan)) {
-                continue;
+            Note note;
+            if (fields.read(note.tick) && fields.read(note.duration) &&
+                fields.read(note.key) && fields.read(note.velocity) &&
+                fields.read(note.channel)) {
+                record.type = RecordType::Note;
+                record.note = note;
+            } else {
+                record.type = RecordType::Malformed;
             }
-            notes.create_note(tick,
-                              dur,
-                              key,
-                              vel,
-                              chan,
-                              /*selected=*/false,
-                              /*record_undo=*/false,
-                              /*allow_overlap=*/true);
-        } else if (type == 'C') {
+            return true;
+        }
+        if (type == 'X') {
+            int dimension{};
+            std::int64_t offset{};
+            float value{};
+            if (fields.read(dimension) && fields.read(offset) &&
+                fields.read(value) && dimension >= 0 &&
+                dimension < kExpressionDimensionCount && offset >= 0) {
+                record.type = RecordType::Expression;
+                record.expression = ExpressionPoint{
+                    static_cast<ExpressionDimension>(dimension),
+                    static_cast<std::uint32_t>(offset),
+                    value};
+            } else {
+                record.type = RecordType::Malformed;
+            }
+            return true;
+        }
+        if (type == 'C') {
             int cc{};
-            Tick tick{};
-            int value{};
-            if (!(iss >> cc >> tick >> value)) {
-                continue;
+            ControlPoint point;
+            if (!(fields.read(cc) && fields.read(point.tick) &&
+                  fields.read(point.value))) {
+                record.type = RecordType::Malformed;
+                return true;
+            }
+            // Optional segment shape; absent on linear segments.
+            int shape{};
+            float tension{};
+            if (fields.read(shape) && fields.read(tension) && shape >= 0 &&
+                shape < kCurveShapeCount) {
+                point.shape = static_cast<CurveShape>(shape);
+                point.tension = tension;
             }
+            record.type = RecordType::Control;
+            record.cc = cc;
+            record.control = point;
+            return true;
+        }
+        // Unknown line type; ignore.
+        ++skipped_;
+    }
+    return false;
+}
 
-            auto it = cc_to_index.find(cc);
+void deserialize_notes_and_cc(NoteManager& notes,
+                              std::vector<ControlLane>& lanes,
+                              std::istream& in) {
+    notes.clear();
+    lanes.clear();
+
+    std::unordered_map<int, std::size_t> cc_to_index;
+
+    // Notes and each lane's points are collected and inserted in one batch;
+    // expression points are attached afterwards by position in the batch.
+    std::vector<Note> parsed;
+    std::vector<std::pair<std::size_t, std::vector<ExpressionPoint>>>
+        expressions;
+    bool have_note = false;
+    std::vector<std::vector<ControlPoint>> lane_points;
+
+    Ppr1Reader reader(in);
+    Ppr1Reader::Record record;
+    while (reader.next(record)) {
+        switch (record.type) {
+        case Ppr1Reader::RecordType::Note:
+            parsed.push_back(record.note);
+            have_note = true;
+            break;
+        case Ppr1Reader::RecordType::Expression:
+            if (!have_note) {
+                break;
+            }
+            if (expressions.empty() ||
+                expressions.back().first != parsed.size() - 1) {
+                expressions.emplace_back(parsed.size() - 1,
+                                         std::vector<ExpressionPoint>{});
+            }
+            expressions.back().second.push_back(record.expression);
+            break;
+        case Ppr1Reader::RecordType::Control: {
+            auto it = cc_to_index.find(record.cc);
             if (it == cc_to_index.end()) {
-                lanes.push_back(ControlLane{cc});
-                std::size_t idx = lanes.size() - 1;
-                cc_to_index.emplace(cc, idx);
-                it = cc_to_index.find(cc);
+                lanes.push_back(ControlLane{record.cc});
+                lane_points.emplace_back();
+                it = cc_to_index.emplace(record.cc, lanes.size() - 1).first;
             }
+            lane_points[it->second].push_back(record.control);
+            break;
+        }
+        case Ppr1Reader::RecordType::Malformed:
+            break;
+        }
+    }
 
-            lanes[it->second].add_point(tick, value);
-        } else {
-            // Unknown line type; ignore.
-            continue;
+    for (std::size_t i = 0; i < lanes.size(); ++i) {
+        lanes[i].add_points(lane_points[i]);
+    }
+
+    const std::vector<NoteId> ids =
+        notes.add_notes(parsed, /*record_undo=*/false);
+    for (auto& [index, points] : expressions) {
+        if (ids[index] != 0) {
+            notes.set_note_expression(
+                ids[index], std::move(points), /*record_undo=*/false);
         }
     }
 }
 
 }  // namespace piano_roll
-
@@ -0,0 +1,404 @@
+#include "piano_roll/shared_snapshot.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define PIANO_ROLL_HAS_POSIX_SHM 1
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace piano_roll {
+
+namespace {
+
+constexpr std::size_t kHeaderSize = sizeof(SharedSnapshotHeader);
+
+// The generation word is shared with other processes; lock-free 64-bit
+// atomics are address-free, so atomic_ref works on the mapping directly.
+std::uint64_t load_generation(const unsigned char* base,
+                              std::memory_order order) noexcept {
+    auto* header = reinterpret_cast<SharedSnapshotHeader*>(
+        const_cast<unsigned char*>(base));
+    return std::atomic_ref<std::uint64_t>(header->generation).load(order);
+}
+
+#ifdef PIANO_ROLL_HAS_POSIX_SHM
+std::string system_error(const char* what) {
+    return std::string(what) + ": " + std::strerror(errno);
+}
+#endif
+
+}  // namespace
+
+// ---------------------------------------------------------------------------
+// Writer
+
+SharedSnapshotWriter::~SharedSnapshotWriter() {
+    close();
+}
+
+bool SharedSnapshotWriter::create(const std::string& name,
+                                  std::size_t initial_bytes) {
+    close();
+    error_.clear();
+#ifdef PIANO_ROLL_HAS_POSIX_SHM
+    ::shm_unlink(name.c_str());
+    fd_ = ::shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd_ < 0) {
+        error_ = system_error("shm_open");
+        return false;
+    }
+    name_ = name;
+    if (!resize(std::max(initial_bytes, kHeaderSize))) {
+        close();
+        return false;
+    }
+
+    // An empty snapshot at generation 0.
+    SharedSnapshotHeader header{};
+    header.magic = kSharedSnapshotMagic;
+    header.version_major = kSharedSnapshotVersionMajor;
+    header.version_minor = kSharedSnapshotVersionMinor;
+    header.header_size = static_cast<std::uint32_t>(kHeaderSize);
+    header.note_record_size = sizeof(SharedNoteRecord);
+    header.lane_record_size = sizeof(SharedLaneRecord);
+    header.point_record_size = sizeof(SharedControlPointRecord);
+    header.segment_size = size_;
+    header.notes_offset = kHeaderSize;
+    header.lanes_offset = kHeaderSize;
+    header.points_offset = kHeaderSize;
+    std::memcpy(base_, &header, kHeaderSize);
+    return true;
+#else
+    (void)name;
+    (void)initial_bytes;
+    error_ = "shared memory snapshots need POSIX shm_open";
+    return false;
+#endif
+}
+
+void SharedSnapshotWriter::close() {
+#ifdef PIANO_ROLL_HAS_POSIX_SHM
+    if (base_ != nullptr) {
+        ::munmap(base_, size_);
+    }
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+    if (!name_.empty()) {
+        ::shm_unlink(name_.c_str());
+    }
+#endif
+    base_ = nullptr;
+    size_ = 0;
+    fd_ = -1;
+    name_.clear();
+}
+
+bool SharedSnapshotWriter::resize(std::size_t bytes) {
+#ifdef PIANO_ROLL_HAS_POSIX_SHM
+    // Growing the file leaves readers' existing (smaller) mappings valid;
+    // they remap when they see the larger segment_size.
+    if (::ftruncate(fd_, static_cast<off_t>(bytes)) != 0) {
+        error_ = system_error("ftruncate");
+        return false;
+    }
+    void* mapped =
+        ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if (mapped == MAP_FAILED) {
+        error_ = system_error("mmap");
+        return false;
+    }
+    if (base_ != nullptr) {
+        ::munmap(base_, size_);
+    }
+    base_ = static_cast<unsigned char*>(mapped);
+    size_ = bytes;
+    return true;
+#else
+    (void)bytes;
+    return false;
+#endif
+}
+
+bool SharedSnapshotWriter::publish(const NoteManager& notes,
+                                   const std::vector<ControlLane>& lanes) {
+    if (base_ == nullptr) {
+        error_ = "segment not open";
+        return false;
+    }
+
+    std::size_t point_total = 0;
+    for (const ControlLane& lane : lanes) {
+        point_total += lane.points().size();
+    }
+    const std::size_t notes_offset = kHeaderSize;
+    const std::size_t lanes_offset =
+        notes_offset + notes.notes().size() * sizeof(SharedNoteRecord);
+    const std::size_t points_offset =
+        lanes_offset + lanes.size() * sizeof(SharedLaneRecord);
+    const std::size_t needed =
+        points_offset + point_total * sizeof(SharedControlPointRecord);
+    if (needed > size_ && !resize(std::max(needed, size_ * 2))) {
+        return false;
+    }
+
+    auto* header = reinterpret_cast<SharedSnapshotHeader*>(base_);
+    std::atomic_ref<std::uint64_t> generation(header->generation);
+    const std::uint64_t current = generation.load(std::memory_order_relaxed);
+    generation.store(current + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    // Plain stores from here on: readers that overlap them see a changed
+    // generation and discard what they read.
+    auto* note_out =
+        reinterpret_cast<SharedNoteRecord*>(base_ + notes_offset);
+    for (const Note& note : notes.notes()) {
+        SharedNoteRecord record{};
+        record.tick = note.tick;
+        record.duration = note.duration;
+        record.id = note.id;
+        record.key = static_cast<std::int16_t>(note.key);
+        record.velocity = static_cast<std::uint8_t>(note.velocity);
+        record.channel = static_cast<std::uint8_t>(note.channel);
+        record.flags = note.selected ? kSharedSelected : 0;
+        *note_out++ = record;
+    }
+    auto* lane_out =
+        reinterpret_cast<SharedLaneRecord*>(base_ + lanes_offset);
+    auto* point_out =
+        reinterpret_cast<SharedControlPointRecord*>(base_ + points_offset);
+    std::uint64_t first_point = 0;
+    for (const ControlLane& lane : lanes) {
+        SharedLaneRecord record{};
+        record.cc_number = lane.cc_number();
+        record.point_count = static_cast<std::uint32_t>(lane.points().size());
+        record.first_point = first_point;
+        *lane_out++ = record;
+        for (const ControlPoint& p : lane.points()) {
+            SharedControlPointRecord point{};
+            point.tick = p.tick;
+            point.value = p.value;
+            point.tension = p.tension;
+            point.shape = static_cast<std::uint8_t>(p.shape);
+            point.flags = p.selected ? kSharedSelected : 0;
+            *point_out++ = point;
+        }
+        first_point += lane.points().size();
+    }
+
+    header->segment_size = size_;
+    header->revision = notes.revision();
+    header->note_count = notes.notes().size();
+    header->notes_offset = notes_offset;
+    header->lane_count = lanes.size();
+    header->lanes_offset = lanes_offset;
+    header->point_count = point_total;
+    header->points_offset = points_offset;
+
+    generation.store(current + 2, std::memory_order_release);
+    return true;
+}
+
+std::uint64_t SharedSnapshotWriter::generation() const noexcept {
+    return base_ != nullptr ? load_generation(base_, std::memory_order_relaxed)
+                            : 0;
+}
+
+// ---------------------------------------------------------------------------
+// Reader
+
+SharedSnapshotReader::~SharedSnapshotReader() {
+    close();
+}
+
+bool SharedSnapshotReader::open(const std::string& name) {
+    close();
+    error_.clear();
+#ifdef PIANO_ROLL_HAS_POSIX_SHM
+    fd_ = ::shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd_ < 0) {
+        error_ = system_error("shm_open");
+        return false;
+    }
+    struct stat info {};
+    if (::fstat(fd_, &info) != 0 ||
+        static_cast<std::size_t>(info.st_size) < kHeaderSize) {
+        error_ = "segment too small for a snapshot header";
+        close();
+        return false;
+    }
+    if (!remap(static_cast<std::size_t>(info.st_size))) {
+        close();
+        return false;
+    }
+
+    SharedSnapshotHeader header;
+    std::memcpy(&header, base_, kHeaderSize);
+    if (header.magic != kSharedSnapshotMagic) {
+        error_ = "not a piano roll snapshot segment";
+    } else if (header.version_major != kSharedSnapshotVersionMajor) {
+        error_ = "unsupported snapshot layout version " +
+                 std::to_string(header.version_major);
+    } else if (header.header_size < kHeaderSize ||
+               header.note_record_size != sizeof(SharedNoteRecord) ||
+               header.lane_record_size != sizeof(SharedLaneRecord) ||
+               header.point_record_size != sizeof(SharedControlPointRecord)) {
+        error_ = "unexpected snapshot record sizes";
+    }
+    if (!error_.empty()) {
+        close();
+        return false;
+    }
+    return true;
+#else
+    (void)name;
+    error_ = "shared memory snapshots need POSIX shm_open";
+    return false;
+#endif
+}
+
+void SharedSnapshotReader::close() {
+#ifdef PIANO_ROLL_HAS_POSIX_SHM
+    if (base_ != nullptr) {
+        ::munmap(const_cast<unsigned char*>(base_), size_);
+    }
+    if (fd_ >= 0) {
+        ::close(fd_);
+    }
+#endif
+    base_ = nullptr;
+    size_ = 0;
+    fd_ = -1;
+}
+
+bool SharedSnapshotReader::remap(std::size_t bytes) {
+#ifdef PIANO_ROLL_HAS_POSIX_SHM
+    void* mapped = ::mmap(nullptr, bytes, PROT_READ, MAP_SHARED, fd_, 0);
+    if (mapped == MAP_FAILED) {
+        error_ = system_error("mmap");
+        return false;
+    }
+    if (base_ != nullptr) {
+        ::munmap(const_cast<unsigned char*>(base_), size_);
+    }
+    base_ = static_cast<const unsigned char*>(mapped);
+    size_ = bytes;
+    return true;
+#else
+    (void)bytes;
+    return false;
+#endif
+}
+
+std::uint64_t SharedSnapshotReader::generation() const noexcept {
+    return base_ != nullptr ? load_generation(base_, std::memory_order_acquire)
+                            : 0;
+}
+
+bool SharedSnapshotReader::begin_read(SharedSnapshotView& view) {
+    error_.clear();
+    if (base_ == nullptr) {
+        error_ = "segment not open";
+        return false;
+    }
+    const std::uint64_t generation =
+        load_generation(base_, std::memory_order_acquire);
+    if ((generation & 1) != 0) {
+        return false;
+    }
+
+    SharedSnapshotHeader header;
+    std::memcpy(&header, base_, kHeaderSize);
+    if (header.segment_size > size_ && !remap(header.segment_size)) {
+        return false;
+    }
+
+    auto fits = [this](std::uint64_t offset,
+                       std::uint64_t count,
+                       std::size_t record) {
+        return offset <= size_ && count <= (size_ - offset) / record;
+    };
+    if (!fits(header.notes_offset, header.note_count, sizeof(SharedNoteRecord)) ||
+        !fits(header.lanes_offset, header.lane_count, sizeof(SharedLaneRecord)) ||
+        !fits(header.points_offset,
+              header.point_count,
+              sizeof(SharedControlPointRecord))) {
+        // Torn header from a concurrent publish, or a corrupt segment.
+        if (load_generation(base_, std::memory_order_acquire) == generation) {
+            error_ = "snapshot offsets exceed the segment";
+        }
+        return false;
+    }
+
+    view.generation = generation;
+    view.revision = header.revision;
+    view.notes = {reinterpret_cast<const SharedNoteRecord*>(
+                      base_ + header.notes_offset),
+                  static_cast<std::size_t>(header.note_count)};
+    view.lanes = {reinterpret_cast<const SharedLaneRecord*>(
+                      base_ + header.lanes_offset),
+                  static_cast<std::size_t>(header.lane_count)};
+    view.points = {reinterpret_cast<const SharedControlPointRecord*>(
+                       base_ + header.points_offset),
+                   static_cast<std::size_t>(header.point_count)};
+    return true;
+}
+
+bool SharedSnapshotReader::end_read(
+    const SharedSnapshotView& view) const noexcept {
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return load_generation(base_, std::memory_order_relaxed) ==
+           view.generation;
+}
+
+bool SharedSnapshotReader::copy_to(NoteManager& notes,
+                                   std::vector<ControlLane>& lanes) {
+    std::vector<Note> copied_notes;
+    std::vector<ControlLane> copied_lanes;
+    const bool ok = read([&](const SharedSnapshotView& view) {
+        copied_notes.clear();
+        copied_lanes.clear();
+        copied_notes.reserve(view.notes.size());
+        for (const SharedNoteRecord& record : view.notes) {
+            Note note;
+            note.tick = record.tick;
+            note.duration = record.duration;
+            note.key = record.key;
+            note.velocity = record.velocity;
+            note.channel = record.channel;
+            note.selected = (record.flags & kSharedSelected) != 0;
+            copied_notes.push_back(note);
+        }
+        for (const SharedLaneRecord& record : view.lanes) {
+            std::vector<ControlPoint> points;
+            for (const SharedControlPointRecord& p : view.lane_points(record)) {
+                ControlPoint point;
+                point.tick = p.tick;
+                point.value = p.value;
+                point.tension = p.tension;
+                point.shape = static_cast<CurveShape>(
+                    std::min<int>(p.shape, kCurveShapeCount - 1));
+                point.selected = (p.flags & kSharedSelected) != 0;
+                points.push_back(point);
+            }
+            copied_lanes.emplace_back(record.cc_number);
+            copied_lanes.back().replace_points(std::move(points), false);
+        }
+    });
+    if (!ok) {
+        return false;
+    }
+    notes.clear();
+    notes.add_notes(copied_notes, /*record_undo=*/false);
+    lanes = std::move(copied_lanes);
+    return true;
+}
+
+}  // namespace piano_roll
@@ -0,0 +1,149 @@
+#include "piano_roll/transport_clock.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace piano_roll {
+
+void TransportClock::publish(const TransportStamp& stamp) noexcept {
+    const std::uint64_t sequence = sequence_.load(std::memory_order_relaxed);
+    sequence_.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    sample_position_.store(stamp.sample_position, std::memory_order_relaxed);
+    sample_rate_.store(stamp.sample_rate, std::memory_order_relaxed);
+    tick_.store(stamp.tick, std::memory_order_relaxed);
+    tempo_bpm_.store(stamp.tempo_bpm, std::memory_order_relaxed);
+    host_time_.store(stamp.host_time_seconds, std::memory_order_relaxed);
+    playing_.store(stamp.playing, std::memory_order_relaxed);
+
+    sequence_.store(sequence + 2, std::memory_order_release);
+}
+
+bool TransportClock::latest(TransportStamp& out) const noexcept {
+    for (;;) {
+        const std::uint64_t before = sequence_.load(std::memory_order_acquire);
+        if (before == 0) {
+            return false;
+        }
+        if ((before & 1) != 0) {
+            continue;  // publish() in progress
+        }
+        out.sample_position = sample_position_.load(std::memory_order_relaxed);
+        out.sample_rate = sample_rate_.load(std::memory_order_relaxed);
+        out.tick = tick_.load(std::memory_order_relaxed);
+        out.tempo_bpm = tempo_bpm_.load(std::memory_order_relaxed);
+        out.host_time_seconds = host_time_.load(std::memory_order_relaxed);
+        out.playing = playing_.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (sequence_.load(std::memory_order_relaxed) == before) {
+            return true;
+        }
+    }
+}
+
+void TransportClock::set_loop(bool enabled,
+                              Tick start_tick,
+                              Tick end_tick) noexcept {
+    loop_enabled_ = enabled && end_tick > start_tick;
+    loop_start_ = static_cast<double>(start_tick);
+    loop_end_ = static_cast<double>(end_tick);
+}
+
+bool TransportClock::playing() const noexcept {
+    TransportStamp stamp;
+    return latest(stamp) && stamp.playing;
+}
+
+double TransportClock::wrap(double tick) const noexcept {
+    if (!loop_enabled_ || tick < loop_end_) {
+        return tick;
+    }
+    const double length = loop_end_ - loop_start_;
+    return loop_start_ + std::fmod(tick - loop_start_, length);
+}
+
+double TransportClock::playhead(double host_time_seconds) noexcept {
+    TransportStamp stamp;
+    if (!latest(stamp)) {
+        return displayed_;
+    }
+    if (!stamp.playing || stamp.tempo_bpm <= 0.0 ||
+        options_.ticks_per_beat <= 0) {
+        // Stopped: show the engine position as is.
+        has_display_ = false;
+        displayed_ = stamp.tick;
+        return displayed_;
+    }
+
+    const double ticks_per_second =
+        stamp.tempo_bpm * static_cast<double>(options_.ticks_per_beat) / 60.0;
+
+    // Position being heard now: the stamp position advanced by the time
+    // since it was taken, minus what is still in the output buffers. Just
+    // after a loop wrap this can fall before the loop start; it maps back
+    // to the end of the loop.
+    double target = stamp.tick +
+                    (host_time_seconds - stamp.host_time_seconds -
+                     options_.output_latency_seconds) *
+                        ticks_per_second;
+    const bool in_loop = loop_enabled_ && stamp.tick >= loop_start_ &&
+                         stamp.tick < loop_end_;
+    if (in_loop) {
+        const double length = loop_end_ - loop_start_;
+        double offset = std::fmod(target - loop_start_, length);
+        if (offset < 0.0) {
+            offset += length;
+        }
+        target = loop_start_ + offset;
+    } else {
+        target = std::max(target, 0.0);
+    }
+
+    const double elapsed = host_time_seconds - last_host_time_;
+    if (!has_display_ || elapsed < 0.0) {
+        displayed_ = target;
+        has_display_ = true;
+        last_host_time_ = host_time_seconds;
+        return displayed_;
+    }
+    last_host_time_ = host_time_seconds;
+
+    // Advance at the tempo, then pull a fraction of the remaining error in.
+    const double predicted =
+        in_loop ? wrap(displayed_ + elapsed * ticks_per_second)
+                : displayed_ + elapsed * ticks_per_second;
+    double error = target - predicted;
+    if (in_loop) {
+        // Measure across the wrap point the short way round.
+        const double length = loop_end_ - loop_start_;
+        if (error > length * 0.5) {
+            error -= length;
+        } else if (error < -length * 0.5) {
+            error += length;
+        }
+    }
+    const double snap_ticks =
+        options_.snap_beats * static_cast<double>(options_.ticks_per_beat);
+    if (std::abs(error) > snap_ticks) {
+        displayed_ = target;
+        return displayed_;
+    }
+    const double gain =
+        options_.smoothing_seconds > 0.0
+            ? 1.0 - std::exp(-elapsed / options_.smoothing_seconds)
+            : 1.0;
+    displayed_ = predicted + error * gain;
+    if (in_loop) {
+        displayed_ = displayed_ < loop_start_
+                         ? displayed_ + (loop_end_ - loop_start_)
+                         : wrap(displayed_);
+    }
+    return displayed_;
+}
+
+Tick TransportClock::playhead_tick(double host_time_seconds) noexcept {
+    return static_cast<Tick>(std::floor(playhead(host_time_seconds)));
+}
+
+}  // namespace piano_roll
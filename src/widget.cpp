@@ -2,6 +2,9 @@
 
 #include "piano_roll/playback.hpp"
 
+#include <chrono>
+#include <cmath>
+
 #ifdef PIANO_ROLL_USE_IMGUI
 #include <imgui.h>
 #endif
@@ -16,6 +19,8 @@ PianoRollWidget::PianoRollWidget(const PianoRollConfig& cfg)
       snap_(cfg.ticks_per_beat),
       renderer_(config_),
       pointer_(notes_, coords_, &snap_),
+      pattern_coords_(cfg.piano_key_width),
+      pattern_pointer_(notes_, pattern_coords_, &snap_),
       keyboard_(notes_),
       loop_markers_(&coords_,
                     4 * cfg.ticks_per_beat,
@@ -78,9 +83,11 @@ PianoRollWidget::PianoRollWidget(const PianoRollConfig& cfg)
 
     keyboard_.set_snap_system(&snap_);
     keyboard_.set_coordinate_system(&coords_);
-    pointer_.set_edge_threshold_pixels(10.0);
-    pointer_.set_drag_threshold_pixels(4.0);
-    pointer_.set_enable_ctrl_drag_duplicate(true);
+    for (PointerTool* tool : {&pointer_, &pattern_pointer_}) {
+        tool->set_edge_threshold_pixels(10.0);
+        tool->set_drag_threshold_pixels(4.0);
+        tool->set_enable_ctrl_drag_duplicate(true);
+    }
 }
 
 void PianoRollWidget::set_playback_start_tick(
@@ -170,14 +177,57 @@ Tick PianoRollWidget::update_playback(Tick current_tick,
         }
     }
 
-    Tick new_tick = advance_playback_ticks(current_tick,
-                                           tempo_bpm,
-                                           tpb,
-                                           delta_seconds,
-                                           loop_on,
-                                           loop_start,
-                                           loop_end);
+    // Continue from the exact position only if the host passed back the
+    // tick we returned last time; anything else is a seek.
+    const double fraction =
+        has_playhead() && current_tick == playhead_tick() ? playback_fraction_
+                                                          : 0.0;
+    const double position =
+        advance_playback_position(static_cast<double>(current_tick) + fraction,
+                                  tempo_bpm,
+                                  tpb,
+                                  delta_seconds,
+                                  loop_on,
+                                  loop_start,
+                                  loop_end);
+    const Tick new_tick = static_cast<Tick>(std::floor(position));
     set_playhead(new_tick);
+    playback_fraction_ =
+        playhead_tick() == new_tick ? position - static_cast<double>(new_tick)
+                                    : 0.0;
+    return playhead_tick();
+}
+
+Tick PianoRollWidget::update_playback(Tick current_tick,
+                                      double tempo_bpm) noexcept {
+    const double now = clock_->now_seconds();
+    const double delta =
+        has_playback_time_ ? std::max(0.0, now - last_playback_time_) : 0.0;
+    has_playback_time_ = true;
+    last_playback_time_ = now;
+    return update_playback(current_tick, tempo_bpm, delta);
+}
+
+void PianoRollWidget::set_clock(const Clock* clock) noexcept {
+    clock_ = clock != nullptr ? clock : &default_clock();
+    h_scrollbar_.set_clock(clock_);
+    // Times from the previous clock are not comparable with the new one.
+    has_frame_time_ = false;
+    has_playback_time_ = false;
+    frame_delta_ = 0.0;
+}
+
+Tick PianoRollWidget::follow_transport(TransportClock& clock,
+                                       double host_time_seconds) noexcept {
+    TransportClockOptions options = clock.options();
+    if (options.ticks_per_beat != coords_.ticks_per_beat()) {
+        options.ticks_per_beat = coords_.ticks_per_beat();
+        clock.set_options(options);
+    }
+    const auto range = loop_markers_.tick_range();
+    clock.set_loop(loop_markers_.enabled, range.first, range.second);
+    set_playhead(clock.playhead_tick(host_time_seconds));
+    playback_fraction_ = 0.0;
     return playhead_tick();
 }
 
@@ -274,30 +324,224 @@ void PianoRollWidget::fit_view_to_selection() noexcept {
     update_scrollbar_geometry();
 }
 
-bool PianoRollWidget::selection_bounds(Tick& min_tick,
-                                       Tick& max_tick,
-                                       MidiKey& min_key,
-                                       MidiKey& max_key) const noexcept {
-    const auto& ns = notes_.notes();
-    bool any_selected = false;
-    for (const Note& n : ns) {
-        if (!n.selected) {
+PatternId PianoRollWidget::instance_selection(int repeats) {
+    Tick min_tick{};
+    Tick max_tick{};
+    MidiKey min_key{};
+    MidiKey max_key{};
+    if (repeats < 1 ||
+        !selection_bounds(min_tick, max_tick, min_key, max_key)) {
+        return 0;
+    }
+    const std::vector<NoteId> ids = notes_.selected_ids();
+    const Tick length = max_tick - min_tick;
+    PatternId pattern =
+        patterns_.create_pattern_from_notes(notes_, ids, min_tick, length);
+    if (pattern == 0) {
+        return 0;
+    }
+    notes_.remove_notes(ids);
+    for (int i = 0; i < repeats; ++i) {
+        patterns_.add_instance(pattern, min_tick + i * length);
+    }
+    const std::uint64_t group = next_undo_group_++;
+    notes_.set_undo_group(group);
+    record_pattern_undo(
+        PatternUndo{group, pattern, repeats, ids, min_tick, length});
+    return pattern;
+}
+
+std::size_t PianoRollWidget::insert_time(Tick tick, Tick length) {
+    const std::uint64_t group = next_undo_group_++;
+    bool lanes_changed = false;
+    for (ControlLane& lane : cc_lanes_) {
+        if (lane.ripple_insert(tick, length) > 0) {
+            lane.set_undo_group(group);
+            lanes_changed = true;
+        }
+    }
+    const std::size_t moved = notes_.ripple_insert(tick, length);
+    if (moved == 0 && lanes_changed) {
+        // The notes anchor the group even when only lanes changed.
+        notes_.snapshot_for_undo();
+    }
+    if (moved > 0 || lanes_changed) {
+        notes_.set_undo_group(group);
+    }
+    return moved;
+}
+
+std::size_t PianoRollWidget::delete_time(Tick start_tick,
+                                         Tick end_tick,
+                                         bool split_straddling) {
+    const std::uint64_t group = next_undo_group_++;
+    bool lanes_changed = false;
+    for (ControlLane& lane : cc_lanes_) {
+        if (lane.ripple_delete(start_tick, end_tick) > 0) {
+            lane.set_undo_group(group);
+            lanes_changed = true;
+        }
+    }
+    const std::size_t changed =
+        notes_.ripple_delete(start_tick, end_tick, split_straddling);
+    if (changed == 0 && lanes_changed) {
+        notes_.snapshot_for_undo();
+    }
+    if (changed > 0 || lanes_changed) {
+        notes_.set_undo_group(group);
+    }
+    return changed;
+}
+
+bool PianoRollWidget::undo() {
+    const std::uint64_t group = notes_.undo_group();
+    if (!notes_.undo()) {
+        return false;
+    }
+    if (group == 0) {
+        return true;
+    }
+    for (ControlLane& lane : cc_lanes_) {
+        if (lane.undo_group() == group) {
+            lane.undo();
+        }
+    }
+    for (PatternUndo& step : pattern_undo_) {
+        if (step.group != group) {
             continue;
         }
-        if (!any_selected) {
-            any_selected = true;
-            min_tick = n.tick;
-            max_tick = n.end_tick();
-            min_key = n.key;
-            max_key = n.key;
-        } else {
-            if (n.tick < min_tick) min_tick = n.tick;
-            if (n.end_tick() > max_tick) max_tick = n.end_tick();
-            if (n.key < min_key) min_key = n.key;
-            if (n.key > max_key) max_key = n.key;
+        if (step.repeats > 0) {
+            patterns_.remove_pattern(step.pattern);
+            step.pattern = 0;
+        } else if (Pattern* pattern = patterns_.find_pattern(step.pattern);
+                   pattern != nullptr && pattern->notes.undo_group() == group) {
+            pattern->notes.undo();
         }
     }
-    return any_selected;
+    return true;
+}
+
+bool PianoRollWidget::redo() {
+    const std::uint64_t group = notes_.redo_group();
+    if (group != 0) {
+        // Rebuild instanced patterns while their notes are still in the
+        // clip; the redo below removes them again.
+        for (PatternUndo& step : pattern_undo_) {
+            if (step.group == group && step.repeats > 0) {
+                step.pattern = patterns_.create_pattern_from_notes(
+                    notes_, step.ids, step.origin, step.length);
+            }
+        }
+    }
+    if (!notes_.redo()) {
+        return false;
+    }
+    if (group == 0) {
+        return true;
+    }
+    for (ControlLane& lane : cc_lanes_) {
+        if (lane.redo_group() == group) {
+            lane.redo();
+        }
+    }
+    for (PatternUndo& step : pattern_undo_) {
+        if (step.group != group) {
+            continue;
+        }
+        if (step.repeats > 0) {
+            for (int i = 0; step.pattern != 0 && i < step.repeats; ++i) {
+                patterns_.add_instance(
+                    step.pattern, step.origin + i * step.length);
+            }
+        } else if (Pattern* pattern = patterns_.find_pattern(step.pattern);
+                   pattern != nullptr && pattern->notes.redo_group() == group) {
+            pattern->notes.redo();
+        }
+    }
+    return true;
+}
+
+void PianoRollWidget::record_pattern_undo(PatternUndo&& step) {
+    // Forget groups that have dropped out of the notes' history.
+    std::erase_if(pattern_undo_, [this](const PatternUndo& old) {
+        return !notes_.has_undo_group(old.group);
+    });
+    pattern_undo_.push_back(std::move(step));
+}
+
+void PianoRollWidget::begin_pointer_gesture(float local_x, float local_y) {
+    pattern_edit_instance_ = 0;
+    auto [world_x, world_y] = coords_.screen_to_world(local_x, local_y);
+    const Tick tick = coords_.world_to_tick(world_x);
+    const MidiKey key = coords_.world_y_to_key(world_y);
+    if (notes_.note_at(tick, key) != nullptr) {
+        return;
+    }
+    const std::optional<InstanceNote> hit = patterns_.note_at(tick, key);
+    NoteManager* notes =
+        hit ? patterns_.instance_notes(hit->instance) : nullptr;
+    if (notes == nullptr) {
+        return;
+    }
+    pattern_edit_instance_ = hit->instance;
+    pattern_pointer_.set_note_manager(*notes);
+    pattern_pointer_.set_snap_to_notes(pointer_.snap_to_notes());
+    pattern_pointer_.set_group_resize_mode(pointer_.group_resize_mode());
+}
+
+PointerTool& PianoRollWidget::active_pointer() {
+    const PatternInstance* instance =
+        pattern_edit_instance_ != 0
+            ? patterns_.find_instance(pattern_edit_instance_)
+            : nullptr;
+    if (instance == nullptr) {
+        // Clip notes, or the instance was removed mid-gesture.
+        pattern_edit_instance_ = 0;
+        return pointer_;
+    }
+    // Pattern tick p is drawn at timeline tick p + tick_offset and pattern
+    // key k at k + key_offset.
+    pattern_coords_ = coords_;
+    Viewport& vp = pattern_coords_.viewport();
+    vp.x -= coords_.tick_to_world(instance->tick_offset);
+    vp.y += static_cast<double>(instance->key_offset) * coords_.key_height();
+    return pattern_pointer_;
+}
+
+void PianoRollWidget::finish_pattern_edit() {
+    const PatternInstance* instance =
+        pattern_edit_instance_ != 0
+            ? patterns_.find_instance(pattern_edit_instance_)
+            : nullptr;
+    NoteManager* notes = instance != nullptr
+                             ? patterns_.instance_notes(instance->id)
+                             : nullptr;
+    // A gesture that changed the pattern left an untagged entry on its
+    // stack; anchor it on the clip's notes so undo() takes it in order.
+    if (notes == nullptr || notes->undo_levels() == 0 ||
+        notes->undo_group() != 0) {
+        return;
+    }
+    const std::uint64_t group = next_undo_group_++;
+    notes->set_undo_group(group);
+    notes_.snapshot_for_undo();
+    notes_.set_undo_group(group);
+    record_pattern_undo(PatternUndo{group, instance->pattern});
+}
+
+std::size_t PianoRollWidget::select_motif_occurrences(
+    const MotifSearchOptions& options) {
+    const std::vector<MotifMatch> matches =
+        motif_index_.find_selection(notes_, options);
+    MotifIndex::select_matches(notes_, matches, true);
+    return matches.size();
+}
+
+bool PianoRollWidget::selection_bounds(Tick& min_tick,
+                                       Tick& max_tick,
+                                       MidiKey& min_key,
+                                       MidiKey& max_key) const noexcept {
+    return notes_.selection_bounds(min_tick, max_tick, min_key, max_key);
 }
 
 void PianoRollWidget::set_canvas_rect(float x,
@@ -313,11 +557,37 @@ void PianoRollWidget::set_canvas_rect(float x,
 
 void PianoRollWidget::draw() {
 #ifdef PIANO_ROLL_USE_IMGUI
-    ImGuiIO& io = ImGui::GetIO();
+    // Frame timing for the performance HUD. Renderer layers report their own
+    // timings; the widget times input handling, the CC lane and its overlays.
+    using FrameClock = std::chrono::steady_clock;
+    auto elapsed_ms = [](FrameClock::time_point start) {
+        return std::chrono::duration<double, std::milli>(
+                   FrameClock::now() - start)
+            .count();
+    };
+    const auto frame_start = FrameClock::now();
+    const std::size_t allocations_start =
+        allocation_counter_ ? allocation_counter_() : 0;
+    const int vertices_start = ImGui::GetWindowDrawList()->VtxBuffer.Size;
+    FrameStats stats{};
+
+    // Batches from out-of-process clients, applied once per frame.
+    if (command_server_ != nullptr) {
+        command_server_->process(notes_);
+    }
+
+    // Frame delta on the injected clock; drives the timers below and edge
+    // scrolling instead of ImGui's frame delta.
+    const double frame_time = clock_->now_seconds();
+    frame_delta_ = has_frame_time_
+                       ? std::max(0.0, frame_time - last_frame_time_)
+                       : 0.0;
+    has_frame_time_ = true;
+    last_frame_time_ = frame_time;
 
     // Update piano-key flash timer (short visual highlight after presses).
     if (piano_key_flash_timer_ > 0.0f) {
-        piano_key_flash_timer_ -= io.DeltaTime;
+        piano_key_flash_timer_ -= static_cast<float>(frame_delta_);
         if (piano_key_flash_timer_ <= 0.0f) {
             piano_key_flash_timer_ = 0.0f;
             has_pressed_piano_key_ = false;
@@ -355,15 +625,8 @@ void PianoRollWidget::draw() {
     // scrollbar and, when enabled, for the CC lane. The viewport height
     // controls the note grid + piano-key area only.
     double total_height = height;
-    float lane_height_px = 0.0f;
-    if (config_.show_cc_lane) {
-        lane_height_px = config_.cc_lane_height;
-        if (lane_height_px <= 0.0f ||
-            lane_height_px > static_cast<float>(total_height) * 0.8f) {
-            lane_height_px =
-                static_cast<float>(total_height) * 0.25f;
-        }
-    }
+    float lane_height_px =
+        layout_cc_lanes(static_cast<float>(total_height));
     double reserved_bottom =
         static_cast<double>(h_scrollbar_.track_size) +
         static_cast<double>(lane_height_px);
@@ -458,6 +721,24 @@ void PianoRollWidget::draw() {
                 snap_.set_snap_division(chosen);
             }
 
+            bool snap_to_notes = pointer_.snap_to_notes();
+            if (ImGui::Checkbox("Snap to notes", &snap_to_notes)) {
+                pointer_.set_snap_to_notes(snap_to_notes);
+            }
+
+            bool proportional = pointer_.group_resize_mode() ==
+                                GroupResizeMode::Proportional;
+            if (ImGui::Checkbox("Proportional resize", &proportional)) {
+                pointer_.set_group_resize_mode(
+                    proportional ? GroupResizeMode::Proportional
+                                 : GroupResizeMode::Absolute);
+            }
+
+            int loop_ghosts = clip_loop_repetitions_;
+            if (ImGui::SliderInt("Loop ghosts", &loop_ghosts, 0, 8)) {
+                set_clip_loop_repetitions(loop_ghosts);
+            }
+
             // Display human-readable snap info (e.g. "Snap: ADAPTIVE (1/16)")
             // similar to the Python status text.
             ImGui::TextUnformatted(snap_.snap_info().c_str());
@@ -508,7 +789,16 @@ void PianoRollWidget::draw() {
             ImVec2(static_cast<float>(canvas_origin_x_),
                    static_cast<float>(canvas_origin_y_)));
     }
+    renderer_.set_clip_loop(clip_loop());
+    renderer_.set_pattern_library(&patterns_);
+    if (show_harmony_) {
+        harmony_.sync(notes_, coords_.ticks_per_beat());
+        renderer_.set_harmony(&harmony_);
+    } else {
+        renderer_.set_harmony(nullptr);
+    }
     renderer_.render(coords_, notes_);
+    auto overlay_start = FrameClock::now();
 
     // Debug: visualize the internal piano roll canvas origin and the
     // piano-key strip width using the ImGui item rect. This helps verify
@@ -576,7 +866,7 @@ void PianoRollWidget::draw() {
         ImVec2 canvas_max = ImGui::GetItemRectMax();
 
         float view_top =
-            canvas_min.y + top_padding_ + ruler_height_;
+            canvas_min.y + grid_top();
         float view_bottom = canvas_max.y;
 
         auto to_imvec4 = [](const ColorRGBA& c) {
@@ -906,22 +1196,70 @@ void PianoRollWidget::draw() {
         h_scrollbar_.render(draw_list);
     }
 
+    stats.stage(FrameStage::Overlay) += elapsed_ms(overlay_start);
+
     // Pointer, CC lane pointer, and keyboard interactions.
+    auto input_start = FrameClock::now();
     if (internal_pointer_enabled_) {
         handle_pointer_events();
     }
     if (internal_keyboard_enabled_) {
         handle_keyboard_events();
     }
+    sync_cc_selection_with_notes();
+    stats.stage(FrameStage::Input) = elapsed_ms(input_start);
 
     // CC lane.
-    if (config_.show_cc_lane && active_cc_lane_ >= 0 &&
-        active_cc_lane_ < static_cast<int>(cc_lanes_.size())) {
-        RenderControlLane(
-            cc_lanes_[static_cast<std::size_t>(active_cc_lane_)],
-            coords_,
-            config_);
+    auto cc_start = FrameClock::now();
+    if (config_.show_cc_lane) {
+        ImVec2 canvas_min = ImGui::GetItemRectMin();
+        ImVec2 canvas_max = ImGui::GetItemRectMax();
+        layout_cc_lanes(canvas_max.y - canvas_min.y);
+
+        // The visible tick window and pixel-column boundaries are computed
+        // once and shared by every stacked lane.
+        update_control_lane_frame(
+            cc_lane_frame_, coords_, canvas_min.x, canvas_max.x);
+        for (const CcLaneSlot& slot : cc_lane_slots_) {
+            if (slot.lane_index < 0 ||
+                slot.lane_index >= static_cast<int>(cc_lanes_.size())) {
+                continue;
+            }
+            RenderControlLane(
+                cc_lanes_[static_cast<std::size_t>(slot.lane_index)],
+                cc_lane_frame_,
+                canvas_min.y + slot.top,
+                canvas_min.y + slot.bottom,
+                config_,
+                slot.lane_index == active_cc_lane_);
+        }
+
+        if (cc_rect_selecting_) {
+            ImDrawList* draw_list = ImGui::GetWindowDrawList();
+            ImVec2 rect_min(canvas_min.x + std::min(cc_rect_start_x_,
+                                                    cc_rect_end_x_),
+                            canvas_min.y + std::min(cc_rect_start_y_,
+                                                    cc_rect_end_y_));
+            ImVec2 rect_max(canvas_min.x + std::max(cc_rect_start_x_,
+                                                    cc_rect_end_x_),
+                            canvas_min.y + std::max(cc_rect_start_y_,
+                                                    cc_rect_end_y_));
+            const ColorRGBA& fill = config_.selection_rect_fill_color;
+            const ColorRGBA& border = config_.selection_rect_border_color;
+            draw_list->AddRectFilled(
+                rect_min,
+                rect_max,
+                ImGui::ColorConvertFloat4ToU32(
+                    ImVec4(fill.r, fill.g, fill.b, fill.a)));
+            draw_list->AddRect(
+                rect_min,
+                rect_max,
+                ImGui::ColorConvertFloat4ToU32(
+                    ImVec4(border.r, border.g, border.b, border.a)));
+        }
     }
+    stats.stage(FrameStage::CcLane) = elapsed_ms(cc_start);
+    overlay_start = FrameClock::now();
 
     // Debug clicked-cell highlight (uses same coordinate math as Python's
     // last_clicked_cell overlay).
@@ -957,7 +1295,7 @@ void PianoRollWidget::draw() {
             canvas_min.x +
             static_cast<float>(coords_.piano_key_width());
         float grid_top =
-            canvas_min.y + top_padding_ + ruler_height_;
+            canvas_min.y + grid_top();
         float grid_right = canvas_max.x;
         float grid_bottom = canvas_max.y;
 
@@ -996,6 +1334,51 @@ void PianoRollWidget::draw() {
                            col,
                            1.0f);
     }
+    stats.stage(FrameStage::Overlay) += elapsed_ms(overlay_start);
+
+    // Idle-time storage compaction (skipped while a gesture may hold note
+    // indices or the user is actively editing).
+    if (idle_compaction_enabled_ && !notes_.storage_is_compact() &&
+        !pointer_.is_dragging_note() && !pointer_.is_resizing_note() &&
+        cc_drag_index_ < 0 && !ImGui::IsMouseDown(ImGuiMouseButton_Left)) {
+        notes_.compact_storage_step(idle_compaction_budget_);
+    }
+
+    // Collect frame stats, then draw the HUD itself (excluded from timings).
+    {
+        const RenderStats& rs = renderer_.last_render_stats();
+        stats.stage(FrameStage::Background) = rs.background_ms;
+        stats.stage(FrameStage::Notes) = rs.notes_ms;
+        stats.stage(FrameStage::Ruler) = rs.ruler_ms + rs.playhead_ms;
+        stats.visible_notes = rs.visible_notes;
+        stats.note_tiles_drawn = rs.note_tiles_drawn;
+        stats.note_tiles_built = rs.note_tiles_built;
+        stats.total_notes = notes_.notes().size();
+        int vertices_end = ImGui::GetWindowDrawList()->VtxBuffer.Size;
+        stats.vertices_emitted =
+            vertices_end > vertices_start
+                ? static_cast<std::size_t>(vertices_end - vertices_start)
+                : rs.vertices;
+        if (allocation_counter_) {
+            stats.allocations = allocation_counter_() - allocations_start;
+            stats.has_allocation_count = true;
+        }
+        stats.note_manager_bytes = notes_.memory_usage_bytes();
+        stats.undo_bytes = notes_.undo_memory_bytes();
+        stats.undo_levels = notes_.undo_levels();
+        stats.total_ms = elapsed_ms(frame_start);
+
+        frame_stats_ = stats;
+        frame_history_.push(stats.total_ms);
+
+        if (show_perf_hud_) {
+            RenderPerfHud(frame_stats_,
+                          frame_history_,
+                          static_cast<float>(coords_.piano_key_width()),
+                          grid_top(),
+                          config_);
+        }
+    }
 #else
     // No Dear ImGui; nothing to draw.
 #endif
@@ -1036,21 +1419,14 @@ void PianoRollWidget::handle_pointer_events() {
     float local_y = mouse.y - canvas_min.y;
 
     float total_height = canvas_max.y - canvas_min.y;
-    float lane_height = config_.cc_lane_height;
-    if (lane_height <= 0.0f || lane_height > total_height * 0.8f) {
-        lane_height = total_height * 0.25f;
-    }
-    float lane_top_local = total_height - lane_height;
-    float lane_bottom_local = total_height;
+    float lane_area_height = layout_cc_lanes(total_height);
+    float lane_top_local = total_height - lane_area_height;
 
     // Grid bottom (note area) sits above the horizontal scrollbar and, when
-    // enabled, above the CC lane. This mirrors the visual stack:
-    // grid -> scrollbar -> CC lane.
-    float grid_bottom_local = total_height;
-    if (config_.show_cc_lane) {
-        grid_bottom_local -= lane_height;
-    }
-    grid_bottom_local -= h_scrollbar_.track_size;
+    // enabled, above the CC lanes. This mirrors the visual stack:
+    // grid -> scrollbar -> CC lanes.
+    float grid_bottom_local =
+        total_height - lane_area_height - h_scrollbar_.track_size;
 
     ModifierKeys mods{
         .shift = io.KeyShift,
@@ -1058,9 +1434,16 @@ void PianoRollWidget::handle_pointer_events() {
         .alt = io.KeyAlt,
     };
 
-    const bool in_cc_lane =
-        config_.show_cc_lane &&
-        local_y >= lane_top_local && local_y <= lane_bottom_local;
+    // Copied: the slot list is rebuilt when the scrollbar geometry updates.
+    CcLaneSlot hovered_slot{};
+    bool in_cc_lane = false;
+    for (const CcLaneSlot& slot : cc_lane_slots_) {
+        if (local_y >= slot.top && local_y <= slot.bottom) {
+            hovered_slot = slot;
+            in_cc_lane = true;
+            break;
+        }
+    }
 
     // Mouse wheel: vertical scroll only (Bitwig-style).
     float wheel = io.MouseWheel;
@@ -1239,7 +1622,7 @@ void PianoRollWidget::handle_pointer_events() {
     // Start note-names interaction (vertical pan/zoom) when clicking in label area.
     if (left_clicked &&
         local_x >= 0.0f && local_x <= note_label_width_ &&
-        local_y >= top_padding_ + ruler_height_) {
+        local_y >= grid_top()) {
         note_names_interaction_active_ = true;
         note_names_pan_active_ = false;
         vertical_zoom_active_ = false;
@@ -1386,14 +1769,14 @@ void PianoRollWidget::handle_pointer_events() {
 
                 double view_height =
                     coords_.viewport().height -
-                    static_cast<double>(top_padding_ + ruler_height_ +
+                    static_cast<double>(grid_top() +
                                         footer_height_);
                 if (view_height <= 0.0) {
                     view_height = coords_.viewport().height;
                 }
 
                 double content_top =
-                    static_cast<double>(top_padding_ + ruler_height_);
+                    static_cast<double>(grid_top());
                 double anchor_fraction =
                     (vertical_zoom_anchor_y_ - content_top) / view_height;
                 if (anchor_fraction < 0.0) anchor_fraction = 0.0;
@@ -1433,7 +1816,7 @@ void PianoRollWidget::handle_pointer_events() {
         bool in_grid_x =
             local_x >= static_cast<float>(coords_.piano_key_width());
         bool in_grid_y =
-            local_y >= top_padding_ + ruler_height_ &&
+            local_y >= grid_top() &&
             local_y < grid_bottom_local;
         if (in_grid_x && in_grid_y) {
             auto [world_x, world_y] =
@@ -1477,7 +1860,7 @@ void PianoRollWidget::handle_pointer_events() {
             local_x >= note_label_width_ &&
             local_x < static_cast<float>(coords_.piano_key_width());
         bool in_piano_keys_y =
-            local_y >= top_padding_ + ruler_height_ &&
+            local_y >= grid_top() &&
             (!config_.show_cc_lane || local_y < lane_top_local);
         if (in_piano_keys_x && in_piano_keys_y) {
             auto [world_x_pk, world_y_pk] =
@@ -1504,7 +1887,7 @@ void PianoRollWidget::handle_pointer_events() {
             local_x >= note_label_width_ &&
             local_x < static_cast<float>(coords_.piano_key_width());
         bool in_piano_keys_y =
-            local_y >= top_padding_ + ruler_height_ &&
+            local_y >= grid_top() &&
             (!config_.show_cc_lane || local_y < lane_top_local);
         if (in_piano_keys_x && in_piano_keys_y) {
             auto [world_x_pk, world_y_pk] =
@@ -1521,13 +1904,32 @@ void PianoRollWidget::handle_pointer_events() {
     // First let the scrollbar handle events in its track area.
     handle_scrollbar_events();
 
-    if (in_cc_lane && active_cc_lane_ >= 0 &&
+    const bool cc_gesture_active = cc_dragging_ || cc_rect_selecting_;
+    if (ImGui::IsMouseClicked(ImGuiMouseButton_Left)) {
+        cc_lane_focused_ = in_cc_lane;
+        if (in_cc_lane && !cc_gesture_active) {
+            // Clicking a stacked lane makes it the one receiving edits.
+            if (hovered_slot.lane_index >= 0) {
+                active_cc_lane_ = hovered_slot.lane_index;
+            }
+            cc_gesture_top_ = hovered_slot.top;
+            cc_gesture_bottom_ = hovered_slot.bottom;
+        }
+    }
+
+    // CC gestures keep receiving events after leaving the lane so drags and
+    // selection rectangles can finish anywhere on the canvas; they stay
+    // mapped to the rows of the lane they started in.
+    if ((in_cc_lane || cc_gesture_active) &&
+        active_cc_lane_ >= 0 &&
         active_cc_lane_ < static_cast<int>(cc_lanes_.size())) {
-        handle_cc_pointer_events(local_x,
-                                 local_y,
-                                 lane_top_local,
-                                 lane_bottom_local,
-                                 mods);
+        const bool use_gesture_rows = cc_gesture_active || !in_cc_lane;
+        handle_cc_pointer_events(
+            local_x,
+            local_y,
+            use_gesture_rows ? cc_gesture_top_ : hovered_slot.top,
+            use_gesture_rows ? cc_gesture_bottom_ : hovered_slot.bottom,
+            mods);
     } else {
         // Avoid forwarding clicks that land on the horizontal scrollbar
         // into the note grid / ruler. Scrollbar has its own handlers.
@@ -1545,36 +1947,40 @@ void PianoRollWidget::handle_pointer_events() {
         bool in_grid_x =
             local_x >= static_cast<float>(coords_.piano_key_width());
         bool in_grid_y =
-            local_y >= top_padding_ + ruler_height_ &&
+            local_y >= grid_top() &&
             (!config_.show_cc_lane || local_y < lane_top_local);
         bool in_main_grid = in_grid_x && in_grid_y;
 
         if (ImGui::IsMouseClicked(ImGuiMouseButton_Left) &&
             !in_scrollbar &&
             in_main_grid) {
-            pointer_.on_mouse_down(MouseButton::Left,
-                                   local_x,
-                                   local_y,
-                                   mods);
+            begin_pointer_gesture(local_x, local_y);
+            active_pointer().on_mouse_down(MouseButton::Left,
+                                           local_x,
+                                           local_y,
+                                           mods);
         }
         if (ImGui::IsMouseReleased(ImGuiMouseButton_Left)) {
-            pointer_.on_mouse_up(MouseButton::Left,
-                                 local_x,
-                                 local_y,
-                                 mods);
+            active_pointer().on_mouse_up(MouseButton::Left,
+                                         local_x,
+                                         local_y,
+                                         mods);
+            finish_pattern_edit();
         }
         if (ImGui::IsMouseDown(ImGuiMouseButton_Left)) {
-            if (pointer_.has_selection_rectangle()) {
+            PointerTool& tool = active_pointer();
+            if (tool.has_selection_rectangle()) {
                 check_rectangle_edge_scrolling(local_x, local_y);
             }
-            pointer_.on_mouse_move(local_x, local_y, mods);
+            tool.on_mouse_move(local_x, local_y, mods);
         }
         if (ImGui::IsMouseDoubleClicked(ImGuiMouseButton_Left) &&
             in_main_grid) {
-            pointer_.on_double_click(MouseButton::Left,
-                                     local_x,
-                                     local_y,
-                                     mods);
+            active_pointer().on_double_click(MouseButton::Left,
+                                             local_x,
+                                             local_y,
+                                             mods);
+            finish_pattern_edit();
         }
 
          if (left_released && piano_key_pressed_active_) {
@@ -1604,7 +2010,7 @@ bool PianoRollWidget::check_rectangle_edge_scrolling(float local_x,
     float left_edge =
         static_cast<float>(coords_.piano_key_width()) + margin;
     float right_edge = widget_width - margin;
-    float top_edge = top_padding_ + ruler_height_ + margin;
+    float top_edge = grid_top() + margin;
     float bottom_edge =
         widget_height - footer_height_ - h_scrollbar_.track_size - margin;
 
@@ -1632,8 +2038,12 @@ bool PianoRollWidget::check_rectangle_edge_scrolling(float local_x,
     }
 
     if (h_scroll != 0.0 || v_scroll != 0.0) {
-        double new_x = coords_.viewport().x + h_scroll;
-        double new_y = coords_.viewport().y + v_scroll;
+        // The speeds above are pixels per 60 Hz frame, as in the Python
+        // original; scale them by the frame delta so the scroll rate does
+        // not depend on the frame rate (capped after long stalls).
+        const double frame_scale = std::min(frame_delta_ * 60.0, 4.0);
+        double new_x = coords_.viewport().x + h_scroll * frame_scale;
+        double new_y = coords_.viewport().y + v_scroll * frame_scale;
         coords_.set_scroll(new_x, new_y);
         expand_explored_area(new_x);
         update_scrollbar_geometry();
@@ -1656,6 +2066,116 @@ void PianoRollWidget::set_active_cc_lane_index(int index) noexcept {
     }
 }
 
+ControlLane* PianoRollWidget::active_cc_lane() noexcept {
+    if (active_cc_lane_ < 0 ||
+        active_cc_lane_ >= static_cast<int>(cc_lanes_.size())) {
+        return nullptr;
+    }
+    return &cc_lanes_[static_cast<std::size_t>(active_cc_lane_)];
+}
+
+void PianoRollWidget::set_visible_cc_lanes(std::vector<CcLaneView> views) {
+    cc_lane_views_ = std::move(views);
+    cc_lane_slots_.clear();
+    for (const CcLaneView& view : cc_lane_views_) {
+        if (view.lane_index == active_cc_lane_) {
+            return;
+        }
+    }
+    // Keep editing on a lane that is actually on screen.
+    for (const CcLaneView& view : cc_lane_views_) {
+        if (view.lane_index >= 0 &&
+            view.lane_index < static_cast<int>(cc_lanes_.size())) {
+            active_cc_lane_ = view.lane_index;
+            return;
+        }
+    }
+}
+
+float PianoRollWidget::layout_cc_lanes(float total_height) {
+    cc_lane_slots_.clear();
+    if (!config_.show_cc_lane || total_height <= 0.0f) {
+        return 0.0f;
+    }
+
+    float default_height = config_.cc_lane_height;
+    if (default_height <= 0.0f || default_height > total_height * 0.8f) {
+        default_height = total_height * 0.25f;
+    }
+
+    if (cc_lane_views_.empty()) {
+        // Single-lane layout: the area is reserved even before a lane is
+        // chosen, matching the lane selector's "show" state.
+        cc_lane_slots_.push_back(CcLaneSlot{
+            active_cc_lane_, total_height - default_height, total_height});
+        return default_height;
+    }
+
+    float stacked_height = 0.0f;
+    for (const CcLaneView& view : cc_lane_views_) {
+        if (view.lane_index < 0 ||
+            view.lane_index >= static_cast<int>(cc_lanes_.size())) {
+            continue;
+        }
+        stacked_height += view.height > 0.0f ? view.height : default_height;
+    }
+    if (stacked_height <= 0.0f) {
+        return 0.0f;
+    }
+    const float scale = stacked_height > total_height * 0.8f
+                            ? total_height * 0.8f / stacked_height
+                            : 1.0f;
+
+    float top = total_height - stacked_height * scale;
+    const float area_top = top;
+    for (const CcLaneView& view : cc_lane_views_) {
+        if (view.lane_index < 0 ||
+            view.lane_index >= static_cast<int>(cc_lanes_.size())) {
+            continue;
+        }
+        float height =
+            (view.height > 0.0f ? view.height : default_height) * scale;
+        cc_lane_slots_.push_back(
+            CcLaneSlot{view.lane_index, top, top + height});
+        top += height;
+    }
+    return total_height - area_top;
+}
+
+void PianoRollWidget::sync_cc_selection_with_notes() {
+    if (!cc_selection_follows_notes_ || cc_lanes_.empty()) {
+        return;
+    }
+    // Runs every frame: nothing to do until the notes or selection change.
+    if (notes_.revision() == cc_sync_revision_) {
+        return;
+    }
+    cc_sync_revision_ = notes_.revision();
+
+    SelectionSpan span{};
+    MidiKey min_key = 0;
+    MidiKey max_key = 0;
+    if (!notes_.selection_bounds(span.start, span.end, min_key, max_key)) {
+        span = SelectionSpan{};
+    } else {
+        span.any = true;
+    }
+
+    // Only react to changes so CC-only selections made afterwards persist.
+    if (span == last_note_selection_span_) {
+        return;
+    }
+    last_note_selection_span_ = span;
+
+    for (ControlLane& lane : cc_lanes_) {
+        if (!span.any) {
+            lane.clear_selection();
+        } else {
+            lane.select_range(span.start, span.end);
+        }
+    }
+}
+
 void PianoRollWidget::set_loop_enabled(bool enabled) noexcept {
     loop_markers_.enabled = enabled;
     loop_markers_.visible = enabled;
@@ -1715,36 +2235,95 @@ void PianoRollWidget::handle_cc_pointer_events(float local_x,
     if (mouse_clicked) {
         // Ctrl-click near a point deletes it.
         if (io.KeyCtrl) {
-            if (lane.remove_near(tick, threshold)) {
+            int idx = lane.index_near(tick, threshold);
+            if (idx >= 0) {
+                lane.snapshot_for_undo();
+                lane.remove_near(tick, threshold);
                 return;
             }
         }
 
-        // Try to start dragging an existing point.
+        // Clicking a point selects it (Shift adds to the selection) unless it
+        // is already selected, then starts dragging the whole selection.
         int idx = lane.index_near(tick, threshold);
         if (idx >= 0) {
+            const ControlPoint* hit = lane.point_at_index(idx);
+            if (hit != nullptr && !hit->selected) {
+                lane.select_index(idx, mods.shift);
+            }
+            cc_drag_origin_ = lane.points();
+            cc_drag_moved_ = false;
+            cc_drag_start_tick_ = tick;
+            cc_drag_start_value_ = cc_value;
             cc_dragging_ = true;
             cc_drag_index_ = idx;
-            lane.set_value(idx, cc_value);
             return;
         }
 
-        // Otherwise create a new point.
-        lane.add_point(tick, cc_value);
+        // Otherwise start a selection rectangle; a click without movement
+        // adds a point on release.
+        cc_rect_selecting_ = true;
+        cc_rect_start_x_ = cc_rect_end_x_ = local_x;
+        cc_rect_start_y_ = cc_rect_end_y_ = local_y;
         cc_dragging_ = false;
         cc_drag_index_ = -1;
         return;
     }
 
-    if (mouse_down && cc_dragging_ && cc_drag_index_ >= 0) {
-        // Whilst dragging, update tick and value.
-        lane.set_value(cc_drag_index_, cc_value);
-        lane.set_tick(cc_drag_index_, tick);
+    if (mouse_down && cc_dragging_) {
+        // The undo step is taken once the points first move, so a click
+        // that only selects records none. Re-apply the total delta to the
+        // points captured at drag start so clamping at tick 0 / value bounds
+        // never accumulates.
+        const Tick delta_tick = tick - cc_drag_start_tick_;
+        const int delta_value = cc_value - cc_drag_start_value_;
+        if (!cc_drag_moved_ && (delta_tick != 0 || delta_value != 0)) {
+            cc_drag_moved_ = true;
+            lane.snapshot_for_undo();
+        }
+        if (cc_drag_moved_) {
+            lane.points() = cc_drag_origin_;
+            lane.translate_selected(delta_tick,
+                                    delta_value,
+                                    /*record_undo=*/false);
+        }
+    }
+
+    if (mouse_down && cc_rect_selecting_) {
+        cc_rect_end_x_ = local_x;
+        cc_rect_end_y_ = std::clamp(local_y, lane_top_local, lane_bottom_local);
     }
 
     if (mouse_released) {
+        if (cc_rect_selecting_) {
+            cc_rect_selecting_ = false;
+            constexpr float kClickSlop = 3.0f;
+            if (std::abs(cc_rect_end_x_ - cc_rect_start_x_) < kClickSlop &&
+                std::abs(cc_rect_end_y_ - cc_rect_start_y_) < kClickSlop) {
+                lane.snapshot_for_undo();
+                lane.clear_selection();
+                lane.add_point(tick, cc_value);
+            } else {
+                auto x_to_tick = [this](float x) {
+                    auto [wx, wy] = coords_.screen_to_world(x, 0.0);
+                    (void)wy;
+                    return coords_.world_to_tick(wx);
+                };
+                auto y_to_value = [&](float y) {
+                    float ty = (y - lane_top_local) / lane_height;
+                    ty = std::clamp(ty, 0.0f, 1.0f);
+                    return static_cast<int>((1.0f - ty) * 127.0f + 0.5f);
+                };
+                Tick t1 = x_to_tick(std::min(cc_rect_start_x_, cc_rect_end_x_));
+                Tick t2 = x_to_tick(std::max(cc_rect_start_x_, cc_rect_end_x_));
+                int v_hi = y_to_value(std::min(cc_rect_start_y_, cc_rect_end_y_));
+                int v_lo = y_to_value(std::max(cc_rect_start_y_, cc_rect_end_y_));
+                lane.select_range(t1, t2 + 1, v_lo, v_hi, mods.shift);
+            }
+        }
         cc_dragging_ = false;
         cc_drag_index_ = -1;
+        cc_drag_origin_.clear();
     }
 #else
     (void)local_x;
@@ -1770,14 +2349,27 @@ void PianoRollWidget::handle_keyboard_events() {
         return ImGui::IsKeyPressed(imgui_key) ? true : false;
     };
 
+    // While the CC lane has focus (the last click landed in it), delete,
+    // select-all and undo/redo act on the active lane's points.
+    ControlLane* focused_lane =
+        cc_lane_focused_ && config_.show_cc_lane ? active_cc_lane() : nullptr;
+
     if (map_key(ImGuiKey_Delete, Key::Delete)) {
-        keyboard_.on_key_press(Key::Delete, mods);
+        if (!(focused_lane && focused_lane->delete_selected() > 0)) {
+            keyboard_.on_key_press(Key::Delete, mods);
+        }
     }
     if (map_key(ImGuiKey_Backspace, Key::Backspace)) {
-        keyboard_.on_key_press(Key::Backspace, mods);
+        if (!(focused_lane && focused_lane->delete_selected() > 0)) {
+            keyboard_.on_key_press(Key::Backspace, mods);
+        }
     }
     if (map_key(ImGuiKey_A, Key::A)) {
-        keyboard_.on_key_press(Key::A, mods);
+        if (focused_lane && mods.ctrl) {
+            focused_lane->select_all();
+        } else {
+            keyboard_.on_key_press(Key::A, mods);
+        }
     }
     if (map_key(ImGuiKey_C, Key::C)) {
         keyboard_.on_key_press(Key::C, mods);
@@ -1795,10 +2387,55 @@ void PianoRollWidget::handle_keyboard_events() {
         }
     }
     if (map_key(ImGuiKey_Z, Key::Z)) {
-        keyboard_.on_key_press(Key::Z, mods);
+        if (focused_lane && mods.ctrl) {
+            if (mods.shift) {
+                focused_lane->redo();
+            } else {
+                focused_lane->undo();
+            }
+        } else if (mods.ctrl) {
+            undo();
+        } else {
+            keyboard_.on_key_press(Key::Z, mods);
+        }
     }
     if (map_key(ImGuiKey_Y, Key::Y)) {
-        keyboard_.on_key_press(Key::Y, mods);
+        if (focused_lane && mods.ctrl) {
+            focused_lane->redo();
+        } else if (mods.ctrl) {
+            redo();
+        } else {
+            keyboard_.on_key_press(Key::Y, mods);
+        }
+    }
+    // S cycles the shape of the segments starting at the selected points:
+    // linear -> exponential -> bezier -> hold -> linear.
+    if (focused_lane && !mods.ctrl && ImGui::IsKeyPressed(ImGuiKey_S, false)) {
+        CurveShape current = CurveShape::Linear;
+        for (const ControlPoint& p : focused_lane->points()) {
+            if (p.selected) {
+                current = p.shape;
+                break;
+            }
+        }
+        CurveShape next = CurveShape::Linear;
+        switch (current) {
+        case CurveShape::Linear:
+            next = CurveShape::Exponential;
+            break;
+        case CurveShape::Exponential:
+            next = CurveShape::Bezier;
+            break;
+        case CurveShape::Bezier:
+            next = CurveShape::Hold;
+            break;
+        case CurveShape::Hold:
+            next = CurveShape::Linear;
+            break;
+        }
+        const bool bends = next == CurveShape::Exponential ||
+                           next == CurveShape::Bezier;
+        focused_lane->set_selected_shape(next, bends ? 0.5f : 0.0f);
     }
 
     bool moved = false;
@@ -1822,36 +2459,11 @@ void PianoRollWidget::handle_keyboard_events() {
 }
 
 void PianoRollWidget::ensure_selected_notes_visible() {
-    const auto& ns = notes_.notes();
-    if (ns.empty()) {
-        return;
-    }
-
-    bool any_selected = false;
     Tick min_tick = 0;
     Tick max_tick = 0;
     MidiKey min_key = 0;
     MidiKey max_key = 0;
-
-    for (const Note& n : ns) {
-        if (!n.selected) {
-            continue;
-        }
-        if (!any_selected) {
-            any_selected = true;
-            min_tick = n.tick;
-            max_tick = n.end_tick();
-            min_key = n.key;
-            max_key = n.key;
-        } else {
-            if (n.tick < min_tick) min_tick = n.tick;
-            if (n.end_tick() > max_tick) max_tick = n.end_tick();
-            if (n.key < min_key) min_key = n.key;
-            if (n.key > max_key) max_key = n.key;
-        }
-    }
-
-    if (!any_selected) {
+    if (!selection_bounds(min_tick, max_tick, min_key, max_key)) {
         return;
     }
 
@@ -1911,14 +2523,7 @@ void PianoRollWidget::update_scrollbar_geometry() {
                                   static_cast<float>(coords_.piano_key_width()));
     float y = canvas_max.y - h_scrollbar_.track_size;
 
-    if (config_.show_cc_lane) {
-        float lane_height = config_.cc_lane_height;
-        if (lane_height <= 0.0f || lane_height > widget_height * 0.8f) {
-            lane_height = widget_height * 0.25f;
-        }
-        float lane_top = canvas_max.y - lane_height;
-        y = lane_top - h_scrollbar_.track_size;
-    }
+    y -= layout_cc_lanes(widget_height);
 
     h_scrollbar_.update_geometry(x,
                                  static_cast<int>(y),
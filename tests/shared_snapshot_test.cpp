@@ -0,0 +1,354 @@
+// Cross-process test for the shared-memory snapshot export
+// (shared_snapshot.hpp). The parent publishes generations with
+// SharedSnapshotWriter; a forked child maps the segment read-only with
+// SharedSnapshotReader and checks what it sees:
+//
+//   lockstep  the parent publishes one snapshot at a time and reports its
+//             generation and revision over a pipe; the child checks both and
+//             that every record round-trips. One step outgrows the segment,
+//             so the reader has to remap.
+//   odd       the parent forces the generation odd, as a writer stopped
+//             mid-update would leave it; the child must accept no snapshot.
+//   stress    the parent publishes as fast as it can while the child reads;
+//             every accepted snapshot must have an even, non-decreasing
+//             generation and records that all belong to one publish.
+//
+// Exit status 0 on success; failures are printed with the checking side.
+
+#include "piano_roll/shared_snapshot.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace piano_roll;
+
+namespace {
+
+int failures = 0;
+
+#define CHECK(cond)                                                        \
+    do {                                                                   \
+        if (!(cond)) {                                                     \
+            std::fprintf(stderr, "[%d] %s:%d: CHECK(%s) failed\n",         \
+                         static_cast<int>(::getpid()), __FILE__, __LINE__, \
+                         #cond);                                           \
+            ++failures;                                                    \
+        }                                                                  \
+    } while (0)
+
+enum class Phase : std::uint32_t {
+    Lockstep = 0,
+    Odd = 1,
+    Stress = 2,
+    Done = 3,
+};
+
+struct Message {
+    Phase phase{Phase::Done};
+    std::uint64_t step{0};
+    std::uint64_t generation{0};
+    std::uint64_t revision{0};
+};
+
+constexpr std::size_t kInitialBytes = 4096;
+constexpr std::uint64_t kGrowthStep = 3;
+constexpr std::uint64_t kLockstepSteps = 6;
+constexpr std::uint64_t kStressFirst = 100;
+constexpr std::uint64_t kStressLast = 400;
+
+// Snapshot content is a pure function of the step, so the child can check
+// records without seeing the parent's NoteManager. The step is recoverable
+// from any note (duration - 120).
+std::size_t note_count(std::uint64_t step) {
+    if (step == kGrowthStep) {
+        return 20000;  // 640 KB of note records, far past kInitialBytes
+    }
+    return 3 + static_cast<std::size_t>(step % 97) * 7;
+}
+
+Note expected_note(std::uint64_t step, std::size_t i) {
+    Note note;
+    note.tick = static_cast<Tick>(i) * 240;
+    note.duration = 120 + static_cast<Duration>(step);
+    note.key = 36 + static_cast<MidiKey>(i % 48);
+    note.velocity = 1 + static_cast<Velocity>(step % 127);
+    note.channel = static_cast<Channel>(step % 16);
+    note.selected = i % 3 == 0;
+    return note;
+}
+
+std::size_t point_count(std::uint64_t step) {
+    return 2 + static_cast<std::size_t>(step % 5);
+}
+
+ControlPoint expected_point(std::uint64_t step, std::size_t j) {
+    ControlPoint point;
+    point.tick = static_cast<Tick>(j) * 480;
+    point.value = static_cast<int>((j * 10 + step) % 128);
+    point.shape = static_cast<CurveShape>(j % kCurveShapeCount);
+    point.tension = 0.25f;
+    point.selected = j == 1;
+    return point;
+}
+
+void build(std::uint64_t step,
+           NoteManager& notes,
+           std::vector<ControlLane>& lanes) {
+    std::vector<Note> content(note_count(step));
+    for (std::size_t i = 0; i < content.size(); ++i) {
+        content[i] = expected_note(step, i);
+    }
+    notes.clear();
+    notes.add_notes(content, /*record_undo=*/false);
+
+    lanes.assign(1, ControlLane(1 + static_cast<int>(step % 3)));
+    std::vector<ControlPoint> points(point_count(step));
+    for (std::size_t j = 0; j < points.size(); ++j) {
+        points[j] = expected_point(step, j);
+    }
+    lanes[0].replace_points(std::move(points), /*record_undo=*/false);
+}
+
+// Records copied out of a view inside SharedSnapshotReader::read.
+struct Copy {
+    std::uint64_t generation{0};
+    std::uint64_t revision{0};
+    std::vector<SharedNoteRecord> notes;
+    std::vector<SharedLaneRecord> lanes;
+    std::vector<SharedControlPointRecord> points;
+};
+
+bool read_copy(SharedSnapshotReader& reader, Copy& copy) {
+    return reader.read([&copy](const SharedSnapshotView& view) {
+        copy.generation = view.generation;
+        copy.revision = view.revision;
+        copy.notes.assign(view.notes.begin(), view.notes.end());
+        copy.lanes.assign(view.lanes.begin(), view.lanes.end());
+        copy.points.assign(view.points.begin(), view.points.end());
+    });
+}
+
+// Whether every record of the copy matches the content of `step`.
+bool matches_step(const Copy& copy, std::uint64_t step) {
+    if (copy.notes.size() != note_count(step) || copy.lanes.size() != 1 ||
+        copy.points.size() != point_count(step)) {
+        return false;
+    }
+    for (std::size_t i = 0; i < copy.notes.size(); ++i) {
+        const SharedNoteRecord& r = copy.notes[i];
+        const Note n = expected_note(step, i);
+        if (r.tick != n.tick || r.duration != n.duration || r.key != n.key ||
+            r.velocity != n.velocity || r.channel != n.channel ||
+            ((r.flags & kSharedSelected) != 0) != n.selected || r.id == 0) {
+            return false;
+        }
+    }
+    const SharedLaneRecord& lane = copy.lanes[0];
+    if (lane.cc_number != 1 + static_cast<int>(step % 3) ||
+        lane.first_point != 0 || lane.point_count != copy.points.size()) {
+        return false;
+    }
+    for (std::size_t j = 0; j < copy.points.size(); ++j) {
+        const SharedControlPointRecord& r = copy.points[j];
+        const ControlPoint p = expected_point(step, j);
+        if (r.tick != p.tick || r.value != p.value ||
+            r.shape != static_cast<std::uint8_t>(p.shape) ||
+            r.tension != p.tension ||
+            ((r.flags & kSharedSelected) != 0) != p.selected) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool send(int fd, const Message& message) {
+    return ::write(fd, &message, sizeof(message)) ==
+           static_cast<ssize_t>(sizeof(message));
+}
+
+bool receive(int fd, Message& message) {
+    return ::read(fd, &message, sizeof(message)) ==
+           static_cast<ssize_t>(sizeof(message));
+}
+
+int run_child(const std::string& name, int from_parent, int to_parent) {
+    SharedSnapshotReader reader;
+    CHECK(reader.open(name));
+    Message message;
+    Copy copy;
+    std::uint64_t last_generation = 0;
+    while (receive(from_parent, message) && message.phase != Phase::Done) {
+        if (message.phase == Phase::Lockstep) {
+            CHECK(read_copy(reader, copy));
+            CHECK(copy.generation == message.generation);
+            CHECK(copy.generation % 2 == 0);
+            CHECK(copy.generation >= last_generation);
+            CHECK(copy.revision == message.revision);
+            CHECK(matches_step(copy, message.step));
+            CHECK(reader.generation() == message.generation);
+            last_generation = copy.generation;
+        } else if (message.phase == Phase::Odd) {
+            CHECK(reader.generation() % 2 == 1);
+            bool called = false;
+            const bool accepted = reader.read(
+                [&called](const SharedSnapshotView&) { called = true; }, 16);
+            CHECK(!accepted);
+            CHECK(!called);
+            CHECK(reader.error().empty());  // not stable, but not invalid
+        } else if (message.phase == Phase::Stress) {
+            // Read until the last stress step shows up; the parent is
+            // publishing concurrently.
+            const auto deadline =
+                std::chrono::steady_clock::now() + std::chrono::seconds(20);
+            std::uint64_t last_step = kLockstepSteps - 1;  // still published
+            std::size_t accepted = 0;
+            while (last_step != kStressLast &&
+                   std::chrono::steady_clock::now() < deadline) {
+                if (!read_copy(reader, copy)) {
+                    CHECK(reader.error().empty());
+                    continue;
+                }
+                ++accepted;
+                CHECK(copy.generation % 2 == 0);
+                CHECK(copy.generation >= last_generation);
+                CHECK(!copy.notes.empty());
+                if (copy.notes.empty()) {
+                    break;
+                }
+                const auto step =
+                    static_cast<std::uint64_t>(copy.notes[0].duration - 120);
+                CHECK(matches_step(copy, step));
+                CHECK(copy.generation != last_generation || step == last_step);
+                CHECK(step >= last_step);
+                last_generation = copy.generation;
+                last_step = step;
+            }
+            CHECK(last_step == kStressLast);
+            std::printf("child: %zu consistent snapshots during stress\n",
+                        accepted);
+        }
+        if (!send(to_parent, message)) {
+            ++failures;
+            break;
+        }
+    }
+    reader.close();
+    std::fflush(stdout);
+    return failures == 0 ? 0 : 1;
+}
+
+// Flip the generation to odd (or back) through a second, writable mapping,
+// as a writer that stopped mid-update would leave it.
+bool set_generation(const std::string& name, std::uint64_t generation) {
+    const int fd = ::shm_open(name.c_str(), O_RDWR, 0);
+    if (fd < 0) {
+        return false;
+    }
+    void* mapped = ::mmap(nullptr,
+                          sizeof(SharedSnapshotHeader),
+                          PROT_READ | PROT_WRITE,
+                          MAP_SHARED,
+                          fd,
+                          0);
+    ::close(fd);
+    if (mapped == MAP_FAILED) {
+        return false;
+    }
+    auto* header = static_cast<SharedSnapshotHeader*>(mapped);
+    std::atomic_ref<std::uint64_t>(header->generation)
+        .store(generation, std::memory_order_release);
+    ::munmap(mapped, sizeof(SharedSnapshotHeader));
+    return true;
+}
+
+}  // namespace
+
+int main() {
+    const std::string name =
+        "/piano_roll_snapshot_test." + std::to_string(::getpid());
+    SharedSnapshotWriter writer;
+    if (!writer.create(name, kInitialBytes)) {
+        std::fprintf(stderr, "create: %s\n", writer.error().c_str());
+        return 1;
+    }
+    NoteManager notes;
+    notes.set_max_undo_levels(0);
+    std::vector<ControlLane> lanes;
+    build(0, notes, lanes);
+    CHECK(writer.publish(notes, lanes));
+
+    int down[2];
+    int up[2];
+    if (::pipe(down) != 0 || ::pipe(up) != 0) {
+        std::perror("pipe");
+        return 1;
+    }
+    const pid_t child = ::fork();
+    if (child < 0) {
+        std::perror("fork");
+        return 1;
+    }
+    if (child == 0) {
+        ::close(down[1]);
+        ::close(up[0]);
+        // _exit: the inherited writer must not unlink the segment.
+        ::_exit(run_child(name, down[0], up[1]));
+    }
+    ::close(down[0]);
+    ::close(up[1]);
+
+    Message reply;
+    auto round_trip = [&](const Message& message) {
+        CHECK(send(down[1], message));
+        CHECK(receive(up[0], reply));
+        CHECK(reply.phase == message.phase);
+    };
+
+    for (std::uint64_t step = 0; step < kLockstepSteps; ++step) {
+        if (step > 0) {
+            build(step, notes, lanes);
+            CHECK(writer.publish(notes, lanes));
+        }
+        round_trip(Message{
+            Phase::Lockstep, step, writer.generation(), notes.revision()});
+    }
+
+    const std::uint64_t stable = writer.generation();
+    CHECK(set_generation(name, stable + 1));
+    round_trip(Message{Phase::Odd, 0, stable + 1, 0});
+    CHECK(set_generation(name, stable));
+    round_trip(Message{
+        Phase::Lockstep, kLockstepSteps - 1, stable, notes.revision()});
+
+    // The child starts reading once it has the message; publish meanwhile.
+    CHECK(send(down[1], Message{Phase::Stress, 0, 0, 0}));
+    for (std::uint64_t step = kStressFirst; step <= kStressLast; ++step) {
+        build(step, notes, lanes);
+        CHECK(writer.publish(notes, lanes));
+    }
+    CHECK(receive(up[0], reply));
+    CHECK(reply.phase == Phase::Stress);
+
+    CHECK(send(down[1], Message{Phase::Done, 0, 0, 0}));
+    ::close(down[1]);
+    int status = 0;
+    CHECK(::waitpid(child, &status, 0) == child);
+    CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    ::close(up[0]);
+
+    if (failures != 0) {
+        std::fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+    std::puts("shared snapshot cross-process test passed");
+    return 0;
+}
@@ -0,0 +1,277 @@
+// piano_roll_ipc_bench: throughput and latency benchmark for the local
+// command channel (command_channel.hpp). By default it runs a server and a
+// simulated UI frame loop in-process; with --connect it load-tests a
+// running application's server instead. See usage() for the options.
+
+#include "piano_roll/command_channel.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+using namespace piano_roll;
+
+namespace {
+
+void usage() {
+    std::fputs(
+        "usage: piano_roll_ipc_bench [options]\n"
+        "\n"
+        "options:\n"
+        "  --connect <path>     benchmark an existing server instead of an\n"
+        "                       in-process one\n"
+        "  --batches <n>        batches to send (default 200)\n"
+        "  --notes <n>          notes inserted per batch (default 256)\n"
+        "  --inflight <n>       batches sent before waiting for a response\n"
+        "                       (default 4)\n"
+        "  --frame-ms <f>       in-process UI frame interval; 0 processes\n"
+        "                       continuously (default 16.7)\n"
+        "  --no-undo            in-process server records no undo steps\n",
+        stderr);
+}
+
+struct Options {
+    std::string connect;
+    std::size_t batches{200};
+    std::size_t notes{256};
+    std::size_t inflight{4};
+    double frame_ms{16.7};
+    bool record_undo{true};
+};
+
+template <typename T>
+bool parse_number(std::string_view text, T& out) {
+    const char* end = text.data() + text.size();
+    auto [ptr, ec] = std::from_chars(text.data(), end, out);
+    return ec == std::errc() && ptr == end;
+}
+
+bool parse_options(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view arg = argv[i];
+        const bool has_value = i + 1 < argc;
+        if (arg == "--no-undo") {
+            options.record_undo = false;
+        } else if (arg == "--connect" && has_value) {
+            options.connect = argv[++i];
+        } else if (arg == "--batches" && has_value) {
+            if (!parse_number(argv[++i], options.batches)) {
+                return false;
+            }
+        } else if (arg == "--notes" && has_value) {
+            if (!parse_number(argv[++i], options.notes)) {
+                return false;
+            }
+        } else if (arg == "--inflight" && has_value) {
+            if (!parse_number(argv[++i], options.inflight) ||
+                options.inflight == 0) {
+                return false;
+            }
+        } else if (arg == "--frame-ms" && has_value) {
+            if (!parse_number(argv[++i], options.frame_ms) ||
+                options.frame_ms < 0.0) {
+                return false;
+            }
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+double percentile(std::vector<double> values, double fraction) {
+    if (values.empty()) {
+        return 0.0;
+    }
+    const auto index = static_cast<std::size_t>(
+        fraction * static_cast<double>(values.size() - 1));
+    std::nth_element(values.begin(),
+                     values.begin() + static_cast<std::ptrdiff_t>(index),
+                     values.end());
+    return values[index];
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parse_options(argc, argv, options)) {
+        usage();
+        return 2;
+    }
+
+    // In-process server with a UI thread that applies batches once per
+    // simulated frame, as PianoRollWidget::draw does.
+    NoteManager notes;
+    notes.set_max_undo_levels(16);
+    CommandServerOptions server_options;
+    server_options.record_undo = options.record_undo;
+    CommandServer server(server_options);
+    std::atomic<bool> done{false};
+    std::thread ui;
+    std::string path = options.connect;
+    if (path.empty()) {
+        path = "/tmp/piano_roll_ipc_bench." + std::to_string(::getpid()) +
+               ".sock";
+        if (!server.start(path)) {
+            std::fprintf(stderr, "server: %s\n", server.error().c_str());
+            return 1;
+        }
+        const auto frame = std::chrono::duration<double, std::milli>(
+            options.frame_ms);
+        ui = std::thread([&] {
+            while (!done) {
+                server.process(notes);
+                if (options.frame_ms > 0.0) {
+                    std::this_thread::sleep_for(frame);
+                } else {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+
+    CommandClient client;
+    if (!client.connect(path)) {
+        std::fprintf(stderr, "connect: %s\n", client.error().c_str());
+        done = true;
+        if (ui.joinable()) {
+            ui.join();
+        }
+        return 1;
+    }
+
+    // Each batch inserts fresh notes, moves the notes of the last insert
+    // whose ids came back, and every tenth batch queries a range and
+    // reselects by velocity.
+    using Clock = std::chrono::steady_clock;
+    std::mt19937 rng(1);
+    std::vector<Note> fresh(options.notes);
+    std::vector<CommandNoteMove> moves;
+    std::deque<Clock::time_point> sent_at;
+    std::vector<double> round_trip_ms;
+    std::vector<double> apply_ms;
+    std::vector<double> queued_ms;
+    round_trip_ms.reserve(options.batches);
+    std::size_t sent = 0;
+    std::size_t received = 0;
+    std::size_t inserted = 0;
+    std::size_t moved = 0;
+    bool ok = true;
+
+    const auto start = Clock::now();
+    while (ok && received < options.batches) {
+        while (sent < options.batches &&
+               sent - received < options.inflight) {
+            CommandBatch batch;
+            const Tick base = static_cast<Tick>(sent) * 1920;
+            for (Note& note : fresh) {
+                note.tick = base + static_cast<Tick>(rng() % 1920);
+                note.duration = 60 + static_cast<Duration>(rng() % 420);
+                note.key = 36 + static_cast<MidiKey>(rng() % 48);
+                note.velocity = 40 + static_cast<Velocity>(rng() % 88);
+            }
+            batch.insert_notes(fresh);
+            if (!moves.empty()) {
+                batch.move_notes(moves);
+                moves.clear();
+            }
+            if (sent % 10 == 9) {
+                batch.query_range(base - 19200, base, 0, 127);
+                CommandNoteFilter filter = CommandBatch::match_all();
+                filter.min_velocity = 100;
+                batch.select_where(filter);
+            }
+            if (client.send(batch) == 0) {
+                ok = false;
+                break;
+            }
+            sent_at.push_back(Clock::now());
+            ++sent;
+        }
+        if (!ok) {
+            break;
+        }
+
+        CommandBatchResult result;
+        if (!client.receive(result)) {
+            ok = false;
+            break;
+        }
+        round_trip_ms.push_back(std::chrono::duration<double, std::milli>(
+                                    Clock::now() - sent_at.front())
+                                    .count());
+        sent_at.pop_front();
+        apply_ms.push_back(static_cast<double>(result.apply_ns) * 1e-6);
+        queued_ms.push_back(static_cast<double>(result.queued_ns) * 1e-6);
+        ++received;
+        if (result.status != CommandStatus::Ok) {
+            std::fprintf(stderr, "batch %u rejected\n", result.batch_id);
+            ok = false;
+            break;
+        }
+        for (const CommandResult& r : result.results) {
+            if (r.opcode == CommandOpcode::InsertNotes) {
+                inserted += r.count;
+                moves.clear();
+                for (NoteId id : r.ids) {
+                    if (id != 0) {
+                        moves.push_back(CommandNoteMove{id, 10, 1, 0});
+                    }
+                }
+            } else if (r.opcode == CommandOpcode::MoveNotes) {
+                moved += r.count;
+            }
+        }
+    }
+    const double seconds =
+        std::chrono::duration<double>(Clock::now() - start).count();
+
+    client.close();
+    done = true;
+    if (ui.joinable()) {
+        ui.join();
+    }
+    if (!ok) {
+        std::fprintf(stderr, "client: %s\n", client.error().c_str());
+        return 1;
+    }
+
+    double apply_total = 0.0;
+    double queued_total = 0.0;
+    for (std::size_t i = 0; i < apply_ms.size(); ++i) {
+        apply_total += apply_ms[i];
+        queued_total += queued_ms[i];
+    }
+    const double count = static_cast<double>(std::max<std::size_t>(received, 1));
+    const double safe_seconds = std::max(seconds, 1e-9);
+    std::printf(
+        "%zu batches (%zu notes each, %zu in flight) in %.3f s: "
+        "%.1f batches/s, %.0f notes inserted/s, %zu notes moved\n",
+        received,
+        options.notes,
+        options.inflight,
+        seconds,
+        static_cast<double>(received) / safe_seconds,
+        static_cast<double>(inserted) / safe_seconds,
+        moved);
+    std::printf(
+        "round trip ms: p50 %.3f  p99 %.3f  max %.3f\n"
+        "server ms per batch: queued %.3f  apply %.3f (mean)\n",
+        percentile(round_trip_ms, 0.5),
+        percentile(round_trip_ms, 0.99),
+        percentile(round_trip_ms, 1.0),
+        queued_total / count,
+        apply_total / count);
+    return 0;
+}
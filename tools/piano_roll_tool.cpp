@@ -0,0 +1,923 @@
+// piano_roll_tool: batch conversion, validation, statistics and transforms
+// for PPR1 text files and Standard MIDI Files, built on the piano_roll
+// library. PPR1 input is streamed record by record wherever the operation
+// allows it; see usage() for the commands.
+
+#include "piano_roll/midi_file.hpp"
+#include "piano_roll/note_cleanup.hpp"
+#include "piano_roll/parallel.hpp"
+#include "piano_roll/serialization.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cctype>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace fs = std::filesystem;
+using namespace piano_roll;
+
+namespace {
+
+constexpr std::size_t kMaxIssuesShown = 20;
+
+void usage() {
+    std::fputs(
+        "usage: piano_roll_tool <command> [options] <files...>\n"
+        "\n"
+        "commands:\n"
+        "  convert <input> <output>   convert between formats (by extension:\n"
+        "                             .mid/.midi/.smf = Standard MIDI File,\n"
+        "                             anything else = PPR1)\n"
+        "  validate <files...>        check files, exit 1 if any is invalid\n"
+        "  stats <files...>           note counts per key/channel, extents,\n"
+        "                             overlaps and CC densities\n"
+        "  transform <files...>       apply transforms to every file\n"
+        "\n"
+        "options:\n"
+        "  --tpb <n>                  ticks per beat (default 480)\n"
+        "  -j <n>                     worker threads, 0 = all cores "
+        "(default)\n"
+        "\n"
+        "transform options:\n"
+        "  --transpose <keys>         shift keys; notes leaving 0-127 are "
+        "dropped\n"
+        "  --shift <ticks>            shift notes and CC points in time\n"
+        "  --quantize <ticks>         round note starts to a grid\n"
+        "  --velocity-scale <f>       scale velocities (clamped to 1-127)\n"
+        "  --cleanup                  remove duplicates and trim overlaps\n"
+        "                             (loads the whole file)\n"
+        "  --to <ppr|mid>             output format (default: same as "
+        "input)\n"
+        "  --out-dir <dir>            write outputs there (default: next to "
+        "input)\n"
+        "  --suffix <s>               appended to output stems (default "
+        "_out; may be\n"
+        "                             empty with --out-dir)\n",
+        stderr);
+}
+
+enum class FileFormat { Ppr1, Smf };
+
+FileFormat format_for(const fs::path& path) {
+    std::string ext = path.extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) {
+        return static_cast<char>(std::tolower(c));
+    });
+    if (ext == ".mid" || ext == ".midi" || ext == ".smf") {
+        return FileFormat::Smf;
+    }
+    return FileFormat::Ppr1;
+}
+
+const char* format_name(FileFormat format) {
+    return format == FileFormat::Smf ? "SMF" : "PPR1";
+}
+
+template <typename T>
+bool parse_number(std::string_view text, T& value) {
+    auto [ptr, ec] =
+        std::from_chars(text.data(), text.data() + text.size(), value);
+    return ec == std::errc{} && ptr == text.data() + text.size();
+}
+
+std::string key_name(int key) {
+    static const char* names[12] = {
+        "C", "C#", "D", "D#", "E", "F", "F#", "G", "G#", "A", "A#", "B"};
+    if (key < 0 || key > 127) {
+        return "?";
+    }
+    return std::string(names[key % 12]) + std::to_string(key / 12 - 2);
+}
+
+std::uintmax_t file_size_or_zero(const fs::path& path) {
+    std::error_code ec;
+    std::uintmax_t size = fs::file_size(path, ec);
+    return ec ? 0 : size;
+}
+
+struct Options {
+    std::vector<std::string> files;
+    int ticks_per_beat{480};
+    unsigned jobs{0};
+
+    int transpose{0};
+    Tick shift{0};
+    Tick quantize{0};
+    double velocity_scale{1.0};
+    bool cleanup{false};
+    bool has_target_format{false};
+    FileFormat target_format{FileFormat::Ppr1};
+    std::string out_dir;
+    std::string suffix{"_out"};
+};
+
+bool parse_options(int argc, char** argv, int first, Options& options) {
+    for (int i = first; i < argc; ++i) {
+        std::string_view arg = argv[i];
+        auto value = [&](std::string_view& out) {
+            if (i + 1 >= argc) {
+                std::fprintf(stderr, "missing value for %s\n", argv[i]);
+                return false;
+            }
+            out = argv[++i];
+            return true;
+        };
+        std::string_view v;
+        bool ok = true;
+        if (arg == "--tpb") {
+            ok = value(v) && parse_number(v, options.ticks_per_beat) &&
+                 options.ticks_per_beat > 0;
+        } else if (arg == "-j") {
+            ok = value(v) && parse_number(v, options.jobs);
+        } else if (arg == "--transpose") {
+            ok = value(v) && parse_number(v, options.transpose);
+        } else if (arg == "--shift") {
+            ok = value(v) && parse_number(v, options.shift);
+        } else if (arg == "--quantize") {
+            ok = value(v) && parse_number(v, options.quantize) &&
+                 options.quantize >= 0;
+        } else if (arg == "--velocity-scale") {
+            ok = value(v) && parse_number(v, options.velocity_scale) &&
+                 options.velocity_scale >= 0.0;
+        } else if (arg == "--cleanup") {
+            options.cleanup = true;
+        } else if (arg == "--to") {
+            ok = value(v) && (v == "ppr" || v == "mid");
+            options.has_target_format = true;
+            options.target_format =
+                v == "mid" ? FileFormat::Smf : FileFormat::Ppr1;
+        } else if (arg == "--out-dir") {
+            ok = value(v);
+            options.out_dir = std::string(v);
+        } else if (arg == "--suffix") {
+            ok = value(v);
+            options.suffix = std::string(v);
+        } else if (arg.size() > 1 && arg[0] == '-') {
+            std::fprintf(stderr, "unknown option %s\n", argv[i]);
+            return false;
+        } else {
+            options.files.emplace_back(arg);
+        }
+        if (!ok) {
+            std::fprintf(stderr, "invalid value for %s\n", argv[i]);
+            return false;
+        }
+    }
+    return true;
+}
+
+// Run fn(i) for every file index, each worker pulling the next file so
+// large and small files balance out.
+template <typename Fn>
+void for_each_file(std::size_t count, unsigned jobs, Fn&& fn) {
+    std::atomic<std::size_t> next{0};
+    const std::size_t workers =
+        std::min<std::size_t>(resolve_thread_count(jobs), count);
+    parallel_chunks(workers,
+                    static_cast<unsigned>(workers),
+                    [&](std::size_t, std::size_t) {
+                        for (std::size_t i = next++; i < count; i = next++) {
+                            fn(i);
+                        }
+                    });
+}
+
+bool load_file(const fs::path& path,
+               NoteManager& notes,
+               std::vector<ControlLane>& lanes,
+               int ticks_per_beat,
+               std::string& error) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        error = "cannot open file";
+        return false;
+    }
+    if (format_for(path) == FileFormat::Smf) {
+        SmfReadResult result =
+            read_smf(notes, lanes, in, SmfReadOptions{ticks_per_beat});
+        if (!result.ok) {
+            error = result.error;
+            return false;
+        }
+        return true;
+    }
+    try {
+        deserialize_notes_and_cc(notes, lanes, in);
+    } catch (const std::exception& e) {
+        error = e.what();
+        return false;
+    }
+    return true;
+}
+
+bool save_file(const fs::path& path,
+               FileFormat format,
+               const NoteManager& notes,
+               const std::vector<ControlLane>& lanes,
+               int ticks_per_beat,
+               std::string& error) {
+    std::ofstream out(path, std::ios::binary);
+    if (!out) {
+        error = "cannot create " + path.string();
+        return false;
+    }
+    if (format == FileFormat::Smf) {
+        SmfWriteOptions options;
+        options.ticks_per_beat = ticks_per_beat;
+        options.bounce.max_threads = 1;
+        write_smf(notes, lanes, out, options);
+    } else {
+        serialize_notes_and_cc(notes, lanes, out);
+    }
+    if (!out) {
+        error = "write failed for " + path.string();
+        return false;
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Per-note and per-point transforms shared by the streaming and loaded paths.
+
+struct Transform {
+    int transpose{0};
+    Tick shift{0};
+    Tick quantize{0};
+    double velocity_scale{1.0};
+
+    // Returns false when the note leaves the valid range and is dropped.
+    bool apply(Note& note) const noexcept {
+        note.tick += shift;
+        if (quantize > 0) {
+            const Tick half = quantize / 2;
+            const Tick q = note.tick >= 0 ? (note.tick + half) / quantize
+                                          : -((half - note.tick) / quantize);
+            note.tick = q * quantize;
+        }
+        note.key += transpose;
+        if (velocity_scale != 1.0) {
+            note.velocity = std::clamp(
+                static_cast<int>(std::lround(note.velocity * velocity_scale)),
+                1,
+                127);
+        }
+        return note.tick >= 0 && note.key >= 0 && note.key <= 127;
+    }
+
+    bool apply(ControlPoint& point) const noexcept {
+        point.tick += shift;
+        return point.tick >= 0;
+    }
+};
+
+struct TransformResult {
+    bool ok{false};
+    bool streamed{false};
+    std::string error;
+    fs::path output;
+    std::size_t notes_in{0};
+    std::size_t notes_out{0};
+    std::size_t cc_points{0};
+    std::uintmax_t bytes_in{0};
+};
+
+// PPR1 to PPR1 without cleanup: one record in, at most one record out.
+void transform_stream(std::istream& in,
+                      std::ostream& out,
+                      const Transform& transform,
+                      TransformResult& result) {
+    write_ppr1_header(out);
+    Ppr1Reader reader(in);
+    Ppr1Reader::Record record;
+    bool keep_expression = false;
+    while (reader.next(record)) {
+        switch (record.type) {
+        case Ppr1Reader::RecordType::Note:
+            ++result.notes_in;
+            keep_expression = transform.apply(record.note);
+            if (keep_expression) {
+                write_ppr1_note(out, record.note);
+                ++result.notes_out;
+            }
+            break;
+        case Ppr1Reader::RecordType::Expression:
+            if (keep_expression) {
+                write_ppr1_expression(out, record.expression);
+            }
+            break;
+        case Ppr1Reader::RecordType::Control:
+            if (transform.apply(record.control)) {
+                write_ppr1_control(out, record.cc, record.control);
+                ++result.cc_points;
+            }
+            break;
+        case Ppr1Reader::RecordType::Malformed:
+            break;
+        }
+    }
+}
+
+void transform_loaded(NoteManager& notes,
+                      std::vector<ControlLane>& lanes,
+                      const Transform& transform,
+                      bool cleanup,
+                      TransformResult& result) {
+    result.notes_in = notes.notes().size();
+    std::vector<NoteEdit> edits;
+    std::vector<NoteId> removals;
+    for (Note& note : notes.notes()) {
+        Note moved = note;
+        if (!transform.apply(moved)) {
+            removals.push_back(note.id);
+            continue;
+        }
+        note.velocity = moved.velocity;
+        if (moved.tick != note.tick || moved.key != note.key) {
+            edits.push_back(
+                NoteEdit{note.id, moved.tick, moved.duration, moved.key});
+        }
+    }
+    notes.apply_note_edits(edits, removals, /*record_undo=*/false);
+
+    for (ControlLane& lane : lanes) {
+        std::vector<ControlPoint>& points = lane.points();
+        std::erase_if(points, [&transform](ControlPoint& p) {
+            return !transform.apply(p);
+        });
+        result.cc_points += points.size();
+    }
+
+    if (cleanup) {
+        CleanupOptions options;
+        options.max_threads = 1;
+        CleanupFixes fixes;
+        fixes.legato = false;
+        apply_cleanup(notes,
+                      analyze_notes(notes, options),
+                      fixes,
+                      /*record_undo=*/false);
+    }
+    result.notes_out = notes.notes().size();
+}
+
+fs::path output_path(const fs::path& input,
+                     FileFormat format,
+                     const Options& options) {
+    fs::path dir = options.out_dir.empty() ? input.parent_path()
+                                           : fs::path(options.out_dir);
+    std::string ext = input.extension().string();
+    if (format != format_for(input)) {
+        ext = format == FileFormat::Smf ? ".mid" : ".ppr";
+    }
+    return dir / (input.stem().string() + options.suffix + ext);
+}
+
+TransformResult transform_file(const fs::path& input, const Options& options) {
+    TransformResult result;
+    result.bytes_in = file_size_or_zero(input);
+    const FileFormat in_format = format_for(input);
+    const FileFormat out_format =
+        options.has_target_format ? options.target_format : in_format;
+    result.output = output_path(input, out_format, options);
+    if (fs::exists(result.output) &&
+        fs::equivalent(result.output, input)) {
+        result.error = "output would overwrite the input";
+        return result;
+    }
+
+    Transform transform;
+    transform.transpose = options.transpose;
+    transform.shift = options.shift;
+    transform.quantize = options.quantize;
+    transform.velocity_scale = options.velocity_scale;
+
+    if (in_format == FileFormat::Ppr1 && out_format == FileFormat::Ppr1 &&
+        !options.cleanup) {
+        std::ifstream in(input, std::ios::binary);
+        if (!in) {
+            result.error = "cannot open file";
+            return result;
+        }
+        std::ofstream out(result.output, std::ios::binary);
+        if (!out) {
+            result.error = "cannot create " + result.output.string();
+            return result;
+        }
+        transform_stream(in, out, transform, result);
+        result.streamed = true;
+        result.ok = static_cast<bool>(out);
+        if (!result.ok) {
+            result.error = "write failed";
+        }
+        return result;
+    }
+
+    NoteManager notes;
+    std::vector<ControlLane> lanes;
+    if (!load_file(
+            input, notes, lanes, options.ticks_per_beat, result.error)) {
+        return result;
+    }
+    transform_loaded(notes, lanes, transform, options.cleanup, result);
+    result.ok = save_file(result.output,
+                          out_format,
+                          notes,
+                          lanes,
+                          options.ticks_per_beat,
+                          result.error);
+    return result;
+}
+
+// ---------------------------------------------------------------------------
+// validate
+
+struct ValidationReport {
+    bool valid{true};
+    std::size_t notes{0};
+    std::size_t control_points{0};
+    std::size_t issue_count{0};
+    std::vector<std::string> issues;    // first kMaxIssuesShown
+    std::vector<std::string> warnings;
+};
+
+void add_issue(ValidationReport& report, std::string text) {
+    report.valid = false;
+    if (report.issues.size() < kMaxIssuesShown) {
+        report.issues.push_back(std::move(text));
+    }
+    ++report.issue_count;
+}
+
+void validate_ppr1(std::istream& in, ValidationReport& report) {
+    Ppr1Reader reader(in);
+    Ppr1Reader::Record record;
+    bool seen_note = false;
+    auto at = [&record](const char* what) {
+        return "line " + std::to_string(record.line) + ": " + what;
+    };
+    while (reader.next(record)) {
+        switch (record.type) {
+        case Ppr1Reader::RecordType::Note: {
+            const Note& n = record.note;
+            seen_note = true;
+            ++report.notes;
+            if (n.tick < 0) add_issue(report, at("negative note tick"));
+            if (n.duration <= 0) add_issue(report, at("non-positive duration"));
+            if (n.key < 0 || n.key > 127) add_issue(report, at("key outside 0-127"));
+            if (n.velocity < 0 || n.velocity > 127)
+                add_issue(report, at("velocity outside 0-127"));
+            if (n.channel < 0 || n.channel > 15)
+                add_issue(report, at("channel outside 0-15"));
+            break;
+        }
+        case Ppr1Reader::RecordType::Expression:
+            if (!seen_note) {
+                add_issue(report, at("expression point before any note"));
+            }
+            break;
+        case Ppr1Reader::RecordType::Control: {
+            const ControlPoint& p = record.control;
+            ++report.control_points;
+            if (record.cc < 0 || record.cc > 127)
+                add_issue(report, at("controller number outside 0-127"));
+            if (p.tick < 0) add_issue(report, at("negative CC tick"));
+            if (p.value < 0 || p.value > 127)
+                add_issue(report, at("CC value outside 0-127"));
+            break;
+        }
+        case Ppr1Reader::RecordType::Malformed:
+            add_issue(report, at("malformed record"));
+            break;
+        }
+    }
+    if (!reader.has_header()) {
+        add_issue(report, "missing PPR1 header");
+    }
+    if (reader.skipped_lines() > 0) {
+        report.warnings.push_back("lines of unknown type ignored: " +
+                                  std::to_string(reader.skipped_lines()));
+    }
+}
+
+ValidationReport validate_file(const fs::path& path, int ticks_per_beat) {
+    ValidationReport report;
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        add_issue(report, "cannot open file");
+        return report;
+    }
+    if (format_for(path) == FileFormat::Ppr1) {
+        validate_ppr1(in, report);
+        return report;
+    }
+
+    NoteManager notes;
+    std::vector<ControlLane> lanes;
+    SmfReadResult result =
+        read_smf(notes, lanes, in, SmfReadOptions{ticks_per_beat});
+    if (!result.ok) {
+        add_issue(report, result.error);
+        return report;
+    }
+    report.notes = result.notes;
+    report.control_points = result.control_points;
+    if (result.unmatched_note_offs > 0) {
+        report.warnings.push_back(
+            std::to_string(result.unmatched_note_offs) +
+            " note-offs without a sounding note");
+    }
+    if (result.unterminated_notes > 0) {
+        report.warnings.push_back(std::to_string(result.unterminated_notes) +
+                                  " notes never released");
+    }
+    return report;
+}
+
+// ---------------------------------------------------------------------------
+// stats
+
+struct LaneStats {
+    std::size_t points{0};
+    Tick first{std::numeric_limits<Tick>::max()};
+    Tick last{std::numeric_limits<Tick>::min()};
+};
+
+struct FileStats {
+    bool ok{true};
+    std::string error;
+    std::size_t notes{0};
+    std::size_t expression_points{0};
+    std::array<std::size_t, 128> per_key{};
+    std::array<std::size_t, 16> per_channel{};
+    std::size_t other_channel{0};
+    Tick first_tick{std::numeric_limits<Tick>::max()};
+    Tick last_tick{std::numeric_limits<Tick>::min()};
+    std::size_t overlapping_notes{0};
+    std::size_t overlapping_keys{0};
+    std::map<int, LaneStats> lanes;
+
+    // (start, end) per key, kept only until the overlap count is done.
+    std::array<std::vector<std::pair<Tick, Tick>>, 128> spans;
+
+    void add_note(const Note& n) {
+        ++notes;
+        first_tick = std::min(first_tick, n.tick);
+        last_tick = std::max(last_tick, n.end_tick());
+        if (n.key >= 0 && n.key <= 127) {
+            ++per_key[static_cast<std::size_t>(n.key)];
+            spans[static_cast<std::size_t>(n.key)].emplace_back(n.tick,
+                                                                n.end_tick());
+        }
+        if (n.channel >= 0 && n.channel <= 15) {
+            ++per_channel[static_cast<std::size_t>(n.channel)];
+        } else {
+            ++other_channel;
+        }
+    }
+
+    void add_control(int cc, const ControlPoint& p) {
+        LaneStats& lane = lanes[cc];
+        ++lane.points;
+        lane.first = std::min(lane.first, p.tick);
+        lane.last = std::max(lane.last, p.tick);
+    }
+
+    void finish() {
+        for (auto& key_spans : spans) {
+            std::sort(key_spans.begin(), key_spans.end());
+            Tick reach = std::numeric_limits<Tick>::min();
+            std::size_t before = overlapping_notes;
+            for (const auto& [start, end] : key_spans) {
+                if (start < reach) {
+                    ++overlapping_notes;
+                }
+                reach = std::max(reach, end);
+            }
+            if (overlapping_notes != before) {
+                ++overlapping_keys;
+            }
+            key_spans = {};
+        }
+    }
+};
+
+FileStats stats_for_file(const fs::path& path, int ticks_per_beat) {
+    FileStats stats;
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        stats.ok = false;
+        stats.error = "cannot open file";
+        return stats;
+    }
+    if (format_for(path) == FileFormat::Ppr1) {
+        Ppr1Reader reader(in);
+        Ppr1Reader::Record record;
+        while (reader.next(record)) {
+            if (record.type == Ppr1Reader::RecordType::Note) {
+                stats.add_note(record.note);
+            } else if (record.type == Ppr1Reader::RecordType::Expression) {
+                ++stats.expression_points;
+            } else if (record.type == Ppr1Reader::RecordType::Control) {
+                stats.add_control(record.cc, record.control);
+            }
+        }
+    } else {
+        NoteManager notes;
+        std::vector<ControlLane> lanes;
+        SmfReadResult result =
+            read_smf(notes, lanes, in, SmfReadOptions{ticks_per_beat});
+        if (!result.ok) {
+            stats.ok = false;
+            stats.error = result.error;
+            return stats;
+        }
+        for (const Note& n : notes.notes()) {
+            stats.add_note(n);
+        }
+        for (const ControlLane& lane : lanes) {
+            for (const ControlPoint& p : lane.points()) {
+                stats.add_control(lane.cc_number(), p);
+            }
+        }
+    }
+    stats.finish();
+    return stats;
+}
+
+std::string format_stats(const fs::path& path,
+                         const FileStats& s,
+                         int ticks_per_beat) {
+    std::ostringstream out;
+    out << path.string() << " [" << format_name(format_for(path)) << "]\n";
+    if (!s.ok) {
+        out << "  error: " << s.error << "\n";
+        return out.str();
+    }
+    out << "  notes        " << s.notes << " (" << s.expression_points
+        << " expression points)\n";
+    if (s.notes > 0) {
+        const double beats = static_cast<double>(s.last_tick - s.first_tick) /
+                             ticks_per_beat;
+        out << "  extent       ticks " << s.first_tick << ".." << s.last_tick
+            << " (" << beats << " beats at " << ticks_per_beat << " tpb)\n";
+        out << "  overlapping  " << s.overlapping_notes << " notes on "
+            << s.overlapping_keys << " keys\n";
+
+        out << "  channels    ";
+        for (std::size_t c = 0; c < s.per_channel.size(); ++c) {
+            if (s.per_channel[c] > 0) {
+                out << " " << c << ":" << s.per_channel[c];
+            }
+        }
+        if (s.other_channel > 0) {
+            out << " other:" << s.other_channel;
+        }
+        out << "\n  keys\n";
+        int column = 0;
+        for (int key = 0; key < 128; ++key) {
+            const std::size_t count = s.per_key[static_cast<std::size_t>(key)];
+            if (count == 0) {
+                continue;
+            }
+            if (column == 0) {
+                out << "   ";
+            }
+            out << " " << key_name(key) << "(" << key << "):" << count;
+            if (++column == 8) {
+                out << "\n";
+                column = 0;
+            }
+        }
+        if (column != 0) {
+            out << "\n";
+        }
+    }
+    out << "  cc lanes     " << s.lanes.size() << "\n";
+    for (const auto& [cc, lane] : s.lanes) {
+        const double beats =
+            std::max(1.0,
+                     static_cast<double>(lane.last - lane.first) /
+                         ticks_per_beat);
+        out << "    cc " << cc << ": " << lane.points << " points, ticks "
+            << lane.first << ".." << lane.last << ", "
+            << static_cast<double>(lane.points) / beats << " points/beat\n";
+    }
+    return out.str();
+}
+
+// ---------------------------------------------------------------------------
+// commands
+
+int run_convert(const Options& options) {
+    if (options.files.size() != 2) {
+        usage();
+        return 2;
+    }
+    const fs::path input = options.files[0];
+    const fs::path output = options.files[1];
+    const FileFormat in_format = format_for(input);
+    const FileFormat out_format = format_for(output);
+    std::string error;
+
+    if (in_format == FileFormat::Ppr1 && out_format == FileFormat::Ppr1) {
+        // Streams through, normalising the records.
+        std::ifstream in(input, std::ios::binary);
+        std::ofstream out(output, std::ios::binary);
+        if (!in || !out) {
+            std::fprintf(stderr, "cannot open %s\n",
+                         (!in ? input : output).string().c_str());
+            return 1;
+        }
+        TransformResult result;
+        transform_stream(in, out, Transform{}, result);
+        return out ? 0 : 1;
+    }
+
+    NoteManager notes;
+    std::vector<ControlLane> lanes;
+    if (!load_file(input, notes, lanes, options.ticks_per_beat, error) ||
+        !save_file(output,
+                   out_format,
+                   notes,
+                   lanes,
+                   options.ticks_per_beat,
+                   error)) {
+        std::fprintf(stderr, "%s: %s\n", input.string().c_str(), error.c_str());
+        return 1;
+    }
+    std::printf("%s [%s] -> %s [%s]: %zu notes, %zu cc lanes\n",
+                input.string().c_str(),
+                format_name(in_format),
+                output.string().c_str(),
+                format_name(out_format),
+                notes.notes().size(),
+                lanes.size());
+    return 0;
+}
+
+int run_validate(const Options& options) {
+    std::vector<ValidationReport> reports(options.files.size());
+    for_each_file(options.files.size(), options.jobs, [&](std::size_t i) {
+        reports[i] = validate_file(options.files[i], options.ticks_per_beat);
+    });
+
+    std::size_t invalid = 0;
+    for (std::size_t i = 0; i < reports.size(); ++i) {
+        const ValidationReport& r = reports[i];
+        if (r.valid) {
+            std::printf("%s: OK (%zu notes, %zu cc points)\n",
+                        options.files[i].c_str(),
+                        r.notes,
+                        r.control_points);
+        } else {
+            ++invalid;
+            std::printf("%s: INVALID (%zu issues)\n",
+                        options.files[i].c_str(),
+                        r.issue_count);
+            for (const std::string& issue : r.issues) {
+                std::printf("  %s\n", issue.c_str());
+            }
+            if (r.issue_count > r.issues.size()) {
+                std::printf("  ... %zu more\n", r.issue_count - r.issues.size());
+            }
+        }
+        for (const std::string& warning : r.warnings) {
+            std::printf("  warning: %s\n", warning.c_str());
+        }
+    }
+    if (reports.size() > 1) {
+        std::printf("%zu files, %zu invalid\n", reports.size(), invalid);
+    }
+    return invalid == 0 ? 0 : 1;
+}
+
+int run_stats(const Options& options) {
+    std::vector<std::string> reports(options.files.size());
+    std::vector<std::size_t> note_counts(options.files.size(), 0);
+    std::atomic<bool> all_ok{true};
+    for_each_file(options.files.size(), options.jobs, [&](std::size_t i) {
+        FileStats stats =
+            stats_for_file(options.files[i], options.ticks_per_beat);
+        note_counts[i] = stats.notes;
+        if (!stats.ok) {
+            all_ok = false;
+        }
+        reports[i] =
+            format_stats(options.files[i], stats, options.ticks_per_beat);
+    });
+    for (const std::string& report : reports) {
+        std::fputs(report.c_str(), stdout);
+    }
+    if (reports.size() > 1) {
+        std::size_t total = 0;
+        for (std::size_t n : note_counts) {
+            total += n;
+        }
+        std::printf("%zu files, %zu notes\n", reports.size(), total);
+    }
+    return all_ok ? 0 : 1;
+}
+
+int run_transform(const Options& options) {
+    if (!options.out_dir.empty()) {
+        std::error_code ec;
+        fs::create_directories(options.out_dir, ec);
+        if (ec) {
+            std::fprintf(stderr, "cannot create %s\n", options.out_dir.c_str());
+            return 1;
+        }
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<TransformResult> results(options.files.size());
+    for_each_file(options.files.size(), options.jobs, [&](std::size_t i) {
+        results[i] = transform_file(options.files[i], options);
+    });
+    const double seconds = std::chrono::duration<double>(
+                               std::chrono::steady_clock::now() - start)
+                               .count();
+
+    std::size_t failed = 0;
+    std::size_t notes = 0;
+    std::uintmax_t bytes = 0;
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        const TransformResult& r = results[i];
+        if (!r.ok) {
+            ++failed;
+            std::printf("%s: FAILED (%s)\n",
+                        options.files[i].c_str(),
+                        r.error.c_str());
+            continue;
+        }
+        notes += r.notes_in;
+        bytes += r.bytes_in;
+        std::printf("%s -> %s: %zu -> %zu notes, %zu cc points%s\n",
+                    options.files[i].c_str(),
+                    r.output.string().c_str(),
+                    r.notes_in,
+                    r.notes_out,
+                    r.cc_points,
+                    r.streamed ? " (streamed)" : "");
+    }
+
+    const double safe_seconds = std::max(seconds, 1e-9);
+    std::printf(
+        "transformed %zu files (%zu failed) in %.3f s on %zu threads: "
+        "%.1f files/s, %.0f notes/s, %.2f MB/s\n",
+        results.size() - failed,
+        failed,
+        seconds,
+        std::min<std::size_t>(resolve_thread_count(options.jobs),
+                              std::max<std::size_t>(results.size(), 1)),
+        static_cast<double>(results.size()) / safe_seconds,
+        static_cast<double>(notes) / safe_seconds,
+        static_cast<double>(bytes) / (1024.0 * 1024.0) / safe_seconds);
+    return failed == 0 ? 0 : 1;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        usage();
+        return 2;
+    }
+    const std::string_view command = argv[1];
+    Options options;
+    if (!parse_options(argc, argv, 2, options)) {
+        return 2;
+    }
+    if (options.files.empty()) {
+        usage();
+        return 2;
+    }
+
+    if (command == "convert") {
+        return run_convert(options);
+    }
+    if (command == "validate") {
+        return run_validate(options);
+    }
+    if (command == "stats") {
+        return run_stats(options);
+    }
+    if (command == "transform") {
+        return run_transform(options);
+    }
+    std::fprintf(stderr, "unknown command %s\n", argv[1]);
+    usage();
+    return 2;
+}
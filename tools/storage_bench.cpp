@@ -0,0 +1,266 @@
+// piano_roll_storage_bench: range-query cost before and after
+// NoteManager::compact_storage. It builds a clip, scatters storage with a
+// simulated edit session (notes deleted, re-added at random times and
+// moved), then sweeps a viewport-sized for_each_in_range window across the
+// clip on the scattered and on the compacted storage. Besides wall time it
+// reports how many distinct 64-byte lines of note storage each query
+// touches, a portable stand-in for the cache misses the compaction saves.
+// See usage() for the options.
+
+#include "piano_roll/note_manager.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <span>
+#include <string_view>
+#include <vector>
+
+using namespace piano_roll;
+
+namespace {
+
+void usage() {
+    std::fputs(
+        "usage: piano_roll_storage_bench [options]\n"
+        "\n"
+        "options:\n"
+        "  --notes <n>          notes in the clip (default 400000)\n"
+        "  --edits <n>          edit batches in the scattering session\n"
+        "                       (default 40)\n"
+        "  --batch <n>          notes deleted, re-added and moved per edit\n"
+        "                       batch (default 2560)\n"
+        "  --window <ticks>     width of each range query (default 7680,\n"
+        "                       four 4/4 bars at 480 ppq)\n"
+        "  --passes <n>         sweeps across the clip per measurement\n"
+        "                       (default 5)\n",
+        stderr);
+}
+
+struct Options {
+    std::size_t notes{400000};
+    std::size_t edits{40};
+    std::size_t batch{2560};
+    Tick window{7680};
+    std::size_t passes{5};
+};
+
+template <typename T>
+bool parse_number(std::string_view text, T& out) {
+    const char* end = text.data() + text.size();
+    auto [ptr, ec] = std::from_chars(text.data(), end, out);
+    return ec == std::errc() && ptr == end;
+}
+
+bool parse_options(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view arg = argv[i];
+        if (i + 1 >= argc) {
+            return false;
+        }
+        const std::string_view value = argv[++i];
+        bool ok = false;
+        if (arg == "--notes") {
+            ok = parse_number(value, options.notes) && options.notes > 0;
+        } else if (arg == "--edits") {
+            ok = parse_number(value, options.edits);
+        } else if (arg == "--batch") {
+            ok = parse_number(value, options.batch);
+        } else if (arg == "--window") {
+            ok = parse_number(value, options.window) && options.window > 0;
+        } else if (arg == "--passes") {
+            ok = parse_number(value, options.passes) && options.passes > 0;
+        }
+        if (!ok) {
+            return false;
+        }
+    }
+    return true;
+}
+
+Note random_note(std::mt19937& rng, Tick clip_end) {
+    Note note;
+    note.tick = static_cast<Tick>(rng() % static_cast<std::uint32_t>(clip_end));
+    note.duration = 60 + static_cast<Duration>(rng() % 900);
+    note.key = 24 + static_cast<MidiKey>(rng() % 72);
+    note.velocity = 40 + static_cast<Velocity>(rng() % 88);
+    return note;
+}
+
+struct SweepResult {
+    double ms{0.0};
+    std::size_t visited{0};
+    std::size_t queries{0};
+    std::size_t lines{0};  // over one sweep, see touched_lines
+    std::int64_t checksum{0};
+};
+
+// Time `passes` sweeps of [start, start + window) across the clip.
+SweepResult time_sweeps(const NoteManager& notes,
+                        Tick clip_end,
+                        Tick window,
+                        std::size_t passes) {
+    using Clock = std::chrono::steady_clock;
+    SweepResult result;
+    const auto start = Clock::now();
+    for (std::size_t pass = 0; pass < passes; ++pass) {
+        for (Tick tick = 0; tick < clip_end; tick += window) {
+            notes.for_each_in_range(
+                tick, tick + window, 0, 127, [&result](const Note& note) {
+                    result.checksum += note.tick + note.velocity;
+                    ++result.visited;
+                });
+            ++result.queries;
+        }
+    }
+    result.ms =
+        std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    return result;
+}
+
+// Distinct 64-byte lines of notes() storage touched by one sweep (untimed).
+std::size_t touched_lines(const NoteManager& notes, Tick clip_end, Tick window) {
+    const auto base = reinterpret_cast<std::uintptr_t>(notes.notes().data());
+    std::vector<std::uintptr_t> lines;
+    std::size_t total = 0;
+    for (Tick tick = 0; tick < clip_end; tick += window) {
+        lines.clear();
+        notes.for_each_in_range(
+            tick, tick + window, 0, 127, [&](const Note& note) {
+                const auto offset =
+                    reinterpret_cast<std::uintptr_t>(&note) - base;
+                lines.push_back(offset / 64);
+                lines.push_back((offset + sizeof(Note) - 1) / 64);
+            });
+        std::sort(lines.begin(), lines.end());
+        total += static_cast<std::size_t>(
+            std::unique(lines.begin(), lines.end()) - lines.begin());
+    }
+    return total;
+}
+
+void report(const char* label, const SweepResult& result, std::size_t passes) {
+    const double visited =
+        static_cast<double>(std::max<std::size_t>(result.visited, 1));
+    const double queries =
+        static_cast<double>(std::max<std::size_t>(result.queries, 1));
+    std::printf(
+        "%-10s %9.2f ms  %6.2f ns/note  %7.1f us/query  "
+        "%8.1f lines/query\n",
+        label,
+        result.ms,
+        result.ms * 1e6 / visited,
+        result.ms * 1e3 / queries,
+        static_cast<double>(result.lines) * static_cast<double>(passes) /
+            queries);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parse_options(argc, argv, options)) {
+        usage();
+        return 2;
+    }
+
+    // Roughly eight notes per beat across all keys.
+    const Tick clip_end = std::max<Tick>(
+        static_cast<Tick>(options.notes / 8) * 480, options.window);
+    std::mt19937 rng(1);
+
+    // The clip starts out recorded in time order, i.e. already compact.
+    std::vector<Note> initial(options.notes);
+    for (Note& note : initial) {
+        note = random_note(rng, clip_end);
+    }
+    std::sort(initial.begin(), initial.end(), [](const Note& a, const Note& b) {
+        return a.tick != b.tick ? a.tick < b.tick : a.key < b.key;
+    });
+    NoteManager notes;
+    notes.set_max_undo_levels(0);
+    notes.add_notes(initial, false);
+    notes.compact_storage();
+
+    // Edit session: each batch deletes random notes, records new ones at
+    // random times (appended at the end of storage) and moves others.
+    std::vector<NoteId> ids;
+    std::vector<Note> fresh(options.batch);
+    std::vector<NoteEdit> moves;
+    for (std::size_t edit = 0; edit < options.edits; ++edit) {
+        ids.clear();
+        for (const Note& note : notes.notes()) {
+            ids.push_back(note.id);
+        }
+        // Partial shuffle: the first 2 * count ids are a random sample.
+        const std::size_t count = std::min(options.batch, ids.size() / 2);
+        for (std::size_t i = 0; i < 2 * count; ++i) {
+            std::swap(ids[i], ids[i + rng() % (ids.size() - i)]);
+        }
+        notes.remove_notes(std::span<const NoteId>(ids.data(), count), false);
+
+        for (Note& note : fresh) {
+            note = random_note(rng, clip_end);
+        }
+        notes.add_notes(fresh, false);
+
+        moves.clear();
+        for (std::size_t i = count; i < 2 * count; ++i) {
+            const Note* note = notes.find_by_id(ids[i]);
+            if (note != nullptr) {
+                const Note target = random_note(rng, clip_end);
+                moves.push_back(
+                    NoteEdit{note->id, target.tick, note->duration, note->key});
+            }
+        }
+        notes.apply_note_edits(moves, {}, false);
+    }
+
+    std::printf(
+        "%zu notes over %lld ticks after %zu edit batches of %zu; "
+        "%lld-tick window, %zu passes\n",
+        notes.notes().size(),
+        static_cast<long long>(clip_end),
+        options.edits,
+        options.batch,
+        static_cast<long long>(options.window),
+        options.passes);
+
+    // One untimed sweep first so both runs start with warm indexes.
+    time_sweeps(notes, clip_end, options.window, 1);
+    SweepResult scattered =
+        time_sweeps(notes, clip_end, options.window, options.passes);
+    scattered.lines = touched_lines(notes, clip_end, options.window);
+
+    using Clock = std::chrono::steady_clock;
+    const auto compact_start = Clock::now();
+    notes.compact_storage();
+    const double compact_ms = std::chrono::duration<double, std::milli>(
+                                  Clock::now() - compact_start)
+                                  .count();
+
+    time_sweeps(notes, clip_end, options.window, 1);
+    SweepResult compacted =
+        time_sweeps(notes, clip_end, options.window, options.passes);
+    compacted.lines = touched_lines(notes, clip_end, options.window);
+
+    if (scattered.checksum != compacted.checksum ||
+        scattered.visited != compacted.visited) {
+        std::fprintf(stderr, "range results differ after compaction\n");
+        return 1;
+    }
+
+    report("scattered", scattered, options.passes);
+    report("compacted", compacted, options.passes);
+    std::printf(
+        "compact_storage: %.2f ms; range sweeps %.2fx faster, %.2fx fewer "
+        "storage lines touched\n",
+        compact_ms,
+        scattered.ms / std::max(compacted.ms, 1e-9),
+        static_cast<double>(scattered.lines) /
+            static_cast<double>(std::max<std::size_t>(compacted.lines, 1)));
+    return 0;
+}